@@ -0,0 +1,324 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Provides microbenchmarks of the tensor algebra operations and Lyndon transforms that Signatory is built on.
+
+These are timed directly from C++ (see ta_ops_benchmark.cpp), so that they can be measured without any Python or
+autograd overhead, and the timings are compared against a roofline: the best that could be done given the number of
+floating point operations and the memory traffic involved, and the peak FLOP/s and bytes/s of the hardware.
+"""
+
+import collections as co
+import datetime
+import io
+import itertools as it
+import json
+import os
+import subprocess
+import sys
+import timeit
+import torch
+from torch.utils import cpp_extension as cpp
+
+from . import helpers
+
+
+_here = os.path.realpath(os.path.dirname(__file__))
+_src = os.path.join(os.path.dirname(_here), 'src')
+
+# Everything but the bindings, which ta_ops_benchmark.cpp provides its own replacement for.
+_sources = ['logsignature.cpp',
+            'lyndon.cpp',
+            'misc.cpp',
+            'profiling.cpp',
+            'signature.cpp',
+            'signature_kernel.cpp',
+            'tensor_algebra_ops.cpp',
+            'workspace.cpp']
+_cuda_sources = ['signature_kernel_cuda.cu',
+                 'tensor_algebra_ops_cuda.cu']
+
+
+# The operations that ta_ops_benchmark.time_op knows how to time.
+operations = ('mult', 'restricted_exp', 'mult_fused_restricted_exp', 'log', 'lyndon_words', 'lyndon_brackets')
+
+
+# These are the different predefined sizes that we can produce benchmarks for. Every combination of channels, depth,
+# batch size and stream size is run.
+class Types(helpers.Container):
+    class typical(object):
+        """Tests two typical use cases."""
+        channels = (4,)
+        depths = (4, 6)
+        batches = (32,)
+        streams = (128,)
+
+    class channels(object):
+        """Tests a number of channels for a fixed depth."""
+        channels = (2, 3, 4, 5, 6)
+        depths = (5,)
+        batches = (32,)
+        streams = (128,)
+
+    class depths(object):
+        """Tests depths for a fixed number of channels."""
+        channels = (4,)
+        depths = (2, 3, 4, 5, 6, 7)
+        batches = (32,)
+        streams = (128,)
+
+    class small(object):
+        """Tests on very small data. This doesn't give meaningful results, but serves to test the benchmark framework
+        itself.
+        """
+        channels = (2,)
+        depths = (2, 3)
+        batches = (1,)
+        streams = (2,)
+
+
+def load(verbose=False):
+    """Compiles (or loads the cached copy of) ta_ops_benchmark.cpp together with Signatory's sources.
+
+    This is done in the same way as setup.py does it, so that the CUDA kernels are included if a CUDA toolkit is
+    available.
+    """
+    sources = [os.path.join(_here, 'ta_ops_benchmark.cpp')] + [os.path.join(_src, source) for source in _sources]
+    if sys.platform.startswith('win'):
+        extra_cflags = ['/O2', '/openmp']
+        extra_ldflags = []
+    else:
+        extra_cflags = ['-O3', '-fvisibility=hidden', '-fopenmp']
+        extra_ldflags = ['-fopenmp']
+    extra_cuda_cflags = None
+    if cpp.CUDA_HOME is not None and torch.version.cuda is not None and os.environ.get('SIGNATORY_NO_CUDA', '0') != '1':
+        sources.extend(os.path.join(_src, source) for source in _cuda_sources)
+        extra_cflags.append('-DSIGNATORY_CUDA')
+        extra_cuda_cflags = ['-O3', '-DSIGNATORY_CUDA']
+    return cpp.load(name='signatory_ta_ops_benchmark',
+                    sources=sources,
+                    extra_cflags=extra_cflags,
+                    extra_cuda_cflags=extra_cuda_cflags,
+                    extra_ldflags=extra_ldflags,
+                    extra_include_paths=[_src],
+                    verbose=verbose)
+
+
+def measure_peaks(device):
+    """Measures the FLOP/s of a large matrix multiplication and the bytes/s of a large copy. These are used as the
+    peaks of the roofline, in place of the (typically unattainable) theoretical peaks of the hardware.
+    """
+    def time(fn):
+        fn()  # warm up
+        if device != 'cpu':
+            torch.cuda.synchronize()
+        start = timeit.default_timer()
+        for _ in range(5):
+            fn()
+        if device != 'cpu':
+            torch.cuda.synchronize()
+        return (timeit.default_timer() - start) / 5
+
+    size = 2048
+    a = torch.rand(size, size, device=device)
+    b = torch.rand(size, size, device=device)
+    peak_flops = 2 * size ** 3 / time(lambda: torch.mm(a, b))
+
+    numel = 2 ** 25
+    a = torch.rand(numel, device=device)
+    b = torch.empty(numel, device=device)
+    peak_bandwidth = 2 * 4 * numel / time(lambda: b.copy_(a))
+
+    return peak_flops, peak_bandwidth
+
+
+def estimate(op, backward, channels, depth, batch, stream, lyndon_sizes):
+    """Estimates the number of floating point operations performed by, and the number of bytes of memory traffic
+    needed for, a call to ta_ops_benchmark.time_op. These are estimates for the purposes of the roofline: a
+    multiply-add is counted as two operations, every tensor is assumed to be read or written just once, and everything
+    is in single precision.
+
+    Returns:
+        A 2-tuple of the number of floating point operations and the number of bytes.
+    """
+    itemsize = 4
+    sizes = [channels ** k for k in range(1, depth + 1)]
+    total = sum(sizes)  # the size of a member of the tensor algebra, excluding the scalar term
+
+    if op == 'mult':
+        flops = sum((2 * k - 1) * size for k, size in enumerate(sizes, start=1))
+        elements = 5 * total if backward else 3 * total
+    elif op == 'restricted_exp':
+        flops = total
+        elements = 3 * total if backward else total + channels
+    elif op == 'mult_fused_restricted_exp':
+        # Multiplying by the exponential is done by Horner's method, one level of the result at a time.
+        flops = sum(2 * sum(sizes[:k]) for k in range(1, depth + 1))
+        elements = 3 * total if backward else 2 * total + channels
+    elif op == 'log':
+        # Horner's method again, with depth - 1 multiplications.
+        flops = (depth - 1) * sum((2 * k - 1) * size for k, size in enumerate(sizes, start=1))
+        elements = 4 * total if backward else 2 * total
+        stream = 1
+    elif op in ('lyndon_words', 'lyndon_brackets'):
+        amount, nnz = lyndon_sizes
+        flops = 0
+        # Picking out the Lyndon words in the forward pass; scattering them into zeros in the backward pass.
+        elements = total + 2 * amount if backward else 2 * amount
+        if op == 'lyndon_brackets':
+            # The transpose of the change of basis has as many nonzero entries as the change of basis itself.
+            flops = 2 * nnz
+            elements += 2 * amount
+        return batch * flops, batch * elements * itemsize
+    else:
+        raise ValueError("Unrecognised operation {}".format(op))
+
+    if backward:
+        # Very roughly, the backward pass of a multilinear operation is twice the work of the forward pass.
+        flops *= 2
+    return stream * batch * flops, stream * batch * elements * itemsize
+
+
+class NativeBenchmarkRunner(object):
+    """Runs all operations forwards and backwards, for multiple sizes, on the CPU both with and without parallelism,
+    and on the GPU, and records their speed.
+    """
+
+    def __init__(self, type_, test_signatory_gpu, repeats=10, peak_flops=None, peak_bandwidth=None, **kwargs):
+        assert type_ in Types
+
+        if test_signatory_gpu and not torch.cuda.is_available():
+            test_signatory_gpu = False
+
+        self.type_ = type_
+        self.test_signatory_gpu = test_signatory_gpu
+        self.repeats = repeats
+        self.peak_flops = peak_flops
+        self.peak_bandwidth = peak_bandwidth
+
+        self.dirname = 'native_' + type_.__name__
+
+        self._results = None
+
+        super(NativeBenchmarkRunner, self).__init__(**kwargs)
+
+    @property
+    def results(self):
+        return self._results
+
+    def run(self):
+        """Runs the benchmarks."""
+
+        # Compile in this process, so that any errors are visible. The worker processes then load the cached copy.
+        module = load(verbose=True)
+
+        configs = [('cpu', True), ('cpu', False)]
+        if self.test_signatory_gpu:
+            configs.append(('cuda', True))
+
+        results = co.OrderedDict()
+        for device, parallel in configs:
+            peak_flops, peak_bandwidth, timings = self._run_worker(device, parallel)
+            if self.peak_flops is not None:
+                peak_flops = self.peak_flops
+            if self.peak_bandwidth is not None:
+                peak_bandwidth = self.peak_bandwidth
+            for op, backward, channels, depth, batch, stream, seconds in timings:
+                lyndon_sizes = module.lyndon_sizes(channels, depth) if op.startswith('lyndon') else None
+                flops, bytes_ = estimate(op, backward, channels, depth, batch, stream, lyndon_sizes)
+                achieved_flops = flops / seconds
+                achieved_bandwidth = bytes_ / seconds
+                if flops == 0:
+                    roofline = achieved_bandwidth / peak_bandwidth
+                else:
+                    roofline = achieved_flops / min(peak_flops, peak_bandwidth * flops / bytes_)
+                row = co.OrderedDict()
+                row['Time (ms)'] = 1000 * seconds
+                row['GFLOP/s'] = achieved_flops / 1e9 if flops != 0 else None
+                row['GB/s'] = achieved_bandwidth / 1e9
+                row['FLOP/byte'] = flops / bytes_
+                row['Roofline'] = '{:.1%}'.format(roofline)
+                key = (op, backward, device, parallel, channels, depth, batch, stream)
+                results[key] = row
+        self._results = results
+
+    def _run_worker(self, device, parallel):
+        type_ = self.type_
+        spec = dict(device=device,
+                    parallel=parallel,
+                    repeats=self.repeats,
+                    cuda_device=int(torch.cuda.current_device()) if device == 'cuda' else -1,
+                    sizes=list(it.product(type_.channels, type_.depths, type_.batches, type_.streams)),
+                    operations=operations)
+        p = subprocess.run([sys.executable, '-m', __package__ + '.native_', json.dumps(spec)],
+                           cwd=os.path.dirname(_here), stdout=subprocess.PIPE, stderr=subprocess.PIPE)
+        if p.returncode != 0:
+            print('Error:')
+            print('------')
+            print(p.stderr.decode())
+            print('')
+            raise RuntimeError("Error in native benchmark on " + device)
+        result = json.loads(p.stdout.decode().strip().split('\n')[-1])
+        return result['peak_flops'], result['peak_bandwidth'], result['timings']
+
+    @staticmethod
+    def _table_format_index(op, backward, device, parallel, channels, depth, batch, stream):
+        if device == 'cpu':
+            device = 'CPU' if parallel else 'CPU no parallel'
+        else:
+            device = 'GPU'
+        return "{} {}, {}, channels {}, depth {}, batch {}, stream {}".format(op, 'backward' if backward else 'forward',
+                                                                               device, channels, depth, batch,
+                                                                               stream)
+
+    def table(self, save=False):
+        """Formats the results into a table."""
+
+        def val_to_str(val):
+            if val is None:
+                return '-'
+            if isinstance(val, float):
+                return '{:.3}'.format(val)
+            return str(val)
+
+        operation_str = 'Operation'
+        padding = 1
+        row_headings = [self._table_format_index(*key) for key in self.results]
+        row_heading_width = max([len(operation_str)] + [len(row_heading) for row_heading in row_headings])
+        row_heading_width += 2 * padding
+
+        column_headings = list(next(iter(self.results.values())).keys())
+        column_widths = []
+        for column_heading in column_headings:
+            column_width = max([len(column_heading)] + [len(val_to_str(row[column_heading]))
+                                                        for row in self.results.values()])
+            column_widths.append(column_width + 2 * padding)
+
+        out_str = "{{:^{}}}".format(row_heading_width).format(operation_str)
+        out_str += ''.join("|{{:^{}}}".format(column_width).format(column_heading)
+                           for column_width, column_heading in zip(column_widths, column_headings)) + '\n'
+        out_str += '+'.join('-' * column_width for column_width in [row_heading_width] + column_widths) + '\n'
+        for row_heading, row in zip(row_headings, self.results.values()):
+            out_str += "{{:<{}}}".format(row_heading_width).format(row_heading)
+            out_str += ''.join("|{{:>{}}}".format(column_width).format(val_to_str(row[column_heading]))
+                               for column_width, column_heading in zip(column_widths, column_headings)) + '\n'
+
+        if save:
+            if not os.path.isdir(self.dirname):
+                os.mkdir(self.dirname)
+            filename = os.path.join(self.dirname, str(datetime.datetime.utcnow())) + '.txt'
+            with io.open(filename, 'w', encoding='utf-8') as f:
+                f.write(out_str)
+        else:
+            print(out_str)
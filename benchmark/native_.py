@@ -0,0 +1,61 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Performs the native microbenchmarks on a particular device, with or without parallelism.
+
+As with time_.py, this is pulled out in a separate process to work around an apparent PyTorch bug, that only allows for
+setting the number of threads during the 'preamble', and not during the runtime of the program.
+"""
+
+
+import json
+import statistics
+import sys
+import torch
+
+
+spec = json.loads(sys.argv[1])
+if not spec['parallel']:
+    torch.set_num_threads(1)
+
+from . import native
+
+
+def main():
+    module = native.load()
+    peak_flops, peak_bandwidth = native.measure_peaks(spec['device'])
+
+    timings = []
+    seen = set()
+    for op in spec['operations']:
+        for backward in (False, True):
+            for channels, depth, batch, stream in spec['sizes']:
+                # Only the operations working on a single increment care about the stream size.
+                if op in ('log', 'lyndon_words', 'lyndon_brackets'):
+                    stream = 1
+                if (op, backward, channels, depth, batch, stream) in seen:
+                    continue
+                seen.add((op, backward, channels, depth, batch, stream))
+                times = module.time_op(op, backward, channels, depth, batch, stream, spec['device'], spec['repeats'])
+                timings.append((op, backward, channels, depth, batch, stream, statistics.median(times)))
+
+    # Report results
+    print(json.dumps(dict(peak_flops=peak_flops, peak_bandwidth=peak_bandwidth, timings=timings)))
+
+
+if spec['cuda_device'] == -1:
+    main()
+else:
+    with torch.cuda.device(spec['cuda_device']):
+        main()
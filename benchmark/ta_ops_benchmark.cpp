@@ -0,0 +1,274 @@
+/* Copyright 2019 Patrick Kidger. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ========================================================================= */
+ // Times the tensor algebra operations of tensor_algebra_ops.hpp, and the Lyndon transforms of logsignature.hpp,
+ // directly from C++, so that they can be measured without any Python or autograd overhead. This is compiled together
+ // with Signatory's own sources (besides its bindings) by benchmark/native.py, which sweeps over sizes and turns the
+ // timings into FLOP/s and bytes/s.
+
+
+#include <torch/extension.h>
+#include <torch/cuda.h>  // torch::cuda::synchronize
+#include <algorithm>     // std::min
+#include <chrono>        // std::chrono::duration, std::chrono::steady_clock
+#include <cstdint>       // int64_t
+#include <functional>    // std::function
+#include <stdexcept>     // std::invalid_argument
+#include <string>        // std::string
+#include <tuple>         // std::make_tuple, std::tuple
+#include <vector>        // std::vector
+
+#include "logsignature.hpp"        // signatory::logsignature::detail::LyndonInfo,
+                                   // signatory::logsignature::detail::apply_transform,
+                                   // signatory::logsignature::detail::compress,
+                                   // signatory::logsignature::detail::compress_backward
+#include "misc.hpp"                // signatory::signature_channels,
+                                   // signatory::misc::checkargs_channels_depth,
+                                   // signatory::misc::make_reciprocals,
+                                   // signatory::misc::max_threads,
+                                   // signatory::misc::slice_by_term
+#include "tensor_algebra_ops.hpp"  // signatory::ta_ops
+
+namespace signatory {
+    namespace benchmark {
+        namespace detail {
+            // Something to time. 'run' is what is timed. It may modify its arguments in-place, so 'reset' (which is
+            // not timed) is called before every run to put them back as they were.
+            struct Operation {
+                std::function<void()> reset;
+                std::function<void()> run;
+            };
+
+            // Makes a member of the tensor algebra for each of 'batch' batch elements, with small random values. It is
+            // returned as a single tensor of shape (batch, signature_channels(channels, depth)), and its terms are put
+            // in 'terms'.
+            torch::Tensor make_element(std::vector<torch::Tensor>& terms, int64_t batch, int64_t channels,
+                                       s_size_type depth, torch::TensorOptions opts) {
+                torch::Tensor flat = torch::rand({batch, signature_channels(channels, depth, /*scalar_term=*/false)},
+                                                 opts) / depth;
+                misc::slice_by_term(flat, terms, channels, depth);
+                return flat;
+            }
+
+            void synchronize(torch::TensorOptions opts) {
+                if (opts.device().is_cuda()) {
+                    torch::cuda::synchronize();
+                }
+            }
+
+            // The operations working on a single increment ('mult', 'restricted_exp', 'mult_fused_restricted_exp')
+            // are called once for each of 'stream' increments, just as when computing a signature. The operations
+            // working on whole signatures ('log', 'lyndon_words', 'lyndon_brackets') are called just once, as when
+            // computing a logsignature, and 'stream' is ignored.
+            Operation make_operation(const std::string& op, bool backward, int64_t channels, s_size_type depth,
+                                     int64_t batch, int64_t stream, torch::TensorOptions opts) {
+                int64_t batch_threads = opts.device().is_cuda() ? 1 : std::min(batch, misc::max_threads());
+                torch::Tensor reciprocals = misc::make_reciprocals(depth, opts);
+
+                // Small enough that nothing overflows however long the stream is.
+                std::vector<torch::Tensor> increments = (torch::rand({stream, batch, channels}, opts) /
+                                                         stream).unbind(0);
+                std::vector<torch::Tensor> grad_increments = torch::empty({stream, batch, channels}, opts).unbind(0);
+
+                if (op == "mult") {
+                    std::vector<torch::Tensor> arg1;
+                    std::vector<torch::Tensor> arg2;
+                    torch::Tensor arg1_flat = make_element(arg1, batch, channels, depth, opts);
+                    torch::Tensor arg1_initial = arg1_flat.clone();
+                    // The exponential of an increment, so that repeatedly multiplying by it stays bounded.
+                    make_element(arg2, batch, channels, depth, opts);
+                    ta_ops::restricted_exp(increments[0], arg2, reciprocals);
+                    if (!backward) {
+                        return {[=]() mutable { arg1_flat.copy_(arg1_initial); },
+                                [=]() mutable {
+                                    for (int64_t stream_index = 0; stream_index < stream; ++stream_index) {
+                                        ta_ops::mult(arg1, arg2, /*inverse=*/false, batch_threads);
+                                    }
+                                }};
+                    }
+                    std::vector<torch::Tensor> grad_arg1;
+                    std::vector<torch::Tensor> grad_arg2;
+                    torch::Tensor grad_arg1_flat = make_element(grad_arg1, batch, channels, depth, opts);
+                    torch::Tensor grad_arg1_initial = grad_arg1_flat.clone();
+                    make_element(grad_arg2, batch, channels, depth, opts);
+                    return {[=]() mutable { grad_arg1_flat.copy_(grad_arg1_initial); },
+                            [=]() mutable {
+                                for (int64_t stream_index = 0; stream_index < stream; ++stream_index) {
+                                    ta_ops::mult_backward</*add_not_copy=*/false>(grad_arg1, grad_arg2, arg1, arg2,
+                                                                                  batch_threads);
+                                }
+                            }};
+                }
+                else if (op == "restricted_exp") {
+                    std::vector<torch::Tensor> out;
+                    make_element(out, batch, channels, depth, opts);
+                    if (!backward) {
+                        return {[] {},
+                                [=]() mutable {
+                                    for (int64_t stream_index = 0; stream_index < stream; ++stream_index) {
+                                        ta_ops::restricted_exp(increments[stream_index], out, reciprocals);
+                                    }
+                                }};
+                    }
+                    ta_ops::restricted_exp(increments[0], out, reciprocals);
+                    std::vector<torch::Tensor> grad_out;
+                    torch::Tensor grad_out_flat = make_element(grad_out, batch, channels, depth, opts);
+                    torch::Tensor grad_out_initial = grad_out_flat.clone();
+                    return {[=]() mutable { grad_out_flat.copy_(grad_out_initial); },
+                            [=]() mutable {
+                                for (int64_t stream_index = 0; stream_index < stream; ++stream_index) {
+                                    ta_ops::restricted_exp_backward(grad_increments[stream_index], grad_out,
+                                                                    increments[stream_index], out, reciprocals);
+                                }
+                            }};
+                }
+                else if (op == "mult_fused_restricted_exp") {
+                    std::vector<torch::Tensor> prev;
+                    torch::Tensor prev_flat = make_element(prev, batch, channels, depth, opts);
+                    // Zero is the (nonscalar part of the) signature of the empty path, so this computes a signature.
+                    auto reset = [=]() mutable { prev_flat.zero_(); };
+                    auto run = [=]() mutable {
+                        for (int64_t stream_index = 0; stream_index < stream; ++stream_index) {
+                            ta_ops::mult_fused_restricted_exp(increments[stream_index], prev, /*inverse=*/false,
+                                                              reciprocals, batch_threads);
+                        }
+                    };
+                    if (!backward) {
+                        return {reset, run};
+                    }
+                    reset();
+                    run();
+                    std::vector<torch::Tensor> grad_prev;
+                    torch::Tensor grad_prev_flat = make_element(grad_prev, batch, channels, depth, opts);
+                    torch::Tensor grad_prev_initial = grad_prev_flat.clone();
+                    return {[=]() mutable { grad_prev_flat.copy_(grad_prev_initial); },
+                            [=]() mutable {
+                                for (int64_t stream_index = 0; stream_index < stream; ++stream_index) {
+                                    ta_ops::mult_fused_restricted_exp_backward(grad_increments[stream_index],
+                                                                               grad_prev,
+                                                                               increments[stream_index],
+                                                                               prev,
+                                                                               /*inverse=*/false,
+                                                                               reciprocals,
+                                                                               batch_threads);
+                                }
+                            }};
+                }
+                else if (op == "log") {
+                    std::vector<torch::Tensor> input;
+                    std::vector<torch::Tensor> output;
+                    torch::Tensor input_flat = make_element(input, batch, channels, depth, opts);
+                    torch::Tensor output_flat = make_element(output, batch, channels, depth, opts);
+                    if (!backward) {
+                        // log expects its output to start off equal to its input.
+                        return {[=]() mutable { output_flat.copy_(input_flat); },
+                                [=]() mutable { ta_ops::log(output, input, reciprocals, batch_threads); }};
+                    }
+                    std::vector<torch::Tensor> grad_output;
+                    std::vector<torch::Tensor> grad_input;
+                    torch::Tensor grad_output_flat = make_element(grad_output, batch, channels, depth, opts);
+                    torch::Tensor grad_output_initial = grad_output_flat.clone();
+                    torch::Tensor grad_input_flat = make_element(grad_input, batch, channels, depth, opts);
+                    return {[=]() mutable {
+                                grad_output_flat.copy_(grad_output_initial);
+                                grad_input_flat.zero_();
+                            },
+                            [=]() mutable {
+                                ta_ops::log_backward(grad_output, grad_input, input, reciprocals, batch_threads);
+                            }};
+                }
+                else if (op == "lyndon_words" || op == "lyndon_brackets") {
+                    bool brackets = (op == "lyndon_brackets");
+                    logsignature::detail::LyndonInfo lyndon_info {channels, depth, brackets ? "brackets" : "words"};
+                    torch::Tensor indices = lyndon_info.get_indices(opts.device());
+                    torch::Tensor transform;
+                    if (brackets) {
+                        transform = lyndon_info.get_transform(opts, backward);
+                    }
+                    int64_t output_channel_size = signature_channels(channels, depth, /*scalar_term=*/false);
+                    if (!backward) {
+                        torch::Tensor logsignature = torch::rand({batch, output_channel_size}, opts);
+                        return {[] {},
+                                [=]() mutable {
+                                    torch::Tensor out = logsignature::detail::compress(indices, logsignature);
+                                    if (brackets) {
+                                        logsignature::detail::apply_transform(transform, out);
+                                    }
+                                }};
+                    }
+                    torch::Tensor grad_logsignature = torch::rand({batch, lyndon_info.amount}, opts);
+                    return {[] {},
+                            [=]() mutable {
+                                torch::Tensor grad = grad_logsignature;
+                                if (brackets) {
+                                    grad = logsignature::detail::apply_transform(transform, grad);
+                                }
+                                logsignature::detail::compress_backward(grad, indices, opts, /*stream=*/false,
+                                                                        output_channel_size);
+                            }};
+                }
+                else {
+                    throw std::invalid_argument("Argument 'op' must be one of 'mult', 'restricted_exp', "
+                                                "'mult_fused_restricted_exp', 'log', 'lyndon_words' or "
+                                                "'lyndon_brackets'.");
+                }
+            }
+        }  // namespace signatory::benchmark::detail
+
+        // Times 'op' (forwards or backwards) 'repeats' times, after one warm-up run, returning each time in seconds.
+        // See detail::make_operation for what 'batch' and 'stream' mean for each operation.
+        // On the CPU, as many threads are used as PyTorch is set to use (via torch.set_num_threads) and the
+        // operation supports.
+        std::vector<double> time_op(const std::string& op, bool backward, int64_t channels, s_size_type depth,
+                                    int64_t batch, int64_t stream, const std::string& device, int64_t repeats) {
+            misc::checkargs_channels_depth(channels, depth);
+            if (batch < 1 || stream < 1 || repeats < 1) {
+                throw std::invalid_argument("Arguments 'batch', 'stream' and 'repeats' must all be at least one.");
+            }
+            py::gil_scoped_release release;
+
+            torch::TensorOptions opts = torch::dtype(torch::kFloat32).device(torch::Device(device));
+            detail::Operation operation = detail::make_operation(op, backward, channels, depth, batch, stream, opts);
+
+            std::vector<double> times;
+            for (int64_t repeat = -1; repeat < repeats; ++repeat) {
+                operation.reset();
+                detail::synchronize(opts);
+                auto start = std::chrono::steady_clock::now();
+                operation.run();
+                detail::synchronize(opts);
+                auto end = std::chrono::steady_clock::now();
+                if (repeat >= 0) {
+                    times.push_back(std::chrono::duration<double>(end - start).count());
+                }
+            }
+            return times;
+        }
+
+        // The number of Lyndon words, and the number of nonzero entries of the transform from Lyndon words to the
+        // Lyndon basis, for the given channels and depth. Used for estimating the cost of the Lyndon transforms.
+        std::tuple<int64_t, int64_t> lyndon_sizes(int64_t channels, s_size_type depth) {
+            misc::checkargs_channels_depth(channels, depth);
+            logsignature::detail::LyndonInfo lyndon_info {channels, depth, "brackets"};
+            return std::make_tuple(lyndon_info.amount, lyndon_info.transform._nnz());
+        }
+    }  // namespace signatory::benchmark
+}  // namespace signatory
+
+PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
+    m.def("time_op",
+          &signatory::benchmark::time_op);
+    m.def("lyndon_sizes",
+          &signatory::benchmark::lyndon_sizes);
+}
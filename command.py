@@ -91,6 +91,19 @@ def main():
                                                                             'displaying them. (By default tables are '
                                                                             'printed to stdout and graphs are opened '
                                                                             'in a new window.)')
+    benchmark_parser.add_argument('-n', '--native', action='store_true',
+                                  help="Instead of comparing against esig and iisignature, run microbenchmarks of "
+                                       "the tensor algebra operations and Lyndon transforms that Signatory is built "
+                                       "on, timed directly from C++, forwards and backwards, on the CPU with and "
+                                       "without parallelism and on the GPU. The results are reported in FLOP/s and "
+                                       "bytes/s, and as a fraction of the roofline. Only the --nogpu, --type, "
+                                       "--output and --save options apply.")
+    benchmark_parser.add_argument('--peak-flops', type=float, default=None,
+                                  help="The peak GFLOP/s to use for the roofline of the native microbenchmarks. "
+                                       "Defaults to that measured for a large matrix multiplication.")
+    benchmark_parser.add_argument('--peak-bandwidth', type=float, default=None,
+                                  help="The peak GB/s to use for the roofline of the native microbenchmarks. Defaults "
+                                       "to that measured for a large copy.")
                                   
     docs_parser.add_argument('-o', '--open', action='store_true',
                              help="Open the documentation in a web browser as soon as it is built.")
@@ -147,6 +160,9 @@ def test(args):
 
 def benchmark(args):
     """Run speed benchmarks."""
+    if args.native:
+        return _native_benchmark(args)
+
     try:
         import iisignature  # fail fast here if necessary
     except ImportError:
@@ -217,6 +233,41 @@ def benchmark(args):
 
         return runner
 
+
+def _native_benchmark(args):
+    """Run microbenchmarks of the tensor algebra operations."""
+    import benchmark.native as native
+    import torch
+
+    if args.type == 'typical':
+        type_ = native.Types.typical
+    elif args.type == 'depths':
+        type_ = native.Types.depths
+    elif args.type == 'channels':
+        type_ = native.Types.channels
+    elif args.type == 'small':
+        type_ = native.Types.small
+    else:
+        raise RuntimeError
+
+    if args.output in ('graph', 'graphtable'):
+        print("Cannot output the native microbenchmarks as a graph.")
+        return
+
+    runner = native.NativeBenchmarkRunner(type_=type_,
+                                          test_signatory_gpu=args.test_signatory_gpu,
+                                          peak_flops=None if args.peak_flops is None else args.peak_flops * 1e9,
+                                          peak_bandwidth=(None if args.peak_bandwidth is None
+                                                          else args.peak_bandwidth * 1e9))
+    with torch.cuda.device(args.device) if args.device != -1 else _NullContext():
+        print('Using ' + _get_device())
+        runner.run()
+
+    if args.output == 'table':
+        runner.table(save=args.save)
+
+    return runner
+
     
 def docs(args=()):
     """Build the documentation. After it has been built then it can be found in ./docs/_build/html/index.html/
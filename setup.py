@@ -15,9 +15,11 @@
 """setup.py - hopefully you know what this does without me telling you..."""
 
 
+import os
 import setuptools
 import sys
 try:
+    import torch
     import torch.utils.cpp_extension as cpp
 except ImportError:
     raise ImportError("PyTorch is not installed, and must be installed prior to installing Signatory.")
@@ -35,20 +37,46 @@ if sys.platform.startswith('win'):  # windows
 else:  # linux or mac
     extra_compile_args.append('-fopenmp')
 
-ext_modules = [cpp.CppExtension(name='_impl',
-                                sources=['src/logsignature.cpp',
-                                         'src/lyndon.cpp',
-                                         'src/misc.cpp',
-                                         'src/pytorchbind.cpp',
-                                         'src/signature.cpp',
-                                         'src/tensor_algebra_ops.cpp'],
-                                depends=['src/logsignature.hpp',
-                                         'src/lyndon.hpp',
-                                         'src/misc.hpp',
-                                         'src/signature.hpp',
-                                         'src/tensor_algebra_ops.hpp'],
-                                extra_compile_args=extra_compile_args)]
+sources = ['src/library.cpp',
+           'src/logsignature.cpp',
+           'src/lyndon.cpp',
+           'src/misc.cpp',
+           'src/profiling.cpp',
+           'src/pytorchbind.cpp',
+           'src/signature.cpp',
+           'src/signature_kernel.cpp',
+           'src/tensor_algebra_ops.cpp',
+           'src/workspace.cpp']
+depends = ['src/logsignature.hpp',
+           'src/lyndon.hpp',
+           'src/misc.hpp',
+           'src/profiling.hpp',
+           'src/signature.hpp',
+           'src/signature_kernel.hpp',
+           'src/tensor_algebra_ops.hpp',
+           'src/workspace.hpp']
+define_macros = []
 
+# If we can find a CUDA toolkit (and PyTorch has been built with CUDA) then compile the hand-written CUDA kernels as
+# well. Otherwise computations on the GPU are expressed in terms of high-level PyTorch operations instead.
+# Set SIGNATORY_NO_CUDA=1 to skip compiling the CUDA kernels regardless.
+if cpp.CUDA_HOME is not None and torch.version.cuda is not None and os.environ.get('SIGNATORY_NO_CUDA', '0') != '1':
+    extension = cpp.CUDAExtension
+    sources.append('src/signature_kernel_cuda.cu')
+    sources.append('src/tensor_algebra_ops_cuda.cu')
+    depends.append('src/signature_kernel_cuda.hpp')
+    depends.append('src/tensor_algebra_ops_cuda.hpp')
+    define_macros.append(('SIGNATORY_CUDA', None))
+    # The flags above are for the host compiler only; nvcc doesn't understand them.
+    extra_compile_args = {'cxx': extra_compile_args, 'nvcc': ['-O3']}
+else:
+    extension = cpp.CppExtension
+
+ext_modules = [extension(name='_impl',
+                         sources=sources,
+                         depends=depends,
+                         define_macros=define_macros,
+                         extra_compile_args=extra_compile_args)]
 
 setuptools.setup(name=metadata.project,
                  version=metadata.version,
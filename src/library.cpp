@@ -0,0 +1,255 @@
+/* Copyright 2019 Patrick Kidger. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ========================================================================= */
+ // Registers the signature computations with PyTorch's dispatcher, so that they may be used from TorchScript, and
+ // from libtorch without Python at all. These are available as torch.ops.signatory.signature,
+ // torch.ops.signatory.signature_to_logsignature and torch.ops.signatory.signature_combine, along with the class
+ // torch.classes.signatory.LyndonInfo.
+ // Unlike the Python bindings in pytorchbind.cpp, the backward passes are provided here as C++ autograd functions, and
+ // nothing here ever touches Python.
+
+
+#include <torch/extension.h>
+#include <torch/custom_class.h>  // torch::class_, torch::init
+#include <torch/library.h>       // TORCH_LIBRARY
+#include <cstdint>    // int64_t
+#include <stdexcept>  // std::invalid_argument, std::runtime_error
+#include <string>     // std::string
+#include <tuple>      // std::get, std::make_tuple, std::tie, std::tuple
+#include <vector>     // std::vector
+
+#include "logsignature.hpp"        // signatory::logsignature::detail::LyndonInfo,
+                                   // signatory::logsignature::detail::mode_to_string,
+                                   // signatory::signature_to_logsignature_forward_impl,
+                                   // signatory::signature_to_logsignature_backward_impl
+#include "signature.hpp"           // signatory::signature_forward_impl,
+                                   // signatory::signature_backward_impl
+#include "tensor_algebra_ops.hpp"  // signatory::signature_combine_forward_impl,
+                                   // signatory::signature_combine_backward_impl
+
+
+namespace signatory {
+    namespace library {
+        namespace detail {
+            using torch::autograd::AutogradContext;
+            using torch::autograd::variable_list;
+            using logsignature::detail::LyndonInfo;
+
+            // The equivalent of @once_differentiable for the autograd functions below, as their backward functions use
+            // in-place operations for memory efficiency. Unlike @once_differentiable (which waits until the result is
+            // differentiated) this throws straight away if a graph of the backward pass is being recorded.
+            void check_once_differentiable(const variable_list& grad_outputs) {
+                if (torch::GradMode::is_enabled()) {
+                    for (const auto& grad_output : grad_outputs) {
+                        if (grad_output.defined() && grad_output.requires_grad()) {
+                            throw std::runtime_error("Trying to differentiate twice a Signatory operation, which is "
+                                                     "only once differentiable.");
+                        }
+                    }
+                }
+            }
+
+            // As _SignatureFunction in signature_module.py.
+            class SignatureFunction : public torch::autograd::Function<SignatureFunction> {
+            public:
+                static torch::Tensor forward(AutogradContext* ctx, torch::Tensor path, int64_t depth, bool stream,
+                                             bool basepoint, torch::Tensor basepoint_value, bool inverse,
+                                             bool initial, torch::Tensor initial_value, bool scalar_term) {
+                    torch::Tensor signature;
+                    torch::Tensor path_increments;
+                    std::tie(signature, path_increments) = signature_forward_impl(path, depth, stream, basepoint,
+                                                                                  basepoint_value, inverse, initial,
+                                                                                  initial_value, scalar_term,
+                                                                                  /*time=*/false, /*lead_lag=*/false,
+                                                                                  /*workspace=*/nullptr);
+                    ctx->save_for_backward({signature, path_increments});
+                    ctx->saved_data["depth"] = depth;
+                    ctx->saved_data["stream"] = stream;
+                    ctx->saved_data["basepoint"] = basepoint;
+                    ctx->saved_data["inverse"] = inverse;
+                    ctx->saved_data["initial"] = initial;
+                    ctx->saved_data["scalar_term"] = scalar_term;
+                    return signature;
+                }
+
+                static variable_list backward(AutogradContext* ctx, variable_list grad_outputs) {
+                    check_once_differentiable(grad_outputs);
+                    torch::NoGradGuard no_grad;
+                    variable_list saved = ctx->get_saved_variables();
+                    bool basepoint = ctx->saved_data["basepoint"].toBool();
+                    bool initial = ctx->saved_data["initial"].toBool();
+
+                    torch::Tensor grad_path;
+                    torch::Tensor grad_basepoint_value;
+                    torch::Tensor grad_initial_value;
+                    // contiguous for the same reason as in _SignatureFunction.backward
+                    std::tie(grad_path, grad_basepoint_value, grad_initial_value) = signature_backward_impl(
+                            grad_outputs[0], saved[0], saved[1].contiguous(), ctx->saved_data["depth"].toInt(),
+                            ctx->saved_data["stream"].toBool(), basepoint, ctx->saved_data["inverse"].toBool(),
+                            initial, ctx->saved_data["scalar_term"].toBool(), /*time=*/false, /*lead_lag=*/false,
+                            /*workspace=*/nullptr);
+
+                    if (!basepoint) {
+                        grad_basepoint_value = torch::Tensor();
+                    }
+                    if (!initial) {
+                        grad_initial_value = torch::Tensor();
+                    }
+                    return {grad_path, torch::Tensor(), torch::Tensor(), torch::Tensor(), grad_basepoint_value,
+                            torch::Tensor(), torch::Tensor(), grad_initial_value, torch::Tensor()};
+                }
+            };
+
+            // As _SignatureToLogsignatureFunction in logsignature_module.py. The channels, depth and mode are those
+            // that the LyndonInfo was made for.
+            class SignatureToLogsignatureFunction : public torch::autograd::Function<SignatureToLogsignatureFunction> {
+            public:
+                static torch::Tensor forward(AutogradContext* ctx, torch::Tensor signature,
+                                             c10::intrusive_ptr<LyndonInfo> lyndon_info, bool stream,
+                                             bool scalar_term) {
+                    torch::Tensor logsignature = signature_to_logsignature_forward_impl(signature,
+                                                                                        lyndon_info->channels,
+                                                                                        lyndon_info->depth, stream,
+                                                                                        lyndon_info->mode,
+                                                                                        lyndon_info.get(),
+                                                                                        scalar_term,
+                                                                                        /*workspace=*/nullptr);
+                    ctx->save_for_backward({signature});
+                    ctx->saved_data["lyndon_info"] = lyndon_info;
+                    ctx->saved_data["stream"] = stream;
+                    ctx->saved_data["scalar_term"] = scalar_term;
+                    return logsignature;
+                }
+
+                static variable_list backward(AutogradContext* ctx, variable_list grad_outputs) {
+                    check_once_differentiable(grad_outputs);
+                    torch::NoGradGuard no_grad;
+                    variable_list saved = ctx->get_saved_variables();
+                    auto lyndon_info = ctx->saved_data["lyndon_info"].toCustomClass<LyndonInfo>();
+
+                    torch::Tensor grad_signature = signature_to_logsignature_backward_impl(
+                            grad_outputs[0], saved[0], lyndon_info->channels, lyndon_info->depth,
+                            ctx->saved_data["stream"].toBool(), lyndon_info->mode, lyndon_info.get(),
+                            ctx->saved_data["scalar_term"].toBool(), /*workspace=*/nullptr);
+
+                    return {grad_signature, torch::Tensor(), torch::Tensor(), torch::Tensor()};
+                }
+            };
+
+            // As _SignatureCombineFunction in signature_module.py. The signatures are stacked into a single tensor of
+            // shape (num_sigtensors, batch, channel) beforehand, as autograd functions are much simpler to write with
+            // a fixed number of tensor inputs.
+            class SignatureCombineFunction : public torch::autograd::Function<SignatureCombineFunction> {
+            public:
+                static torch::Tensor forward(AutogradContext* ctx, torch::Tensor stacked_sigtensors,
+                                             int64_t input_channels, int64_t depth, bool scalar_term) {
+                    ctx->save_for_backward({stacked_sigtensors});
+                    ctx->saved_data["input_channels"] = input_channels;
+                    ctx->saved_data["depth"] = depth;
+                    ctx->saved_data["scalar_term"] = scalar_term;
+                    return signature_combine_forward_impl(stacked_sigtensors.unbind(/*dim=*/0), input_channels, depth,
+                                                          scalar_term);
+                }
+
+                static variable_list backward(AutogradContext* ctx, variable_list grad_outputs) {
+                    check_once_differentiable(grad_outputs);
+                    torch::NoGradGuard no_grad;
+                    variable_list saved = ctx->get_saved_variables();
+                    std::vector<torch::Tensor> grad_sigtensors = signature_combine_backward_impl(
+                            grad_outputs[0], saved[0].unbind(/*dim=*/0), ctx->saved_data["input_channels"].toInt(),
+                            ctx->saved_data["depth"].toInt(), ctx->saved_data["scalar_term"].toBool());
+                    return {torch::stack(grad_sigtensors), torch::Tensor(), torch::Tensor(), torch::Tensor()};
+                }
+            };
+
+            // See torch.ops.signatory.signature in the schema below. As signatory.signature, except that 'stream' may
+            // only be a bool, and 'basepoint' may only be None or a tensor.
+            torch::Tensor signature_op(torch::Tensor path, int64_t depth, bool stream,
+                                       c10::optional<torch::Tensor> basepoint, bool inverse,
+                                       c10::optional<torch::Tensor> initial, bool scalar_term) {
+                // As in signatory.signature, we have to do the transposes outside of the autograd function.
+                path = path.transpose(0, 1);  // (batch, stream, channel) to (stream, batch, channel)
+                torch::Tensor basepoint_value = basepoint.has_value() ? *basepoint : torch::empty({0}, path.options());
+                torch::Tensor initial_value = initial.has_value() ? *initial : torch::empty({0}, path.options());
+                torch::Tensor signature = SignatureFunction::apply(path, depth, stream, basepoint.has_value(),
+                                                                   basepoint_value, inverse, initial.has_value(),
+                                                                   initial_value, scalar_term);
+                if (stream) {
+                    signature = signature.transpose(0, 1);  // (stream, batch, channel) to (batch, stream, channel)
+                }
+                return signature;
+            }
+
+            // See torch.ops.signatory.signature_to_logsignature in the schema below. As
+            // signatory.signature_to_logsignature, except that the channels, depth and mode are specified by the
+            // LyndonInfo.
+            torch::Tensor signature_to_logsignature_op(torch::Tensor signature,
+                                                       c10::intrusive_ptr<LyndonInfo> lyndon_info, bool stream,
+                                                       bool scalar_term) {
+                if (stream) {
+                    signature = signature.transpose(0, 1);  // (batch, stream, channel) to (stream, batch, channel)
+                }
+                torch::Tensor logsignature = SignatureToLogsignatureFunction::apply(signature, lyndon_info, stream,
+                                                                                    scalar_term);
+                if (stream) {
+                    // (stream, batch, channel) to (batch, stream, channel)
+                    logsignature = logsignature.transpose(0, 1);
+                }
+                return logsignature;
+            }
+
+            // See torch.ops.signatory.signature_combine in the schema below. As signatory.multi_signature_combine.
+            torch::Tensor signature_combine_op(std::vector<torch::Tensor> sigtensors, int64_t input_channels,
+                                               int64_t depth, bool scalar_term) {
+                if (sigtensors.size() == 0) {
+                    throw std::invalid_argument("sigtensors must be of nonzero length.");
+                }
+                for (const auto& elem : sigtensors) {
+                    if (elem.sizes() != sigtensors[0].sizes()) {
+                        throw std::invalid_argument("Every element of sigtensors must have the same shape.");
+                    }
+                }
+                return SignatureCombineFunction::apply(torch::stack(sigtensors), input_channels, depth, scalar_term);
+            }
+        }  // namespace signatory::library::detail
+    }  // namespace signatory::library
+}  // namespace signatory
+
+
+TORCH_LIBRARY(signatory, m) {
+    using signatory::logsignature::detail::LyndonInfo;
+
+    // A LyndonInfo is constructed as LyndonInfo(channels, depth, mode), with mode one of "expand", "brackets" or
+    // "words". When pickled (for example as an attribute of a saved TorchScript module) only these arguments are
+    // saved, and everything else is recomputed when it is loaded again.
+    m.class_<LyndonInfo>("LyndonInfo")
+        .def(torch::init<int64_t, int64_t, std::string>())
+        .def_pickle(
+            [](const c10::intrusive_ptr<LyndonInfo>& self) -> std::tuple<int64_t, int64_t, std::string> {
+                return std::make_tuple(self->channels, self->depth,
+                                       signatory::logsignature::detail::mode_to_string(self->mode));
+            },
+            [](std::tuple<int64_t, int64_t, std::string> state) -> c10::intrusive_ptr<LyndonInfo> {
+                return c10::make_intrusive<LyndonInfo>(std::get<0>(state), std::get<1>(state), std::get<2>(state));
+            });
+
+    m.def("signature(Tensor path, int depth, bool stream=False, Tensor? basepoint=None, bool inverse=False, "
+          "Tensor? initial=None, bool scalar_term=False) -> Tensor",
+          &signatory::library::detail::signature_op);
+    m.def("signature_to_logsignature(Tensor signature, __torch__.torch.classes.signatory.LyndonInfo lyndon_info, "
+          "bool stream=False, bool scalar_term=False) -> Tensor",
+          &signatory::library::detail::signature_to_logsignature_op);
+    m.def("signature_combine(Tensor[] sigtensors, int input_channels, int depth, bool scalar_term=False) -> Tensor",
+          &signatory::library::detail::signature_combine_op);
+}
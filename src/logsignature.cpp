@@ -15,61 +15,40 @@
  
 
 #include <torch/extension.h>
+#include <algorithm>  // std::lower_bound, std::min, std::sort, std::unique
 #include <cstdint>    // int64_t
-#include <memory>     // std::unique_ptr
-#include <omp.h>
+#include <fstream>    // std::ifstream, std::ofstream
+#include <map>        // std::map
+#include <mutex>      // std::lock_guard, std::mutex
 #include <stdexcept>  // std::invalid_argument
-#include <tuple>      // std::tie, std::tuple
+#include <string>     // std::string
+#include <tuple>      // std::make_tuple, std::tie, std::tuple
 #include <utility>     // std::pair
 #include <vector>     // std::vector
 
 #include "logsignature.hpp"
 #include "lyndon.hpp"
 #include "misc.hpp"
+#include "profiling.hpp"
 #include "pycapsule.hpp"
 #include "signature.hpp"
 #include "tensor_algebra_ops.hpp"
+#include "workspace.hpp"
 
 
 namespace signatory {
     namespace logsignature {
         namespace detail {
-            // This struct will be wrapped into a PyCapsule. Using it allows for computing certain aspects of the
-            // logsignature transformation just once, so that repeated use of the logsignature transformation is more
-            // efficient.
-            struct LyndonInfo {
-                LyndonInfo(std::unique_ptr<lyndon::LyndonWords> lyndon_words,
-                           std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>>&& transforms,
-                std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>>&& transforms_backward) :
-                lyndon_words{std::move(lyndon_words)},
-                transforms{transforms},
-                transforms_backward{transforms_backward}
-                {};
-
-                // A list of Lyndon words
-                std::unique_ptr<lyndon::LyndonWords> lyndon_words;
-
-                // The transforms for going from Lyndon words to Lyndon basis
-                // This is in terms of the 'compressed' index, i.e. in the free Lie algebra
-                // They are grouped (the outermost vector) by anagram class
-                std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>> transforms;
-
-                // The transforms for going from Lyndon basis to Lyndon words
-                // This is in terms of the tensor algebra index
-                // They are grouped (the outermost vector) by anagram class
-                std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>> transforms_backward;
-
-                constexpr static auto capsule_name = "signatory.LyndonInfoCapsule";
-            };
-
-            // Compresses a representation of a member of the free Lie algebra.
-            // In the tensor algebra it is represented by coefficients of all words. This just extracts the coefficients
-            // of all the Lyndon words.
-            // The list of all Lyndon words must have already been computed, and passed in as an argument.
-            torch::Tensor compress(const lyndon::LyndonWords& lyndon_words, torch::Tensor input)
-            {
-                // TODO: avoid the need for this copy operation entirely by having all of the `tensor_algebra_index`s be
-                //       a std::vector<int64_t> attribute of lyndon_words instead, and then just use torch::from_blob.
+            // The layout of the files written by save_lyndon_info. Everything is a sequence of eight-byte values: first
+            // this many int64_t header values (the magic number, the version, the channels, the depth, the mode, the
+            // number of Lyndon words, and the number of nonzero entries of the transform), then LyndonInfo::indices,
+            // then the indices of the transform, and finally the values of the transform as doubles.
+            constexpr int64_t lyndon_info_header_size = 7;
+            constexpr int64_t lyndon_info_magic = 0x4c594e444f4e4931;  // "LYNDONI1"
+            constexpr int64_t lyndon_info_version = 1;
+
+            // The tensor algebra index of every Lyndon word, ordered by compressed index.
+            torch::Tensor lyndon_indices(const lyndon::LyndonWords& lyndon_words) {
                 torch::Tensor indices = torch::empty({lyndon_words.amount}, torch::dtype(torch::kInt64));
                 auto index_accessor = indices.accessor<int64_t, 1>();
                 for (s_size_type depth_index = 0; depth_index < lyndon_words.depth; ++depth_index){
@@ -77,14 +56,132 @@ namespace signatory {
                         index_accessor[lyndon_word.compressed_index] = lyndon_word.tensor_algebra_index;
                     }
                 }
-                indices = indices.to(input.device());
+                return indices;
+            }
+
+            // Converts the transforms given by LyndonWords::to_lyndon_basis into a single sparse matrix, such that
+            // multiplying the coefficients of the Lyndon words by it gives the coefficients of the Lyndon basis.
+            // Each transform is of the form target -= coefficient * source, and they must be applied serially within
+            // each anagram class; this is essentially solving a triangular linear system. Here we solve it once and
+            // for all, by applying the transforms to the rows of the identity matrix. As distinct anagram classes
+            // don't interact, the result is block diagonal with one (dense) block per anagram class, so this is the
+            // same trick of collecting together Lyndon anagrams that iisignature uses. It also means that the blocks
+            // can be computed in parallel.
+            torch::Tensor make_transform(int64_t amount,
+                                         const std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>>&
+                                         transforms) {
+                int64_t num_classes = transforms.size();
+                // The compressed indices of the Lyndon words of each anagram class, and the nonzero entries of each
+                // block as (row, column, value).
+                std::vector<std::vector<int64_t>> class_members (num_classes);
+                std::vector<std::vector<std::tuple<int64_t, int64_t, double>>> class_entries (num_classes);
+
+                // Anagram classes vary a lot in size, so deal them out to the threads in turn, as in
+                // LyndonWords::to_lyndon_basis.
+                int64_t threads = std::min(num_classes, misc::max_threads());
+                misc::parallel_for(threads, threads, [&](int64_t begin, int64_t end) {
+                    for (int64_t offset = begin; offset < end; ++offset) {
+                        for (int64_t class_number = offset; class_number < num_classes; class_number += threads) {
+                            const auto& transform_class = transforms[class_number];
+
+                            // The compressed indices of every Lyndon word in this anagram class, in increasing order
+                            std::vector<int64_t> class_indices;
+                            class_indices.reserve(2 * transform_class.size());
+                            for (const auto& transform : transform_class) {
+                                class_indices.push_back(std::get<0>(transform));
+                                class_indices.push_back(std::get<1>(transform));
+                            }
+                            std::sort(class_indices.begin(), class_indices.end());
+                            class_indices.erase(std::unique(class_indices.begin(), class_indices.end()),
+                                                class_indices.end());
+                            int64_t class_size = class_indices.size();
+
+                            // Row-major, starts off as the identity matrix
+                            std::vector<double> block (class_size * class_size, 0);
+                            for (int64_t index = 0; index < class_size; ++index) {
+                                block[index * class_size + index] = 1;
+                            }
+                            for (const auto& transform : transform_class) {
+                                int64_t source_row = std::lower_bound(class_indices.begin(), class_indices.end(),
+                                                                      std::get<0>(transform)) - class_indices.begin();
+                                int64_t target_row = std::lower_bound(class_indices.begin(), class_indices.end(),
+                                                                      std::get<1>(transform)) - class_indices.begin();
+                                double coefficient = std::get<2>(transform);
+                                for (int64_t column = 0; column < class_size; ++column) {
+                                    block[target_row * class_size + column] -= coefficient *
+                                                                               block[source_row * class_size + column];
+                                }
+                            }
+
+                            auto& entries = class_entries[class_number];
+                            for (int64_t row = 0; row < class_size; ++row) {
+                                for (int64_t column = 0; column < class_size; ++column) {
+                                    double value = block[row * class_size + column];
+                                    if (value != 0) {
+                                        entries.emplace_back(class_indices[row], class_indices[column], value);
+                                    }
+                                }
+                            }
+                            class_members[class_number] = std::move(class_indices);
+                        }
+                    }
+                });
+
+                std::vector<int64_t> rows;
+                std::vector<int64_t> columns;
+                std::vector<double> values;
+                std::vector<bool> in_class (amount, false);
+                for (const auto& members : class_members) {
+                    for (int64_t index : members) {
+                        in_class[index] = true;
+                    }
+                }
+                for (const auto& entries : class_entries) {
+                    for (const auto& entry : entries) {
+                        rows.push_back(std::get<0>(entry));
+                        columns.push_back(std::get<1>(entry));
+                        values.push_back(std::get<2>(entry));
+                    }
+                }
 
+                // Every other Lyndon word is the only member of its anagram class, and is left unchanged.
+                for (int64_t index = 0; index < amount; ++index) {
+                    if (!in_class[index]) {
+                        rows.push_back(index);
+                        columns.push_back(index);
+                        values.push_back(1);
+                    }
+                }
+
+                torch::Tensor indices = torch::stack({torch::tensor(rows, torch::dtype(torch::kInt64)),
+                                                      torch::tensor(columns, torch::dtype(torch::kInt64))});
+                return torch::sparse_coo_tensor(indices, torch::tensor(values, torch::dtype(torch::kFloat64)),
+                                                {amount, amount}).coalesce();
+            }
+
+            // Multiplies every vector along the channel dimension of 'input' by the sparse matrix 'transform'.
+            torch::Tensor apply_transform(torch::Tensor transform, torch::Tensor input) {
+                SIGNATORY_PROFILE_STAGE("lyndon_transform");
+                std::vector<int64_t> sizes = input.sizes().vec();
+                torch::Tensor flat_input = input.reshape({-1, input.size(channel_dim)});
+                return torch::mm(transform, flat_input.t()).t().reshape(sizes);
+            }
+
+            // Compresses a representation of a member of the free Lie algebra.
+            // In the tensor algebra it is represented by coefficients of all words. This just extracts the coefficients
+            // of all the Lyndon words.
+            // 'indices' should be the tensor algebra indices of all the Lyndon words, as given by
+            // LyndonInfo::get_indices.
+            torch::Tensor compress(torch::Tensor indices, torch::Tensor input)
+            {
+                SIGNATORY_PROFILE_STAGE("lyndon_compress");
                 return torch::index_select(input, /*dim=*/channel_dim, /*index=*/indices);
             }
 
             // The backwards operation corresponding to compress.
-            torch::Tensor compress_backward(torch::Tensor grad_compressed, const lyndon::LyndonWords& lyndon_words,
+            torch::Tensor compress_backward(torch::Tensor grad_compressed, torch::Tensor indices,
                                             torch::TensorOptions opts, bool stream, int64_t output_channel_size) {
+                SIGNATORY_PROFILE_STAGE("lyndon_compress_backward");
                 int64_t batch_size = grad_compressed.size(batch_dim);
                 torch::Tensor grad_expanded;
                 if (stream) {
@@ -98,20 +195,7 @@ namespace signatory {
                                                   output_channel_size}, opts);
                 }
 
-                // TODO: avoid the need for this copy operation entirely by having all of the `tensor_algebra_index`s be
-                //       a std::vector<int64_t> attribute of lyndon_words instead, and then just use torch::from_blob.
-                torch::Tensor indices = torch::empty({lyndon_words.amount}, torch::dtype(torch::kInt64));
-                auto index_accessor = indices.accessor<int64_t, 1>();
-                for (s_size_type depth_index = 0; depth_index < lyndon_words.depth; ++depth_index){
-                    for (auto& lyndon_word : lyndon_words[depth_index]) {
-                        index_accessor[lyndon_word.compressed_index] = lyndon_word.tensor_algebra_index;
-                    }
-                }
-                indices = indices.to(grad_compressed.device());
-
-                indices = indices.expand_as(grad_compressed);
-
-                return grad_expanded.scatter_(channel_dim, indices, grad_compressed);
+                return grad_expanded.index_copy_(channel_dim, indices, grad_compressed);
             }
 
             void logsignature_checkargs(torch::Tensor signature, int64_t input_channel_size, s_size_type depth,
@@ -145,152 +229,290 @@ namespace signatory {
                     throw std::invalid_argument("Argument 'signature' must be of floating point type.");
                 }
             }
+
+            // Computes the contents of a LyndonInfo.
+            void compute_lyndon_info(int64_t channels, s_size_type depth, LogSignatureMode mode, int64_t& amount,
+                                     torch::Tensor& indices, torch::Tensor& transform) {
+                if (mode == LogSignatureMode::Words) {
+                    lyndon::LyndonWords lyndon_words(channels, depth, lyndon::LyndonWords::word_tag);
+                    amount = lyndon_words.amount;
+                    indices = lyndon_indices(lyndon_words);
+                }
+                else if (mode == LogSignatureMode::Brackets) {
+                    lyndon::LyndonWords lyndon_words(channels, depth, lyndon::LyndonWords::bracket_tag);
+                    std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>> transforms;
+                    lyndon_words.to_lyndon_basis(transforms);
+                    lyndon_words.delete_extra();
+                    amount = lyndon_words.amount;
+                    indices = lyndon_indices(lyndon_words);
+                    transform = make_transform(amount, transforms);
+                }
+            }
+
+            LyndonInfo::LyndonInfo(int64_t channels, s_size_type depth, const std::string& mode) :
+            channels{channels},
+            depth{depth},
+            mode{mode_from_string(mode)},
+            amount{0}
+            {
+                SIGNATORY_PROFILE_STAGE("make_lyndon_info");
+                misc::checkargs_channels_depth(channels, depth);
+                compute_lyndon_info(channels, depth, this->mode, amount, indices, transform);
+            }
+
+            LogSignatureMode mode_from_string(const std::string& mode) {
+                if (mode == "expand") {
+                    return LogSignatureMode::Expand;
+                }
+                else if (mode == "brackets") {
+                    return LogSignatureMode::Brackets;
+                }
+                else if (mode == "words") {
+                    return LogSignatureMode::Words;
+                }
+                throw std::invalid_argument("Invalid values for argument 'mode'. Valid values are 'expand', "
+                                            "'brackets', or 'words'.");
+            }
+
+            std::string mode_to_string(LogSignatureMode mode) {
+                switch (mode) {
+                    case LogSignatureMode::Expand: return "expand";
+                    case LogSignatureMode::Brackets: return "brackets";
+                    case LogSignatureMode::Words: return "words";
+                }
+                throw std::invalid_argument("Invalid LogSignatureMode.");
+            }
         }  // namespace signatory::logsignature::detail
     }  // namespace signatory::logsignature
 
     py::object make_lyndon_info(int64_t channels, s_size_type depth, LogSignatureMode mode) {
         misc::checkargs_channels_depth(channels, depth);
 
+        int64_t amount = 0;
+        torch::Tensor indices;
+        torch::Tensor transform;
+        {  // release GIL
+            py::gil_scoped_release release;
+            logsignature::detail::compute_lyndon_info(channels, depth, mode, amount, indices, transform);
+        }  // finish released GIL
+
+        return misc::wrap_capsule<logsignature::detail::LyndonInfo>(channels, depth, mode, amount, indices, transform);
+    }
+
+    void save_lyndon_info(py::object lyndon_info_capsule, const std::string& filename) {
+        logsignature::detail::LyndonInfo* lyndon_info =
+                misc::unwrap_capsule<logsignature::detail::LyndonInfo>(lyndon_info_capsule);
+
         py::gil_scoped_release release;
 
-        std::unique_ptr<lyndon::LyndonWords> lyndon_words;
-        std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>> transforms;
-        std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>> transforms_backward;
+        torch::Tensor transform_indices;
+        torch::Tensor transform_values;
+        int64_t nnz = 0;
+        if (lyndon_info->transform.defined()) {
+            transform_indices = lyndon_info->transform._indices().contiguous();
+            transform_values = lyndon_info->transform._values().contiguous();
+            nnz = transform_values.size(0);
+        }
 
-        // no make_unique in C++11
-        if (mode == LogSignatureMode::Words) {
-            lyndon_words.reset(new lyndon::LyndonWords(channels, depth, lyndon::LyndonWords::word_tag));
+        int64_t header[logsignature::detail::lyndon_info_header_size] {logsignature::detail::lyndon_info_magic,
+                                                                        logsignature::detail::lyndon_info_version,
+                                                                        lyndon_info->channels,
+                                                                        lyndon_info->depth,
+                                                                        static_cast<int64_t>(lyndon_info->mode),
+                                                                        lyndon_info->amount,
+                                                                        nnz};
+
+        std::ofstream file (filename, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            throw std::invalid_argument("Could not open '" + filename + "' for writing.");
         }
-        else if (mode == LogSignatureMode::Brackets) {
-            lyndon_words.reset(new lyndon::LyndonWords(channels, depth, lyndon::LyndonWords::bracket_tag));
-            lyndon_words->to_lyndon_basis(transforms, transforms_backward);
-            lyndon_words->delete_extra();
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        if (lyndon_info->indices.defined()) {
+            torch::Tensor indices = lyndon_info->indices.contiguous();
+            file.write(reinterpret_cast<const char*>(indices.data_ptr<int64_t>()), indices.numel() * sizeof(int64_t));
+        }
+        if (nnz > 0) {
+            file.write(reinterpret_cast<const char*>(transform_indices.data_ptr<int64_t>()),
+                       2 * nnz * sizeof(int64_t));
+            file.write(reinterpret_cast<const char*>(transform_values.data_ptr<double>()), nnz * sizeof(double));
+        }
+        if (!file) {
+            throw std::invalid_argument("Could not write to '" + filename + "'.");
         }
-
-        return misc::wrap_capsule<logsignature::detail::LyndonInfo>(std::move(lyndon_words),
-                                                                    std::move(transforms),
-                                                                    std::move(transforms_backward));
     }
 
-    std::tuple<torch::Tensor, py::object>
-    signature_to_logsignature_forward(torch::Tensor signature, int64_t input_channel_size, s_size_type depth,
-                                      bool stream, LogSignatureMode mode, py::object lyndon_info_capsule,
-                                      bool scalar_term) {
-        logsignature::detail::logsignature_checkargs(signature, input_channel_size, depth, stream, scalar_term);
+    py::object load_lyndon_info(const std::string& filename, int64_t channels, s_size_type depth,
+                                LogSignatureMode mode) {
+        misc::checkargs_channels_depth(channels, depth);
 
-        // must finish using Python objects before we release the GIL
-        if (lyndon_info_capsule.is_none()) {
-            lyndon_info_capsule = make_lyndon_info(input_channel_size, depth, mode);
+        py::gil_scoped_release release;
+
+        constexpr int64_t header_size = logsignature::detail::lyndon_info_header_size;
+        int64_t header[header_size];
+        int64_t file_size;
+        {
+            std::ifstream file (filename, std::ios::binary | std::ios::ate);
+            if (!file) {
+                throw std::invalid_argument("Could not open '" + filename + "' for reading.");
+            }
+            file_size = file.tellg();
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(header), sizeof(header));
+            if (!file || header[0] != logsignature::detail::lyndon_info_magic ||
+                header[1] != logsignature::detail::lyndon_info_version) {
+                throw std::invalid_argument("'" + filename + "' is not a LyndonInfo file saved by this version of "
+                                            "Signatory.");
+            }
+        }
+        if (header[2] != channels || header[3] != depth || header[4] != static_cast<int64_t>(mode)) {
+            throw std::invalid_argument("'" + filename + "' was saved for a different number of channels, depth, or "
+                                        "mode.");
+        }
+        int64_t amount = header[5];
+        int64_t nnz = header[6];
+        // Everything in the file is eight bytes wide.
+        int64_t num_elements = header_size + amount + 3 * nnz;
+        if (amount < 0 || nnz < 0 || file_size != num_elements * static_cast<int64_t>(sizeof(int64_t))) {
+            throw std::invalid_argument("'" + filename + "' is truncated or corrupted.");
         }
-        logsignature::detail::LyndonInfo* lyndon_info =
-                misc::unwrap_capsule<logsignature::detail::LyndonInfo>(lyndon_info_capsule);
 
-        torch::Tensor logsignature;
-        {  // release GIL
-            py::gil_scoped_release release;
+        // Memory-map the file, rather than reading it in: the tensors below are views into the mapped memory, so
+        // nothing is copied until it's needed on another device or in another dtype. The mapping is private, so
+        // nothing we do can modify the file.
+        torch::Tensor mapped = torch::from_file(filename, /*shared=*/false, /*size=*/num_elements,
+                                                torch::dtype(torch::kInt64));
 
-            if (scalar_term) {
-                signature = signature.narrow(/*dim=*/channel_dim, /*start=*/1,
-                                             /*length=*/signature.size(channel_dim) - 1);
-            }
+        torch::Tensor indices;
+        torch::Tensor transform;
+        if (mode != LogSignatureMode::Expand) {
+            indices = mapped.narrow(/*dim=*/0, /*start=*/header_size, /*length=*/amount);
+        }
+        if (mode == LogSignatureMode::Brackets) {
+            torch::Tensor transform_indices = mapped.narrow(/*dim=*/0, /*start=*/header_size + amount,
+                                                            /*length=*/2 * nnz).view({2, nnz});
+            // The values are doubles, so reinterpret that part of the mapped memory. The deleter keeps the mapping
+            // alive for as long as the values are.
+            void* values_ptr = mapped.data_ptr<int64_t>() + header_size + amount + 2 * nnz;
+            torch::Tensor transform_values = torch::from_blob(values_ptr, {nnz}, [mapped](void*) {},
+                                                              torch::dtype(torch::kFloat64));
+            // It's already coalesced, as that's how it was saved.
+            transform = torch::_sparse_coo_tensor_unsafe(transform_indices, transform_values,
+                                                         {amount, amount})._coalesced_(true);
+        }
 
-            // Don't need to track gradients when we have a custom backward
-            signature = signature.detach();
+        return misc::wrap_capsule<logsignature::detail::LyndonInfo>(channels, depth, mode, amount, indices, transform);
+    }
 
-            torch::TensorOptions opts = signature.options();
-            torch::Tensor reciprocals = misc::make_reciprocals(depth, opts);
-            int64_t output_stream_size = stream ? signature.size(stream_dim) : -1;
+    torch::Tensor signature_to_logsignature_forward_impl(torch::Tensor signature, int64_t input_channel_size,
+                                                         s_size_type depth, bool stream, LogSignatureMode mode,
+                                                         logsignature::detail::LyndonInfo* lyndon_info,
+                                                         bool scalar_term, workspace::Workspace* workspace) {
+        logsignature::detail::logsignature_checkargs(signature, input_channel_size, depth, stream, scalar_term);
+        SIGNATORY_PROFILE_STAGE("signature_to_logsignature_forward");
 
-            // and allocate memory for the logsignature
-            logsignature = torch::empty_like(signature);
-            std::vector <torch::Tensor> signature_by_term;
-            std::vector <torch::Tensor> logsignature_by_term;
-            misc::slice_by_term(signature, signature_by_term, input_channel_size, depth);
-            misc::slice_by_term(logsignature, logsignature_by_term, input_channel_size, depth);
+        torch::Tensor logsignature;
+        if (scalar_term) {
+            signature = signature.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                         /*length=*/signature.size(channel_dim) - 1);
+        }
 
-            if (stream) {
-                std::vector <torch::Tensor> signature_by_term_at_stream;
+        // Don't need to track gradients when we have a custom backward
+        signature = signature.detach();
 
-                // The if statement is for safety's sake... we haven't had issues with this one, but there have been
-                // other issues we've run into with OpenMP+GPU on other for loops.
-                // (even though presumably those threads are just scheduling work for the GPU to do... ?)
-                #pragma omp parallel for default(none) \
-                                     if(!signature.is_cuda()) \
-                                     shared(output_stream_size, logsignature_by_term, signature_by_term, reciprocals)
-                for (int64_t stream_index = 0;
-                     stream_index < output_stream_size;
-                     ++stream_index) {
-                    std::vector <torch::Tensor> signature_by_term_at_stream;
-                    std::vector <torch::Tensor> logsignature_by_term_at_stream;
+        torch::TensorOptions opts = signature.options();
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
+        int64_t output_stream_size = stream ? signature.size(stream_dim) : -1;
+
+        // and allocate memory for the logsignature
+        if (mode == LogSignatureMode::Expand) {
+            logsignature = torch::empty_like(signature);
+        }
+        else {
+            // In this case this is just an intermediate result, before it gets compressed.
+            logsignature = workspace::empty(workspace, "expanded_logsignature", signature.sizes(), opts);
+        }
+        std::vector <torch::Tensor> signature_by_term;
+        std::vector <torch::Tensor> logsignature_by_term;
+        misc::slice_by_term(signature, signature_by_term, input_channel_size, depth);
+        misc::slice_by_term(logsignature, logsignature_by_term, input_channel_size, depth);
+
+        if (stream) {
+            std::vector <torch::Tensor> signature_by_term_at_stream;
 
+            SIGNATORY_PROFILE_STAGE("logsignature_log");
+            // Only parallelise on the CPU: on the GPU each operation is already parallelised.
+            int64_t stream_threads = signature.is_cuda() ? 1 : misc::max_threads();
+            profiling::set("signature_to_logsignature_forward.stream_threads", stream_threads);
+            misc::parallel_for(output_stream_size, stream_threads, [&](int64_t begin, int64_t end) {
+                std::vector <torch::Tensor> signature_by_term_at_stream;
+                std::vector <torch::Tensor> logsignature_by_term_at_stream;
+                for (int64_t stream_index = begin; stream_index < end; ++stream_index) {
                     misc::slice_at_stream(signature_by_term, signature_by_term_at_stream, stream_index);
                     misc::slice_at_stream(logsignature_by_term, logsignature_by_term_at_stream, stream_index);
 
                     ta_ops::log(logsignature_by_term_at_stream, signature_by_term_at_stream, reciprocals);
                 }
-            }
-            else {
-                ta_ops::log(logsignature_by_term, signature_by_term, reciprocals);
-            }
+            });
+        }
+        else {
+            SIGNATORY_PROFILE_STAGE("logsignature_log");
+            // No stream dimension to parallelise over, so parallelise over the batch dimension instead.
+            int64_t batch_threads = signature.is_cuda() ? 1 : std::min<int64_t>(signature.size(batch_dim),
+                                                                                 misc::max_threads());
+            profiling::set("signature_to_logsignature_forward.batch_threads", batch_threads);
+            ta_ops::log(logsignature_by_term, signature_by_term, reciprocals, batch_threads);
+        }
 
-            // Brackets and Words are the two possible compressed forms of the logsignature. So here we perform the
-            // compression.
-            if (mode == LogSignatureMode::Words) {
-                logsignature = logsignature::detail::compress(*lyndon_info->lyndon_words, logsignature);
-            }
-            else if (mode == LogSignatureMode::Brackets) {
-                logsignature = logsignature::detail::compress(*lyndon_info->lyndon_words, logsignature);
-                // This is essentially solving a sparse linear system... and it's horrendously slow on a GPU.
-                // There may well be ways of speeding this up beyond what's done here, but the brackets mode is
-                // definitely the least favoured child out of the mode options we provide. (It's typically a strange
-                // choice in machine learning anyway, when the words mode is available.)
-                // iisignature does manage to provide this mode efficiently on the CPU by collecting together Lyndon
-                // anagrams and then using pseudoinverses, which is an approach that might well work efficiently on the
-                // GPU, so that is a possibility
-                auto device = logsignature.device();
-                logsignature = logsignature.cpu();
-                // Then apply the transforms. We rely on the triangularity property of the Lyndon basis for this to work.
-                #pragma omp parallel for default(none) \
-                                     shared(lyndon_info, logsignature) schedule(dynamic, 1)
-                for (s_size_type transform_class_index = 0;
-                     transform_class_index < static_cast<s_size_type>(lyndon_info->transforms.size());
-                     ++transform_class_index) {
-                    // Note that it is very important that this inner loop operate serially!
-                    for (const auto& transform : lyndon_info->transforms[transform_class_index]) {
-                        int64_t source_index = std::get<0>(transform);
-                        int64_t target_index = std::get<1>(transform);
-                        int64_t coefficient = std::get<2>(transform);
-                        torch::Tensor source = logsignature.narrow(/*dim=*/channel_dim,
-                                                                   /*start=*/source_index,
-                                                                   /*length=*/1);
-                        torch::Tensor target = logsignature.narrow(/*dim=*/channel_dim,
-                                                                   /*start=*/target_index,
-                                                                   /*length=*/1);
-                        target.sub_(source, coefficient);
-                    }
-                }
-                logsignature = logsignature.to(device);
-            }
-        }  // finish released GIL
+        // Brackets and Words are the two possible compressed forms of the logsignature. So here we perform the
+        // compression.
+        if (mode == LogSignatureMode::Words) {
+            logsignature = logsignature::detail::compress(lyndon_info->get_indices(opts.device()), logsignature);
+        }
+        else if (mode == LogSignatureMode::Brackets) {
+            logsignature = logsignature::detail::compress(lyndon_info->get_indices(opts.device()), logsignature);
+            // Then change basis. This happens on the same device as the logsignature.
+            logsignature = logsignature::detail::apply_transform(lyndon_info->get_transform(opts,
+                                                                                            /*backward=*/false),
+                                                                 logsignature);
+        }
 
-        return std::tuple<torch::Tensor, py::object> {logsignature, lyndon_info_capsule};
+        return logsignature;
     }
 
-    torch::Tensor signature_to_logsignature_backward(torch::Tensor grad_logsignature,
-                                                     torch::Tensor signature,
-                                                     int64_t input_channel_size,
-                                                     s_size_type depth,
-                                                     bool stream,
-                                                     LogSignatureMode mode,
-                                                     py::object lyndon_info_capsule,
-                                                     bool scalar_term) {
+    std::tuple<torch::Tensor, py::object>
+    signature_to_logsignature_forward(torch::Tensor signature, int64_t input_channel_size, s_size_type depth,
+                                      bool stream, LogSignatureMode mode, py::object lyndon_info_capsule,
+                                      bool scalar_term, py::object workspace_capsule) {
+        logsignature::detail::logsignature_checkargs(signature, input_channel_size, depth, stream, scalar_term);
 
-        // Must do this before releasing the GIL.
+        // must finish using Python objects before we release the GIL
+        if (lyndon_info_capsule.is_none()) {
+            lyndon_info_capsule = make_lyndon_info(input_channel_size, depth, mode);
+        }
         logsignature::detail::LyndonInfo* lyndon_info =
                 misc::unwrap_capsule<logsignature::detail::LyndonInfo>(lyndon_info_capsule);
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
 
-        py::gil_scoped_release release;
+        torch::Tensor logsignature;
+        {  // release GIL
+            py::gil_scoped_release release;
+            logsignature = signature_to_logsignature_forward_impl(signature, input_channel_size, depth, stream, mode,
+                                                                  lyndon_info, scalar_term, workspace);
+        }  // finish released GIL
+
+        return std::tuple<torch::Tensor, py::object> {logsignature, lyndon_info_capsule};
+    }
 
+    torch::Tensor signature_to_logsignature_backward_impl(torch::Tensor grad_logsignature,
+                                                          torch::Tensor signature,
+                                                          int64_t input_channel_size,
+                                                          s_size_type depth,
+                                                          bool stream,
+                                                          LogSignatureMode mode,
+                                                          logsignature::detail::LyndonInfo* lyndon_info,
+                                                          bool scalar_term,
+                                                          workspace::Workspace* workspace) {
+        SIGNATORY_PROFILE_STAGE("signature_to_logsignature_backward");
         if (scalar_term) {
             signature = signature.narrow(/*dim=*/channel_dim, /*start=*/1, /*length=*/signature.size(channel_dim) - 1);
         }
@@ -299,7 +521,7 @@ namespace signatory {
         signature = signature.detach();
 
         torch::TensorOptions opts = signature.options();
-        torch::Tensor reciprocals = misc::make_reciprocals(depth, opts);
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
         int64_t output_stream_size = stream ? signature.size(stream_dim) : -1;
         int64_t output_channel_size = signature.size(channel_dim);
 
@@ -308,49 +530,28 @@ namespace signatory {
 
         // Decompress the logsignature
         if (mode == LogSignatureMode::Expand) {
-            grad_logsignature = grad_logsignature.clone();  // Clone so we don't leak changes through grad_logsignature.
+            // Copy so we don't leak changes through grad_logsignature.
+            torch::Tensor grad_logsignature_copy = workspace::empty(workspace, "grad_logsignature",
+                                                                    grad_logsignature.sizes(), opts);
+            grad_logsignature_copy.copy_(grad_logsignature);
+            grad_logsignature = grad_logsignature_copy;
         }
         else if (mode == LogSignatureMode::Words){
-            grad_logsignature = logsignature::detail::compress_backward(grad_logsignature, *lyndon_info->lyndon_words,
+            grad_logsignature = logsignature::detail::compress_backward(grad_logsignature,
+                                                                        lyndon_info->get_indices(opts.device()),
                                                                         opts, stream,
                                                                         output_channel_size);
         }
         else {  // mode == LogSignatureMode::Brackets
-            grad_logsignature = logsignature::detail::compress_backward(grad_logsignature, *lyndon_info->lyndon_words,
+            // Backwards through the change of basis; as it's a linear transformation this is just multiplication by
+            // the transpose.
+            grad_logsignature = logsignature::detail::apply_transform(lyndon_info->get_transform(opts,
+                                                                                                 /*backward=*/true),
+                                                                      grad_logsignature);
+            grad_logsignature = logsignature::detail::compress_backward(grad_logsignature,
+                                                                        lyndon_info->get_indices(opts.device()),
                                                                         opts, stream,
                                                                         output_channel_size);
-
-            /* This is a deliberate asymmetry between the forwards and backwards: in the forwards pass we applied the
-             * linear transformation after compression, but on the backwards we don't apply the transforms before
-             * decompressing. Instead we apply a different (equivalent) transformation after decompressing. This is
-             * because otherwise we would have to clone the grad_logsignature we were given, to be sure that the
-             * transformations (which necessarily operate in-place) don't leak out. By doing it this way the memory that
-             * we operate on is internal memory that we've claimed, not memory that we've been given in an input.
-             */
-            auto device = grad_logsignature.device();
-            grad_logsignature = grad_logsignature.cpu();
-            // This is essentially solving a sparse linear system... and it's horrendously slow on a GPU.
-            #pragma omp parallel for default(none) \
-                                     shared(lyndon_info, grad_logsignature) schedule(dynamic,1)
-            for (s_size_type transform_class_index = 0;
-                 transform_class_index < static_cast<s_size_type>(lyndon_info->transforms_backward.size());
-                 ++transform_class_index) {
-                for (auto tptr = lyndon_info->transforms_backward[transform_class_index].rbegin();
-                     tptr != lyndon_info->transforms_backward[transform_class_index].rend();
-                     ++tptr)  {
-                    int64_t source_index = std::get<0>(*tptr);
-                    int64_t target_index = std::get<1>(*tptr);
-                    int64_t coefficient = std::get<2>(*tptr);
-                    torch::Tensor grad_source = grad_logsignature.narrow(/*dim=*/channel_dim,
-                                                                         /*start=*/source_index,
-                                                                         /*length=*/1);
-                    torch::Tensor grad_target = grad_logsignature.narrow(/*dim=*/channel_dim,
-                                                                         /*start=*/target_index,
-                                                                         /*length=*/1);
-                    grad_source.sub_(grad_target, coefficient);
-                }
-            }
-            grad_logsignature = grad_logsignature.to(device);
         }
 
         torch::Tensor grad_signature;
@@ -381,37 +582,244 @@ namespace signatory {
         misc::slice_by_term(grad_signature, grad_signature_by_term, input_channel_size, depth);
 
         if (stream) {
-            // The if statement is because this sometimes hangs on the GPU... for some reason.
-            #pragma omp parallel for default(none) \
-                                     if(!grad_logsignature.is_cuda()) \
-                                     shared(grad_logsignature_by_term, \
-                                            grad_signature_by_term, \
-                                            signature_by_term, \
-                                            reciprocals, \
-                                            output_stream_size)
-            for (int64_t stream_index = 0; stream_index < output_stream_size; ++stream_index) {
+            SIGNATORY_PROFILE_STAGE("logsignature_log_backward");
+            // Only parallelise on the CPU: on the GPU each operation is already parallelised.
+            int64_t stream_threads = grad_logsignature.is_cuda() ? 1 : misc::max_threads();
+            profiling::set("signature_to_logsignature_backward.stream_threads", stream_threads);
+            misc::parallel_for(output_stream_size, stream_threads, [&](int64_t begin, int64_t end) {
                 std::vector<torch::Tensor> grad_logsignature_by_term_at_stream;
                 std::vector<torch::Tensor> grad_signature_by_term_at_stream;
                 std::vector<torch::Tensor> signature_by_term_at_stream;
-
-                misc::slice_at_stream(grad_logsignature_by_term,
-                                      grad_logsignature_by_term_at_stream,
-                                      stream_index);
-                misc::slice_at_stream(grad_signature_by_term,
-                                      grad_signature_by_term_at_stream,
-                                      stream_index);
-                misc::slice_at_stream(signature_by_term,
-                                      signature_by_term_at_stream,
-                                      stream_index);
-
-                ta_ops::log_backward(grad_logsignature_by_term_at_stream, grad_signature_by_term_at_stream,
-                                     signature_by_term_at_stream, reciprocals);
-            }
+                for (int64_t stream_index = begin; stream_index < end; ++stream_index) {
+                    misc::slice_at_stream(grad_logsignature_by_term,
+                                          grad_logsignature_by_term_at_stream,
+                                          stream_index);
+                    misc::slice_at_stream(grad_signature_by_term,
+                                          grad_signature_by_term_at_stream,
+                                          stream_index);
+                    misc::slice_at_stream(signature_by_term,
+                                          signature_by_term_at_stream,
+                                          stream_index);
+
+                    ta_ops::log_backward(grad_logsignature_by_term_at_stream, grad_signature_by_term_at_stream,
+                                         signature_by_term_at_stream, reciprocals);
+                }
+            });
         }
         else {
-            ta_ops::log_backward(grad_logsignature_by_term, grad_signature_by_term, signature_by_term, reciprocals);
+            SIGNATORY_PROFILE_STAGE("logsignature_log_backward");
+            int64_t batch_threads = grad_logsignature.is_cuda() ? 1 : std::min<int64_t>(
+                    grad_logsignature.size(batch_dim), misc::max_threads());
+            profiling::set("signature_to_logsignature_backward.batch_threads", batch_threads);
+            ta_ops::log_backward(grad_logsignature_by_term, grad_signature_by_term, signature_by_term, reciprocals,
+                                 batch_threads);
         }
 
         return grad_signature_with_scalar;
     }
-}  // namespace signatory
\ No newline at end of file
+
+    torch::Tensor signature_to_logsignature_backward(torch::Tensor grad_logsignature,
+                                                     torch::Tensor signature,
+                                                     int64_t input_channel_size,
+                                                     s_size_type depth,
+                                                     bool stream,
+                                                     LogSignatureMode mode,
+                                                     py::object lyndon_info_capsule,
+                                                     bool scalar_term,
+                                                     py::object workspace_capsule) {
+        // Must do this before releasing the GIL.
+        logsignature::detail::LyndonInfo* lyndon_info =
+                misc::unwrap_capsule<logsignature::detail::LyndonInfo>(lyndon_info_capsule);
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
+
+        py::gil_scoped_release release;
+
+        return signature_to_logsignature_backward_impl(grad_logsignature, signature, input_channel_size, depth, stream,
+                                                       mode, lyndon_info, scalar_term, workspace);
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, py::object>
+    logsignature_stream_forward(torch::Tensor path, s_size_type depth, bool basepoint, torch::Tensor basepoint_value,
+                                bool inverse, LogSignatureMode mode, py::object lyndon_info_capsule,
+                                py::object workspace_capsule) {
+        signature_checkargs(path, depth, basepoint, basepoint_value, /*initial=*/false,
+                            /*initial_value=*/torch::Tensor(), /*scalar_term=*/false, /*time=*/false,
+                            /*lead_lag=*/false);
+        int64_t input_channel_size = path.size(channel_dim);
+
+        // must finish using Python objects before we release the GIL
+        if (lyndon_info_capsule.is_none()) {
+            lyndon_info_capsule = make_lyndon_info(input_channel_size, depth, mode);
+        }
+        logsignature::detail::LyndonInfo* lyndon_info =
+                misc::unwrap_capsule<logsignature::detail::LyndonInfo>(lyndon_info_capsule);
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
+
+        torch::Tensor logsignature;
+        torch::Tensor signature;
+        torch::Tensor path_increments;
+        {  // release GIL
+            py::gil_scoped_release release;
+            SIGNATORY_PROFILE_STAGE("logsignature_stream_forward");
+
+            // Don't need to track gradients when we have a custom backward
+            path = path.detach();
+            basepoint_value = basepoint_value.detach();
+
+            int64_t batch_size = path.size(batch_dim);
+            int64_t output_channel_size = signature_channels(input_channel_size, depth, false);
+            torch::TensorOptions opts = path.options();
+            torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
+
+            path_increments = signature::detail::compute_path_increments(path, basepoint, basepoint_value, inverse);
+            int64_t output_stream_size = path_increments.size(stream_dim);
+            int64_t block_size = signature::detail::stream_block_size(output_stream_size, batch_size,
+                                                                      output_channel_size);
+
+            torch::Tensor indices;
+            int64_t logsignature_channel_size = output_channel_size;
+            if (mode != LogSignatureMode::Expand) {
+                indices = lyndon_info->get_indices(opts.device());
+                logsignature_channel_size = lyndon_info->amount;
+            }
+            logsignature = torch::empty({output_stream_size, batch_size, logsignature_channel_size}, opts);
+
+            torch::Tensor logsignature_block = workspace::empty(workspace, "stream_logsignature_block",
+                                                                {block_size, batch_size, output_channel_size}, opts);
+
+            std::vector<torch::Tensor> signature_by_term;
+            std::vector<torch::Tensor> logsignature_by_term;
+            signature = signature::detail::signature_stream_blocks(
+                    path_increments, reciprocals, inverse, /*initial=*/false, /*initial_value=*/torch::Tensor(), depth,
+                    block_size, workspace,
+                    [&] (int64_t block_start, torch::Tensor signature_block) {
+                        int64_t block_length = signature_block.size(0);
+
+                        // Take all of the logarithms at once, by treating the stream dimension as part of the batch
+                        // dimension.
+                        torch::Tensor logsignature_in = logsignature_block.narrow(/*dim=*/0, /*start=*/0,
+                                                                                  /*length=*/block_length);
+                        torch::Tensor signature_view = signature_block.view({block_length * batch_size,
+                                                                             output_channel_size});
+                        torch::Tensor logsignature_view = logsignature_in.view({block_length * batch_size,
+                                                                                output_channel_size});
+                        logsignature_view.copy_(signature_view);
+                        misc::slice_by_term(signature_view, signature_by_term, input_channel_size, depth);
+                        misc::slice_by_term(logsignature_view, logsignature_by_term, input_channel_size, depth);
+                        int64_t log_threads = signature_view.is_cuda() ? 1 : std::min<int64_t>(
+                                block_length * batch_size, misc::max_threads());
+                        ta_ops::log(logsignature_by_term, signature_by_term, reciprocals, log_threads);
+
+                        // And compress them straight into the output.
+                        torch::Tensor logsignature_out = logsignature.narrow(/*dim=*/stream_dim,
+                                                                             /*start=*/block_start,
+                                                                             /*length=*/block_length);
+                        if (mode == LogSignatureMode::Expand) {
+                            logsignature_out.copy_(logsignature_in);
+                        }
+                        else {
+                            torch::index_select_out(logsignature_out, logsignature_in, /*dim=*/channel_dim,
+                                                    /*index=*/indices);
+                        }
+                    });
+
+            if (mode == LogSignatureMode::Brackets) {
+                logsignature = logsignature::detail::apply_transform(lyndon_info->get_transform(opts,
+                                                                                                /*backward=*/false),
+                                                                     logsignature);
+            }
+        }  // finish released GIL
+
+        return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, py::object> {logsignature, signature,
+                                                                                    path_increments,
+                                                                                    lyndon_info_capsule};
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor>
+    logsignature_stream_backward(torch::Tensor grad_logsignature, torch::Tensor signature,
+                                 torch::Tensor path_increments, s_size_type depth, bool basepoint, bool inverse,
+                                 LogSignatureMode mode, py::object lyndon_info_capsule, py::object workspace_capsule) {
+        // Must do this before releasing the GIL.
+        logsignature::detail::LyndonInfo* lyndon_info =
+                misc::unwrap_capsule<logsignature::detail::LyndonInfo>(lyndon_info_capsule);
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
+
+        py::gil_scoped_release release;
+        SIGNATORY_PROFILE_STAGE("logsignature_stream_backward");
+
+        grad_logsignature = grad_logsignature.detach();
+        signature = signature.detach();
+        path_increments = path_increments.detach();
+
+        torch::TensorOptions opts = signature.options();
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
+        int64_t batch_size = signature.size(batch_dim);
+        int64_t output_channel_size = signature.size(channel_dim);
+        int64_t input_channel_size = path_increments.size(channel_dim);
+        int64_t output_stream_size = path_increments.size(stream_dim);
+        int64_t block_size = signature::detail::stream_block_size(output_stream_size, batch_size,
+                                                                  output_channel_size);
+
+        torch::Tensor indices;
+        if (mode == LogSignatureMode::Brackets) {
+            // Backwards through the change of basis
+            grad_logsignature = logsignature::detail::apply_transform(lyndon_info->get_transform(opts,
+                                                                                                 /*backward=*/true),
+                                                                      grad_logsignature);
+        }
+        if (mode != LogSignatureMode::Expand) {
+            indices = lyndon_info->get_indices(opts.device());
+        }
+
+        torch::Tensor grad_logsignature_block = workspace::empty(workspace, "stream_logsignature_block",
+                                                                 {block_size, batch_size, output_channel_size}, opts);
+
+        std::vector<torch::Tensor> grad_logsignature_by_term;
+        std::vector<torch::Tensor> grad_signature_by_term;
+        std::vector<torch::Tensor> signature_by_term;
+        torch::Tensor grad_path_increments;
+        torch::Tensor grad_initial_value;
+        std::tie(grad_path_increments, grad_initial_value) = signature::detail::signature_stream_blocks_backward(
+                signature, path_increments, reciprocals, inverse, /*initial=*/false, depth, block_size, workspace,
+                [&] (int64_t block_start, torch::Tensor signature_block, torch::Tensor grad_signature_block) {
+                    int64_t block_length = signature_block.size(0);
+
+                    // Decompress the gradient. Either way we copy, so that we don't leak changes through
+                    // grad_logsignature.
+                    torch::Tensor grad_logsignature_in = grad_logsignature.narrow(/*dim=*/stream_dim,
+                                                                                  /*start=*/block_start,
+                                                                                  /*length=*/block_length);
+                    torch::Tensor grad_logsignature_out = grad_logsignature_block.narrow(/*dim=*/0, /*start=*/0,
+                                                                                         /*length=*/block_length);
+                    if (mode == LogSignatureMode::Expand) {
+                        grad_logsignature_out.copy_(grad_logsignature_in);
+                    }
+                    else {
+                        grad_logsignature_out.zero_();
+                        grad_logsignature_out.index_copy_(channel_dim, indices, grad_logsignature_in);
+                    }
+
+                    // Then backwards through the logarithms, all at once.
+                    misc::slice_by_term(grad_logsignature_out.view({block_length * batch_size, output_channel_size}),
+                                        grad_logsignature_by_term, input_channel_size, depth);
+                    misc::slice_by_term(grad_signature_block.view({block_length * batch_size, output_channel_size}),
+                                        grad_signature_by_term, input_channel_size, depth);
+                    misc::slice_by_term(signature_block.view({block_length * batch_size, output_channel_size}),
+                                        signature_by_term, input_channel_size, depth);
+                    int64_t log_threads = grad_signature_block.is_cuda() ? 1 : std::min<int64_t>(
+                            block_length * batch_size, misc::max_threads());
+                    ta_ops::log_backward(grad_logsignature_by_term, grad_signature_by_term, signature_by_term,
+                                         reciprocals, log_threads);
+                });
+
+        // Find the gradient on the path from the gradient on the path increments.
+        torch::Tensor grad_path;
+        torch::Tensor grad_basepoint_value;
+        std::tie(grad_path, grad_basepoint_value) = signature::detail::compute_path_increments_backward(
+                                                                                                   grad_path_increments,
+                                                                                                   basepoint,
+                                                                                                   inverse,
+                                                                                                   opts);
+        return std::tuple<torch::Tensor, torch::Tensor> {grad_path, grad_basepoint_value};
+    }
+}  // namespace signatory
@@ -19,24 +19,138 @@
 #define SIGNATORY_LOGSIGNATURE_HPP
 
 #include <torch/extension.h>
+#include <torch/custom_class.h>  // torch::CustomClassHolder
 #include <cstdint>    // int64_t
+#include <map>        // std::map
+#include <mutex>      // std::mutex
+#include <string>     // std::string
 #include <tuple>      // std::tuple
 
 #include "misc.hpp"
+#include "workspace.hpp"
 
 namespace signatory {
     // Modes for the return value of logsignature
     // See signatory.logsignature for further documentation
     enum class LogSignatureMode { Expand, Brackets, Words };
 
+    namespace logsignature {
+        namespace detail {
+            // This struct will be wrapped into a PyCapsule, or used as the TorchScript class
+            // torch.classes.signatory.LyndonInfo (see library.cpp). Using it allows for computing certain aspects of
+            // the logsignature transformation just once, so that repeated use of the logsignature transformation is
+            // more efficient.
+            // Everything is stored in flat tensors, which makes it straightforward to save to and load from a file;
+            // see save_lyndon_info and load_lyndon_info.
+            struct LyndonInfo : torch::CustomClassHolder {
+                LyndonInfo(int64_t channels, s_size_type depth, LogSignatureMode mode, int64_t amount,
+                           torch::Tensor indices, torch::Tensor transform) :
+                channels{channels},
+                depth{depth},
+                mode{mode},
+                amount{amount},
+                indices{indices},
+                transform{transform}
+                {};
+
+                // Computes everything for the given arguments. 'mode' is one of "expand", "brackets" or "words", as
+                // for signatory.logsignature.
+                LyndonInfo(int64_t channels, s_size_type depth, const std::string& mode);
+
+                // Returns 'indices' on the given device. This is computed once and then cached, so that repeated use
+                // of the words and brackets modes doesn't involve any host work or copying to the GPU.
+                torch::Tensor get_indices(torch::Device device) {
+                    std::lock_guard<std::mutex> lock {mutex};
+                    auto key = misc::make_options_key(torch::dtype(torch::kInt64).device(device));
+                    auto found = indices_cache.find(key);
+                    if (found != indices_cache.end()) {
+                        return found->second;
+                    }
+                    torch::Tensor out = indices.to(device);
+                    indices_cache[key] = out;
+                    return out;
+                }
+
+                // Returns 'transform' with the given dtype and on the given device; or its transpose if
+                // backward==true. These are computed once and then cached, so that repeated use of the brackets mode
+                // doesn't involve repeatedly copying the matrix to the GPU.
+                torch::Tensor get_transform(torch::TensorOptions opts, bool backward) {
+                    std::lock_guard<std::mutex> lock {mutex};
+                    auto key = std::make_tuple(backward, misc::make_options_key(opts));
+                    auto found = transform_cache.find(key);
+                    if (found != transform_cache.end()) {
+                        return found->second;
+                    }
+                    torch::Tensor out = backward ? transform.t().coalesce() : transform;
+                    out = out.to(opts.device(), c10::typeMetaToScalarType(opts.dtype()));
+                    transform_cache[key] = out;
+                    return out;
+                }
+
+                // What this was made for
+                int64_t channels;
+                s_size_type depth;
+                LogSignatureMode mode;
+
+                // The number of Lyndon words. Only meaningful if we're in words or brackets mode.
+                int64_t amount;
+
+                // The tensor algebra index of every Lyndon word, ordered by compressed index. It is stored on the CPU,
+                // and is undefined unless we're in words or brackets mode.
+                torch::Tensor indices;
+
+                // The sparse matrix for going from Lyndon words to Lyndon basis; see make_transform.
+                // This is in terms of the 'compressed' index, i.e. in the free Lie algebra.
+                // It is stored on the CPU in double precision, and is undefined unless we're in brackets mode.
+                torch::Tensor transform;
+
+                std::mutex mutex;
+                std::map<misc::options_key, torch::Tensor> indices_cache;
+                std::map<std::tuple<bool, misc::options_key>, torch::Tensor> transform_cache;
+
+                constexpr static auto capsule_name = "signatory.LyndonInfoCapsule";
+            };
+
+            // Converts between LogSignatureMode and the strings used by signatory.logsignature.
+            LogSignatureMode mode_from_string(const std::string& mode);
+            std::string mode_to_string(LogSignatureMode mode);
+
+            // The pieces of the Lyndon transforms, exposed so that they may be benchmarked separately from the
+            // logarithm; see benchmark/native. 'compress' extracts the coefficients of the Lyndon words, given their
+            // indices from LyndonInfo::get_indices. 'apply_transform' applies the sparse change of basis given by
+            // LyndonInfo::get_transform. 'compress_backward' is the backwards operation corresponding to 'compress'.
+            torch::Tensor apply_transform(torch::Tensor transform, torch::Tensor input);
+            torch::Tensor compress(torch::Tensor indices, torch::Tensor input);
+            torch::Tensor compress_backward(torch::Tensor grad_compressed, torch::Tensor indices,
+                                            torch::TensorOptions opts, bool stream, int64_t output_channel_size);
+        }  // namespace signatory::logsignature::detail
+    }  // namespace signatory::logsignature
+
     // Makes a LyndonInfo PyCapsule
     py::object make_lyndon_info(int64_t channels, s_size_type depth, LogSignatureMode mode);
 
+    // Saves a LyndonInfo PyCapsule to a file, so that it may be loaded again with load_lyndon_info rather than being
+    // recomputed.
+    void save_lyndon_info(py::object lyndon_info_capsule, const std::string& filename);
+
+    // Loads a LyndonInfo PyCapsule from a file written by save_lyndon_info, checking that it was made for the given
+    // arguments. The file is memory-mapped rather than read, so this is essentially instant.
+    py::object load_lyndon_info(const std::string& filename, int64_t channels, s_size_type depth,
+                                LogSignatureMode mode);
+
     // See signatory.signature_to_logsignature for documentation
     std::tuple<torch::Tensor, py::object>
     signature_to_logsignature_forward(torch::Tensor signature, int64_t input_channel_size, s_size_type depth,
                                       bool stream, LogSignatureMode mode, py::object lyndon_info_capsule,
-                                      bool scalar_term);
+                                      bool scalar_term, py::object workspace_capsule);
+
+    // As signature_to_logsignature_forward, except that it doesn't touch Python at all: the LyndonInfo and workspace
+    // (nullptr for none) are passed directly, and it must be called without holding the GIL. This is what the
+    // TorchScript operators are built on; see library.cpp.
+    torch::Tensor signature_to_logsignature_forward_impl(torch::Tensor signature, int64_t input_channel_size,
+                                                         s_size_type depth, bool stream, LogSignatureMode mode,
+                                                         logsignature::detail::LyndonInfo* lyndon_info,
+                                                         bool scalar_term, workspace::Workspace* workspace);
 
     // See signatory.signature_to_logsignature for documentation
     torch::Tensor signature_to_logsignature_backward(torch::Tensor grad_logsignature,
@@ -46,7 +160,38 @@ namespace signatory {
                                                      bool stream,
                                                      LogSignatureMode mode,
                                                      py::object lyndon_info_capsule,
-                                                     bool scalar_term);
+                                                     bool scalar_term,
+                                                     py::object workspace_capsule);
+
+    // As signature_to_logsignature_backward, without touching Python; c.f. signature_to_logsignature_forward_impl.
+    torch::Tensor signature_to_logsignature_backward_impl(torch::Tensor grad_logsignature,
+                                                          torch::Tensor signature,
+                                                          int64_t input_channel_size,
+                                                          s_size_type depth,
+                                                          bool stream,
+                                                          LogSignatureMode mode,
+                                                          logsignature::detail::LyndonInfo* lyndon_info,
+                                                          bool scalar_term,
+                                                          workspace::Workspace* workspace);
+
+    // Computes the logsignature of a path with stream==true directly, without going via signature_forward. The
+    // signatures of the partial paths are computed (and then turned into logsignatures) a block at a time, so that
+    // they are never all held in memory at once. See signatory.logsignature for documentation.
+    // Returns the logsignature, the signature of the whole path, the path increments, and the LyndonInfo capsule used.
+    // The middle two of these are what's needed for the backward pass.
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor, py::object>
+    logsignature_stream_forward(torch::Tensor path, s_size_type depth, bool basepoint, torch::Tensor basepoint_value,
+                                bool inverse, LogSignatureMode mode, py::object lyndon_info_capsule,
+                                py::object workspace_capsule);
+
+    // The backward pass corresponding to logsignature_stream_forward. The signatures of the partial paths are
+    // recomputed, backwards from the signature of the whole path, in the same way as signature_backward does when
+    // stream==false.
+    // Returns the gradients with respect to the path, and the basepoint.
+    std::tuple<torch::Tensor, torch::Tensor>
+    logsignature_stream_backward(torch::Tensor grad_logsignature, torch::Tensor signature,
+                                 torch::Tensor path_increments, s_size_type depth, bool basepoint, bool inverse,
+                                 LogSignatureMode mode, py::object lyndon_info_capsule, py::object workspace_capsule);
 }  // namespace signatory
 
 #endif //SIGNATORY_LOGSIGNATURE_HPP
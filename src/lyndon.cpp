@@ -14,6 +14,7 @@
  * ========================================================================= */
 
 
+#include <algorithm>  // std::min
 #include <cstdint>    // int64_t
 #include <stdexcept>  // std::invalid_argument
 #include <utility>    // std::pair
@@ -127,8 +128,7 @@ namespace signatory {
             finalise();
         }
 
-        void LyndonWords::to_lyndon_basis(std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>>& transforms,
-                                          std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>>& transforms_backward){
+        void LyndonWords::to_lyndon_basis(std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>>& transforms){
 
             std::vector<std::map<std::multiset<int64_t>, std::vector<LyndonWord*>>> lyndon_anagrams;
             //                   \--------------------/  \----------------------/
@@ -175,97 +175,118 @@ namespace signatory {
             }
 
             // Now unpack each bracket to find the coefficients we're interested in. This takes quite a lot of work.
-
-            // not exact: we don't know precisely how many nontrivial anagram classes there are
-            transforms.reserve(lyndon_anagrams.size());
-            transforms_backward.reserve(lyndon_anagrams.size());
-
-            transforms.emplace_back();
-            transforms_backward.emplace_back();
-
+            // The expansion of a Lyndon word only depends upon the expansions of the two parts of its standard
+            // bracketing, which are of strictly lower depth. So having handled all lower depths, every anagram class of
+            // a particular depth can be handled independently of the others, and in parallel.
+            using AnagramClass = std::pair<const std::multiset<int64_t>, std::vector<LyndonWord*>>;
+            std::vector<const AnagramClass*> anagram_classes;
+            std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>> class_transforms;
             for (const auto& depth_class : lyndon_anagrams) {  // important to iterate by increasing depth
+                anagram_classes.clear();
                 for (const auto& key_value : depth_class) {
-                    const std::multiset<int64_t>& letters = key_value.first;
-                    if (letters.size() == 1) {
-                        // The lowest level can't be decomposed into two subwords
-                        continue;
+                    // The lowest level can't be decomposed into two subwords
+                    if (key_value.first.size() > 1) {
+                        anagram_classes.push_back(&key_value);
                     }
-                    if (transforms.back().size() != 0) {
-                        transforms.emplace_back();
-                        transforms_backward.emplace_back();
-                    }
-                    auto& transforms_back = transforms.back();
-                    auto& transforms_backward_back = transforms_backward.back();
-                    for (const auto& lyndon_word : key_value.second) {
-                        // Record the coefficients of each word in the expansion
-                        std::map<std::vector<int64_t>, int64_t> bracket_expansion;
-
-                        const auto& first_bracket_expansion = lyndon_word->extra->first_child->extra->expansion;
-                        const auto& second_bracket_expansion = lyndon_word->extra->second_child->extra->expansion;
-
-                        // Iterate over every word in the expansion of the first element of the bracket
-                        for (const auto& first_word_coeff : first_bracket_expansion) {
-                            const std::vector<int64_t>& first_word = first_word_coeff.first;
-                            int64_t first_coeff = first_word_coeff.second;
-
-                            // And over every word in the expansion of the second element of the bracket
-                            for (const auto& second_word_coeff : second_bracket_expansion) {
-                                const std::vector<int64_t>& second_word = second_word_coeff.first;
-                                int64_t second_coeff = second_word_coeff.second;
-
-                                // And put them together to get every word in the expansion of the bracket
-                                std::vector<int64_t> first_then_second = detail::concat_vectors(first_word, second_word);
-                                std::vector<int64_t> second_then_first = detail::concat_vectors(second_word, first_word);
-
-
-                                int64_t product = first_coeff * second_coeff;
-
-                                // At the final depth we only need to
-                                // record the coefficients of Lyndon words. At lower depths we need to record the
-                                // coefficients of non-Lyndon words in case some concatenation on to them becomes a Lyndon
-                                // word at higher depths.
-                                if (static_cast<s_size_type>(letters.size()) < depth ||
-                                    lyndon_word->is_lyndon_anagram(first_then_second)) {
-                                    bracket_expansion[first_then_second] += product;
-                                }
-                                if (static_cast<s_size_type>(letters.size()) < depth ||
-                                    lyndon_word->is_lyndon_anagram(second_then_first)) {
-                                    bracket_expansion[second_then_first] -= product;
-                                }
-                            }
+                }
+                class_transforms.clear();
+                class_transforms.resize(anagram_classes.size());
+
+                // Anagram classes vary a lot in size, so deal them out to the threads in turn, rather than giving each
+                // thread a contiguous chunk of them.
+                int64_t num_classes = anagram_classes.size();
+                int64_t threads = std::min(num_classes, misc::max_threads());
+                misc::parallel_for(threads, threads, [&](int64_t begin, int64_t end) {
+                    for (int64_t offset = begin; offset < end; ++offset) {
+                        for (int64_t class_index = offset; class_index < num_classes; class_index += threads) {
+                            anagram_class_to_lyndon_basis(anagram_classes[class_index]->first,
+                                                          anagram_classes[class_index]->second,
+                                                          class_transforms[class_index]);
                         }
+                    }
+                });
+
+                // Keep the same order as a serial computation would have
+                for (auto& transform_class : class_transforms) {
+                    if (transform_class.size() != 0) {
+                        transforms.push_back(std::move(transform_class));
+                    }
+                }
+            }
+            if (transforms.size() == 0) {
+                transforms.emplace_back();
+            }
+        }
 
-                        // Record the transformations we're interested in
-                        auto end = lyndon_word->extra->anagram_class->end();
-                        for (const auto& word_coeff : bracket_expansion) {
-                            const std::vector<int64_t>& word = word_coeff.first;
-                            int64_t coeff = word_coeff.second;
-
-                            // Filter out non-Lyndon words. (If letters.size() == depth then we've essentially
-                            // already done this above so the if statement should always be true, so we check that
-                            // preferentially as it's probably faster to check. Probably - I know I know I should time it
-                            // but it's not that big a deal either way...)
-                            auto ptr_to_word = std::lower_bound(lyndon_word->extra->anagram_limit, end, word,
-                                                                detail::compare_words);
-                            if (ptr_to_word != end) {
-                                if (static_cast<s_size_type>(letters.size()) == depth ||
-                                    (*ptr_to_word)->extra->word == word) {
-                                    transforms_back.emplace_back(lyndon_word->compressed_index,
-                                                                 (*ptr_to_word)->compressed_index,
-                                                                 coeff);
-                                    transforms_backward_back.emplace_back(lyndon_word->tensor_algebra_index,
-                                                                          (*ptr_to_word)->tensor_algebra_index,
-                                                                          coeff);
-                                }
-                            }
+        void LyndonWords::anagram_class_to_lyndon_basis(const std::multiset<int64_t>& letters,
+                                                        const std::vector<LyndonWord*>& anagram_class,
+                                                        std::vector<std::tuple<int64_t, int64_t, int64_t>>& transforms)
+                                                        const {
+            for (const auto& lyndon_word : anagram_class) {
+                // Record the coefficients of each word in the expansion
+                std::map<std::vector<int64_t>, int64_t> bracket_expansion;
+
+                const auto& first_bracket_expansion = lyndon_word->extra->first_child->extra->expansion;
+                const auto& second_bracket_expansion = lyndon_word->extra->second_child->extra->expansion;
+
+                // Iterate over every word in the expansion of the first element of the bracket
+                for (const auto& first_word_coeff : first_bracket_expansion) {
+                    const std::vector<int64_t>& first_word = first_word_coeff.first;
+                    int64_t first_coeff = first_word_coeff.second;
+
+                    // And over every word in the expansion of the second element of the bracket
+                    for (const auto& second_word_coeff : second_bracket_expansion) {
+                        const std::vector<int64_t>& second_word = second_word_coeff.first;
+                        int64_t second_coeff = second_word_coeff.second;
+
+                        // And put them together to get every word in the expansion of the bracket
+                        std::vector<int64_t> first_then_second = detail::concat_vectors(first_word, second_word);
+                        std::vector<int64_t> second_then_first = detail::concat_vectors(second_word, first_word);
+
+
+                        int64_t product = first_coeff * second_coeff;
+
+                        // At the final depth we only need to
+                        // record the coefficients of Lyndon words. At lower depths we need to record the
+                        // coefficients of non-Lyndon words in case some concatenation on to them becomes a Lyndon
+                        // word at higher depths.
+                        if (static_cast<s_size_type>(letters.size()) < depth ||
+                            lyndon_word->is_lyndon_anagram(first_then_second)) {
+                            bracket_expansion[first_then_second] += product;
                         }
+                        if (static_cast<s_size_type>(letters.size()) < depth ||
+                            lyndon_word->is_lyndon_anagram(second_then_first)) {
+                            bracket_expansion[second_then_first] -= product;
+                        }
+                    }
+                }
 
-                        // At the final depth then we don't need to record what we've found
-                        if (static_cast<s_size_type>(letters.size()) < depth) {
-                            lyndon_word->extra->expansion = std::move(bracket_expansion);
+                // Record the transformations we're interested in
+                auto end = lyndon_word->extra->anagram_class->end();
+                for (const auto& word_coeff : bracket_expansion) {
+                    const std::vector<int64_t>& word = word_coeff.first;
+                    int64_t coeff = word_coeff.second;
+
+                    // Filter out non-Lyndon words. (If letters.size() == depth then we've essentially
+                    // already done this above so the if statement should always be true, so we check that
+                    // preferentially as it's probably faster to check. Probably - I know I know I should time it
+                    // but it's not that big a deal either way...)
+                    auto ptr_to_word = std::lower_bound(lyndon_word->extra->anagram_limit, end, word,
+                                                        detail::compare_words);
+                    if (ptr_to_word != end) {
+                        if (static_cast<s_size_type>(letters.size()) == depth ||
+                            (*ptr_to_word)->extra->word == word) {
+                            transforms.emplace_back(lyndon_word->compressed_index,
+                                                    (*ptr_to_word)->compressed_index,
+                                                    coeff);
                         }
                     }
                 }
+
+                // At the final depth then we don't need to record what we've found
+                if (static_cast<s_size_type>(letters.size()) < depth) {
+                    lyndon_word->extra->expansion = std::move(bracket_expansion);
+                }
             }
         }
 
@@ -421,8 +442,7 @@ namespace signatory {
 
         lyndon::LyndonWords lyndon_words(channels, depth, lyndon::LyndonWords::bracket_tag);
         std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>> transforms;
-        std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>> transforms_backward;
-        lyndon_words.to_lyndon_basis(transforms, transforms_backward);
+        lyndon_words.to_lyndon_basis(transforms);
         return transforms;
     }
 }  // namespace signatory
\ No newline at end of file
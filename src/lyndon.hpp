@@ -55,10 +55,10 @@ namespace signatory {
 
             /* Computes the transforms that need to be applied to the coefficients of the Lyndon words to produce the
              * coefficients of the Lyndon basis.
-             * The transforms are returned in the transforms argument.
+             * The transforms are returned in the transforms argument, grouped by anagram class.
+             * The anagram classes of each depth are handled in parallel.
              */
-            void to_lyndon_basis(std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>>& transforms,
-                                 std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>>& transforms_backward);
+            void to_lyndon_basis(std::vector<std::vector<std::tuple<int64_t, int64_t, int64_t>>>& transforms);
 
             /* Deletes the ExtraLyndonInformation associated with each word, if it is present. This is to reclaim memory
              * when we know we don't need it any more.
@@ -71,6 +71,12 @@ namespace signatory {
             s_size_type depth;
         private:
             void finalise();
+
+            // Computes the transforms of to_lyndon_basis for a single anagram class, whose Lyndon words all consist of
+            // 'letters'. Every anagram class of lower depth must already have been handled.
+            void anagram_class_to_lyndon_basis(const std::multiset<int64_t>& letters,
+                                               const std::vector<LyndonWord*>& anagram_class,
+                                               std::vector<std::tuple<int64_t, int64_t, int64_t>>& transforms) const;
         };
 
         /* Represents a single Lyndon word. It is primarily represented by a pair of indices, corresponding to how
@@ -19,6 +19,7 @@
 #define SIGNATORY_MISC_HPP
 
 #include <torch/extension.h>
+#include <ATen/Parallel.h>  // at::parallel_for, at::get_num_threads
 #include <cstdint>      // int64_t
 #include <tuple>        // std::tuple
 #include <type_traits>  // std::make_signed, std::make_unsigned
@@ -56,6 +57,10 @@ namespace signatory {
     namespace misc {
         inline torch::Tensor make_reciprocals(s_size_type depth, torch::TensorOptions opts);
 
+        // Identifies a dtype and device, for use as the key when caching tensors: dtype, device type, device index.
+        using options_key = std::tuple<torch::ScalarType, torch::DeviceType, int64_t>;
+        inline options_key make_options_key(torch::TensorOptions opts);
+
         // Argument 'in' is assumed to be a tensor with channel dimension of size minimalspec.input_channels.
         // It is sliced up along that dimension, and the resulting tensors placed into 'out'.
         // Each resulting tensor corresponds to one of the (tensor, not scalar) terms in the signature.
@@ -67,6 +72,17 @@ namespace signatory {
         inline void slice_at_stream(const std::vector<torch::Tensor>& in, std::vector<torch::Tensor>& out,
                                     int64_t stream_index);
 
+        // The number of threads that a computation on the CPU may use. This is PyTorch's intra-op thread count, so it
+        // respects torch.set_num_threads.
+        inline int64_t max_threads();
+
+        // Calls fn(begin, end) on disjoint chunks covering [0, size), spread over at most 'threads' threads of the
+        // intra-op thread pool that ATen uses for its own operations. If called from within another such parallel
+        // region (e.g. when parallelising along the stream dimension, and then the batch dimension within that) then
+        // the inner region simply runs serially in the current thread, so that we never oversubscribe the machine.
+        template <typename F>
+        inline void parallel_for(int64_t size, int64_t threads, const F& fn);
+
         // Checks the arguments for a bunch of functions only depending on channels and depth.
         void checkargs_channels_depth(int64_t channels, s_size_type depth);
     }  // namespace signatory::misc
@@ -15,7 +15,9 @@
 
 
 #include <torch/extension.h>
+#include <ATen/Parallel.h>  // at::parallel_for, at::get_num_threads
 #include <cstdint>      // int64_t
+#include <tuple>        // std::make_tuple
 #include <vector>       // std::vector
 
 
@@ -30,6 +32,12 @@ namespace signatory {
             }
         }
 
+        inline options_key make_options_key(torch::TensorOptions opts) {
+            torch::Device device = opts.device();
+            return std::make_tuple(c10::typeMetaToScalarType(opts.dtype()), device.type(),
+                                   static_cast<int64_t>(device.index()));
+        }
+
         inline void slice_by_term(torch::Tensor in, std::vector<torch::Tensor>& out, int64_t input_channel_size,
                                   s_size_type depth) {
             int64_t current_memory_pos = 0;
@@ -53,5 +61,23 @@ namespace signatory {
                 out.push_back(elem[stream_index]);
             }
         }
+
+        inline int64_t max_threads() {
+            return at::get_num_threads();
+        }
+
+        template <typename F>
+        inline void parallel_for(int64_t size, int64_t threads, const F& fn) {
+            if (size <= 0) {
+                return;
+            }
+            if (threads <= 1 || size == 1) {
+                fn(0, size);
+                return;
+            }
+            // at::parallel_for won't split the range into chunks smaller than grain_size, so this asks for at most
+            // 'threads' chunks. (It also caps the number of chunks at torch.get_num_threads().)
+            at::parallel_for(0, size, (size + threads - 1) / threads, fn);
+        }
     }  // namespace signatory::misc
 }  // namespace signatory
\ No newline at end of file
@@ -0,0 +1,59 @@
+/* Copyright 2019 Patrick Kidger. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ========================================================================= */
+
+
+#include <torch/extension.h>
+#include <atomic>     // std::atomic, std::memory_order_relaxed
+#include <map>        // std::map
+#include <mutex>      // std::lock_guard, std::mutex
+#include <string>     // std::string
+
+#include "profiling.hpp"
+
+
+namespace signatory {
+    namespace profiling {
+        namespace detail {
+            std::atomic<bool> counters_enabled {false};
+
+            std::mutex mutex;
+            std::map<std::string, double> counters;
+
+            void add(const std::string& name, double value) {
+                std::lock_guard<std::mutex> lock {mutex};
+                counters[name] += value;
+            }
+
+            void set(const std::string& name, double value) {
+                std::lock_guard<std::mutex> lock {mutex};
+                counters[name] = value;
+            }
+        }  // namespace signatory::profiling::detail
+    }  // namespace signatory::profiling
+
+    void enable_profiling_counters(bool enabled) {
+        profiling::detail::counters_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    std::map<std::string, double> profiling_counters() {
+        std::lock_guard<std::mutex> lock {profiling::detail::mutex};
+        return profiling::detail::counters;
+    }
+
+    void reset_profiling_counters() {
+        std::lock_guard<std::mutex> lock {profiling::detail::mutex};
+        profiling::detail::counters.clear();
+    }
+}  // namespace signatory
@@ -0,0 +1,94 @@
+/* Copyright 2019 Patrick Kidger. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ========================================================================= */
+ // Provides instrumentation of the signature and logsignature computations.
+ //
+ // Each stage of a computation is marked with SIGNATORY_PROFILE_STAGE. This always records a range for the PyTorch
+ // profiler, which is essentially free when no profiler is running. (And which becomes an NVTX range inside
+ // torch.autograd.profiler.emit_nvtx.) If the counters have been turned on (see signatory.enable_profiling_counters)
+ // then it also adds one to the number of calls of that stage, and the time spent in it to its total time. Other
+ // counters record the amount of parallelism chosen, and the amount of memory allocated.
+ //
+ // When the counters are turned off, the only cost is the check of whether they're turned on. When they're turned on,
+ // updating them takes a lock, so stages should be coarse: never a single operation inside a loop along the stream.
+
+
+#ifndef SIGNATORY_PROFILING_HPP
+#define SIGNATORY_PROFILING_HPP
+
+#include <torch/extension.h>
+#include <ATen/record_function.h>  // RECORD_FUNCTION
+#include <atomic>     // std::atomic
+#include <chrono>     // std::chrono::steady_clock
+#include <map>        // std::map
+#include <string>     // std::string
+#include <vector>     // std::vector
+
+
+namespace signatory {
+    namespace profiling {
+        namespace detail {
+            extern std::atomic<bool> counters_enabled;
+
+            // As profiling::add and profiling::set, except that these update the counters regardless of whether
+            // they're turned on.
+            void add(const std::string& name, double value);
+            void set(const std::string& name, double value);
+        }  // namespace signatory::profiling::detail
+
+        // Whether the counters are turned on.
+        inline bool counters_enabled();
+
+        // Adds 'value' onto the counter 'name'. Does nothing if the counters are turned off.
+        inline void add(const char* name, double value);
+
+        // Sets the counter 'name' to 'value'. Does nothing if the counters are turned off.
+        inline void set(const char* name, double value);
+
+        // Adds the time between its construction and destruction onto the counter "<stage>.seconds", and one onto the
+        // counter "<stage>.calls". Does nothing if the counters were turned off when it was constructed. Use
+        // SIGNATORY_PROFILE_STAGE rather than using this directly.
+        //
+        // On the GPU this is the time taken on the host, which (as kernels are launched asynchronously) need not be
+        // the time the stage took to run. Set CUDA_LAUNCH_BLOCKING=1 to make the two the same.
+        class StageTimer {
+        public:
+            inline explicit StageTimer(const char* stage);
+            inline ~StageTimer();
+        private:
+            const char* stage;
+            bool enabled;
+            std::chrono::steady_clock::time_point start;
+        };
+    }  // namespace signatory::profiling
+
+    // See signatory.enable_profiling_counters
+    void enable_profiling_counters(bool enabled);
+
+    // See signatory.profiling_counters
+    std::map<std::string, double> profiling_counters();
+
+    // See signatory.reset_profiling_counters
+    void reset_profiling_counters();
+}  // namespace signatory
+
+// Marks the rest of the enclosing scope as the stage 'name' of a computation; see the top of this file. 'name' must be
+// a string literal. (At most one stage may be started in any one scope.)
+#define SIGNATORY_PROFILE_STAGE(name)                                 \
+    RECORD_FUNCTION("signatory::" name, std::vector<c10::IValue>()); \
+    signatory::profiling::StageTimer signatory_profile_stage_timer {name}
+
+#include "profiling.inl"
+
+#endif //SIGNATORY_PROFILING_HPP
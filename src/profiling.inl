@@ -0,0 +1,54 @@
+/* Copyright 2019 Patrick Kidger. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ========================================================================= */
+
+
+#include <atomic>     // std::memory_order_relaxed
+#include <chrono>     // std::chrono::duration, std::chrono::steady_clock
+#include <string>     // std::string
+
+
+namespace signatory {
+    namespace profiling {
+        inline bool counters_enabled() {
+            return detail::counters_enabled.load(std::memory_order_relaxed);
+        }
+
+        inline void add(const char* name, double value) {
+            if (counters_enabled()) {
+                detail::add(name, value);
+            }
+        }
+
+        inline void set(const char* name, double value) {
+            if (counters_enabled()) {
+                detail::set(name, value);
+            }
+        }
+
+        inline StageTimer::StageTimer(const char* stage) : stage{stage}, enabled{counters_enabled()} {
+            if (enabled) {
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        inline StageTimer::~StageTimer() {
+            if (enabled) {
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                detail::add(std::string(stage) + ".seconds", elapsed.count());
+                detail::add(std::string(stage) + ".calls", 1);
+            }
+        }
+    }  // namespace signatory::profiling
+}  // namespace signatory
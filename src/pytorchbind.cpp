@@ -20,20 +20,56 @@
 #include "logsignature.hpp"  // signatory::LogSignatureMode,
                              // signatory::signature_to_logsignature_forward,
                              // signatory::signature_to_logsignature_backward,
-                             // signatory::make_lyndon_info
+                             // signatory::logsignature_stream_forward,
+                             // signatory::logsignature_stream_backward,
+                             // signatory::make_lyndon_info,
+                             // signatory::save_lyndon_info,
+                             // signatory::load_lyndon_info
 
 #include "misc.hpp"          // signatory::signature_channels
 
+#include "profiling.hpp"     // signatory::enable_profiling_counters,
+                             // signatory::profiling_counters,
+                             // signatory::reset_profiling_counters
+
 #include "signature.hpp"     // signatory::signature_checkargs
                              // signatory::signature_forward,
                              // signatory::signature_backward,
+                             // signatory::signature_and_inverse_forward,
+                             // signatory::signature_levels_checkargs,
+                             // signatory::signature_levels_forward,
+                             // signatory::signature_levels_backward,
+                             // signatory::signature_checkpoint_forward,
+                             // signatory::signature_checkpoint_backward,
+                             // signatory::signature_windows_checkargs,
+                             // signatory::signature_windows_forward,
+                             // signatory::signature_windows_backward,
+                             // signatory::signature_packed_checkargs,
+                             // signatory::signature_packed_forward,
+                             // signatory::signature_packed_backward
+
+#include "signature_kernel.hpp"  // signatory::signature_kernel_checkargs,
+                                 // signatory::signature_kernel_forward,
+                                 // signatory::signature_kernel_backward,
+                                 // signatory::signature_kernel::detail::set_tile_elements
 
 #include "lyndon.hpp"        // signatory::lyndon_words,
                              // signatory::lyndon_brackets,
                              // signatory::lyndon_words_to_basis_transform
 
 #include "tensor_algebra_ops.hpp"  // signatory::signature_combine_forward,
-                                   // signatory::signature_combine_backward
+                                   // signatory::signature_combine_backward,
+                                   // signatory::invert_signature_forward,
+                                   // signatory::invert_signature_backward,
+                                   // signatory::ta_ops::mult,
+                                   // signatory::ta_ops::mult_into,
+                                   // signatory::ta_ops::mult_backward,
+                                   // signatory::ta_ops::log,
+                                   // signatory::ta_ops::log_backward,
+                                   // signatory::ta_ops::detail::set_cpu_kernels_enabled
+
+#include "workspace.hpp"     // signatory::make_workspace,
+                             // signatory::workspace_clear
 
 #ifndef _OPENMP
     #error OpenMP required
@@ -44,8 +80,16 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
           &signatory::signature_to_logsignature_forward);
     m.def("signature_to_logsignature_backward",
           &signatory::signature_to_logsignature_backward);
+    m.def("logsignature_stream_forward",
+          &signatory::logsignature_stream_forward);
+    m.def("logsignature_stream_backward",
+          &signatory::logsignature_stream_backward);
     m.def("make_lyndon_info",
           &signatory::make_lyndon_info);
+    m.def("save_lyndon_info",
+          &signatory::save_lyndon_info);
+    m.def("load_lyndon_info",
+          &signatory::load_lyndon_info);
     py::enum_<signatory::LogSignatureMode>(m, "LogSignatureMode")
             .value("Expand", signatory::LogSignatureMode::Expand)
             .value("Brackets", signatory::LogSignatureMode::Brackets)
@@ -56,6 +100,38 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
           &signatory::signature_forward);
     m.def("signature_backward",
           &signatory::signature_backward);
+    m.def("signature_and_inverse_forward",
+          &signatory::signature_and_inverse_forward);
+    m.def("signature_levels_checkargs",
+          &signatory::signature_levels_checkargs);
+    m.def("signature_levels_forward",
+          &signatory::signature_levels_forward);
+    m.def("signature_levels_backward",
+          &signatory::signature_levels_backward);
+    m.def("signature_checkpoint_forward",
+          &signatory::signature_checkpoint_forward);
+    m.def("signature_checkpoint_backward",
+          &signatory::signature_checkpoint_backward);
+    m.def("signature_windows_checkargs",
+          &signatory::signature_windows_checkargs);
+    m.def("signature_windows_forward",
+          &signatory::signature_windows_forward);
+    m.def("signature_windows_backward",
+          &signatory::signature_windows_backward);
+    m.def("signature_packed_checkargs",
+          &signatory::signature_packed_checkargs);
+    m.def("signature_packed_forward",
+          &signatory::signature_packed_forward);
+    m.def("signature_packed_backward",
+          &signatory::signature_packed_backward);
+    m.def("signature_kernel_checkargs",
+          &signatory::signature_kernel_checkargs);
+    m.def("signature_kernel_forward",
+          &signatory::signature_kernel_forward);
+    m.def("signature_kernel_backward",
+          &signatory::signature_kernel_backward);
+    m.def("signature_kernel_set_tile_elements",
+          &signatory::signature_kernel::detail::set_tile_elements);
     m.def("signature_channels",
           &signatory::signature_channels);
     m.def("lyndon_words",
@@ -71,4 +147,35 @@ PYBIND11_MODULE(TORCH_EXTENSION_NAME, m) {
           &signatory::signature_combine_forward);
     m.def("signature_combine_backward",
         &signatory::signature_combine_backward);
+    m.def("invert_signature_forward",
+          &signatory::invert_signature_forward);
+    m.def("invert_signature_backward",
+          &signatory::invert_signature_backward);
+    m.def("tensor_algebra_mult",
+          &signatory::ta_ops::mult);
+    m.def("tensor_algebra_mult_into",
+          &signatory::ta_ops::mult_into</*add_not_copy=*/false>);
+    m.def("tensor_algebra_mult_into_add",
+          &signatory::ta_ops::mult_into</*add_not_copy=*/true>);
+    m.def("tensor_algebra_mult_backward",
+          &signatory::ta_ops::mult_backward</*add_not_copy=*/false>);
+    m.def("tensor_algebra_mult_backward_add",
+          &signatory::ta_ops::mult_backward</*add_not_copy=*/true>);
+    m.def("tensor_algebra_log",
+          &signatory::ta_ops::log);
+    m.def("tensor_algebra_log_backward",
+          &signatory::ta_ops::log_backward);
+    m.def("tensor_algebra_set_cpu_kernels_enabled",
+          &signatory::ta_ops::detail::set_cpu_kernels_enabled);
+    m.def("make_workspace",
+          &signatory::make_workspace);
+    m.def("workspace_clear",
+          &signatory::workspace_clear);
+    m.def("enable_profiling_counters",
+          &signatory::enable_profiling_counters);
+    m.def("profiling_counters",
+          &signatory::profiling_counters,
+          py::return_value_policy::move);
+    m.def("reset_profiling_counters",
+          &signatory::reset_profiling_counters);
 }
\ No newline at end of file
@@ -44,17 +44,27 @@ from .logsignature_module import (signature_to_logsignature,
                                   Logsignature,  # alias for LogSignature
                                   logsignature_channels)
 from .path import Path
+from .profiling import (enable_profiling_counters,
+                        profiling_counters,
+                        reset_profiling_counters)
+from .sharded_module import (signature_sharded,
+                             signature_distributed)
 from .signature_module import (signature,
                                Signature,
                                signature_channels,
                                extract_signature_term,
                                signature_combine,
-                               multi_signature_combine)
+                               multi_signature_combine,
+                               signature_windows,
+                               signature_packed,
+                               signature_async)
 from .signature_inversion_module import invert_signature
+from .signature_kernel_module import signature_kernel
 from . import unstable  # make it available as an attribute here, but don't import any unstable objects themselves
 from .utility import (lyndon_words,
                       lyndon_brackets,
                       all_words)
+from .workspace import Workspace
 
 
 __version__ = "1.2.5"
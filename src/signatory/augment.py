@@ -111,6 +111,13 @@ class Augment(nn.Module):
             if include_time:
                 out_channels += 1
 
+    .. note::
+
+        If the only augmentations wanted are cheap ones - that is, adding time, or taking the lead-lag transform - then
+        consider instead passing :code:`include_time=True` or :code:`lead_lag=True` to :func:`signatory.signature`.
+        These are applied on the fly as part of the signature computation, without ever forming the augmented path, so
+        they save a full read and write of what is typically the largest tensor involved.
+
     """
 
     def __init__(self,
@@ -42,13 +42,48 @@ def _wrap(fn):
 LogSignatureMode = _impl.LogSignatureMode  # not wrapped because it's not a function
 signature_to_logsignature_forward = _wrap(_impl.signature_to_logsignature_forward)
 signature_to_logsignature_backward = _wrap(_impl.signature_to_logsignature_backward)
+logsignature_stream_forward = _wrap(_impl.logsignature_stream_forward)
+logsignature_stream_backward = _wrap(_impl.logsignature_stream_backward)
 make_lyndon_info = _wrap(_impl.make_lyndon_info)
+save_lyndon_info = _wrap(_impl.save_lyndon_info)
+load_lyndon_info = _wrap(_impl.load_lyndon_info)
 signature_forward = _wrap(_impl.signature_forward)
 signature_backward = _wrap(_impl.signature_backward)
+signature_and_inverse_forward = _wrap(_impl.signature_and_inverse_forward)
+signature_levels_checkargs = _wrap(_impl.signature_levels_checkargs)
+signature_levels_forward = _wrap(_impl.signature_levels_forward)
+signature_levels_backward = _wrap(_impl.signature_levels_backward)
+signature_checkpoint_forward = _wrap(_impl.signature_checkpoint_forward)
+signature_checkpoint_backward = _wrap(_impl.signature_checkpoint_backward)
+signature_windows_checkargs = _wrap(_impl.signature_windows_checkargs)
+signature_windows_forward = _wrap(_impl.signature_windows_forward)
+signature_windows_backward = _wrap(_impl.signature_windows_backward)
+signature_packed_checkargs = _wrap(_impl.signature_packed_checkargs)
+signature_packed_forward = _wrap(_impl.signature_packed_forward)
+signature_packed_backward = _wrap(_impl.signature_packed_backward)
+signature_kernel_checkargs = _wrap(_impl.signature_kernel_checkargs)
+signature_kernel_forward = _wrap(_impl.signature_kernel_forward)
+signature_kernel_backward = _wrap(_impl.signature_kernel_backward)
+signature_kernel_set_tile_elements = _wrap(_impl.signature_kernel_set_tile_elements)
 signature_checkargs = _wrap(_impl.signature_checkargs)
 signature_channels = _wrap(_impl.signature_channels)
 signature_combine_forward = _wrap(_impl.signature_combine_forward)
 signature_combine_backward = _wrap(_impl.signature_combine_backward)
+invert_signature_forward = _wrap(_impl.invert_signature_forward)
+invert_signature_backward = _wrap(_impl.invert_signature_backward)
+tensor_algebra_mult = _wrap(_impl.tensor_algebra_mult)
+tensor_algebra_mult_into = _wrap(_impl.tensor_algebra_mult_into)
+tensor_algebra_mult_into_add = _wrap(_impl.tensor_algebra_mult_into_add)
+tensor_algebra_mult_backward = _wrap(_impl.tensor_algebra_mult_backward)
+tensor_algebra_mult_backward_add = _wrap(_impl.tensor_algebra_mult_backward_add)
+tensor_algebra_log = _wrap(_impl.tensor_algebra_log)
+tensor_algebra_log_backward = _wrap(_impl.tensor_algebra_log_backward)
+tensor_algebra_set_cpu_kernels_enabled = _wrap(_impl.tensor_algebra_set_cpu_kernels_enabled)
 lyndon_words_to_basis_transform = _wrap(_impl.lyndon_words_to_basis_transform)
 lyndon_words = _wrap(_impl.lyndon_words)
 lyndon_brackets = _wrap(_impl.lyndon_brackets)
+make_workspace = _wrap(_impl.make_workspace)
+workspace_clear = _wrap(_impl.workspace_clear)
+enable_profiling_counters = _wrap(_impl.enable_profiling_counters)
+profiling_counters = _wrap(_impl.profiling_counters)
+reset_profiling_counters = _wrap(_impl.reset_profiling_counters)
@@ -16,6 +16,8 @@
 
 
 import math
+import os
+import tempfile
 import torch
 from torch import nn
 from torch import autograd
@@ -25,8 +27,9 @@ import weakref
 
 from . import signature_module as smodule
 from . import impl
+from . import workspace as wmodule
 
-from typing import Union
+from typing import Optional, Union
 
 
 def _interpret_mode(mode):
@@ -40,13 +43,48 @@ def _interpret_mode(mode):
         raise ValueError("Invalid values for argument 'mode'. Valid values are 'expand', 'brackets', or 'words'.")
 
 
+def _make_lyndon_info(in_channels, depth, mode):
+    # If SIGNATORY_LYNDON_CACHE is set to a directory then the LyndonInfo is kept there between processes; see the
+    # documentation for signatory.SignatureToLogSignature.
+    mode_ = _interpret_mode(mode)
+    cache_dir = os.environ.get('SIGNATORY_LYNDON_CACHE')
+    if not cache_dir:
+        return impl.make_lyndon_info(in_channels, depth, mode_)
+
+    filename = os.path.join(cache_dir, 'lyndon_info_{}_{}_{}.bin'.format(in_channels, depth, mode))
+    if os.path.exists(filename):
+        try:
+            return impl.load_lyndon_info(filename, in_channels, depth, mode_)
+        except ValueError:
+            # e.g. written by a different version of Signatory, so just recompute it and overwrite it.
+            pass
+
+    lyndon_info = impl.make_lyndon_info(in_channels, depth, mode_)
+    try:
+        os.makedirs(cache_dir, exist_ok=True)
+        # Write to a temporary file and then move it into place, so that other processes starting up at the same time
+        # never see a partially-written file.
+        fd, temp_filename = tempfile.mkstemp(dir=cache_dir, suffix='.tmp')
+        os.close(fd)
+        try:
+            impl.save_lyndon_info(lyndon_info, temp_filename)
+            os.replace(temp_filename, filename)
+        except BaseException:
+            os.remove(temp_filename)
+            raise
+    except (OSError, ValueError) as e:
+        warnings.warn("Could not save to the Lyndon cache directory '{}': {}".format(cache_dir, e))
+    return lyndon_info
+
+
 class _SignatureToLogsignatureFunction(autograd.Function):
     @staticmethod
-    def forward(ctx, signature, channels, depth, stream, mode, lyndon_info, scalar_term):
+    def forward(ctx, signature, channels, depth, stream, mode, lyndon_info, scalar_term, workspace):
         mode = _interpret_mode(mode)
 
         logsignature_, lyndon_info_capsule = impl.signature_to_logsignature_forward(signature, channels, depth, stream,
-                                                                                     mode, lyndon_info, scalar_term)
+                                                                                     mode, lyndon_info, scalar_term,
+                                                                                     workspace)
         ctx.save_for_backward(signature.detach())
         ctx.channels = channels
         ctx.depth = depth
@@ -54,6 +92,7 @@ class _SignatureToLogsignatureFunction(autograd.Function):
         ctx.mode = mode
         ctx.lyndon_info_capsule = lyndon_info_capsule
         ctx.scalar_term = scalar_term
+        ctx.workspace = workspace
 
         return logsignature_
 
@@ -64,23 +103,69 @@ class _SignatureToLogsignatureFunction(autograd.Function):
 
         grad_signature = impl.signature_to_logsignature_backward(grad_logsignature, signature, ctx.channels, ctx.depth,
                                                                  ctx.stream, ctx.mode, ctx.lyndon_info_capsule,
-                                                                 ctx.scalar_term)
+                                                                 ctx.scalar_term, ctx.workspace)
 
-        return grad_signature, None, None, None, None, None, None
+        return grad_signature, None, None, None, None, None, None, None
 
 
-def _signature_to_logsignature(signature, channels, depth, stream, mode, lyndon_info, scalar_term):
+def _signature_to_logsignature(signature, channels, depth, stream, mode, lyndon_info, scalar_term, workspace):
     if stream:
         signature = signature.transpose(0, 1)  # (batch, stream, channel) to (stream, batch, channel)
     logsignature_ = _SignatureToLogsignatureFunction.apply(signature, channels, depth, stream, mode, lyndon_info,
-                                                           scalar_term)
+                                                           scalar_term, wmodule._capsule(workspace))
     if stream:
         logsignature_ = logsignature_.transpose(0, 1)  # (stream, batch, channel) to (batch, stream, channel)
     return logsignature_
 
 
+class _LogSignatureStreamFunction(autograd.Function):
+    @staticmethod
+    def forward(ctx, path, depth, basepoint, inverse, mode, lyndon_info, workspace):
+        mode = _interpret_mode(mode)
+
+        ctx.basepoint_is_tensor = isinstance(basepoint, torch.Tensor)
+        basepoint, basepoint_value = smodule.interpret_basepoint(basepoint, path.size(-2), path.size(-1), path.dtype,
+                                                                 path.device)
+
+        logsignature_, signature_, path_increments, lyndon_info_capsule = impl.logsignature_stream_forward(
+            path, depth, basepoint, basepoint_value, inverse, mode, lyndon_info, workspace)
+        ctx.save_for_backward(signature_, path_increments)
+        ctx.depth = depth
+        ctx.basepoint = basepoint
+        ctx.inverse = inverse
+        ctx.mode = mode
+        ctx.lyndon_info_capsule = lyndon_info_capsule
+        ctx.workspace = workspace
+
+        return logsignature_
+
+    @staticmethod
+    @autograd_function.once_differentiable  # Our backward function uses in-place operations for memory efficiency
+    def backward(ctx, grad_logsignature):
+        signature_, path_increments = ctx.saved_tensors
+        # See _SignatureFunction.backward
+        path_increments = path_increments.contiguous()
+
+        grad_path, grad_basepoint = impl.logsignature_stream_backward(grad_logsignature, signature_, path_increments,
+                                                                      ctx.depth, ctx.basepoint, ctx.inverse, ctx.mode,
+                                                                      ctx.lyndon_info_capsule, ctx.workspace)
+
+        if not ctx.basepoint_is_tensor:
+            grad_basepoint = None
+
+        return grad_path, None, grad_basepoint, None, None, None, None
+
+
+def _logsignature_stream(path, depth, basepoint, inverse, mode, lyndon_info, workspace):
+    path = path.transpose(0, 1)  # (batch, stream, channel) to (stream, batch, channel)
+    logsignature_ = _LogSignatureStreamFunction.apply(path, depth, basepoint, inverse, mode, lyndon_info,
+                                                      wmodule._capsule(workspace))
+    return logsignature_.transpose(0, 1)  # (stream, batch, channel) to (batch, stream, channel)
+
+
 def signature_to_logsignature(signature: torch.Tensor, channels: int, depth: int, stream: bool = False,
-                              mode: str = "words", scalar_term: bool = False) -> torch.Tensor:
+                              mode: str = "words", scalar_term: bool = False,
+                              workspace: Optional[wmodule.Workspace] = None) -> torch.Tensor:
     """Calculates the logsignature corresponding to a signature.
 
     Arguments:
@@ -99,6 +184,8 @@ def signature_to_logsignature(signature: torch.Tensor, channels: int, depth: int
         scalar_term (bool, optional): Defaults to False. The value of :attr:`scalar_term` that
             :func:`signatory.signature` was called with.
 
+        workspace (None or :class:`signatory.Workspace`, optional): Defaults to None. As :func:`signatory.signature`.
+
     Example:
         .. code-block:: python
 
@@ -115,7 +202,7 @@ def signature_to_logsignature(signature: torch.Tensor, channels: int, depth: int
         :func:`signatory.logsignature`.
     """
     # Go via the class so that it uses a cached lyndon info capsule, if we have one already for some reason.
-    return SignatureToLogSignature(channels, depth, stream, mode, scalar_term)(signature)
+    return SignatureToLogSignature(channels, depth, stream, mode, scalar_term)(signature, workspace=workspace)
 
 
 class SignatureToLogSignature(nn.Module):
@@ -126,6 +213,11 @@ class SignatureToLogSignature(nn.Module):
     :func:`signatory.signature_to_logsignature` function, in the same way that :class:`signatory.LogSignature` will be
     faster than :func:`signatory.logsignature`.
 
+    The precomputation this involves (of the Lyndon words, and in :code:`mode="brackets"` of the Lyndon basis) can take
+    a while for large numbers of channels and depths. If the environment variable :code:`SIGNATORY_LYNDON_CACHE` is set
+    to a directory then the result is saved there, and subsequently loaded from there rather than being recomputed, for
+    example by every worker of a distributed job. Loading is essentially instant, as the file is memory-mapped.
+
     Arguments:
         channels (int): as :func:`signatory.signature_to_logsignature`.
 
@@ -169,26 +261,23 @@ class SignatureToLogSignature(nn.Module):
             # This computation can be pretty slow! We definitely want to reuse it between instances
             return cls._lyndon_info_capsule_cache[(in_channels, depth, mode)]
         except KeyError:
-            mode = _interpret_mode(mode)
-            lyndon_info_capsule = cls._RefHolder(impl.make_lyndon_info(in_channels, depth, mode))
+            lyndon_info_capsule = cls._RefHolder(_make_lyndon_info(in_channels, depth, mode))
             cls._lyndon_info_capsule_cache[(in_channels, depth, mode)] = lyndon_info_capsule
             return lyndon_info_capsule
 
-    def forward(self, signature: torch.Tensor) -> torch.Tensor:
+    def forward(self, signature: torch.Tensor, workspace: Optional[wmodule.Workspace] = None) -> torch.Tensor:
         """The forward operation.
 
         Arguments:
             signature (:class:`torch.Tensor`): As :func:`signatory.signature_to_logsignature`.
 
+            workspace (None or :class:`signatory.Workspace`, optional): As :func:`signatory.signature_to_logsignature`.
+
         Returns:
             As :func:`signatory.signature_to_logsignature`.
         """
-        if signature.is_cuda and self._mode == 'brackets':
-            warnings.warn("The logsignature with mode='brackets' has been requested on the GPU. This mode is quite "
-                          "slow to calculate, and the GPU offers no speedup. Consider mode='words' instead.")
-
         return _signature_to_logsignature(signature, self._channels, self._depth, self._stream, self._mode,
-                                          self._lyndon_info_capsule.item, self._scalar_term)
+                                          self._lyndon_info_capsule.item, self._scalar_term, workspace)
 
     def extra_repr(self):
         return ('channels={channels}, depth={depth}, stream={stream}, mode={mode}'
@@ -200,7 +289,7 @@ SignatureToLogsignature = SignatureToLogSignature
 
 
 def logsignature(path: torch.Tensor, depth: int, stream: Union[bool, torch.Tensor] = False, basepoint: bool = False,
-                 inverse=False, mode: str = "words") -> torch.Tensor:
+                 inverse=False, mode: str = "words", workspace: Optional[wmodule.Workspace] = None) -> torch.Tensor:
     """Applies the logsignature transform to a stream of data.
 
     The :attr:`modes` argument determines how the logsignature is represented.
@@ -226,6 +315,8 @@ def logsignature(path: torch.Tensor, depth: int, stream: Union[bool, torch.Tenso
             "Returns" section below. For machine learning applications, :code:`"words"` is the appropriate choice. The
             other two options are mostly only interesting for mathematicians.
 
+        workspace (None or :class:`signatory.Workspace`, optional): as :func:`signatory.signature`.
+
     Returns:
         A :class:`torch.Tensor`, of almost the same shape as the tensor returned from :func:`signatory.signature` called
         with the same arguments.
@@ -262,7 +353,8 @@ def logsignature(path: torch.Tensor, depth: int, stream: Union[bool, torch.Tenso
         In all cases, the ordering corresponds to the ordering on words given by first ordering the words by length,
         and then ordering each length class lexicographically.
     """
-    return LogSignature(depth, stream=stream, inverse=inverse, mode=mode)(path, basepoint=basepoint)
+    return LogSignature(depth, stream=stream, inverse=inverse, mode=mode)(path, basepoint=basepoint,
+                                                                          workspace=workspace)
 
 
 class LogSignature(nn.Module):
@@ -317,7 +409,8 @@ class LogSignature(nn.Module):
 
     # Deliberately no 'initial' argument. To support that for logsignatures we'd need to be able to expand a
     # (potentially compressed) logsignature into a signature first. (Which is possible in principle.)
-    def forward(self, path: torch.Tensor, basepoint: Union[bool, torch.Tensor] = False) -> torch.Tensor:
+    def forward(self, path: torch.Tensor, basepoint: Union[bool, torch.Tensor] = False,
+                workspace: Optional[wmodule.Workspace] = None) -> torch.Tensor:
         """The forward operation.
 
         Arguments:
@@ -325,13 +418,22 @@ class LogSignature(nn.Module):
 
             basepoint (bool or torch.Tensor, optional): As :func:`signatory.logsignature`.
 
+            workspace (None or :class:`signatory.Workspace`, optional): As :func:`signatory.logsignature`.
+
         Returns:
             As :func:`signatory.logsignature`.
         """
 
+        signature_to_logsignature_instance = self._get_signature_to_logsignature_instance(path.size(-1))
+        if self._stream:
+            # Computed directly rather than via the signature, so that the signatures of every partial path don't all
+            # have to be held in memory at once.
+            return _logsignature_stream(path, self._depth, basepoint, self._inverse, self._mode,
+                                        signature_to_logsignature_instance._lyndon_info_capsule.item, workspace)
+
         signature = smodule.signature(path, self._depth, stream=self._stream, basepoint=basepoint,
-                                      inverse=self._inverse, initial=None)
-        return self._get_signature_to_logsignature_instance(path.size(-1))(signature)
+                                      inverse=self._inverse, initial=None, workspace=workspace)
+        return signature_to_logsignature_instance(signature, workspace=workspace)
 
     def extra_repr(self):
         return ('depth={depth}, stream={stream}, inverse={inverse}, mode={mode}'
@@ -82,7 +82,10 @@ class _BackwardShortcut(autograd.Function):
                                                   False,  # basepoint
                                                   False,  # inverse
                                                   False,  # initial
-                                                  ctx.scalar_term)
+                                                  ctx.scalar_term,
+                                                  False,  # include_time
+                                                  False,  # lead_lag
+                                                  None)  # workspace
 
         result = [None, None, None]
         start = 0
@@ -130,29 +133,49 @@ class Path:
 
         scalar_term (bool, optional): Defaults to False. Whether to include the scalar '1' when calling the
             :meth:`signatory.Path.signature` method; see also the equivalent argument for :func:`signatory.signature`.
+
+        window (int or None, optional): Defaults to None. If an integer, then only the information needed to compute
+            signatures and logsignatures over the final :attr:`window` many points of the path is retained, so that
+            memory usage stays constant no matter how many times :meth:`signatory.Path.update` is called. (Useful for
+            streams of data that never end.) Asking for the signature or logsignature of an interval starting before
+            this will raise an error. If :attr:`remember_path` is True then similarly only those parts of the path that
+            are still needed are retained in :attr:`signatory.Path.path`. Must be at least 2.
     """
 
     # !! If you change this, make sure to adjust __eq__ and __copy__ accordingly.
-    __slots__ = ('_remember_path', '_scalar_term', '_depth', '_signature', '_inverse_signature', '_path',
-                 '_length', '_signature_length', '_lengths', '_signature_lengths', '_batch_size', '_channels',
-                 '_device', '_signature_channels', '_logsignature_channels', '_end',
+    __slots__ = ('_remember_path', '_scalar_term', '_depth', '_window', '_signature', '_inverse_signature',
+                 '_owns_buffers', '_path', '_path_start', '_length', '_signature_length', '_lengths', '_batch_size',
+                 '_channels', '_device', '_signature_channels', '_logsignature_channels', '_end',
                  '_signature_to_logsignature_instances')
 
     def __init__(self, path: torch.Tensor, depth: int, basepoint: Union[bool, torch.Tensor] = False,
-                 remember_path: bool = True, scalar_term: bool = False, **kwargs):
+                 remember_path: bool = True, scalar_term: bool = False, window: Union[int, None] = None, **kwargs):
+        if window is not None and window < 2:
+            raise ValueError("window must be at least 2.")
+
         self._remember_path: bool = remember_path
         self._scalar_term: bool = scalar_term
         self._depth: int = depth
-
-        self._signature: List[torch.Tensor] = []
-        self._inverse_signature: List[torch.Tensor] = []
+        self._window: Union[int, None] = window
+
+        # The signatures (and inverse signatures) of every prefix of the path, in preallocated buffers of shape
+        # (batch, capacity, signature_channels). If window is None then they are stored in order, and the buffers grow
+        # geometrically as needed. If window is an integer then each buffer is a ring buffer of capacity window, and
+        # the signature at stream index i is stored at position i % window.
+        self._signature: Union[torch.Tensor, None] = None
+        self._inverse_signature: Union[torch.Tensor, None] = None
+        # Buffers may be shared between multiple Paths as a result of copying, in which case they are copied before
+        # they are next written to.
+        self._owns_buffers: bool = True
 
         self._path: List[torch.Tensor] = []
+        # The index of the first point of the first element of _path. Only nonzero if window is not None and some of
+        # the path has been discarded.
+        self._path_start: int = 0
 
         self._length: int = 0
         self._signature_length: int = 0
         self._lengths: List[int] = []
-        self._signature_lengths: List[int] = []
 
         self._batch_size: int = path.size(-3)
         self._channels: int = path.size(-1)
@@ -189,10 +212,14 @@ class Path:
             type(self).__copy__ = copy_method
 
         for attr_name in self.__slots__:
-            if attr_name not in ('_end', '_signature_to_logsignature_instances'):
+            if attr_name not in ('_end', '_signature_to_logsignature_instances', '_signature', '_inverse_signature'):
                 attr_value = getattr(self, attr_name)
                 # Many of these objects are immutable so the copy isn't actually important
                 setattr(new_path, attr_name, copy.copy(attr_value))
+        # The buffers are shared rather than copied, so neither Path is allowed to write to them any more. (Whichever
+        # gets updated first will make its own copy.)
+        self._owns_buffers = False
+        new_path._owns_buffers = False
         if not isinstance(self._end, torch.Tensor):
             # copying a bool in this case... completely unnecessary but consistent with what we do above.
             new_path._end = copy.copy(self._end)
@@ -206,7 +233,7 @@ class Path:
         if not isinstance(other, Path):
             return NotImplemented
         for attr_name in self.__slots__:
-            if attr_name not in ('_signature', '_inverse_signature', '_path', '_end',
+            if attr_name not in ('_signature', '_inverse_signature', '_owns_buffers', '_path', '_end',
                                  '_signature_to_logsignature_instances'):
                 if getattr(self, attr_name) != getattr(other, attr_name):
                     return False
@@ -218,14 +245,16 @@ class Path:
         else:
             if self._end != other._end:
                 return False
-        for attr_name in ('_signature', '_inverse_signature', '_path'):
-            self_value = getattr(self, attr_name)
-            other_value = getattr(self, attr_name)
-            if len(self_value) != len(other_value):
+        for attr_name in ('_signature', '_inverse_signature'):
+            if (self._retained(getattr(self, attr_name)) != other._retained(getattr(other, attr_name))).any():
+                return False
+        self_value = self._path
+        other_value = other._path
+        if len(self_value) != len(other_value):
+            return False
+        for self_tensor, other_tensor in zip(self_value, other_value):
+            if (self_tensor != other_tensor).any():
                 return False
-            for self_tensor, other_tensor in zip(self_value, other_value):
-                if (self_tensor != other_tensor).any():
-                    return False
         return True
 
     def __ne__(self, other):
@@ -286,28 +315,37 @@ class Path:
         if end - start < 2:
             raise ValueError("start={}, end={} is interpreted as {}, {} for path of length {}, which "
                              "does not describe a valid interval.".format(old_start, old_end, start, end, self._length))
+        # The inverse signature at index start - 1 must still be retained. (This is measured in terms of the signatures
+        # rather than self._length, as the latter doesn't count the basepoint if remember_path=False.)
+        if self._window is not None and start <= self._signature_length - self._window:
+            raise ValueError("start={} is interpreted as {} for path of length {}, but only the final window={} points "
+                             "of the path have been retained.".format(old_start, start, self._length, self._window))
 
         # Find the signature on [:end]
-        sig_end = end - 2
-        index_sig_end, sig_end = self._locate(self._signature_lengths, sig_end)
-        signature = self._signature[index_sig_end][:, sig_end, :]
+        signature = self._signature[:, self._slot(end - 2), :]
 
         # If start takes its minimum value then we've got the correct signature
         # Otherwise we need to apply the inverse signature of the preceding part of the path
         if start != 0:
             # Find the inverse signature on [:start]
-            sig_start = start - 1
-            index_sig_start, sig_start = self._locate(self._signature_lengths, sig_start)
-            inverse_sig_at_start = self._inverse_signature[index_sig_start][:, sig_start, :]
+            inverse_sig_at_start = self._inverse_signature[:, self._slot(start - 1), :]
 
             # Find the signature on [start:end]
             signature = smodule.multi_signature_combine([inverse_sig_at_start, signature], self._channels, self.depth,
                                                         scalar_term=self._scalar_term)
+        else:
+            # Don't return a view into our buffers, as they may be modified in-place by later updates.
+            signature = signature.clone()
+
+        if not self.remember_path:
+            # No gradients are tracked through the stored signatures, and without the path there is nothing else to
+            # backpropagate through.
+            return signature
 
         # Find path[start:end]
         path_pieces = []
-        index_end, end = self._locate(self._lengths, end)
-        index_start, start = self._locate(self._lengths, start)
+        index_end, end = self._locate(end)
+        index_start, start = self._locate(start)
         if index_start == index_end:
             path_pieces.append(self.path[index_start][:, start:end, :])
         else:
@@ -331,13 +369,61 @@ class Path:
         # custom backwards that shortcuts that whole procedure.
         return _backward_shortcut(signature, path_pieces, self._depth, self._scalar_term)
 
-    @staticmethod
-    def _locate(lengths, index):
-        lengths_index = bisect.bisect_right(lengths, index)
+    def _locate(self, index):
+        # Finds which element of self._path contains the point at 'index', and the index of that point within it.
+        lengths_index = bisect.bisect_right(self._lengths, index)
         if lengths_index > 0:
-            index -= lengths[lengths_index - 1]
+            index -= self._lengths[lengths_index - 1]
+        else:
+            index -= self._path_start
         return lengths_index, index
 
+    def _slot(self, index):
+        # Finds the position in the buffers at which the signature at stream index 'index' is stored.
+        if self._window is None:
+            return index
+        else:
+            return index % self._window
+
+    def _retained(self, buffer):
+        # Returns every signature in 'buffer' that is still retained, in order.
+        if self._window is None:
+            return buffer[:, :self._signature_length]
+        else:
+            indices = torch.arange(max(0, self._signature_length - self._window), self._signature_length)
+            return buffer.index_select(1, (indices % self._window).to(buffer.device))
+
+    def _store(self, buffer, signature):
+        # Stores the newly computed 'signature' (of shape (batch, stream, signature_channels)) into 'buffer', which is
+        # either self._signature or self._inverse_signature, and returns the buffer to use from now on. (Which may be a
+        # new one, if the old one had to be grown or copied.)
+        old_length = self._signature_length
+        new_length = old_length + signature.size(-2)
+        if self._window is None:
+            capacity = 0 if buffer is None else buffer.size(-2)
+            if new_length > capacity or not self._owns_buffers:
+                # Grow geometrically, so that repeatedly calling update takes amortised constant time per new point.
+                if new_length > capacity:
+                    capacity = max(new_length, 2 * capacity)
+                new_buffer = torch.empty(signature.size(0), capacity, signature.size(-1), dtype=signature.dtype,
+                                         device=signature.device)
+                if buffer is not None:
+                    new_buffer[:, :old_length] = buffer[:, :old_length]
+                buffer = new_buffer
+            buffer[:, old_length:new_length] = signature
+        else:
+            if buffer is None:
+                buffer = torch.empty(signature.size(0), self._window, signature.size(-1), dtype=signature.dtype,
+                                     device=signature.device)
+            elif not self._owns_buffers:
+                buffer = buffer.clone()
+            # Only the final window many of the new signatures will remain in the buffer, so don't bother storing the
+            # others.
+            first = max(old_length, new_length - self._window)
+            indices = torch.arange(first, new_length)
+            buffer.index_copy_(1, (indices % self._window).to(buffer.device), signature[:, first - old_length:])
+        return buffer
+
     def logsignature(self, start: Union[int, None] = None, end: Union[int, None] = None,
                      mode: str = "words") -> torch.Tensor:
         """Returns the logsignature on a particular interval.
@@ -385,17 +471,29 @@ class Path:
                              "used.")
         if path.size(-1) != self._channels:
             raise ValueError("Cannot append a path with different number of channels to what has already been used.")
-        initial = self._signature[-1][:, -1, :]
-        inverse_initial = self._inverse_signature[-1][:, -1, :]
+        last = self._slot(self._signature_length - 1)
+        initial = self._signature[:, last, :]
+        inverse_initial = self._inverse_signature[:, last, :]
         self._update(path, initial, inverse_initial)
 
     def _update(self, path, initial, inverse_initial):
-        signature = smodule.signature(path, self._depth, stream=True, basepoint=self._end, initial=initial,
-                                      scalar_term=self._scalar_term)
-        inverse_signature = smodule.signature(path, self._depth, stream=True, basepoint=self._end, inverse=True,
-                                              initial=inverse_initial, scalar_term=self._scalar_term)
-        self._signature.append(signature)
-        self._inverse_signature.append(inverse_signature)
+        # No gradients are tracked through the stored signatures (see _backward_shortcut), so we can compute both the
+        # signature and the inverse signature in a single pass, without going via autograd.
+        path_ = path.transpose(0, 1)  # (batch, stream, channel) to (stream, batch, channel)
+        basepoint, basepoint_value = smodule.interpret_basepoint(self._end, path_.size(-2), path_.size(-1),
+                                                                 path_.dtype, path_.device)
+        use_initial, initial_value = smodule.interpret_initial(initial)
+        _, inverse_initial_value = smodule.interpret_initial(inverse_initial)
+        signature, inverse_signature = impl.signature_and_inverse_forward(path_, self._depth, basepoint,
+                                                                          basepoint_value, use_initial, initial_value,
+                                                                          inverse_initial_value, self._scalar_term,
+                                                                          None)  # workspace
+        # (stream, batch, channel) to (batch, stream, channel)
+        signature = signature.transpose(0, 1)
+        inverse_signature = inverse_signature.transpose(0, 1)
+        self._signature = self._store(self._signature, signature)
+        self._inverse_signature = self._store(self._inverse_signature, inverse_signature)
+        self._owns_buffers = True
 
         if self.remember_path:
             self._path.append(path)
@@ -404,7 +502,15 @@ class Path:
         self._length += path.size(-2)
         self._signature_length += signature.size(-2)
         self._lengths.append(self._length)
-        self._signature_lengths.append(self._signature_length)
+
+        if self._window is not None:
+            # Discard every piece of the path that lies entirely before the window.
+            num_discard = bisect.bisect_right(self._lengths, self._length - self._window)
+            if num_discard > 0:
+                self._path_start = self._lengths[num_discard - 1]
+                del self._lengths[:num_discard]
+                if self.remember_path:
+                    del self._path[:num_discard]
 
     @property
     def remember_path(self) -> bool:
@@ -518,12 +624,12 @@ class Path:
         if not_valid:
             raise IndexError("Only integers, slices, one dimensional Tensors, one dimensional numpy arrays, and lists "
                              "of integers, are valid indices.")
-        new_batch_size = self._signature[0][item].size(0)
+        new_signature = self._signature[item]
+        new_batch_size = new_signature.size(0)
         if new_batch_size == 0:
             raise IndexError("Index corresponds to a batch of size zero, which is disallowed.")
 
-        new_signature = [tensor[item] for tensor in self._signature]
-        new_inverse_signature = [tensor[item] for tensor in self._inverse_signature]
+        new_inverse_signature = self._inverse_signature[item]
         new_path = [tensor[item] for tensor in self._path]
         if isinstance(self._end, torch.Tensor):
             new_end = self._end[item]
@@ -536,6 +642,8 @@ class Path:
         # new_signature line before we assign anything, but it doesn't hurt to be sure.
         self._signature = new_signature
         self._inverse_signature = new_inverse_signature
+        # Slicing may have given views into buffers shared with other Paths.
+        self._owns_buffers = False
         self._path = new_path
         self._end = new_end
         self._batch_size = new_batch_size
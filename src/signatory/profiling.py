@@ -0,0 +1,77 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Provides for inspecting where the time goes in the signature and logsignature computations."""
+
+
+from typing import Dict
+
+from . import impl
+
+
+def enable_profiling_counters(enabled: bool = True) -> None:
+    r"""Turns on (or off) Signatory's profiling counters.
+
+    Whilst they are turned on, each stage of the signature and logsignature computations (and of
+    :func:`signatory.signature_combine` and :func:`signatory.invert_signature`) records how many times it was run and
+    the total time spent in it. Also recorded are how many threads were used to parallelise over the stream and batch
+    dimensions, and how many bytes of memory were allocated. See :func:`signatory.profiling_counters`. They are turned
+    off by default, in which case their cost is negligible.
+
+    Regardless of whether the counters are turned on, each stage always appears as a range named
+    :code:`signatory::<stage>` in the PyTorch profiler, :code:`torch.autograd.profiler.profile`. Inside
+    :code:`torch.autograd.profiler.emit_nvtx` these are also emitted as NVTX ranges, for use with Nsight Systems.
+
+    Arguments:
+        enabled (bool, optional): Whether to turn the counters on or off. Defaults to on.
+    """
+    impl.enable_profiling_counters(enabled)
+
+
+def profiling_counters() -> Dict[str, float]:
+    r"""Returns the current values of Signatory's profiling counters. See :func:`signatory.enable_profiling_counters`.
+
+    The counters are (where :code:`<stage>` is for example :code:`signature_forward` or
+    :code:`logsignature_log_backward`):
+
+    - :code:`<stage>.calls`: the number of times that stage has been run.
+    - :code:`<stage>.seconds`: the total time spent in that stage. On the GPU this is the time spent on the host
+      launching kernels, unless the environment variable :code:`CUDA_LAUNCH_BLOCKING=1` is set.
+    - :code:`<function>.batch_threads`, :code:`<function>.stream_threads`: the number of threads used to parallelise
+      over the batch and stream dimensions, by the most recent call of that function.
+    - :code:`bytes_allocated`: the total amount of memory allocated for intermediate results. (Not including the
+      outputs, nor anything that PyTorch allocates itself.) Reusing memory via a :class:`signatory.Workspace` shows up
+      here as this number not increasing.
+
+    Counters only appear once they have been recorded at least once since they were last reset.
+
+    Example:
+        .. code-block:: python
+
+            import signatory
+            import torch
+            signatory.enable_profiling_counters()
+            path = torch.rand(32, 128, 4)
+            signatory.signature(path, 6)
+            print(signatory.profiling_counters()['signature_forward.seconds'])
+
+    Returns:
+        A dictionary from the name of each counter to its value.
+    """
+    return impl.profiling_counters()
+
+
+def reset_profiling_counters() -> None:
+    """Resets all of Signatory's profiling counters. (This does not turn them off.)"""
+    impl.reset_profiling_counters()
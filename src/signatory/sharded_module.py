@@ -0,0 +1,293 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Provides operations for computing the signature of a long path, by splitting it up along the stream dimension
+between several devices or processes."""
+
+
+import torch
+from torch import autograd
+from torch import distributed as dist
+from torch.autograd import function as autograd_function
+
+from . import signature_module as smodule
+
+from typing import List, Optional, Sequence, Union
+
+
+def _shard_boundaries(stream_size, num_shards, basepoint):
+    # Splits the increments of the path up as evenly as possible. Returns a list of (start, end) pairs of indices into
+    # the stream dimension of the path, one for each shard. Every shard after the first uses the point before 'start'
+    # as its basepoint, so that no increment is lost between shards.
+    num_increments = stream_size if basepoint else stream_size - 1
+    num_shards = min(num_shards, num_increments)
+    offset = 0 if basepoint else 1
+    boundaries = []
+    for shard in range(num_shards):
+        start = (shard * num_increments) // num_shards + offset
+        end = ((shard + 1) * num_increments) // num_shards + offset
+        if shard == 0:
+            start = 0
+        boundaries.append((start, end))
+    return boundaries
+
+
+def _prefixes(signatures, channels, depth, inverse, initial, scalar_term):
+    # The signature of everything before each shard. (None for the first shard, if there is no initial value.)
+    prefixes = [initial]
+    for signature in signatures[:-1]:
+        if prefixes[-1] is None:
+            prefixes.append(signature)
+        else:
+            prefixes.append(smodule.signature_combine(prefixes[-1], signature, channels, depth, inverse, scalar_term))
+    return prefixes
+
+
+def signature_sharded(path: torch.Tensor, depth: int, devices: Sequence[Union[str, torch.device]],
+                      stream: bool = False, basepoint: Union[bool, torch.Tensor] = False, inverse: bool = False,
+                      initial: Optional[torch.Tensor] = None,
+                      scalar_term: bool = False) -> Union[torch.Tensor, List[torch.Tensor]]:
+    r"""Computes the signature of a batch of paths, by splitting them up along the stream dimension between several
+    devices.
+
+    The stream is split into one contiguous piece per device, and the signature of each piece is computed on its device,
+    at the same time as each other. By Chen's identity these are then combined into the signature of the whole path,
+    as with :func:`signatory.multi_signature_combine`. The signatures of the pieces are small, so only they are moved
+    between devices; the backward pass is similarly performed on each device.
+
+    Arguments:
+        path (:class:`torch.Tensor`): As :func:`signatory.signature`. It may be on any device (for example in pinned CPU
+            memory); each piece of it is moved to its device as needed.
+
+        depth (int): As :func:`signatory.signature`.
+
+        devices (sequence of str or :class:`torch.device`): The devices to split the computation between, in the
+            order that the pieces of the stream are given to them. The same device may be listed more than once.
+
+        stream (bool, optional): Defaults to False. As :func:`signatory.signature`, except that if it is True then the
+            result is returned as a list of tensors, one on each device. (As the reason for splitting up the
+            computation is typically that the signatures of the whole stream do not fit on one device.) These
+            concatenate along the stream dimension to give what :func:`signatory.signature` would return. The
+            signatures of the pieces are computed first, to find the signature of everything before each piece; then
+            the stream of signatures of each piece is computed on its device. This takes about twice as much work as
+            the computation on a single device.
+
+        basepoint (bool or :class:`torch.Tensor`, optional): As :func:`signatory.signature`.
+
+        inverse (bool, optional): As :func:`signatory.signature`.
+
+        initial (None or :class:`torch.Tensor`, optional): As :func:`signatory.signature`.
+
+        scalar_term (bool, optional): As :func:`signatory.signature`.
+
+    Returns:
+        If :attr:`stream` is False then a :class:`torch.Tensor` on the first device, as :func:`signatory.signature`.
+        If :attr:`stream` is True then a list of :class:`torch.Tensor`, as described above. If the stream is too short
+        to be split between every device then only the first few devices are used.
+    """
+    devices = [torch.device(device) for device in devices]
+    if len(devices) == 0:
+        raise ValueError("Argument 'devices' must contain at least one device.")
+    smodule._signature_checkargs(path, depth, basepoint, initial, scalar_term)
+
+    boundaries = _shard_boundaries(path.size(-2), len(devices), basepoint is not False)
+    devices = devices[:len(boundaries)]
+    pieces = []
+    for shard, ((start, end), device) in enumerate(zip(boundaries, devices)):
+        piece = path[:, start:end].to(device)
+        if shard == 0:
+            piece_basepoint = basepoint
+            if isinstance(basepoint, torch.Tensor):
+                piece_basepoint = basepoint.to(device)
+        else:
+            piece_basepoint = path[:, start - 1].to(device)
+        pieces.append((piece, piece_basepoint))
+
+    first_device = devices[0]
+    if initial is not None:
+        initial = initial.to(first_device)
+
+    if not stream:
+        futures = [smodule.signature_async(piece, depth, basepoint=piece_basepoint, inverse=inverse,
+                                           scalar_term=scalar_term)
+                   for piece, piece_basepoint in pieces]
+        signatures = [future.wait().to(first_device) for future in futures]
+        if initial is not None:
+            signatures.insert(0, initial)
+        return smodule.multi_signature_combine(signatures, path.size(-1), depth, inverse, scalar_term)
+
+    # The signature of the last piece isn't needed for any prefix.
+    futures = [smodule.signature_async(piece, depth, basepoint=piece_basepoint, inverse=inverse,
+                                       scalar_term=scalar_term)
+               for piece, piece_basepoint in pieces[:-1]]
+    signatures = [future.wait().to(first_device) for future in futures]
+    prefixes = _prefixes(signatures + [None], path.size(-1), depth, inverse, initial, scalar_term)
+    futures = []
+    for (piece, piece_basepoint), prefix, device in zip(pieces, prefixes, devices):
+        if prefix is not None:
+            prefix = prefix.to(device)
+        futures.append(smodule.signature_async(piece, depth, stream=True, basepoint=piece_basepoint,
+                                               inverse=inverse, initial=prefix, scalar_term=scalar_term))
+    return [future.wait() for future in futures]
+
+
+def _all_gather(tensor, group):
+    gathered = [torch.empty_like(tensor) for _ in range(dist.get_world_size(group))]
+    dist.all_gather(gathered, tensor.contiguous(), group=group)
+    return gathered
+
+
+def _all_reduce_slot(grads, rank, group):
+    # Each process holds the gradients with respect to what every process contributed to an all_gather. Returns the sum
+    # over every process of the gradient with respect to what this process contributed.
+    grads = torch.stack(grads)
+    dist.all_reduce(grads, group=group)
+    return grads[rank]
+
+
+class _SignatureDistributedFunction(autograd.Function):
+    # The forward pass builds an ordinary (local) autograd graph from the gathered tensors, for the backward pass to
+    # differentiate through. Doing the communication inside a single autograd.Function means that the backward pass
+    # performs the same collective operations on every process, in the same order, regardless of which of the gathered
+    # tensors each process actually used.
+    @staticmethod
+    def forward(ctx, path, basepoint, initial, depth, stream, inverse, scalar_term, group):
+        rank = dist.get_rank(group)
+        channels = path.size(-1)
+
+        with torch.enable_grad():
+            path = path.detach().requires_grad_()
+            ends = _all_gather(path[:, -1].detach(), group)
+            if rank != 0:
+                basepoint = ends[rank - 1].requires_grad_()
+            elif isinstance(basepoint, torch.Tensor):
+                basepoint = basepoint.detach().requires_grad_()
+            if initial is not None:
+                initial = initial.detach().requires_grad_()
+
+            signature = smodule.signature(path, depth, basepoint=basepoint, inverse=inverse, scalar_term=scalar_term)
+            signatures = [elem.requires_grad_() for elem in _all_gather(signature.detach(), group)]
+            if stream:
+                prefix = _prefixes(signatures[:rank + 1], channels, depth, inverse, initial, scalar_term)[rank]
+                result = smodule.signature(path, depth, stream=True, basepoint=basepoint, inverse=inverse,
+                                           initial=prefix, scalar_term=scalar_term)
+            else:
+                chunks = signatures if initial is None else [initial] + signatures
+                result = smodule.multi_signature_combine(chunks, channels, depth, inverse, scalar_term)
+
+        ctx.rank = rank
+        ctx.group = group
+        ctx.path = path
+        ctx.basepoint = basepoint
+        ctx.initial = initial
+        ctx.signature = signature
+        ctx.signatures = signatures
+        ctx.result = result
+        return result.detach()
+
+    @staticmethod
+    @autograd_function.once_differentiable
+    def backward(ctx, grad_result):
+        basepoint_is_tensor = isinstance(ctx.basepoint, torch.Tensor)
+        inputs = [ctx.path] + ctx.signatures
+        if basepoint_is_tensor:
+            inputs.append(ctx.basepoint)
+        if ctx.initial is not None:
+            inputs.append(ctx.initial)
+        grads = autograd.grad(ctx.result, inputs, grad_result, allow_unused=True)
+        grads = [torch.zeros_like(input_) if grad is None else grad for input_, grad in zip(inputs, grads)]
+        grad_path = grads[0]
+        grad_signatures = grads[1:len(ctx.signatures) + 1]
+        grad_basepoint = grads[len(ctx.signatures) + 1] if basepoint_is_tensor else None
+        grad_initial = grads[-1] if ctx.initial is not None else None
+
+        # Back through the signature of this process' piece of the stream.
+        grad_signature = _all_reduce_slot(grad_signatures, ctx.rank, ctx.group)
+        inputs = [ctx.path] + ([ctx.basepoint] if basepoint_is_tensor else [])
+        grads = autograd.grad(ctx.signature, inputs, grad_signature)
+        grad_path = grad_path + grads[0]
+        if basepoint_is_tensor:
+            grad_basepoint = grad_basepoint + grads[1]
+
+        # Back through the final points of each piece, which were used as the basepoints of the next pieces.
+        grad_ends = [torch.zeros_like(grad_path[:, -1]) for _ in ctx.signatures]
+        if ctx.rank != 0:
+            grad_ends[ctx.rank - 1] = grad_basepoint
+            grad_basepoint = None
+        grad_path[:, -1] += _all_reduce_slot(grad_ends, ctx.rank, ctx.group)
+
+        return grad_path, grad_basepoint, grad_initial, None, None, None, None, None
+
+
+def signature_distributed(path: torch.Tensor, depth: int, stream: bool = False,
+                          basepoint: Union[bool, torch.Tensor] = False, inverse: bool = False,
+                          initial: Optional[torch.Tensor] = None, scalar_term: bool = False,
+                          group: Optional['torch.distributed.ProcessGroup'] = None) -> torch.Tensor:
+    r"""Computes the signature of a batch of paths, each of which has been split up along the stream dimension between
+    the processes of a :mod:`torch.distributed` process group.
+
+    This must be called by every process in the group at the same time, each passing its own piece of the stream. The
+    pieces should be in the same order as the ranks of the processes: the piece held by rank :math:`r` is the part of
+    the stream immediately after the piece held by rank :math:`r - 1`. Each process computes the signature of its own
+    piece; these (and the final point of each piece) are then exchanged with :func:`torch.distributed.all_gather`, and
+    combined by Chen's identity, as with :func:`signatory.multi_signature_combine`. Only signatures and single points
+    are ever communicated, never the pieces of the path themselves.
+
+    Arguments:
+        path (:class:`torch.Tensor`): This process' piece of the batch of paths, of shape :math:`(N, L_r, C)`, where
+            :math:`N` and :math:`C` must be the same on every process. If :attr:`basepoint` is False then the piece on
+            rank 0 must have at least two points; every other piece must have at least one.
+
+        depth (int): As :func:`signatory.signature`. Must be the same on every process.
+
+        stream (bool, optional): Defaults to False. As :func:`signatory.signature`, except that if it is True then each
+            process gets the signatures of the partial paths ending in its own piece of the stream. (So that these
+            concatenate across processes to give what :func:`signatory.signature` would give for the whole path.)
+            The signatures of the pieces are computed first, to find the signature of everything before each piece;
+            then the stream of signatures of each piece is computed. This takes about twice as much work as the
+            computation on a single device. Must be the same on every process.
+
+        basepoint (bool or :class:`torch.Tensor`, optional): As :func:`signatory.signature`. Only used on rank 0, as
+            that is where the path starts.
+
+        inverse (bool, optional): As :func:`signatory.signature`. Must be the same on every process.
+
+        initial (None or :class:`torch.Tensor`, optional): As :func:`signatory.signature`. Should be the same on every
+            process.
+
+        scalar_term (bool, optional): As :func:`signatory.signature`. Must be the same on every process.
+
+        group (None or :class:`torch.distributed.ProcessGroup`, optional): The process group to use. Defaults to the
+            default process group.
+
+    Returns:
+        If :attr:`stream` is False then a :class:`torch.Tensor`, on every process, of the signature of the whole path,
+        as :func:`signatory.signature`. If :attr:`stream` is True then a :class:`torch.Tensor` of the stream of
+        signatures ending in this process' piece of the stream, as described above.
+
+    .. note::
+
+        The backward pass also communicates between processes, so must also be performed by every process at the same
+        time. As with the collective operations of :mod:`torch.distributed.nn`, the gradients computed are those of the
+        sum, over every process, of whatever each process computes from the result. So if every process computes the
+        same loss from the (same) signature of the whole path, then the gradients will be multiplied by the number of
+        processes.
+    """
+    if group is None:
+        group = dist.group.WORLD
+    rank = dist.get_rank(group)
+    if rank != 0:
+        basepoint = True
+    smodule._signature_checkargs(path, depth, basepoint, initial, scalar_term)
+    return _SignatureDistributedFunction.apply(path, basepoint, initial, depth, stream, inverse, scalar_term, group)
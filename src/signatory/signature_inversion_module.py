@@ -1,71 +1,34 @@
 import torch
+from torch import autograd
+from torch.autograd import function as autograd_function
 
-from . import signature_module as smodule
+from . import impl
 
 from typing import Optional
 
 
-def get_insertion_matrix(signature, insertion_position, depth, channels):
-    """This function creates the matrix corresponding to the insertion map, used in the optimization problem.
+class _InvertSignatureFunction(autograd.Function):
+    @staticmethod
+    def forward(ctx, signature, depth, channels, initial, initial_position):
+        path = impl.invert_signature_forward(signature, channels, depth, initial, initial_position)
+        ctx.save_for_backward(signature)
+        ctx.depth = depth
+        ctx.channels = channels
+        ctx.initial = initial
 
-     Arguments:
-        signature (:class:`torch.Tensor`): As :func:`signatory.invert_signature`.
+        return path
 
-        insertion_position (int): Insertion spot.
+    @staticmethod
+    @autograd_function.once_differentiable  # Our backward function uses in-place operations for memory efficiency
+    def backward(ctx, grad_path):
+        signature, = ctx.saved_tensors
 
-        depth (int): As :func:`signatory.invert_signature`.
+        grad_signature, grad_initial_position = impl.invert_signature_backward(grad_path, signature, ctx.channels,
+                                                                               ctx.depth, ctx.initial)
+        if not ctx.initial:
+            grad_initial_position = None
 
-        channels (int): As :func:`signatory.invert_signature`.
-
-    Returns:
-        The :class:`torch.Tensor` representing the linear insertion map, of shape
-        :math:`(N, \text{channels}, \text{channels}^{(\text{depth} +1)}', where :math:`N' is the batch size.
-
-    """
-
-    batch = signature.shape[0]
-    B = torch.cat(batch * [torch.eye(channels)])
-    new_shape = [batch] + [channels] + [1] * (insertion_position - 1) + [channels] + [1] * (depth + 1 -
-                                                                                            insertion_position)
-    repeat_points = [1, 1] + [channels] * (insertion_position - 1) + [1] + [channels] * (depth + 1 - insertion_position)
-    new_B = B.view(new_shape)
-    new_B = new_B.repeat(repeat_points)
-
-    last_signature_term = smodule.extract_signature_term(signature, channels, depth)
-    last_signature_term = last_signature_term.view([batch] + [channels] * int(depth)).unsqueeze(insertion_position)
-    repeat_points_sig = [1, channels] + [1] * (insertion_position - 1) + [channels] + [1] * (
-                depth + 1 - insertion_position)
-    sig_new_tensor = last_signature_term.unsqueeze(1).repeat(repeat_points_sig)
-
-    A = (new_B * sig_new_tensor).flatten(start_dim=2)
-    return A
-
-
-def solve_optimization_problem(signature, insertion_position, depth, channels):
-    """This function solves the optimization problem that allows to approximate the derivatives of the path.
-
-    Arguments:
-        signature (:class:`torch.Tensor`): As :func:`signatory.invert_signature`.
-
-        insertion_position (int): Insertion spot.
-
-        depth (int): As :func:`signatory.invert_signature`.
-
-        channels (int): As :func:`signatory.invert_signature`.
-
-    Returns:
-        The :class:`torch.Tensor` approximation of the gradient of the streams on the interval indexed by
-        :attr:`insertion_position'. It is of shape :math:`(N, \text{channels})'.
-    """
-
-    A_matrix = get_insertion_matrix(signature[:, :-channels ** depth], insertion_position, depth - 1, channels)
-    b_vector = depth * smodule.extract_signature_term(signature, channels, depth)
-
-    x_optimal = torch.matmul(A_matrix, b_vector.unsqueeze(-1)).squeeze(-1)
-
-    sign_1 = smodule.extract_signature_term(signature, channels, depth - 1)
-
-    return x_optimal / (torch.norm(sign_1, dim=1).unsqueeze(-1) ** 2)
+        return grad_signature, None, None, None, grad_initial_position
 
 
 def invert_signature(signature: torch.Tensor, depth: int, channels: int,
@@ -91,25 +54,17 @@ def invert_signature(signature: torch.Tensor, depth: int, channels: int,
             reconstructed paths are set to begin at zero.
 
     Returns:
-        The :class:`torch.Tensor` corresponding to a batch of inverted paths.
+        The :class:`torch.Tensor` corresponding to a batch of inverted paths. It has the same dtype and device as
+        :attr:`signature`.
+
+    .. note::
+
+        The increment over each piece of the reconstructed path is the solution of a least-squares problem involving
+        the map which inserts a vector into the penultimate term of the signature. The solution has a closed form, so
+        this is computed for every element of the batch at once, on the same device as :attr:`signature`, and without
+        ever forming the insertion map itself.
     """
-    if smodule.signature_channels(channels, depth) != signature.shape[1]:
-        raise ValueError("channels and depth do not correspond to signature shape.")
-
-    batch = signature.shape[0]
-    path_derivatives = torch.zeros((batch, depth, channels))
-    path = torch.zeros((batch, depth + 1, channels))
-
-    if initial_position is not None:
-        path[:, 0, :] = initial_position
-
-    if depth == 1:
-        path[:, 1, :] = path[:, 0, :] + signature
-    else:
-        for insertion_position in torch.arange(1, depth + 1):
-            x_optimal = solve_optimization_problem(signature, insertion_position, depth, channels)
-            path_derivatives[:, insertion_position - 1, :] = x_optimal
-            path[:, insertion_position, :] = (path[:, insertion_position - 1, :]
-                                              + path_derivatives[:, insertion_position - 1, :] * (1 / depth))
-
-    return path
+    initial = initial_position is not None
+    if not initial:
+        initial_position = torch.empty(0, dtype=signature.dtype, device=signature.device)
+    return _InvertSignatureFunction.apply(signature, depth, channels, initial, initial_position)
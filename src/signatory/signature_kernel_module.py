@@ -0,0 +1,104 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Provides operations relating to signature kernels."""
+
+
+import torch
+from torch import autograd
+from torch.autograd import function as autograd_function
+
+from . import impl
+
+
+class _SignatureKernelFunction(autograd.Function):
+    @staticmethod
+    def forward(ctx, path1, path2, dyadic_order, basepoint, gram):
+        kernel, path_increments1, path_increments2 = impl.signature_kernel_forward(path1, path2, basepoint,
+                                                                                   dyadic_order, gram)
+        ctx.save_for_backward(path_increments1, path_increments2)
+        ctx.dyadic_order = dyadic_order
+        ctx.basepoint = basepoint
+        ctx.gram = gram
+
+        return kernel
+
+    @staticmethod
+    @autograd_function.once_differentiable  # Our backward function uses in-place operations for memory efficiency
+    def backward(ctx, grad_kernel):
+        path_increments1, path_increments2 = ctx.saved_tensors
+
+        grad_path1, grad_path2 = impl.signature_kernel_backward(grad_kernel, path_increments1, path_increments2,
+                                                                ctx.basepoint, ctx.dyadic_order, ctx.gram)
+
+        return grad_path1, grad_path2, None, None, None
+
+
+def signature_kernel(path1: torch.Tensor, path2: torch.Tensor, dyadic_order: int = 0, basepoint: bool = False,
+                     gram: bool = False) -> torch.Tensor:
+    r"""Computes the signature kernel between two batches of paths.
+
+    The signature kernel between two paths :math:`x` and :math:`y` is the inner product of their (untruncated)
+    signatures,
+
+    .. math::
+
+        k(x, y) = \langle \mathrm{Sig}(x), \mathrm{Sig}(y) \rangle = \sum_{n = 0}^\infty \langle \mathrm{Sig}^n(x),
+        \mathrm{Sig}^n(y) \rangle,
+
+    where :math:`\mathrm{Sig}^n` denotes the :math:`n`-th term of the signature (and in particular the scalar term
+    :math:`\mathrm{Sig}^0 = 1` is included). This is computed without ever computing the signatures themselves, by
+    solving a partial differential equation (a Goursat problem) over the grid formed by the increments of the two paths,
+    as in `"The Signature Kernel is the solution of a Goursat PDE" <https://arxiv.org/abs/2006.14794>`__. For long
+    paths, or when a whole Gram matrix is wanted, this is far cheaper than
+    :code:`signatory.signature(path1, depth, scalar_term=True) @ signatory.signature(path2, depth, scalar_term=True).T`,
+    which would in any case only give the kernel truncated to some depth.
+
+    Arguments:
+        path1 (:class:`torch.Tensor`): A batch of paths, as for :func:`signatory.signature`. It should be a
+            three-dimensional tensor of shape :math:`(N, L_1, C)`.
+
+        path2 (:class:`torch.Tensor`): Another batch of paths, of shape :math:`(M, L_2, C)`. It should have the same
+            number of channels :math:`C`, dtype and device as :attr:`path1`.
+
+        dyadic_order (int, optional): Defaults to zero. The PDE is solved with an explicit finite difference scheme on
+            the grid formed by the increments of the paths, after each increment has been split into
+            :math:`2^\text{dyadic_order}` equal pieces. Larger values give more accurate kernels, at a cost of
+            :math:`4^\text{dyadic_order}` times as much computation. For paths whose increments are small, the default
+            of zero is often accurate enough.
+
+        basepoint (bool, optional): Defaults to False. If True then the paths are treated as starting from the origin,
+            as with :code:`basepoint=True` in :func:`signatory.signature`.
+
+        gram (bool, optional): Defaults to False. If True then the kernel is computed between every path of
+            :attr:`path1` and every path of :attr:`path2`. If False then :attr:`path1` and :attr:`path2` must have the
+            same batch size :math:`N = M`, and the kernel is computed between corresponding pairs of paths.
+
+    Returns:
+        A :class:`torch.Tensor`. If :attr:`gram` is True then this is of shape :math:`(N, M)`, whose :math:`(i, j)`-th
+        element is :math:`k(\text{path1[i]}, \text{path2[j]})`. If :attr:`gram` is False then this is of shape
+        :math:`(N,)`, whose :math:`i`-th element is :math:`k(\text{path1[i]}, \text{path2[i]})`.
+
+    .. note::
+
+        The pairs of paths are processed in tiles of bounded size, so that memory usage remains modest even for large
+        Gram matrices. The backward pass recomputes each tile, rather than holding on to anything from the forward
+        pass besides the increments of the paths.
+    """
+    # (batch, stream, channel) to (stream, batch, channel)
+    # As in signatory.signature, we have to do the transposes outside of autograd.Function.apply
+    path1 = path1.transpose(0, 1)
+    path2 = path2.transpose(0, 1)
+    impl.signature_kernel_checkargs(path1, path2, basepoint, dyadic_order, gram)
+    return _SignatureKernelFunction.apply(path1, path2, dyadic_order, basepoint, gram)
@@ -15,7 +15,9 @@
 """Provides operations relating to the signature transform."""
 
 
+import concurrent.futures
 import math
+import threading
 import torch
 from torch import nn
 from torch import autograd
@@ -23,8 +25,9 @@ from torch.autograd import function as autograd_function
 import warnings
 
 from . import impl
+from . import workspace as wmodule
 
-from typing import List, Optional, Union
+from typing import List, Optional, Sequence, Union
 
 
 def interpret_basepoint(basepoint, batch_size, channel_size, dtype, device):
@@ -50,7 +53,8 @@ def interpret_initial(initial):
 
 class _SignatureFunction(autograd.Function):
     @staticmethod
-    def forward(ctx, path, depth, stream, basepoint, inverse, initial, scalar_term):
+    def forward(ctx, path, depth, stream, basepoint, inverse, initial, scalar_term, include_time, lead_lag,
+                workspace):
 
         ctx.basepoint_is_tensor = isinstance(basepoint, torch.Tensor)
         ctx.initial_is_tensor = isinstance(initial, torch.Tensor)
@@ -59,7 +63,8 @@ class _SignatureFunction(autograd.Function):
         initial, initial_value = interpret_initial(initial)
 
         signature_, path_increments = impl.signature_forward(path, depth, stream, basepoint, basepoint_value, inverse,
-                                                             initial, initial_value, scalar_term)
+                                                             initial, initial_value, scalar_term, include_time,
+                                                             lead_lag, workspace)
         ctx.save_for_backward(signature_, path_increments)
         ctx.depth = depth
         ctx.stream = stream
@@ -67,6 +72,9 @@ class _SignatureFunction(autograd.Function):
         ctx.inverse = inverse
         ctx.initial = initial
         ctx.scalar_term = scalar_term
+        ctx.include_time = include_time
+        ctx.lead_lag = lead_lag
+        ctx.workspace = workspace
 
         return signature_
 
@@ -82,28 +90,166 @@ class _SignatureFunction(autograd.Function):
 
         grad_path, grad_basepoint, grad_initial = impl.signature_backward(grad_result, signature_, path_increments,
                                                                           ctx.depth, ctx.stream, ctx.basepoint,
-                                                                          ctx.inverse, ctx.initial, ctx.scalar_term)
+                                                                          ctx.inverse, ctx.initial, ctx.scalar_term,
+                                                                          ctx.include_time, ctx.lead_lag,
+                                                                          ctx.workspace)
 
         if not ctx.basepoint_is_tensor:
             grad_basepoint = None
         if not ctx.initial_is_tensor:
             grad_initial = None
 
-        return grad_path, None, None, grad_basepoint, None, grad_initial, None, None
+        return grad_path, None, None, grad_basepoint, None, grad_initial, None, None, None, None
 
 
-def _signature_checkargs(path, depth, basepoint, initial, scalar_term):
+class _SignatureLevelsFunction(autograd.Function):
+    @staticmethod
+    def forward(ctx, path, depth, basepoint, inverse, initial, scalar_term, levels, stream_indices, workspace):
+
+        ctx.basepoint_is_tensor = isinstance(basepoint, torch.Tensor)
+        ctx.initial_is_tensor = isinstance(initial, torch.Tensor)
+        basepoint, basepoint_value = interpret_basepoint(basepoint, path.size(-2), path.size(-1), path.dtype,
+                                                         path.device)
+        initial, initial_value = interpret_initial(initial)
+
+        result, signature_, path_increments = impl.signature_levels_forward(path, depth, basepoint, basepoint_value,
+                                                                            inverse, initial, initial_value,
+                                                                            scalar_term, levels, stream_indices,
+                                                                            workspace)
+        ctx.save_for_backward(signature_, path_increments)
+        ctx.depth = depth
+        ctx.basepoint = basepoint
+        ctx.inverse = inverse
+        ctx.initial = initial
+        ctx.scalar_term = scalar_term
+        ctx.levels = levels
+        ctx.stream_indices = stream_indices
+        ctx.workspace = workspace
+
+        return result
+
+    @staticmethod
+    @autograd_function.once_differentiable  # Our backward function uses in-place operations for memory efficiency
+    def backward(ctx, grad_result):
+        signature_, path_increments = ctx.saved_tensors
+        # See _SignatureFunction.backward
+        path_increments = path_increments.contiguous()
+
+        grad_path, grad_basepoint, grad_initial = impl.signature_levels_backward(grad_result, signature_,
+                                                                                 path_increments, ctx.depth,
+                                                                                 ctx.basepoint, ctx.inverse,
+                                                                                 ctx.initial, ctx.scalar_term,
+                                                                                 ctx.levels, ctx.stream_indices,
+                                                                                 ctx.workspace)
+
+        if not ctx.basepoint_is_tensor:
+            grad_basepoint = None
+        if not ctx.initial_is_tensor:
+            grad_initial = None
+
+        return grad_path, None, grad_basepoint, None, grad_initial, None, None, None, None
+
+
+class _SignatureCheckpointFunction(autograd.Function):
+    @staticmethod
+    def forward(ctx, path, depth, basepoint, inverse, initial, scalar_term, checkpoint, workspace):
+
+        ctx.basepoint_is_tensor = isinstance(basepoint, torch.Tensor)
+        ctx.initial_is_tensor = isinstance(initial, torch.Tensor)
+        basepoint, basepoint_value = interpret_basepoint(basepoint, path.size(-2), path.size(-1), path.dtype,
+                                                         path.device)
+        initial, initial_value = interpret_initial(initial)
+
+        signature_, path_increments, checkpoints = impl.signature_checkpoint_forward(path, depth, basepoint,
+                                                                                     basepoint_value, inverse, initial,
+                                                                                     initial_value, scalar_term,
+                                                                                     checkpoint, workspace)
+        ctx.save_for_backward(checkpoints, path_increments)
+        ctx.depth = depth
+        ctx.basepoint = basepoint
+        ctx.inverse = inverse
+        ctx.initial = initial
+        ctx.scalar_term = scalar_term
+        ctx.checkpoint = checkpoint
+        ctx.workspace = workspace
+
+        return signature_
+
+    @staticmethod
+    @autograd_function.once_differentiable  # Our backward function uses in-place operations for memory efficiency
+    def backward(ctx, grad_result):
+        checkpoints, path_increments = ctx.saved_tensors
+        # See _SignatureFunction.backward
+        path_increments = path_increments.contiguous()
+
+        grad_path, grad_basepoint, grad_initial = impl.signature_checkpoint_backward(grad_result, checkpoints,
+                                                                                     path_increments, ctx.depth,
+                                                                                     ctx.basepoint, ctx.inverse,
+                                                                                     ctx.initial, ctx.scalar_term,
+                                                                                     ctx.checkpoint, ctx.workspace)
+
+        if not ctx.basepoint_is_tensor:
+            grad_basepoint = None
+        if not ctx.initial_is_tensor:
+            grad_initial = None
+
+        return grad_path, None, grad_basepoint, None, grad_initial, None, None, None
+
+
+def _output_stream_size(path, basepoint):
+    # The length of the stream=True output.
+    output_stream_size = path.size(-2)
+    if basepoint is False:
+        output_stream_size -= 1
+    return output_stream_size
+
+
+def _interpret_stream(stream, path, basepoint):
+    """Converts a stride or a collection of indices, as passed to the 'stream' argument of signatory.signature, into a
+    tensor of indices into the stream=True output. Returns None if 'stream' is just a bool.
+    """
+    if isinstance(stream, bool):
+        return None
+
+    output_stream_size = _output_stream_size(path, basepoint)
+
+    if isinstance(stream, int):
+        if stream < 2:
+            raise ValueError("Argument 'stream' must be at least 2 when given as a stride. (0 and 1 are interpreted as "
+                             "False and True.)")
+        return torch.arange(stream - 1, output_stream_size, stream, dtype=torch.int64)
+
+    stream_indices = torch.as_tensor(stream, dtype=torch.int64).to(device='cpu')
+    # Support negative indices, as for indexing
+    return torch.where(stream_indices < 0, stream_indices + output_stream_size, stream_indices)
+
+
+def _extract_signature_levels(sigtensor, channels, levels, scalar_term):
+    terms = [extract_signature_term(sigtensor, channels, level, scalar_term) for level in levels]
+    if scalar_term:
+        terms.insert(0, sigtensor.narrow(dim=-1, start=0, length=1))
+    if len(terms) == 1:
+        return terms[0]
+    return torch.cat(terms, dim=-1)
+
+
+def _signature_checkargs(path, depth, basepoint, initial, scalar_term, include_time=False, lead_lag=False):
     path = path.transpose(0, 1)  # (batch, stream, channel) to (stream, batch, channel)
     basepoint, basepoint_value = interpret_basepoint(basepoint, path.size(-2), path.size(-1), path.dtype, path.device)
     initial, initial_value = interpret_initial(initial)
-    impl.signature_checkargs(path, depth, basepoint, basepoint_value, initial, initial_value, scalar_term)
+    impl.signature_checkargs(path, depth, basepoint, basepoint_value, initial, initial_value, scalar_term,
+                             include_time, lead_lag)
 
 
-def _signature_batch_trick(path, depth, stream, basepoint, inverse, initial, scalar_term):
+def _signature_batch_trick(path, depth, stream, basepoint, inverse, initial, scalar_term, workspace=None):
     if stream:
         # We can't use this trick in this case
         return
 
+    if path.dtype in (torch.float16, torch.bfloat16):
+        # Combining the chunks would happen at reduced precision, rather than in float32 as the usual computation does.
+        return
+
     if path.is_cuda:
         # A somewhat arbitrary limit for the maximum amount we're willing to try and use a GPU to parallelise.
         # Increasing this value increases the amount of memory we use, but potentially increases speed.
@@ -152,7 +298,7 @@ def _signature_batch_trick(path, depth, stream, basepoint, inverse, initial, sca
 
     # noinspection PyUnresolvedReferences
     result_bulk = _SignatureFunction.apply(path_bulk.transpose(0, 1), depth, stream, basepoint, inverse, None,
-                                           scalar_term)
+                                           scalar_term, False, False, wmodule._capsule(workspace))
     result_bulk = result_bulk.view(batch_size, mult, result_bulk.size(-1))
     chunks = []
     if isinstance(initial, torch.Tensor):
@@ -163,14 +309,18 @@ def _signature_batch_trick(path, depth, stream, basepoint, inverse, initial, sca
         # (stream, batch, channel)
         # noinspection PyUnresolvedReferences
         result_remainder = _SignatureFunction.apply(path_remainder.transpose(0, 1), depth, stream, basepoint_remainder,
-                                                    inverse, None, scalar_term)
+                                                    inverse, None, scalar_term, False, False,
+                                                    wmodule._capsule(workspace))
         chunks.append(result_remainder)
 
     return multi_signature_combine(chunks, channel_size, depth, inverse, scalar_term)
 
 
-def signature(path: torch.Tensor, depth: int, stream: bool = False, basepoint: Union[bool, torch.Tensor] = False,
-              inverse: bool = False, initial: Optional[torch.Tensor] = None, scalar_term: bool = False) -> torch.Tensor:
+def signature(path: torch.Tensor, depth: int, stream: Union[bool, int, Sequence[int], torch.Tensor] = False,
+              basepoint: Union[bool, torch.Tensor] = False, inverse: bool = False,
+              initial: Optional[torch.Tensor] = None, scalar_term: bool = False,
+              workspace: Optional[wmodule.Workspace] = None, levels: Optional[Sequence[int]] = None,
+              checkpoint: Optional[int] = None, include_time: bool = False, lead_lag: bool = False) -> torch.Tensor:
     r"""Applies the signature transform to a stream of data.
 
     The input :attr:`path` is expected to be a three-dimensional tensor, with dimensions :math:`(N, L, C)`, where
@@ -191,13 +341,28 @@ def signature(path: torch.Tensor, depth: int, stream: bool = False, basepoint: U
         (N, C + C^2 + \cdots + C^\text{depth}).
 
     Arguments:
-        path (:class:`torch.Tensor`): The batch of input paths to apply the signature transform to.
+        path (:class:`torch.Tensor`): The batch of input paths to apply the signature transform to. If it is of dtype
+            :code:`torch.float16` or :code:`torch.bfloat16` then the result is returned in that dtype, but the
+            computation itself is performed in :code:`torch.float32`. If :attr:`stream` is True then the signatures are
+            converted a block at a time as they are computed, so that the full stream is never held at full precision.
+            If :attr:`levels` or :attr:`checkpoint` are passed, or if :attr:`stream` selects particular indices, then
+            the computation is still performed in :code:`torch.float32`; only the requested output is converted, and
+            whatever is saved for the backward pass is kept in :code:`torch.float32`.
 
         depth (int): The depth to truncate the signature at.
 
-        stream (bool, optional): Defaults to False. If False then the usual signature transform of the whole path is
-            computed. If True then the signatures of all paths :math:`(x_1, \ldots, x_j)`, for :math:`j=2, \ldots, L`,
-            are returned. (Or :math:`j=1, \ldots, L` is :attr:`basepoint` is passed, see below.)
+        stream (bool or int or sequence of int or :class:`torch.Tensor`, optional): Defaults to False. If False then
+            the usual signature transform of the whole path is computed. If True then the signatures of all paths
+            :math:`(x_1, \ldots, x_j)`, for :math:`j=2, \ldots, L`, are returned. (Or :math:`j=1, \ldots, L` is
+            :attr:`basepoint` is passed, see below.)
+            Alternatively it may be an int :math:`s \geq 2`, in which case only every :math:`s`-th of these signatures
+            is returned, i.e. those that :code:`stream=True` would give at indices :math:`s - 1, 2s - 1, \ldots`. (The
+            ints 0 and 1 are not strides, and mean False and True respectively, as they did before strides were
+            supported. In the case of 1 this gives the same result either way.)
+            Alternatively it may be a sequence or one-dimensional :class:`torch.Tensor` of integers, in which case only
+            the signatures that :code:`stream=True` would give at those indices are returned. They should be in
+            strictly increasing order, and may be negative to count from the end. In both of these cases the other
+            signatures are never stored, so this saves memory.
 
         basepoint (bool or :class:`torch.Tensor`, optional): Defaults to False. If :attr:`basepoint` is True then an
             additional point :math:`x_0 = 0 \in \mathbb{R}^C` is prepended to the path before the signature transform is
@@ -220,13 +385,52 @@ def signature(path: torch.Tensor, depth: int, stream: bool = False, basepoint: U
             be filled with the constant 1 (in accordance with the usual mathematical definition). If False then this
             channel is omitted (in accordance with useful machine learning practice).
 
+        workspace (None or :class:`signatory.Workspace`, optional): Defaults to None. If passed then temporary memory
+            used in the computation is taken from (and kept in) this workspace, so that it may be reused by subsequent
+            calls.
+
+        levels (None or sequence of int, optional): Defaults to None. If passed then only these levels of the signature
+            are returned, concatenated along the channel dimension. For example :code:`levels=[depth]` returns just the
+            highest level, as :func:`signatory.extract_signature_term` would. They should be in strictly increasing
+            order, and each should be between 1 and :attr:`depth` inclusive. If :attr:`stream` is True then the other
+            levels are never stored, so this saves memory. (If :attr:`scalar_term` is True then the scalar term is
+            still included, as the first channel.)
+
+        checkpoint (None or int, optional): Defaults to None. May only be passed if :attr:`stream` is False. If passed
+            then during the forward pass the signature of the partial path is additionally saved every
+            :attr:`checkpoint` steps along the stream. The backward pass then handles each of these segments of the
+            stream independently, in parallel on the CPU, recomputing the signatures of the partial paths forwards from
+            these checkpoints. (Rather than backwards from the signature of the whole path, which is inherently serial,
+            and which may accumulate numerical error over very long streams.) Smaller values use more memory to save
+            the checkpoints; larger values use more memory during the backward pass, recomputing each segment. A value
+            of about the square root of the length of the stream is usually a good trade-off.
+
+        include_time (bool, optional): Defaults to False. If True then the path is augmented with an extra 'time'
+            channel before the signature transform is applied, which moves uniformly from :math:`0` to :math:`1` along
+            the (augmented) path. It is placed after the channels of the path, as with the :code:`include_time`
+            argument of :class:`signatory.Augment`.
+
+        lead_lag (bool, optional): Defaults to False. If True then the lead-lag transform of the path is taken before
+            the signature transform is applied. That is, :math:`(x_1, \ldots, x_L)` is replaced by the path with
+            :math:`2C` channels given by :math:`((x_1, x_1), (x_2, x_1), (x_2, x_2), \ldots, (x_L, x_L))`, whose
+            first :math:`C` channels lead, and whose last :math:`C` channels lag. (If :attr:`include_time` is also
+            True then the time channel is added after this.)
+
+            Both of these augmentations are computed on the fly, as part of computing the increments of the path:
+            the augmented path is never formed. This is cheaper than augmenting the path first. If either is passed
+            then any :attr:`basepoint` is prepended to the path before it is augmented (so it should have the
+            unaugmented shape :math:`(N, C)`), whilst :attr:`initial` should be a signature of the augmented path. In
+            this case :attr:`stream` must be a bool, and :attr:`levels` and :attr:`checkpoint` may not be passed.
+
     Returns:
         A :class:`torch.Tensor`. Given an input :class:`torch.Tensor` of shape :math:`(N, L, C)`, and input arguments
         :attr:`depth`, :attr:`basepoint`, :attr:`stream`, then the return value is, in pseudocode:
 
         .. code-block:: python
 
-            if stream:
+            if stream is an int or a collection of indices:
+                return torch.Tensor of shape (N, number of selected indices, C + C^2 + ... + C^depth)
+            elif stream:
                 if basepoint is True or isinstance(basepoint, torch.Tensor):
                     return torch.Tensor of shape (N, L, C + C^2 + ... + C^depth)
                 else:
@@ -235,7 +439,14 @@ def signature(path: torch.Tensor, depth: int, stream: bool = False, basepoint: U
                 return torch.Tensor of shape (N, C + C^2 + ... + C^depth)
 
         Note that the number of output channels may be calculated via the convenience function
-        :func:`signatory.signature_channels`.
+        :func:`signatory.signature_channels`. If :attr:`levels` is passed then the number of output channels is
+        instead the sum of :math:`C^k` over every :math:`k` in :attr:`levels`.
+
+        If :attr:`include_time` or :attr:`lead_lag` is passed then :math:`C` and :math:`L` above should be replaced
+        with the number of channels, and the length, of the augmented path. (Which includes the basepoint, if there is
+        one, so that :attr:`basepoint` should then be treated as False in the above.) The lead-lag transform of a path
+        of length :math:`L` with :math:`C` channels has length :math:`2L - 1` and :math:`2C` channels; the time channel
+        adds one more channel.
     """
 
     if initial is not None and basepoint is False:
@@ -245,41 +456,179 @@ def signature(path: torch.Tensor, depth: int, stream: bool = False, basepoint: U
                       "    https://signatory.readthedocs.io/en/latest/pages/examples/online.html\n"
                       "for more information.")
 
-    _signature_checkargs(path, depth, basepoint, initial, scalar_term)
-
-    result = _signature_batch_trick(path, depth, stream, basepoint, inverse, initial, scalar_term)
+    _signature_checkargs(path, depth, basepoint, initial, scalar_term, include_time, lead_lag)
+    if isinstance(stream, int) and stream in (0, 1):
+        # Before strides were supported these were accepted as False and True, so they still mean that. (And nothing
+        # below needs to treat them specially.)
+        stream = bool(stream)
+    if include_time or lead_lag:
+        if not isinstance(stream, bool) or levels is not None or checkpoint is not None:
+            raise ValueError("Arguments 'include_time' and 'lead_lag' may only be passed if argument 'stream' is a "
+                             "bool, and arguments 'levels' and 'checkpoint' are None.")
+        # The batch trick doesn't apply, as every piece of the path would get its own time channel.
+        result = _SignatureFunction.apply(path.transpose(0, 1), depth, stream, basepoint, inverse, initial, scalar_term,
+                                          include_time, lead_lag, wmodule._capsule(workspace))
+        if stream:
+            # As below
+            result = result.transpose(0, 1)
+        return result
+    if checkpoint is not None:
+        if stream is not False:
+            raise ValueError("Argument 'checkpoint' may only be passed if argument 'stream' is False.")
+        result = _SignatureCheckpointFunction.apply(path.transpose(0, 1), depth, basepoint, inverse, initial,
+                                                    scalar_term, checkpoint, wmodule._capsule(workspace))
+        if levels is not None:
+            levels = list(levels)
+            impl.signature_levels_checkargs(levels, depth)
+            result = _extract_signature_levels(result, path.size(-1), levels, scalar_term)
+        return result
+    if levels is not None:
+        levels = list(levels)
+        impl.signature_levels_checkargs(levels, depth)
+    stream_indices = _interpret_stream(stream, path, basepoint)
+    if stream_indices is not None or (stream and levels is not None):
+        if levels is None:
+            levels = list(range(1, depth + 1))
+        if stream_indices is None:
+            stream_indices = torch.arange(_output_stream_size(path, basepoint), dtype=torch.int64)
+        result = _SignatureLevelsFunction.apply(path.transpose(0, 1), depth, basepoint, inverse, initial, scalar_term,
+                                                levels, stream_indices, wmodule._capsule(workspace))
+        # As below
+        return result.transpose(0, 1)
+
+    result = _signature_batch_trick(path, depth, stream, basepoint, inverse, initial, scalar_term, workspace)
     if result is None:  # Either because we disabled use of the batch trick, or because the batch trick doesn't apply
-        result = _SignatureFunction.apply(path.transpose(0, 1), depth, stream, basepoint, inverse, initial, scalar_term)
+        result = _SignatureFunction.apply(path.transpose(0, 1), depth, stream, basepoint, inverse, initial, scalar_term,
+                                          False, False, wmodule._capsule(workspace))
 
     # We have to do the transpose outside of autograd.Function.apply to avoid PyTorch bug 24413
     if stream:
         # NOT .transpose_ - the underlying TensorImpl (in C++) is used elsewhere and we don't want to change it.
         result = result.transpose(0, 1)
+    if levels is not None:
+        # Without stream=True the full signature had to be held in memory anyway, so just extract the levels from it.
+        result = _extract_signature_levels(result, path.size(-1), levels, scalar_term)
     return result
 
 
+_async_executor = None
+_async_executor_lock = threading.Lock()
+
+
+def _get_async_executor():
+    global _async_executor
+    with _async_executor_lock:
+        if _async_executor is None:
+            # Sized like PyTorch's own inter-op thread pool, which is what torch.jit.fork uses.
+            _async_executor = concurrent.futures.ThreadPoolExecutor(max_workers=torch.get_num_interop_threads(),
+                                                                    thread_name_prefix='signatory')
+        return _async_executor
+
+
+class _AsyncException(object):
+    # torch.futures.Future only gained set_exception in later versions of PyTorch, so instead exceptions are passed
+    # along as the result, and reraised in a callback; see signature_async.
+    def __init__(self, exception):
+        self.exception = exception
+
+
+def _reraise_async_exception(future):
+    result = future.wait()
+    if isinstance(result, _AsyncException):
+        raise result.exception
+    return result
+
+
+def _signature_async_worker(future, grad_enabled, cuda_stream, args, kwargs):
+    # Grad mode and the current CUDA stream are thread-local, so restore the caller's here.
+    try:
+        with torch.set_grad_enabled(grad_enabled):
+            if cuda_stream is None:
+                result = signature(*args, **kwargs)
+            else:
+                with torch.cuda.stream(cuda_stream):
+                    result = signature(*args, **kwargs)
+    except Exception as e:
+        future.set_result(_AsyncException(e))
+    else:
+        future.set_result(result)
+
+
+def signature_async(path: torch.Tensor, depth: int, stream: Union[bool, int, Sequence[int], torch.Tensor] = False,
+                    basepoint: Union[bool, torch.Tensor] = False, inverse: bool = False,
+                    initial: Optional[torch.Tensor] = None, scalar_term: bool = False,
+                    workspace: Optional[wmodule.Workspace] = None, levels: Optional[Sequence[int]] = None,
+                    checkpoint: Optional[int] = None, include_time: bool = False,
+                    lead_lag: bool = False) -> torch.futures.Future:
+    r"""Schedules the computation of :func:`signatory.signature` on an internal thread pool, and returns immediately.
+
+    The signature computation itself does not hold Python's global interpreter lock, so several of these may run at
+    the same time as each other, and as the calling Python code. For example a data loader may start computing the
+    signatures of one batch and then go on to prepare the next one. This is particularly useful for small problems,
+    for which the parallelism within a single signature computation does not fill the machine.
+
+    The thread pool has :func:`torch.get_num_interop_threads` threads.
+
+    Arguments:
+        As :func:`signatory.signature`. Note that a :attr:`workspace` should not be used by two computations that are
+        running at the same time.
+
+    Returns:
+        A :class:`torch.futures.Future`, whose value is what :func:`signatory.signature` would return. It may be used
+        with e.g. :func:`torch.futures.wait_all`. Calling its :meth:`wait` method will raise an error if the
+        computation raised one. Gradients may be computed through the result as usual, provided that gradient
+        calculation was enabled when this function was called.
+    """
+
+    # Check the arguments now, so that simple mistakes are raised where they're made.
+    _signature_checkargs(path, depth, basepoint, initial, scalar_term, include_time, lead_lag)
+
+    future = torch.futures.Future()
+    cuda_stream = torch.cuda.current_stream(path.device) if path.is_cuda else None
+    _get_async_executor().submit(_signature_async_worker, future, torch.is_grad_enabled(), cuda_stream,
+                                 (path, depth),
+                                 dict(stream=stream, basepoint=basepoint, inverse=inverse, initial=initial,
+                                      scalar_term=scalar_term, workspace=workspace, levels=levels,
+                                      checkpoint=checkpoint, include_time=include_time, lead_lag=lead_lag))
+    return future.then(_reraise_async_exception)
+
+
 class Signature(nn.Module):
     """:class:`torch.nn.Module` wrapper around the :func:`signatory.signature` function.
 
     Arguments:
         depth (int): as :func:`signatory.signature`.
 
-        stream (bool, optional): as :func:`signatory.signature`.
+        stream (bool or int or sequence of int or :class:`torch.Tensor`, optional): as :func:`signatory.signature`.
 
         inverse (bool, optional): as :func:`signatory.signature`.
 
         scalar_term (bool, optional): as :func:`signatory.signature`.
+
+        levels (None or sequence of int, optional): as :func:`signatory.signature`.
+
+        checkpoint (None or int, optional): as :func:`signatory.signature`.
+
+        include_time (bool, optional): as :func:`signatory.signature`.
+
+        lead_lag (bool, optional): as :func:`signatory.signature`.
     """
 
-    def __init__(self, depth: int, stream: bool = False, inverse: bool = False, scalar_term: bool = False, **kwargs):
+    def __init__(self, depth: int, stream: Union[bool, int, Sequence[int], torch.Tensor] = False,
+                 inverse: bool = False, scalar_term: bool = False, levels: Optional[Sequence[int]] = None,
+                 checkpoint: Optional[int] = None, include_time: bool = False, lead_lag: bool = False, **kwargs):
         super(Signature, self).__init__(**kwargs)
         self.depth = depth
         self.stream = stream
         self.inverse = inverse
         self.scalar_term = scalar_term
+        self.levels = levels
+        self.checkpoint = checkpoint
+        self.include_time = include_time
+        self.lead_lag = lead_lag
 
     def forward(self, path: torch.Tensor, basepoint: Union[bool, torch.Tensor] = False,
-                initial: Optional[torch.Tensor] = None) -> torch.Tensor:
+                initial: Optional[torch.Tensor] = None, workspace: Optional[wmodule.Workspace] = None) -> torch.Tensor:
         """The forward operation.
 
         Arguments:
@@ -289,11 +638,14 @@ class Signature(nn.Module):
 
             initial (None or :class:`torch.Tensor`, optional): As :func:`signatory.signature`.
 
+            workspace (None or :class:`signatory.Workspace`, optional): As :func:`signatory.signature`.
+
         Returns:
             As :func:`signatory.signature`.
         """
         return signature(path, self.depth, stream=self.stream, basepoint=basepoint, inverse=self.inverse,
-                         initial=initial, scalar_term=self.scalar_term)
+                         initial=initial, scalar_term=self.scalar_term, workspace=workspace, levels=self.levels,
+                         checkpoint=self.checkpoint, include_time=self.include_time, lead_lag=self.lead_lag)
 
     def extra_repr(self):
         return 'depth={depth}, stream={stream}, inverse={inverse}'.format(depth=self.depth, stream=self.stream,
@@ -447,3 +799,189 @@ def multi_signature_combine(sigtensors: List[torch.Tensor], input_channels: int,
     if inverse:
         sigtensors = reversed(sigtensors)
     return _SignatureCombineFunction.apply(input_channels, depth, scalar_term, *sigtensors)
+
+
+class _SignatureWindowsFunction(autograd.Function):
+    @staticmethod
+    def forward(ctx, path, depth, starts, ends, scalar_term, workspace):
+        result, prefixes, path_increments = impl.signature_windows_forward(path, depth, starts, ends, scalar_term,
+                                                                            workspace)
+        ctx.save_for_backward(prefixes, path_increments)
+        ctx.depth = depth
+        ctx.starts = starts
+        ctx.ends = ends
+        ctx.scalar_term = scalar_term
+        ctx.workspace = workspace
+
+        return result
+
+    @staticmethod
+    @autograd_function.once_differentiable  # Our backward function uses in-place operations for memory efficiency
+    def backward(ctx, grad_result):
+        prefixes, path_increments = ctx.saved_tensors
+
+        grad_path = impl.signature_windows_backward(grad_result, prefixes, path_increments, ctx.depth, ctx.starts,
+                                                    ctx.ends, ctx.scalar_term, ctx.workspace)
+
+        return grad_path, None, None, None, None, None
+
+
+def _interpret_window_indices(indices, length):
+    indices = torch.as_tensor(indices, dtype=torch.int64).to(device='cpu')
+    # Support negative indices, as for slicing
+    return torch.where(indices < 0, indices + length, indices)
+
+
+def signature_windows(path: torch.Tensor, depth: int, starts: Union[Sequence[int], torch.Tensor],
+                      ends: Union[Sequence[int], torch.Tensor], scalar_term: bool = False,
+                      workspace: Optional[wmodule.Workspace] = None) -> torch.Tensor:
+    r"""Computes the signatures of many windows of a path at once.
+
+    This is equivalent to
+
+    .. code-block:: python
+
+        torch.stack([signatory.signature(path[:, start:end], depth, scalar_term=scalar_term)
+                     for start, end in zip(starts, ends)], dim=1)
+
+    but is much faster, especially when there are many windows. The signature (and inverse signature) of every prefix of
+    :attr:`path` is computed just once, and then every window is evaluated with a single batched tensor product, in the
+    same way that :meth:`signatory.Path.signature` does for a single window. (See also :class:`signatory.Path`, which
+    is more appropriate if the windows are not all known in advance.)
+
+    Arguments:
+        path (:class:`torch.Tensor`): As :func:`signatory.signature`.
+
+        depth (int): As :func:`signatory.signature`.
+
+        starts (sequence of int or :class:`torch.Tensor`): The start point of each window. These are interpreted in the
+            same way as the start of a slice :code:`path[:, start:end]`, and may be negative to count from the end.
+
+        ends (sequence of int or :class:`torch.Tensor`): The end point of each window, as for :attr:`starts`. Must be of
+            the same length as :attr:`starts`. Every window must contain at least two points.
+
+        scalar_term (bool, optional): As :func:`signatory.signature`.
+
+        workspace (None or :class:`signatory.Workspace`, optional): As :func:`signatory.signature`.
+
+    Returns:
+        A :class:`torch.Tensor` of shape :math:`(N, W, C + C^2 + \cdots + C^\text{depth})`, where :math:`W` is the number
+        of windows, and whose :math:`i`-th element along dimension 1 is the signature of
+        :code:`path[:, starts[i]:ends[i]]`. (And with an additional channel for the scalar term if :attr:`scalar_term`
+        is True.)
+    """
+    starts = _interpret_window_indices(starts, path.size(-2))
+    ends = _interpret_window_indices(ends, path.size(-2))
+    path = path.transpose(0, 1)  # (batch, stream, channel) to (stream, batch, channel)
+    impl.signature_windows_checkargs(path, depth, starts, ends, scalar_term)
+    result = _SignatureWindowsFunction.apply(path, depth, starts, ends, scalar_term, wmodule._capsule(workspace))
+    # (window, batch, channel) to (batch, window, channel)
+    # As in signatory.signature, we have to do the transpose outside of autograd.Function.apply
+    return result.transpose(0, 1)
+
+
+class _SignaturePackedFunction(autograd.Function):
+    @staticmethod
+    def forward(ctx, data, batch_sizes, depth, basepoint, basepoint_value, inverse, initial, initial_value,
+                scalar_term, workspace):
+        signature_, packed_increments = impl.signature_packed_forward(data, batch_sizes, depth, basepoint,
+                                                                      basepoint_value, inverse, initial, initial_value,
+                                                                      scalar_term, workspace)
+        ctx.save_for_backward(signature_, packed_increments)
+        ctx.batch_sizes = batch_sizes
+        ctx.depth = depth
+        ctx.basepoint = basepoint
+        ctx.inverse = inverse
+        ctx.initial = initial
+        ctx.scalar_term = scalar_term
+        ctx.workspace = workspace
+
+        return signature_
+
+    @staticmethod
+    @autograd_function.once_differentiable  # Our backward function uses in-place operations for memory efficiency
+    def backward(ctx, grad_result):
+        signature_, packed_increments = ctx.saved_tensors
+
+        grad_data, grad_basepoint, grad_initial = impl.signature_packed_backward(grad_result, signature_,
+                                                                                 packed_increments, ctx.batch_sizes,
+                                                                                 ctx.depth, ctx.basepoint, ctx.inverse,
+                                                                                 ctx.initial, ctx.scalar_term,
+                                                                                 ctx.workspace)
+
+        if not ctx.basepoint:
+            grad_basepoint = None
+        if not ctx.initial:
+            grad_initial = None
+
+        return grad_data, None, None, None, grad_basepoint, None, None, grad_initial, None, None
+
+
+def signature_packed(path: nn.utils.rnn.PackedSequence, depth: int, basepoint: Union[bool, torch.Tensor] = False,
+                     inverse: bool = False, initial: Optional[torch.Tensor] = None, scalar_term: bool = False,
+                     workspace: Optional[wmodule.Workspace] = None) -> torch.Tensor:
+    r"""Computes the signatures of a batch of paths of different lengths.
+
+    This is equivalent to
+
+    .. code-block:: python
+
+        paths, lengths = torch.nn.utils.rnn.pad_packed_sequence(path, batch_first=True)
+        torch.cat([signatory.signature(paths[i:i + 1, :length], depth, basepoint=..., inverse=inverse,
+                                       initial=..., scalar_term=scalar_term)
+                   for i, length in enumerate(lengths)])
+
+    but without any padding or Python loops: the computation moves along the stream updating only those paths that have
+    not yet finished, so that its cost is proportional to the total number of points in the batch, rather than to the
+    batch size multiplied by the length of the longest path.
+
+    Arguments:
+        path (:class:`torch.nn.utils.rnn.PackedSequence`): The batch of input paths, for example as produced by
+            :code:`torch.nn.utils.rnn.pack_sequence(paths, enforce_sorted=False)` where every element of :code:`paths`
+            is a tensor of shape :math:`(L_i, C)`. Every path must contain at least two points, unless
+            :attr:`basepoint` is used, in which case every path must contain at least one point.
+
+        depth (int): As :func:`signatory.signature`.
+
+        basepoint (bool or :class:`torch.Tensor`, optional): As :func:`signatory.signature`. If it is a tensor then it
+            should be of shape :math:`(N, C)`, with its batch elements in the same order as the paths that were packed
+            into :attr:`path`.
+
+        inverse (bool, optional): As :func:`signatory.signature`.
+
+        initial (None or :class:`torch.Tensor`, optional): As :func:`signatory.signature`, with its batch elements in
+            the same order as the paths that were packed into :attr:`path`.
+
+        scalar_term (bool, optional): As :func:`signatory.signature`.
+
+        workspace (None or :class:`signatory.Workspace`, optional): As :func:`signatory.signature`.
+
+    Returns:
+        A :class:`torch.Tensor` of shape :math:`(N, C + C^2 + \cdots + C^\text{depth})`, whose :math:`i`-th batch
+        element is the signature of the :math:`i`-th path that was packed into :attr:`path`. (And with an additional
+        channel for the scalar term if :attr:`scalar_term` is True.) Note that only the signature of the whole of each
+        path is returned; there is no equivalent of the :attr:`stream` argument of :func:`signatory.signature`.
+    """
+    data = path.data
+    batch_sizes = path.batch_sizes
+    sorted_indices = path.sorted_indices
+    unsorted_indices = path.unsorted_indices
+
+    basepoint, basepoint_value = interpret_basepoint(basepoint, batch_sizes[0].item(), data.size(-1), data.dtype,
+                                                     data.device)
+    initial, initial_value = interpret_initial(initial)
+    # The PackedSequence stores its batch elements sorted by decreasing length, so put everything else in that order
+    # too.
+    if sorted_indices is not None:
+        if basepoint and basepoint_value.ndimension() == 2 and basepoint_value.size(0) == sorted_indices.size(0):
+            basepoint_value = basepoint_value.index_select(0, sorted_indices.to(basepoint_value.device))
+        if initial and initial_value.ndimension() == 2 and initial_value.size(0) == sorted_indices.size(0):
+            initial_value = initial_value.index_select(0, sorted_indices.to(initial_value.device))
+
+    impl.signature_packed_checkargs(data, batch_sizes, depth, basepoint, basepoint_value, initial, initial_value,
+                                    scalar_term)
+    result = _SignaturePackedFunction.apply(data, batch_sizes, depth, basepoint, basepoint_value, inverse, initial,
+                                            initial_value, scalar_term, wmodule._capsule(workspace))
+    if unsorted_indices is not None:
+        result = result.index_select(0, unsorted_indices.to(result.device))
+    return result
@@ -0,0 +1,69 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Provides for reusing memory between repeated signature and logsignature computations."""
+
+
+from . import impl
+
+
+class Workspace(object):
+    r"""Holds on to memory between calls to :func:`signatory.signature`, :func:`signatory.logsignature` and
+    :func:`signatory.signature_to_logsignature`, and their backward passes.
+
+    Computing signatures involves allocating a number of temporary tensors. If computing many signatures of small
+    inputs, then the time spent allocating these may be noticeable. Passing the same :class:`signatory.Workspace` to
+    each call (via the :attr:`workspace` argument) means that this memory is allocated once and then reused instead.
+
+    Memory is held separately for each dtype and device, and is grown as necessary, so the same
+    :class:`signatory.Workspace` may be used for inputs of different sizes. Precomputed constants depending upon the
+    depth are also cached.
+
+    .. warning::
+
+        A :class:`signatory.Workspace` must not be used by two computations at the same time, for example from multiple
+        Python threads, or on multiple CUDA streams. (It is fine to use it for both the forward and backward passes of
+        the same computation.)
+
+    Example:
+        .. code-block:: python
+
+            import signatory
+            import torch
+            workspace = signatory.Workspace()
+            for _ in range(1000):
+                path = torch.rand(1, 10, 3)
+                signature = signatory.signature(path, 4, workspace=workspace)
+    """
+
+    def __init__(self):
+        self._capsule = impl.make_workspace()
+
+    def clear(self) -> None:
+        """Frees all memory held by this workspace. (It may still be used afterwards, and will simply allocate memory
+        again as it needs it.)"""
+        impl.workspace_clear(self._capsule)
+
+    def __copy__(self):
+        return self
+
+    def __deepcopy__(self, memodict):
+        return self
+
+
+def _capsule(workspace):
+    # Converts from the Python-facing object to the thing the C++ side expects.
+    if workspace is None:
+        return None
+    return workspace._capsule
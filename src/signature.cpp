@@ -15,67 +15,39 @@
 
 
 #include <torch/extension.h>
-#include <algorithm>  // std::min
+#include <algorithm>  // std::lower_bound, std::max, std::min
 #include <cstdint>    // int64_t
 #include <cmath>      // std::sqrt
-#include <omp.h>
+#include <functional> // std::function
+#include <stdexcept>  // std::invalid_argument
+#include <string>     // std::to_string
 #include <tuple>      // std::tie, std::tuple
 #include <vector>     // std::vector
 
 #include "misc.hpp"
+#include "profiling.hpp"
 #include "signature.hpp"
 #include "tensor_algebra_ops.hpp"
+#include "workspace.hpp"
+#ifdef SIGNATORY_CUDA
+#include "tensor_algebra_ops_cuda.hpp"
+#endif
 
 namespace signatory {
     namespace signature {
         namespace detail {
-            // Check if we're using MSVC, which still only uses OpenMP v2.0, which was defined when the dinosaurs still
-            // roamed the earth.
-            #if _OPENMP == 200203
-            struct omp_nested {
-                omp_nested() :
-                was_omp_nested(omp_get_nested()), was_omp_in_parallel(omp_in_parallel())
-                {
-                    if (!was_omp_in_parallel) {
-                        // parallelising over batch and stream
-                        omp_set_nested(true);
-                    }
-                }
-                ~omp_nested() {
-                    if (!was_omp_in_parallel) {
-                        omp_set_nested(was_omp_nested);
-                    }
-                }
-            private:
-                int was_omp_nested;
-                int was_omp_in_parallel;
-            };
-            #else
-            struct omp_nested {
-                omp_nested() :
-                was_omp_max_active_levels(omp_get_max_active_levels()), was_omp_in_parallel(omp_in_parallel())
-                {
-                    if (!was_omp_in_parallel) {
-                        // parallelising over batch and stream
-                        omp_set_max_active_levels(2);
-                    }
-                }
-                ~omp_nested() {
-                    if (!was_omp_in_parallel) {
-                        omp_set_max_active_levels(was_omp_max_active_levels);
-                    }
-                }
-            private:
-                int was_omp_max_active_levels;
-                int was_omp_in_parallel;
-            };
-            #endif
-
-            struct bool_wrapper { bool value; };
+            // Splits the batch dimension into 'num_blocks' roughly equally-sized blocks, and returns the start and
+            // length of the 'block'-th one. Used to tile computations over both the stream and batch dimensions.
+            std::tuple<int64_t, int64_t> batch_block(int64_t batch_size, int64_t num_blocks, int64_t block) {
+                int64_t start = (batch_size * block) / num_blocks;
+                int64_t end = (batch_size * (block + 1)) / num_blocks;
+                return std::tuple<int64_t, int64_t> {start, end - start};
+            }
 
             // Takes the path and basepoint and returns the path increments
             torch::Tensor compute_path_increments(torch::Tensor path, bool basepoint, torch::Tensor basepoint_value,
                                                   bool inverse) {
+                SIGNATORY_PROFILE_STAGE("compute_path_increments");
                 int64_t num_increments {path.size(stream_dim) - 1};
                 // The difference between these cases: basepoint/no basepoint + inverse/no inverse are basically just
                 // niceties.
@@ -118,6 +90,7 @@ namespace signatory {
             std::tuple<torch::Tensor, torch::Tensor>
             compute_path_increments_backward(torch::Tensor grad_path_increments, bool basepoint, bool inverse,
                                              torch::TensorOptions opts) {
+                SIGNATORY_PROFILE_STAGE("compute_path_increments_backward");
                 int64_t batch_size {grad_path_increments.size(batch_dim)};
                 int64_t input_stream_size {grad_path_increments.size(stream_dim)};
                 int64_t input_channel_size {grad_path_increments.size(channel_dim)};
@@ -133,8 +106,9 @@ namespace signatory {
                                 grad_path_increments.narrow(/*dim=*/stream_dim, /*start=*/1, /*len=*/num_increments));
                         grad_path[-1].zero_();
                         grad_path -= grad_path_increments;
+                        // Clone because grad_path_increments may be memory belonging to a workspace
                         return std::tuple<torch::Tensor, torch::Tensor>
-                                                         {grad_path, grad_path_increments[0]};
+                                                         {grad_path, grad_path_increments[0].clone()};
                     }
                     else {
                         torch::Tensor grad_path = grad_path_increments.clone();
@@ -168,6 +142,115 @@ namespace signatory {
                 }
             }
 
+            int64_t augmented_channels(int64_t input_channel_size, bool time, bool lead_lag) {
+                return (lead_lag ? 2 * input_channel_size : input_channel_size) + (time ? 1 : 0);
+            }
+
+            torch::Tensor compute_augmented_path_increments(torch::Tensor path, bool basepoint,
+                                                            torch::Tensor basepoint_value, bool inverse, bool time,
+                                                            bool lead_lag) {
+                if (!time && !lead_lag) {
+                    return compute_path_increments(path, basepoint, basepoint_value, inverse);
+                }
+                SIGNATORY_PROFILE_STAGE("compute_augmented_path_increments");
+
+                int64_t batch_size {path.size(batch_dim)};
+                int64_t input_channel_size {path.size(channel_dim)};
+                int64_t num_path_increments {path.size(stream_dim) - 1};
+                int64_t num_increments {basepoint ? (num_path_increments + 1) : num_path_increments};
+                int64_t num_augmented_increments {lead_lag ? (2 * num_increments) : num_increments};
+                int64_t augmented_channel_size {augmented_channels(input_channel_size, time, lead_lag)};
+                torch::Tensor path_increments = torch::empty({num_augmented_increments, batch_size,
+                                                              augmented_channel_size}, path.options());
+
+                // The slots that the increments of the (unaugmented) path get written in to.
+                torch::Tensor increments;
+                torch::Tensor lag_increments;
+                if (lead_lag) {
+                    // Each increment of the path is taken twice: first by the lead channels whilst the lag channels
+                    // stay still, and then by the lag channels whilst the lead channels stay still.
+                    torch::Tensor steps = path_increments.view({num_increments, 2, batch_size,
+                                                                augmented_channel_size});
+                    torch::Tensor lead_steps = steps.select(/*dim=*/1, /*index=*/0);
+                    torch::Tensor lag_steps = steps.select(/*dim=*/1, /*index=*/1);
+                    increments = lead_steps.narrow(/*dim=*/channel_dim, /*start=*/0, /*len=*/input_channel_size);
+                    lag_increments = lag_steps.narrow(/*dim=*/channel_dim, /*start=*/input_channel_size,
+                                                      /*len=*/input_channel_size);
+                    lead_steps.narrow(/*dim=*/channel_dim, /*start=*/input_channel_size,
+                                      /*len=*/input_channel_size).zero_();
+                    lag_steps.narrow(/*dim=*/channel_dim, /*start=*/0, /*len=*/input_channel_size).zero_();
+                }
+                else {
+                    increments = path_increments.narrow(/*dim=*/channel_dim, /*start=*/0, /*len=*/input_channel_size);
+                }
+
+                // As compute_path_increments, except that the differences are written straight into their slots.
+                torch::Tensor later = path.narrow(/*dim=*/stream_dim, /*start=*/1, /*len=*/num_path_increments);
+                torch::Tensor earlier = path.narrow(/*dim=*/stream_dim, /*start=*/0, /*len=*/num_path_increments);
+                torch::Tensor path_slots = increments;
+                if (basepoint) {
+                    torch::Tensor basepoint_slot = increments[0];
+                    torch::Tensor first = path[0];
+                    if (inverse) {
+                        torch::sub_out(basepoint_slot, basepoint_value, first);
+                    }
+                    else {
+                        torch::sub_out(basepoint_slot, first, basepoint_value);
+                    }
+                    path_slots = increments.narrow(/*dim=*/stream_dim, /*start=*/1, /*len=*/num_path_increments);
+                }
+                if (inverse) {
+                    torch::sub_out(path_slots, earlier, later);
+                }
+                else {
+                    torch::sub_out(path_slots, later, earlier);
+                }
+
+                if (lead_lag) {
+                    lag_increments.copy_(increments);
+                }
+                if (time) {
+                    // The time channel moves uniformly from 0 to 1 over the whole of the augmented path.
+                    double time_increment = 1.0 / static_cast<double>(num_augmented_increments);
+                    path_increments.narrow(/*dim=*/channel_dim, /*start=*/augmented_channel_size - 1,
+                                           /*len=*/1).fill_(inverse ? -time_increment : time_increment);
+                }
+                return path_increments;
+            }
+
+            std::tuple<torch::Tensor, torch::Tensor>
+            compute_augmented_path_increments_backward(torch::Tensor grad_path_increments, bool basepoint,
+                                                       bool inverse, bool time, bool lead_lag,
+                                                       torch::TensorOptions opts) {
+                if (!time && !lead_lag) {
+                    return compute_path_increments_backward(grad_path_increments, basepoint, inverse, opts);
+                }
+                SIGNATORY_PROFILE_STAGE("compute_augmented_path_increments_backward");
+
+                int64_t batch_size {grad_path_increments.size(batch_dim)};
+                int64_t augmented_channel_size {grad_path_increments.size(channel_dim)};
+                int64_t input_channel_size {augmented_channel_size - (time ? 1 : 0)};
+                // The time channel doesn't depend on the path, so its gradient is just dropped.
+                torch::Tensor grad_increments;
+                if (lead_lag) {
+                    input_channel_size /= 2;
+                    int64_t num_increments {grad_path_increments.size(stream_dim) / 2};
+                    torch::Tensor grad_steps = grad_path_increments.reshape({num_increments, 2, batch_size,
+                                                                            augmented_channel_size});
+                    torch::Tensor grad_lead = grad_steps.select(/*dim=*/1, /*index=*/0);
+                    torch::Tensor grad_lag = grad_steps.select(/*dim=*/1, /*index=*/1);
+                    grad_lead = grad_lead.narrow(/*dim=*/channel_dim, /*start=*/0, /*len=*/input_channel_size);
+                    grad_lag = grad_lag.narrow(/*dim=*/channel_dim, /*start=*/input_channel_size,
+                                               /*len=*/input_channel_size);
+                    grad_increments = grad_lead + grad_lag;
+                }
+                else {
+                    grad_increments = grad_path_increments.narrow(/*dim=*/channel_dim, /*start=*/0,
+                                                                  /*len=*/input_channel_size);
+                }
+                return compute_path_increments_backward(grad_increments, basepoint, inverse, opts);
+            }
+
             void signature_forward_inner(torch::Tensor path_increments,
                                          torch::Tensor reciprocals,
                                          torch::Tensor signature,
@@ -190,11 +273,871 @@ namespace signatory {
                                                       batch_threads);
                 }
             }
+
+            // Decides how many chunks to split the stream dimension into when computing a signature with stream==true.
+            // Returns 1 if the ordinary serial computation should be used instead.
+            int64_t num_scan_chunks(torch::Tensor path, int64_t batch_size, int64_t output_stream_size,
+                                    int64_t output_channel_size) {
+                int64_t scan_chunks;
+                if (path.is_cuda()) {
+                    // The GPU kernels parallelise over the batch dimension, so if the batch is large then there's
+                    // nothing to be gained. The magic numbers here are just heuristics.
+                    if (batch_size >= 128 || output_stream_size < 1024) {
+                        return 1;
+                    }
+                    scan_chunks = (128 + batch_size - 1) / batch_size;
+                }
+                else {
+                    // Same magic number as in signature_forward.
+                    if (batch_size * output_stream_size * output_channel_size < 81899) {
+                        return 1;
+                    }
+                    int64_t max_threads = misc::max_threads();
+                    if (batch_size >= max_threads) {
+                        // Then we already have enough parallelism along the batch dimension.
+                        return 1;
+                    }
+                    scan_chunks = (max_threads + batch_size - 1) / batch_size;
+                }
+                scan_chunks = std::min(scan_chunks, static_cast<int64_t>(std::sqrt(output_stream_size)));
+                // A scan performs about twice as much work as the serial computation, so it's only worth doing if we
+                // can split things up into enough pieces.
+                if (scan_chunks < 3) {
+                    return 1;
+                }
+                return scan_chunks;
+            }
+
+            // Decides how much parallelism to use on the CPU: how many threads to parallelise along the
+            // stream dimension, and how many along the batch dimension. Default is no parallelism.
+            std::tuple<int64_t, int64_t> choose_threads(bool is_cuda, int64_t batch_size, int64_t input_stream_size,
+                                                        int64_t output_stream_size, int64_t output_channel_size,
+                                                        bool stream) {
+                int64_t stream_threads = 1;  // We can try to parallelise along the stream dimension...
+                int64_t batch_threads = 1;   // ...and along the batch dimension.
+                if (!is_cuda) {
+                    // If we're on the CPU then we can try parallelising over PyTorch's intra-op thread pool
+                    if (batch_size * output_stream_size * output_channel_size < 81899) {
+                        // Don't use parallelism if the problem is small.
+                        // The magic number 81899 was chosen as being roughly the point at which the small/large
+                        // threshold is crossed. (81899 = batch size 1 * stream size 4096 *
+                        // signature_channels(channels 4, depth 2) - 1, false)
+                        stream_threads = 1;
+                        batch_threads = 1;
+                    }
+                    else {
+                        // We want to parallelise across the batch dimension first, as that's most efficient.
+                        batch_threads = std::min(batch_size, misc::max_threads());
+
+                        if (stream) {
+                            // Can't parallelise along the stream dimension in this inherently-serial case.
+                            stream_threads = 1;
+                        }
+                        else {
+                            stream_threads = (misc::max_threads() + batch_threads - 1) / batch_threads;
+                            stream_threads = std::min(stream_threads,
+                                                      static_cast<int64_t>(std::sqrt(input_stream_size)));
+                            // Don't want to cut the stream dimension _too_ small, or we'll lose the benefits of the
+                            // fused mult-restricted-exp operation
+                            stream_threads = std::min(stream_threads, (input_stream_size + 2) / 3);
+                        }
+                    }
+                }
+                return std::tuple<int64_t, int64_t> {stream_threads, batch_threads};
+            }
+
+            // Computes the signature with stream==true via a parallel scan.
+            //
+            // The computation with stream==true is inherently serial along the stream dimension: each signature is
+            // computed from the previous one. However by Chen's identity, we can instead split the stream up into
+            // chunks and compute the signatures of each chunk independently, and then combine them together afterwards.
+            // That is, the signature at each stream index is (the signature of everything in previous chunks) \otimes
+            // (the signature of the current chunk up to the current stream index).
+            //
+            // We do this by moving the chunks into the batch dimension, so that the independent part of the computation
+            // is a single ordinary signature computation, and is parallelised along the batch dimension in the usual
+            // way. (By the intra-op thread pool on the CPU, or by the GPU kernels.) The signatures at the end of each
+            // chunk are then combined serially, which is cheap as there are only a few chunks, and finally every
+            // signature is multiplied by its chunk's prefix in one large (parallel) operation.
+            //
+            // 'signature' should be the (stream, batch, signature_channel) output, without the scalar term.
+            // 'initial_value' is only used if initial==true, and similarly should not include the scalar term.
+            // 'workspace' may be nullptr.
+            void signature_forward_scan(torch::Tensor path_increments, torch::Tensor reciprocals,
+                                        torch::Tensor signature, bool inverse, bool initial,
+                                        torch::Tensor initial_value, s_size_type depth, int64_t scan_chunks,
+                                        workspace::Workspace* workspace) {
+                SIGNATORY_PROFILE_STAGE("signature_forward_scan");
+                int64_t output_stream_size = path_increments.size(stream_dim);
+                int64_t batch_size = path_increments.size(batch_dim);
+                int64_t input_channel_size = path_increments.size(channel_dim);
+                int64_t output_channel_size = signature.size(channel_dim);
+                int64_t chunk_size = (output_stream_size + scan_chunks - 1) / scan_chunks;
+                int64_t chunked_batch_size = scan_chunks * batch_size;
+                torch::TensorOptions opts = path_increments.options();
+
+                // Lay the chunks out along the batch dimension. The final chunk is padded with zero increments, which
+                // leave the signature unchanged.
+                torch::Tensor padded_increments = workspace::empty(workspace, "scan_padded_increments",
+                                                                   {scan_chunks * chunk_size, batch_size,
+                                                                    input_channel_size}, opts);
+                padded_increments.narrow(/*dim=*/0, /*start=*/0, /*length=*/output_stream_size).copy_(path_increments);
+                padded_increments.narrow(/*dim=*/0, /*start=*/output_stream_size,
+                                         /*length=*/scan_chunks * chunk_size - output_stream_size).zero_();
+                torch::Tensor chunked_increments = workspace::empty(workspace, "scan_chunked_increments",
+                                                                    {chunk_size, chunked_batch_size,
+                                                                     input_channel_size}, opts);
+                chunked_increments.view({chunk_size, scan_chunks, batch_size, input_channel_size})
+                                  .copy_(padded_increments.view({scan_chunks, chunk_size, batch_size,
+                                                                 input_channel_size}).transpose(0, 1));
+
+                // Compute the signature of each chunk
+                torch::Tensor chunked_signature = workspace::empty(workspace, "scan_chunked_signature",
+                                                                   {chunk_size, chunked_batch_size,
+                                                                    output_channel_size}, opts);
+                std::vector<torch::Tensor> chunked_signature_by_term;
+                std::vector<torch::Tensor> chunked_signature_by_term_at_stream;
+                misc::slice_by_term(chunked_signature, chunked_signature_by_term, input_channel_size, depth);
+                misc::slice_by_term(chunked_signature[0], chunked_signature_by_term_at_stream, input_channel_size,
+                                    depth);
+                ta_ops::restricted_exp(chunked_increments[0], chunked_signature_by_term_at_stream, reciprocals);
+                #ifdef SIGNATORY_CUDA
+                if (chunked_increments.is_cuda() &&
+                    ta_ops::detail::mult_fused_restricted_exp_stream_cuda_kernel_supported(chunked_increments,
+                                                                                           chunked_signature,
+                                                                                           depth)) {
+                    ta_ops::detail::mult_fused_restricted_exp_stream_cuda_kernel(chunked_increments, chunked_signature,
+                                                                                 /*stream=*/true, inverse,
+                                                                                 reciprocals, depth, /*start=*/1,
+                                                                                 /*end=*/chunk_size);
+                }
+                else
+                #endif
+                {
+                    int64_t batch_threads = 1;
+                    if (!chunked_increments.is_cuda()) {
+                        batch_threads = std::min(chunked_batch_size, misc::max_threads());
+                    }
+                    signature_forward_inner(chunked_increments, reciprocals, chunked_signature,
+                                            chunked_signature_by_term, chunked_signature_by_term_at_stream, inverse,
+                                            /*stream=*/true, /*start=*/1, /*end=*/chunk_size, batch_threads);
+                }
+
+                // Compute the signature of everything before each chunk. These are cheap serial operations as there's
+                // only a few chunks.
+                torch::Tensor prefixes = workspace::empty(workspace, "scan_prefixes",
+                                                          {scan_chunks, batch_size, output_channel_size}, opts);
+                if (initial) {
+                    prefixes[0].copy_(initial_value);
+                }
+                else {
+                    // zero corresponds to the signature of the trivial path
+                    prefixes[0].zero_();
+                }
+                torch::Tensor chunk_ends = chunked_signature[chunk_size - 1].view({scan_chunks, batch_size,
+                                                                                  output_channel_size});
+                int64_t prefix_threads = 1;
+                if (!chunked_increments.is_cuda()) {
+                    prefix_threads = std::min(batch_size, misc::max_threads());
+                }
+                for (int64_t chunk_index = 1; chunk_index < scan_chunks; ++chunk_index) {
+                    prefixes[chunk_index].copy_(prefixes[chunk_index - 1]);
+                    std::vector<torch::Tensor> prefix_by_term;
+                    std::vector<torch::Tensor> chunk_end_by_term;
+                    misc::slice_by_term(prefixes[chunk_index], prefix_by_term, input_channel_size, depth);
+                    misc::slice_by_term(chunk_ends[chunk_index - 1], chunk_end_by_term, input_channel_size, depth);
+                    ta_ops::mult(prefix_by_term, chunk_end_by_term, inverse, prefix_threads);
+                }
+
+                // Combine every signature with the prefix for its chunk, all at once.
+                int64_t rows = chunk_size * chunked_batch_size;
+                torch::Tensor result = workspace::empty(workspace, "scan_result", {rows, output_channel_size}, opts);
+                result.view({chunk_size, scan_chunks, batch_size, output_channel_size}).copy_(prefixes.unsqueeze(0));
+                std::vector<torch::Tensor> result_by_term;
+                std::vector<torch::Tensor> chunked_signature_rows_by_term;
+                misc::slice_by_term(result, result_by_term, input_channel_size, depth);
+                misc::slice_by_term(chunked_signature.view({rows, output_channel_size}),
+                                    chunked_signature_rows_by_term, input_channel_size, depth);
+                int64_t rows_threads = 1;
+                if (!chunked_increments.is_cuda()) {
+                    rows_threads = std::min(rows, misc::max_threads());
+                }
+                ta_ops::mult(result_by_term, chunked_signature_rows_by_term, inverse, rows_threads);
+
+                // Move the chunks back out of the batch dimension, and into the output
+                result = result.view({chunk_size, scan_chunks, batch_size, output_channel_size});
+                for (int64_t chunk_index = 0; chunk_index < scan_chunks; ++chunk_index) {
+                    int64_t start = chunk_index * chunk_size;
+                    int64_t length = std::min(chunk_size, output_stream_size - start);
+                    if (length <= 0) {
+                        break;
+                    }
+                    signature.narrow(/*dim=*/stream_dim, /*start=*/start, /*length=*/length).copy_(
+                            result.select(/*dim=*/1, /*index=*/chunk_index).narrow(/*dim=*/0, /*start=*/0,
+                                                                                  /*length=*/length));
+                }
+            }
+
+            int64_t stream_block_size(int64_t output_stream_size, int64_t batch_size, int64_t output_channel_size) {
+                // The magic number is 32MB worth of doubles.
+                constexpr int64_t max_block_elements = 1 << 22;
+                int64_t block_size = max_block_elements / (batch_size * output_channel_size);
+                return std::max(static_cast<int64_t>(1), std::min(block_size, output_stream_size));
+            }
+
+            torch::Tensor signature_stream_blocks(torch::Tensor path_increments, torch::Tensor reciprocals,
+                                                  bool inverse, bool initial, torch::Tensor initial_value,
+                                                  s_size_type depth, int64_t block_size,
+                                                  workspace::Workspace* workspace,
+                                                  const std::function<void(int64_t, torch::Tensor)>& block_fn) {
+                int64_t output_stream_size = path_increments.size(stream_dim);
+                int64_t batch_size = path_increments.size(batch_dim);
+                int64_t input_channel_size = path_increments.size(channel_dim);
+                int64_t output_channel_size = signature_channels(input_channel_size, depth, false);
+                int64_t batch_threads;
+                std::tie(std::ignore, batch_threads) = choose_threads(path_increments.is_cuda(), batch_size,
+                                                                      output_stream_size + 1, output_stream_size,
+                                                                      output_channel_size, /*stream=*/true);
+
+                torch::Tensor signature_block = workspace::empty(workspace, "stream_signature_block",
+                                                                 {block_size, batch_size, output_channel_size},
+                                                                 path_increments.options());
+
+                std::vector<torch::Tensor> signature_by_term_at_stream;
+                for (int64_t block_start = 0; block_start < output_stream_size; block_start += block_size) {
+                    int64_t block_length = std::min(block_size, output_stream_size - block_start);
+
+                    // Compute the signatures of the partial paths in this block, each one from the one before.
+                    for (int64_t block_index = 0; block_index < block_length; ++block_index) {
+                        int64_t stream_index = block_start + block_index;
+                        misc::slice_by_term(signature_block[block_index], signature_by_term_at_stream,
+                                            input_channel_size, depth);
+                        if (stream_index == 0) {
+                            if (initial) {
+                                signature_block[0].copy_(initial_value);
+                                ta_ops::mult_fused_restricted_exp(path_increments[0], signature_by_term_at_stream,
+                                                                  inverse, reciprocals, batch_threads);
+                            }
+                            else {
+                                ta_ops::restricted_exp(path_increments[0], signature_by_term_at_stream, reciprocals);
+                            }
+                        }
+                        else {
+                            // At the start of a block this copies in the last signature of the previous block, which
+                            // was necessarily a full one.
+                            signature_block[block_index].copy_(signature_block[block_index == 0 ? block_size - 1
+                                                                                                : block_index - 1]);
+                            ta_ops::mult_fused_restricted_exp(path_increments[stream_index],
+                                                              signature_by_term_at_stream, inverse, reciprocals,
+                                                              batch_threads);
+                        }
+                    }
+
+                    block_fn(block_start, signature_block.narrow(/*dim=*/0, /*start=*/0, /*length=*/block_length));
+                }
+
+                // The signature of the whole path is the last thing we computed. Clone it as it's workspace memory.
+                return signature_block[(output_stream_size - 1) % block_size].clone();
+            }
+
+            std::tuple<torch::Tensor, torch::Tensor>
+            signature_stream_blocks_backward(torch::Tensor signature, torch::Tensor path_increments,
+                                             torch::Tensor reciprocals, bool inverse, bool initial, s_size_type depth,
+                                             int64_t block_size, workspace::Workspace* workspace,
+                                             const std::function<void(int64_t, torch::Tensor, torch::Tensor)>&
+                                             block_fn) {
+                int64_t output_stream_size = path_increments.size(stream_dim);
+                int64_t batch_size = signature.size(batch_dim);
+                int64_t input_channel_size = path_increments.size(channel_dim);
+                int64_t output_channel_size = signature.size(channel_dim);
+                torch::TensorOptions opts = signature.options();
+                int64_t batch_threads;
+                std::tie(std::ignore, batch_threads) = choose_threads(signature.is_cuda(), batch_size,
+                                                                      output_stream_size + 1, output_stream_size,
+                                                                      output_channel_size, /*stream=*/true);
+
+                torch::Tensor signature_block = workspace::empty(workspace, "stream_signature_block",
+                                                                 {block_size, batch_size, output_channel_size}, opts);
+                torch::Tensor grad_signature_block = workspace::empty(workspace, "stream_grad_signature_block",
+                                                                      {block_size, batch_size, output_channel_size},
+                                                                      opts);
+
+                // The signature of the partial path up to the end of the previous block. (Which, as we're going
+                // backwards, means the block we're about to consider next.) It starts off as the signature of the
+                // whole path, and at the very end holds the initial value, if there is one.
+                torch::Tensor signature_at_stream = workspace::empty(workspace, "stream_signature",
+                                                                     {batch_size, output_channel_size}, opts);
+                signature_at_stream.copy_(signature);
+                // The gradient with respect to the signature of the partial path we're currently considering. At the
+                // very end this is the gradient with respect to the initial value, so it isn't workspace memory.
+                torch::Tensor grad_signature_at_stream = torch::zeros({batch_size, output_channel_size}, opts);
+                torch::Tensor grad_path_increments = workspace::empty(workspace, "grad_path_increments",
+                                                                      path_increments.sizes(), opts);
+
+                std::vector<torch::Tensor> grad_signature_by_term_at_stream;
+                std::vector<torch::Tensor> signature_by_term_at_stream;
+                misc::slice_by_term(grad_signature_at_stream, grad_signature_by_term_at_stream, input_channel_size,
+                                    depth);
+
+                int64_t last_block_start = ((output_stream_size - 1) / block_size) * block_size;
+                for (int64_t block_start = last_block_start; block_start >= 0; block_start -= block_size) {
+                    int64_t block_length = std::min(block_size, output_stream_size - block_start);
+
+                    // Recompute the signatures of the partial paths in this block, backwards from the last one. This
+                    // uses the reversibility property of the signature, see signature_backward.
+                    signature_block[block_length - 1].copy_(signature_at_stream);
+                    for (int64_t block_index = block_length - 2; block_index >= 0; --block_index) {
+                        signature_block[block_index].copy_(signature_block[block_index + 1]);
+                        misc::slice_by_term(signature_block[block_index], signature_by_term_at_stream,
+                                            input_channel_size, depth);
+                        ta_ops::mult_fused_restricted_exp(-path_increments[block_start + block_index + 1],
+                                                          signature_by_term_at_stream, inverse, reciprocals,
+                                                          batch_threads);
+                    }
+                    if (block_start > 0 || initial) {
+                        signature_at_stream.copy_(signature_block[0]);
+                        misc::slice_by_term(signature_at_stream, signature_by_term_at_stream, input_channel_size,
+                                            depth);
+                        ta_ops::mult_fused_restricted_exp(-path_increments[block_start], signature_by_term_at_stream,
+                                                          inverse, reciprocals, batch_threads);
+                    }
+
+                    // Find the gradients on the signatures in this block...
+                    torch::Tensor grad_signature_block_narrow = grad_signature_block.narrow(/*dim=*/0, /*start=*/0,
+                                                                                            /*length=*/block_length);
+                    grad_signature_block_narrow.zero_();
+                    block_fn(block_start, signature_block.narrow(/*dim=*/0, /*start=*/0, /*length=*/block_length),
+                             grad_signature_block_narrow);
+
+                    // ...and then go backwards through the computation of those signatures.
+                    for (int64_t block_index = block_length - 1; block_index >= 0; --block_index) {
+                        int64_t stream_index = block_start + block_index;
+                        grad_signature_at_stream += grad_signature_block[block_index];
+                        if (stream_index > 0 || initial) {
+                            torch::Tensor prev = (block_index > 0) ? signature_block[block_index - 1]
+                                                                   : signature_at_stream;
+                            misc::slice_by_term(prev, signature_by_term_at_stream, input_channel_size, depth);
+                            ta_ops::mult_fused_restricted_exp_backward(grad_path_increments[stream_index],
+                                                                       grad_signature_by_term_at_stream,
+                                                                       path_increments[stream_index],
+                                                                       signature_by_term_at_stream,
+                                                                       inverse,
+                                                                       reciprocals,
+                                                                       batch_threads);
+                        }
+                        else {
+                            misc::slice_by_term(signature_block[0], signature_by_term_at_stream, input_channel_size,
+                                                depth);
+                            ta_ops::restricted_exp_backward(grad_path_increments[0],
+                                                            grad_signature_by_term_at_stream,
+                                                            path_increments[0],
+                                                            signature_by_term_at_stream,
+                                                            reciprocals);
+                        }
+                    }
+                }
+
+                return std::tuple<torch::Tensor, torch::Tensor> {grad_path_increments, grad_signature_at_stream};
+            }
+
+            // For each requested level, gives its offset in the signature, its offset in the output, and its size.
+            std::vector<std::tuple<int64_t, int64_t, int64_t>> level_slices(int64_t input_channel_size,
+                                                                            const std::vector<s_size_type>& levels,
+                                                                            bool scalar_term) {
+                std::vector<std::tuple<int64_t, int64_t, int64_t>> slices;
+                slices.reserve(levels.size());
+                int64_t out_offset = scalar_term ? 1 : 0;
+                for (auto level : levels) {
+                    int64_t in_offset = (level == 1) ? 0 : signature_channels(input_channel_size, level - 1, false);
+                    int64_t size = signature_channels(input_channel_size, level, false) - in_offset;
+                    slices.emplace_back(in_offset, out_offset, size);
+                    out_offset += size;
+                }
+                return slices;
+            }
+
+            // Given the (sorted) stream indices, gives the range of them which lie in the block of the stream starting
+            // at block_start of length block_length.
+            std::tuple<int64_t, int64_t> stream_indices_in_block(torch::Tensor stream_indices, int64_t block_start,
+                                                                 int64_t block_length) {
+                const int64_t* begin = stream_indices.data_ptr<int64_t>();
+                const int64_t* end = begin + stream_indices.size(0);
+                const int64_t* lo = std::lower_bound(begin, end, block_start);
+                const int64_t* hi = std::lower_bound(lo, end, block_start + block_length);
+                return std::tuple<int64_t, int64_t> {lo - begin, hi - begin};
+            }
+
+            // Computes the signature of each segment of 'segment_length' path increments, that is to say of
+            // path_increments[segment * segment_length : (segment + 1) * segment_length], for every segment from
+            // first_segment onwards. Both the segments and the batch elements are handled in parallel on the CPU.
+            // Returns a tensor of shape (num_segments, batch, signature_channel), not including the scalar term, which
+            // may be workspace memory. The entries before first_segment are unspecified.
+            torch::Tensor compute_segment_signatures(torch::Tensor path_increments, torch::Tensor reciprocals,
+                                                     bool inverse, s_size_type depth, int64_t segment_length,
+                                                     int64_t num_segments, int64_t first_segment,
+                                                     int64_t segment_threads, int64_t batch_threads,
+                                                     workspace::Workspace* workspace) {
+                int64_t output_stream_size = path_increments.size(stream_dim);
+                int64_t batch_size = path_increments.size(batch_dim);
+                int64_t input_channel_size = path_increments.size(channel_dim);
+                int64_t output_channel_size = signature_channels(input_channel_size, depth, false);
+
+                torch::Tensor segment_signatures = workspace::empty(workspace, "segment_signatures",
+                                                                    {num_segments, batch_size, output_channel_size},
+                                                                    path_increments.options());
+                // Each segment is independent of every other, and so is each batch element, so we tile the
+                // computation over both.
+                int64_t num_batch_blocks = std::max<int64_t>(std::min(batch_threads, batch_size), 1);
+                int64_t num_tiles = (num_segments - first_segment) * num_batch_blocks;
+                misc::parallel_for(num_tiles, segment_threads * num_batch_blocks, [&](int64_t begin, int64_t end) {
+                    std::vector<torch::Tensor> segment_signature_by_term;
+                    for (int64_t tile = begin; tile < end; ++tile) {
+                        int64_t segment = first_segment + tile / num_batch_blocks;
+                        int64_t batch_start;
+                        int64_t batch_length;
+                        std::tie(batch_start, batch_length) = batch_block(batch_size, num_batch_blocks,
+                                                                          tile % num_batch_blocks);
+                        torch::Tensor tile_increments = path_increments.narrow(/*dim=*/batch_dim,
+                                                                               /*start=*/batch_start,
+                                                                               /*length=*/batch_length);
+                        int64_t start = segment * segment_length;
+                        int64_t stop = std::min(start + segment_length, output_stream_size);
+                        misc::slice_by_term(segment_signatures[segment].narrow(/*dim=*/batch_dim,
+                                                                               /*start=*/batch_start,
+                                                                               /*length=*/batch_length),
+                                            segment_signature_by_term, input_channel_size, depth);
+                        ta_ops::restricted_exp(tile_increments[start], segment_signature_by_term, reciprocals);
+                        signature_forward_inner(tile_increments,
+                                                reciprocals,
+                                                torch::Tensor {},               // unused because stream==false
+                                                std::vector<torch::Tensor> {},  // unused because stream==false
+                                                segment_signature_by_term,
+                                                inverse,
+                                                /*stream=*/false,
+                                                /*start=*/start + 1,
+                                                /*end=*/stop,
+                                                /*batch_threads=*/1);
+                    }
+                });
+                return segment_signatures;
+            }
+
+            // The backward pass through a signature computation with stream==false, split up into segments as for
+            // compute_segment_signatures.
+            // 'checkpoints' should be of shape (num_segments, batch, signature_channel), and hold the signature of the
+            // partial path before each segment. (So the first one is the initial value, and is only used if
+            // initial==true.)
+            // 'segment_signatures' should be as returned by compute_segment_signatures. The first segment's isn't
+            // used.
+            // Returns the gradients with respect to the path increments, and with respect to the first checkpoint.
+            // (The latter is only meaningful if initial==true.) Both may be workspace memory.
+            std::tuple<torch::Tensor, torch::Tensor>
+            signature_segments_backward(torch::Tensor grad_signature, torch::Tensor checkpoints,
+                                        torch::Tensor segment_signatures, torch::Tensor path_increments,
+                                        torch::Tensor reciprocals, bool inverse, bool initial, s_size_type depth,
+                                        int64_t segment_length, int64_t segment_threads, int64_t batch_threads,
+                                        workspace::Workspace* workspace) {
+                torch::TensorOptions opts = checkpoints.options();
+                int64_t num_segments = checkpoints.size(0);
+                int64_t batch_size = checkpoints.size(batch_dim);
+                int64_t output_channel_size = checkpoints.size(channel_dim);
+                int64_t input_channel_size = path_increments.size(channel_dim);
+                int64_t output_stream_size = path_increments.size(stream_dim);
+
+                // First of all we need the gradient at the end of each segment. The signature at the end of a segment
+                // is its checkpoint multiplied by the signature of just that segment, so we go backwards through these
+                // multiplications. This is the only serial part of the computation, and it's cheap: just one
+                // mult_backward per segment.
+                torch::Tensor grad_segment_ends = workspace::empty(workspace, "grad_segment_ends",
+                                                                   checkpoints.sizes(), opts);
+                grad_segment_ends[num_segments - 1].copy_(grad_signature);
+                torch::Tensor grad_scratch = workspace::empty(workspace, "grad_segment_scratch",
+                                                              {batch_size, output_channel_size}, opts);
+                std::vector<torch::Tensor> grad_scratch_by_term;
+                std::vector<torch::Tensor> grad_segment_end_by_term;
+                std::vector<torch::Tensor> checkpoint_by_term;
+                std::vector<torch::Tensor> segment_signature_by_term;
+                misc::slice_by_term(grad_scratch, grad_scratch_by_term, input_channel_size, depth);
+                for (int64_t segment = num_segments - 1; segment >= 1; --segment) {
+                    misc::slice_by_term(grad_segment_ends[segment - 1], grad_segment_end_by_term, input_channel_size,
+                                        depth);
+                    misc::slice_by_term(checkpoints[segment], checkpoint_by_term, input_channel_size, depth);
+                    misc::slice_by_term(segment_signatures[segment], segment_signature_by_term, input_channel_size,
+                                        depth);
+                    // grad_scratch gets the (unneeded) gradient with respect to segment_signature.
+                    if (inverse) {
+                        // The signature at the end of this segment is segment_signature \otimes checkpoint
+                        grad_scratch.copy_(grad_segment_ends[segment]);
+                        ta_ops::mult_backward</*add_not_copy=*/false>(grad_scratch_by_term, grad_segment_end_by_term,
+                                                                      segment_signature_by_term, checkpoint_by_term,
+                                                                      batch_threads);
+                    }
+                    else {
+                        // The signature at the end of this segment is checkpoint \otimes segment_signature
+                        grad_segment_ends[segment - 1].copy_(grad_segment_ends[segment]);
+                        ta_ops::mult_backward</*add_not_copy=*/false>(grad_segment_end_by_term, grad_scratch_by_term,
+                                                                      checkpoint_by_term, segment_signature_by_term,
+                                                                      batch_threads);
+                    }
+                }
+
+                // Now every segment is independent of every other. For each one, we recompute the signatures of its
+                // partial paths forwards from its checkpoint, and then go backwards through them. (Rather than
+                // reconstructing them by going backwards through the whole stream, as signature_backward otherwise
+                // does, which accumulates numerical error over long streams.)
+                torch::Tensor grad_path_increments = workspace::empty(workspace, "grad_path_increments",
+                                                                      path_increments.sizes(), opts);
+                int64_t num_batch_blocks = std::max<int64_t>(std::min(batch_threads, batch_size), 1);
+                int64_t num_tiles = num_segments * num_batch_blocks;
+                misc::parallel_for(num_tiles, segment_threads * num_batch_blocks, [&](int64_t begin, int64_t end) {
+                    std::vector<torch::Tensor> signature_by_term_at_stream;
+                    std::vector<torch::Tensor> grad_signature_by_term_at_stream;
+                    for (int64_t tile = begin; tile < end; ++tile) {
+                        int64_t segment = tile / num_batch_blocks;
+                        int64_t start = segment * segment_length;
+                        int64_t length = std::min(segment_length, output_stream_size - start);
+                        bool from_checkpoint = segment > 0 || initial;
+
+                        int64_t batch_start;
+                        int64_t batch_length;
+                        std::tie(batch_start, batch_length) = batch_block(batch_size, num_batch_blocks,
+                                                                          tile % num_batch_blocks);
+                        torch::Tensor tile_increments = path_increments.narrow(/*dim=*/batch_dim,
+                                                                               /*start=*/batch_start,
+                                                                               /*length=*/batch_length);
+                        torch::Tensor tile_grad_increments = grad_path_increments.narrow(/*dim=*/batch_dim,
+                                                                                         /*start=*/batch_start,
+                                                                                         /*length=*/batch_length);
+                        torch::Tensor tile_checkpoint = checkpoints[segment].narrow(/*dim=*/batch_dim,
+                                                                                    /*start=*/batch_start,
+                                                                                    /*length=*/batch_length);
+
+                        // Named after the thread rather than the tile, so that only as many of these are allocated as
+                        // there are threads.
+                        torch::Tensor segment_stream = workspace::empty(workspace,
+                                                                        "segment_stream_" +
+                                                                        std::to_string(at::get_thread_num()),
+                                                                        {length, batch_length, output_channel_size},
+                                                                        opts);
+
+                        misc::slice_by_term(segment_stream[0], signature_by_term_at_stream, input_channel_size, depth);
+                        if (from_checkpoint) {
+                            segment_stream[0].copy_(tile_checkpoint);
+                            ta_ops::mult_fused_restricted_exp(tile_increments[start], signature_by_term_at_stream,
+                                                              inverse, reciprocals);
+                        }
+                        else {
+                            ta_ops::restricted_exp(tile_increments[start], signature_by_term_at_stream, reciprocals);
+                        }
+                        // The signature at the end of the segment isn't needed, so we stop one short.
+                        for (int64_t index = 1; index < length - 1; ++index) {
+                            segment_stream[index].copy_(segment_stream[index - 1]);
+                            misc::slice_by_term(segment_stream[index], signature_by_term_at_stream,
+                                                input_channel_size, depth);
+                            ta_ops::mult_fused_restricted_exp(tile_increments[start + index],
+                                                              signature_by_term_at_stream, inverse, reciprocals);
+                        }
+
+                        misc::slice_by_term(grad_segment_ends[segment].narrow(/*dim=*/batch_dim,
+                                                                              /*start=*/batch_start,
+                                                                              /*length=*/batch_length),
+                                            grad_signature_by_term_at_stream, input_channel_size, depth);
+                        for (int64_t index = length - 1; index >= 1; --index) {
+                            misc::slice_by_term(segment_stream[index - 1], signature_by_term_at_stream,
+                                                input_channel_size, depth);
+                            ta_ops::mult_fused_restricted_exp_backward(tile_grad_increments[start + index],
+                                                                       grad_signature_by_term_at_stream,
+                                                                       tile_increments[start + index],
+                                                                       signature_by_term_at_stream,
+                                                                       inverse,
+                                                                       reciprocals);
+                        }
+                        if (from_checkpoint) {
+                            misc::slice_by_term(tile_checkpoint, signature_by_term_at_stream, input_channel_size,
+                                                depth);
+                            ta_ops::mult_fused_restricted_exp_backward(tile_grad_increments[start],
+                                                                       grad_signature_by_term_at_stream,
+                                                                       tile_increments[start],
+                                                                       signature_by_term_at_stream,
+                                                                       inverse,
+                                                                       reciprocals);
+                        }
+                        else {
+                            misc::slice_by_term(segment_stream[0], signature_by_term_at_stream, input_channel_size,
+                                                depth);
+                            ta_ops::restricted_exp_backward(tile_grad_increments[start],
+                                                            grad_signature_by_term_at_stream,
+                                                            tile_increments[start],
+                                                            signature_by_term_at_stream,
+                                                            reciprocals);
+                        }
+                    }
+                });
+
+                // At this point grad_segment_ends[0] holds the gradient with respect to the first checkpoint.
+                return std::tuple<torch::Tensor, torch::Tensor> {grad_path_increments, grad_segment_ends[0]};
+            }
+
+            // Computes the signature and the inverse signature of every partial path, as signature_and_inverse_forward
+            // does. 'signature' and 'inverse_signature' should be of shape (stream, batch, channel), not including the
+            // scalar term, with the same strides as each other, and with their values at stream index 0 already set
+            // to the initial value (or zero, if there isn't one), before 'path_increments[0]' is included.
+            void signature_and_inverse_stream(torch::Tensor path_increments, torch::Tensor reciprocals,
+                                              torch::Tensor signature, torch::Tensor inverse_signature,
+                                              s_size_type depth) {
+                int64_t output_stream_size = path_increments.size(stream_dim);
+                int64_t batch_size = path_increments.size(batch_dim);
+                int64_t input_channel_size = path_increments.size(channel_dim);
+                int64_t output_channel_size = signature.size(channel_dim);
+
+                #ifdef SIGNATORY_CUDA
+                if (path_increments.is_cuda() &&
+                    ta_ops::detail::mult_fused_restricted_exp_stream_cuda_kernel_supported(path_increments, signature,
+                                                                                           depth) &&
+                    ta_ops::detail::mult_fused_restricted_exp_stream_cuda_kernel_supported(path_increments,
+                                                                                           inverse_signature, depth)) {
+                    ta_ops::detail::mult_fused_restricted_exp_and_inverse_stream_cuda_kernel(path_increments,
+                                                                                             signature,
+                                                                                             inverse_signature,
+                                                                                             reciprocals, depth,
+                                                                                             /*start=*/0,
+                                                                                             output_stream_size);
+                    return;
+                }
+                #endif
+
+                // This is inherently serial along the stream dimension, so we only parallelise along the batch
+                // dimension.
+                int64_t batch_threads;
+                std::tie(std::ignore, batch_threads) = choose_threads(path_increments.is_cuda(), batch_size,
+                                                                      output_stream_size + 1, output_stream_size,
+                                                                      output_channel_size, /*stream=*/true);
+
+                std::vector<torch::Tensor> signature_by_term;
+                std::vector<torch::Tensor> inverse_signature_by_term;
+                std::vector<torch::Tensor> signature_by_term_at_stream;
+                std::vector<torch::Tensor> inverse_signature_by_term_at_stream;
+                misc::slice_by_term(signature, signature_by_term, input_channel_size, depth);
+                misc::slice_by_term(inverse_signature, inverse_signature_by_term, input_channel_size, depth);
+                for (int64_t stream_index = 0; stream_index < output_stream_size; ++stream_index) {
+                    if (stream_index > 0) {
+                        signature[stream_index].copy_(signature[stream_index - 1]);
+                        inverse_signature[stream_index].copy_(inverse_signature[stream_index - 1]);
+                    }
+                    misc::slice_at_stream(signature_by_term, signature_by_term_at_stream, stream_index);
+                    misc::slice_at_stream(inverse_signature_by_term, inverse_signature_by_term_at_stream,
+                                          stream_index);
+                    ta_ops::mult_fused_restricted_exp_and_inverse(path_increments[stream_index],
+                                                                  signature_by_term_at_stream,
+                                                                  inverse_signature_by_term_at_stream,
+                                                                  reciprocals,
+                                                                  batch_threads);
+                }
+            }
+
+            // Whether tensors of this dtype are stored at reduced precision. The signature computations themselves are
+            // not performed at this precision: the products of the many small increments of a path lose far too much
+            // accuracy. Instead they are performed in float32, and only the inputs and outputs are kept in this dtype.
+            bool is_reduced_precision(torch::ScalarType dtype) {
+                return dtype == torch::kFloat16 || dtype == torch::kBFloat16;
+            }
+
+            // Computes the signature of every partial path, as signature_forward does with stream==true, from
+            // float32 'path_increments', and returns them in a tensor of dtype 'storage_dtype'. The computation is
+            // performed a block at a time via signature_stream_blocks, so that only one block of the stream of
+            // signatures is ever held at full precision; this is what makes the memory saving of a reduced precision
+            // dtype actually happen.
+            // 'initial_value' should not include the scalar term. The returned tensor does include it, if
+            // scalar_term==true.
+            torch::Tensor signature_stream_reduced_precision(torch::Tensor path_increments, torch::Tensor reciprocals,
+                                                             bool inverse, bool initial, torch::Tensor initial_value,
+                                                             bool scalar_term, s_size_type depth,
+                                                             torch::ScalarType storage_dtype,
+                                                             workspace::Workspace* workspace) {
+                int64_t output_stream_size = path_increments.size(stream_dim);
+                int64_t batch_size = path_increments.size(batch_dim);
+                int64_t output_channel_size = signature_channels(path_increments.size(channel_dim), depth, false);
+                int64_t output_channel_size_with_scalar = scalar_term ? (output_channel_size + 1)
+                                                                      : output_channel_size;
+
+                torch::Tensor signature_with_scalar = torch::empty({output_stream_size, batch_size,
+                                                                    output_channel_size_with_scalar},
+                                                                   path_increments.options().dtype(storage_dtype));
+                torch::Tensor signature = signature_with_scalar;
+                if (scalar_term) {
+                    signature.narrow(/*dim=*/channel_dim, /*start=*/0, /*length=*/1) = 1;
+                    signature = signature.narrow(/*dim=*/channel_dim, /*start=*/1, /*length=*/output_channel_size);
+                }
+
+                int64_t block_size = stream_block_size(output_stream_size, batch_size, output_channel_size);
+                signature_stream_blocks(path_increments, reciprocals, inverse, initial, initial_value, depth,
+                                        block_size, workspace,
+                                        [&signature](int64_t block_start, torch::Tensor block) {
+                                            signature.narrow(/*dim=*/stream_dim, /*start=*/block_start,
+                                                             /*length=*/block.size(stream_dim)).copy_(block);
+                                        });
+                return signature_with_scalar;
+            }
+
+            // Packed paths, as used by signature_packed_forward, are laid out as a torch.nn.utils.rnn.PackedSequence:
+            // 'data' is of shape (points, channel), and holds the points at stream index 0 of every batch element,
+            // then the points at stream index 1 of every batch element still that long, and so on. The batch
+            // elements are sorted by decreasing length, so that batch_sizes[stream_index] is the number of batch
+            // elements at least stream_index + 1 points long, and these are always the first ones.
+            //
+            // Returns the offset into 'data' of each stream index, with one extra element at the end giving the total
+            // number of points.
+            std::vector<int64_t> packed_offsets(torch::Tensor batch_sizes) {
+                auto batch_sizes_a = batch_sizes.accessor<int64_t, 1>();
+                std::vector<int64_t> offsets (batch_sizes.size(0) + 1, 0);
+                for (int64_t stream_index = 0; stream_index < batch_sizes.size(0); ++stream_index) {
+                    offsets[stream_index + 1] = offsets[stream_index] + batch_sizes_a[stream_index];
+                }
+                return offsets;
+            }
+
+            // For every point of a packed path after stream index 0, the row of 'data' holding the previous point of
+            // the same batch element.
+            torch::Tensor packed_previous_rows(torch::Tensor batch_sizes, const std::vector<int64_t>& offsets,
+                                               torch::Device device) {
+                auto batch_sizes_a = batch_sizes.accessor<int64_t, 1>();
+                torch::Tensor previous_rows = torch::empty({offsets.back() - offsets[1]}, torch::dtype(torch::kInt64));
+                auto previous_rows_a = previous_rows.accessor<int64_t, 1>();
+                for (int64_t stream_index = 1; stream_index < batch_sizes.size(0); ++stream_index) {
+                    for (int64_t batch_index = 0; batch_index < batch_sizes_a[stream_index]; ++batch_index) {
+                        previous_rows_a[offsets[stream_index] - offsets[1] + batch_index] = offsets[stream_index - 1] +
+                                                                                            batch_index;
+                    }
+                }
+                return previous_rows.to(device);
+            }
+
+            // As compute_path_increments, for a packed path. The result has the same layout as 'data', with each row
+            // holding the increment into the corresponding point. The increments into the points at stream index 0
+            // are from the basepoint if basepoint==true, and are zero otherwise.
+            torch::Tensor compute_packed_increments(torch::Tensor data, const std::vector<int64_t>& offsets,
+                                                    torch::Tensor previous_rows, bool basepoint,
+                                                    torch::Tensor basepoint_value, bool inverse) {
+                int64_t first_size = offsets[1];
+                int64_t rest_size = data.size(0) - first_size;
+                torch::Tensor packed_increments = torch::empty_like(data);
+                torch::Tensor first_increments = packed_increments.narrow(/*dim=*/0, /*start=*/0,
+                                                                          /*length=*/first_size);
+                if (basepoint) {
+                    first_increments.copy_(data.narrow(/*dim=*/0, /*start=*/0, /*length=*/first_size));
+                    first_increments -= basepoint_value;
+                }
+                else {
+                    first_increments.zero_();
+                }
+                torch::Tensor rest_increments = packed_increments.narrow(/*dim=*/0, /*start=*/first_size,
+                                                                         /*length=*/rest_size);
+                rest_increments.copy_(data.narrow(/*dim=*/0, /*start=*/first_size, /*length=*/rest_size));
+                rest_increments -= data.index_select(/*dim=*/0, previous_rows);
+                if (inverse) {
+                    packed_increments.neg_();
+                }
+                return packed_increments;
+            }
+
+            // The backward pass through compute_packed_increments.
+            // Returns the gradients for the original data, and for the basepoint.
+            std::tuple<torch::Tensor, torch::Tensor>
+            compute_packed_increments_backward(torch::Tensor grad_packed_increments,
+                                               const std::vector<int64_t>& offsets, torch::Tensor previous_rows,
+                                               bool basepoint, bool inverse) {
+                int64_t first_size = offsets[1];
+                int64_t rest_size = grad_packed_increments.size(0) - first_size;
+                torch::Tensor grad_data = inverse ? -grad_packed_increments : grad_packed_increments.clone();
+                torch::Tensor grad_first = grad_data.narrow(/*dim=*/0, /*start=*/0, /*length=*/first_size);
+                torch::Tensor grad_basepoint_value;
+                if (basepoint) {
+                    grad_basepoint_value = -grad_first;
+                }
+                else {
+                    grad_first.zero_();
+                    // no second return value in this case
+                    grad_basepoint_value = torch::empty({0}, grad_data.options());
+                }
+                grad_data.index_add_(/*dim=*/0, previous_rows,
+                                     -grad_data.narrow(/*dim=*/0, /*start=*/first_size, /*length=*/rest_size));
+                return std::tuple<torch::Tensor, torch::Tensor> {grad_data, grad_basepoint_value};
+            }
+
+            // Splits the batch elements of a packed path into 'num_blocks' contiguous blocks, each containing roughly
+            // the same number of points. (Rather than the same number of batch elements, which would give the threads
+            // handling the longest batch elements far more work than the others.) Returns the num_blocks + 1
+            // boundaries of the blocks.
+            std::vector<int64_t> packed_batch_blocks(torch::Tensor batch_sizes, int64_t num_blocks) {
+                auto batch_sizes_a = batch_sizes.accessor<int64_t, 1>();
+                int64_t batch_size = batch_sizes_a[0];
+                int64_t num_points = 0;
+                std::vector<int64_t> lengths (batch_size, 0);
+                for (int64_t stream_index = 0; stream_index < batch_sizes.size(0); ++stream_index) {
+                    num_points += batch_sizes_a[stream_index];
+                    lengths[batch_sizes_a[stream_index] - 1] = stream_index + 1;
+                }
+                // Every batch element is at least as long as the ones after it
+                for (int64_t batch_index = batch_size - 2; batch_index >= 0; --batch_index) {
+                    lengths[batch_index] = std::max(lengths[batch_index], lengths[batch_index + 1]);
+                }
+
+                std::vector<int64_t> boundaries (num_blocks + 1, batch_size);
+                boundaries[0] = 0;
+                int64_t block = 1;
+                int64_t points_so_far = 0;
+                for (int64_t batch_index = 0; batch_index < batch_size && block < num_blocks; ++batch_index) {
+                    points_so_far += lengths[batch_index];
+                    while (block < num_blocks && points_so_far * num_blocks >= block * num_points) {
+                        boundaries[block] = batch_index + 1;
+                        ++block;
+                    }
+                }
+                return boundaries;
+            }
         }  // namespace signatory::signature::detail
     }  // namespace signatory::signature
 
+    void signature_levels_checkargs(const std::vector<s_size_type>& levels, s_size_type depth) {
+        if (levels.size() == 0) {
+            throw std::invalid_argument("Argument 'levels' must contain at least one level.");
+        }
+        for (s_size_type index = 0; index < static_cast<s_size_type>(levels.size()); ++index) {
+            if (levels[index] < 1 || levels[index] > depth) {
+                throw std::invalid_argument("Argument 'levels' must only contain levels between 1 and 'depth' "
+                                            "inclusive.");
+            }
+            if (index > 0 && levels[index] <= levels[index - 1]) {
+                throw std::invalid_argument("Argument 'levels' must be in strictly increasing order.");
+            }
+        }
+    }
+
+    void signature_stream_indices_checkargs(torch::Tensor stream_indices, int64_t output_stream_size) {
+        if (stream_indices.ndimension() != 1) {
+            throw std::invalid_argument("Argument 'stream' must be one-dimensional when given as indices.");
+        }
+        if (stream_indices.scalar_type() != torch::kInt64 || stream_indices.is_cuda()) {
+            throw std::invalid_argument("Argument 'stream' must be a CPU tensor of dtype int64 when given as indices.");
+        }
+        if (stream_indices.size(0) == 0) {
+            throw std::invalid_argument("Argument 'stream' must contain at least one index.");
+        }
+        stream_indices = stream_indices.contiguous();
+        const int64_t* data = stream_indices.data_ptr<int64_t>();
+        for (int64_t index = 0; index < stream_indices.size(0); ++index) {
+            if (data[index] < 0 || data[index] >= output_stream_size) {
+                throw std::invalid_argument("Argument 'stream' must only contain indices between 0 and " +
+                                            std::to_string(output_stream_size - 1) + " inclusive.");
+            }
+            if (index > 0 && data[index] <= data[index - 1]) {
+                throw std::invalid_argument("Argument 'stream' must contain indices in strictly increasing order.");
+            }
+        }
+    }
+
     void signature_checkargs(torch::Tensor path, s_size_type depth, bool basepoint, torch::Tensor basepoint_value,
-                             bool initial, torch::Tensor initial_value, bool scalar_term) {
+                             bool initial, torch::Tensor initial_value, bool scalar_term, bool time, bool lead_lag) {
         if (path.ndimension() == 2) {
             // Friendlier help message for a common mess-up.
             throw std::invalid_argument("Argument 'path' must be a 3-dimensional tensor, with dimensions "
@@ -242,7 +1185,8 @@ namespace signatory {
                 throw std::invalid_argument("Argument 'initial' must be a 2-dimensional tensor, corresponding to "
                                             "(batch, signature_channels) respectively.");
             }
-            if (initial_value.size(channel_dim) != signature_channels(path.size(channel_dim), depth, scalar_term) ||
+            int64_t input_channel_size = signature::detail::augmented_channels(path.size(channel_dim), time, lead_lag);
+            if (initial_value.size(channel_dim) != signature_channels(input_channel_size, depth, scalar_term) ||
                 initial_value.size(batch_dim) != path.size(batch_dim)) {
                 throw std::invalid_argument("Argument 'initial' must have correctly sized batch and channel "
                                             "dimensions.");
@@ -257,11 +1201,33 @@ namespace signatory {
     }
 
     std::tuple<torch::Tensor, torch::Tensor>
-    signature_forward(torch::Tensor path, s_size_type depth, bool stream, bool basepoint, torch::Tensor basepoint_value,
-                      bool inverse, bool initial, torch::Tensor initial_value, bool scalar_term) {
-        signature_checkargs(path, depth, basepoint, basepoint_value, initial, initial_value, scalar_term);
+    signature_forward_impl(torch::Tensor path, s_size_type depth, bool stream, bool basepoint,
+                           torch::Tensor basepoint_value, bool inverse, bool initial, torch::Tensor initial_value,
+                           bool scalar_term, bool time, bool lead_lag, workspace::Workspace* workspace) {
+        signature_checkargs(path, depth, basepoint, basepoint_value, initial, initial_value, scalar_term, time,
+                            lead_lag);
 
-        py::gil_scoped_release release;
+        torch::ScalarType storage_dtype = path.scalar_type();
+        bool reduced_precision = signature::detail::is_reduced_precision(storage_dtype);
+        if (reduced_precision && !stream) {
+            // The result is small, so we just compute it in float32 and convert at the end. (The stream==true case is
+            // handled below.)
+            torch::Tensor signature_with_scalar;
+            torch::Tensor path_increments;
+            std::tie(signature_with_scalar, path_increments) = signature_forward_impl(path.to(torch::kFloat32),
+                                                                                      depth, stream, basepoint,
+                                                                                      basepoint_value.to(
+                                                                                              torch::kFloat32),
+                                                                                      inverse, initial,
+                                                                                      initial_value.to(
+                                                                                              torch::kFloat32),
+                                                                                      scalar_term, time, lead_lag,
+                                                                                      workspace);
+            return std::tuple<torch::Tensor, torch::Tensor> {signature_with_scalar.to(storage_dtype),
+                                                             path_increments};
+        }
+
+        SIGNATORY_PROFILE_STAGE("signature_forward");
 
         // No sense keeping track of gradients when we have a dedicated backwards function (and in-place operations mean
         // that in any case one cannot autograd through this function)
@@ -269,23 +1235,40 @@ namespace signatory {
         basepoint_value = basepoint_value.detach();
         initial_value = initial_value.detach();
 
+        if (reduced_precision) {
+            path = path.to(torch::kFloat32);
+            basepoint_value = basepoint_value.to(torch::kFloat32);
+            initial_value = initial_value.to(torch::kFloat32);
+        }
+
         if (scalar_term && initial) {
             initial_value = initial_value.narrow(/*dim=*/channel_dim, /*start=*/1,
                                                  /*length=*/initial_value.size(channel_dim) - 1);
         }
 
-        // Some constants to pass around
+        // Compute path increments. Obviously. (Of the augmented path, if we're augmenting it.)
+        torch::Tensor path_increments = signature::detail::compute_augmented_path_increments(path, basepoint,
+                                                                                             basepoint_value, inverse,
+                                                                                             time, lead_lag);
+
+        // Some constants to pass around. These describe the augmented path, if we're augmenting it.
         int64_t batch_size = path.size(batch_dim);
-        int64_t input_stream_size = path.size(stream_dim);
-        int64_t input_channel_size = path.size(channel_dim);
-        int64_t output_stream_size = path.size(stream_dim) - (basepoint ? 0 : 1);
+        int64_t output_stream_size = path_increments.size(stream_dim);
+        int64_t input_stream_size = basepoint ? output_stream_size : (output_stream_size + 1);
+        int64_t input_channel_size = path_increments.size(channel_dim);
         int64_t output_channel_size = signature_channels(input_channel_size, depth, false);
         torch::TensorOptions opts = path.options();
-        torch::Tensor reciprocals = misc::make_reciprocals(depth, opts);
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
 
-        // Compute path increments. Obviously.
-        torch::Tensor path_increments = signature::detail::compute_path_increments(path, basepoint, basepoint_value,
-                                                                                   inverse);
+        if (reduced_precision) {
+            // Then 'stream' must be true. The path increments are kept in float32: they're only as large as the path,
+            // and differences of nearby points are exactly what loses accuracy at reduced precision. The signatures
+            // themselves are what take up the memory, so those are converted as they're computed.
+            torch::Tensor signature_with_scalar = signature::detail::signature_stream_reduced_precision(
+                    path_increments, reciprocals, inverse, initial, initial_value, scalar_term, depth, storage_dtype,
+                    workspace);
+            return std::tuple<torch::Tensor, torch::Tensor> {signature_with_scalar, path_increments};
+        }
 
         // Allocate memory for the computation.
         torch::Tensor first_term;
@@ -319,6 +1302,39 @@ namespace signatory {
         }
         misc::slice_by_term(first_term, signature_by_term_at_stream, input_channel_size, depth);
 
+        if (stream) {
+            // If there isn't enough parallelism available along the batch dimension then we can extract some from the
+            // stream dimension instead.
+            int64_t scan_chunks = signature::detail::num_scan_chunks(path, batch_size, output_stream_size,
+                                                                     output_channel_size);
+            profiling::set("signature_forward.scan_chunks", scan_chunks);
+            if (scan_chunks > 1) {
+                signature::detail::signature_forward_scan(path_increments, reciprocals, signature, inverse, initial,
+                                                          initial_value, depth, scan_chunks, workspace);
+                return std::tuple<torch::Tensor, torch::Tensor> {signature_with_scalar, path_increments};
+            }
+        }
+
+        #ifdef SIGNATORY_CUDA
+        if (path.is_cuda() &&
+            ta_ops::detail::mult_fused_restricted_exp_stream_cuda_kernel_supported(path_increments, signature, depth)) {
+            // Run the whole stream in a single kernel launch, rather than launching a kernel for every increment.
+            // Starting from zero (i.e. the signature of the trivial path) means that the first term is just a
+            // mult_fused_restricted_exp as well.
+            SIGNATORY_PROFILE_STAGE("signature_forward_cuda_kernel");
+            if (initial) {
+                first_term.copy_(initial_value);
+            }
+            else {
+                first_term.zero_();
+            }
+            ta_ops::detail::mult_fused_restricted_exp_stream_cuda_kernel(path_increments, signature, stream, inverse,
+                                                                         reciprocals, depth, /*start=*/0,
+                                                                         /*end=*/output_stream_size);
+            return std::tuple<torch::Tensor, torch::Tensor> {signature_with_scalar, path_increments};
+        }
+        #endif
+
         // Compute the first term.
         if (initial) {
             first_term.copy_(initial_value);
@@ -333,131 +1349,279 @@ namespace signatory {
                                    reciprocals);
         }
 
-        // Decide how much OpenMP-based parallelism to use. Default is no parallelism.
-        int64_t stream_threads = 1;  // We can try to parallelise along the stream dimension...
-        int64_t batch_threads = 1;   // ...and along the batch dimension.
-        if (!path.is_cuda()) {
-            // If we're on the CPU then we can try parallelising with OpenMP
-            if (batch_size * output_stream_size * output_channel_size < 81899) {
-                // Don't use parallelism if the problem is small.
-                // The magic number 81899 was chosen as being roughly the point at which the small/large threshold is
-                // crossed. (81899 = batch size 1 * stream size 4096 * signature_channels(channels 4, depth 2) - 1, false)
-                stream_threads = 1;
-                batch_threads = 1;
-            }
-            else {
-                // We want to parallelise across the batch dimension first, as that's most efficient.
-                batch_threads = std::min(batch_size, static_cast<int64_t>(omp_get_max_threads()));
-
-                if (stream) {
-                    // Can't parallelise along the stream dimension in this inherently-serial case.
-                    stream_threads = 1;
-                }
-                else {
-                    stream_threads = (omp_get_max_threads() + batch_threads - 1) / batch_threads;
-                    stream_threads = std::min(stream_threads, static_cast<int64_t>(std::sqrt(input_stream_size)));
-                    // Don't want to cut the stream dimension _too_ small, or we'll lose the benefits of the fused
-                    // mult-restricted-exp operation
-                    stream_threads = std::min(stream_threads, (input_stream_size + 2) / 3);
-                }
-            }
-        }
+        // Decide how much parallelism to use.
+        int64_t stream_threads;
+        int64_t batch_threads;
+        std::tie(stream_threads, batch_threads) = signature::detail::choose_threads(path.is_cuda(), batch_size,
+                                                                                    input_stream_size,
+                                                                                    output_stream_size,
+                                                                                    output_channel_size, stream);
+        profiling::set("signature_forward.stream_threads", stream_threads);
+        profiling::set("signature_forward.batch_threads", batch_threads);
 
         // Now actually do the computation!
         if (stream_threads == 1) {
+            SIGNATORY_PROFILE_STAGE("signature_forward_stream");
             signature::detail::signature_forward_inner(path_increments, reciprocals, signature, signature_by_term,
                                                        signature_by_term_at_stream, inverse, stream, /*start=*/1,
                                                        /*end=*/output_stream_size, batch_threads);
         }
         else {
-            // If we get here then it's because we can use OpenMP to parallelise across the stream dimension as well
+            // If we get here then it's because we can parallelise across the stream dimension as well
             // as the batch dimension.
+            SIGNATORY_PROFILE_STAGE("signature_forward_stream");
             // stream_threads == 1 is special-cased above primarily for the stream==true case, which this branch
             // doesn't handle. Furthermore even in the stream==false case, this branch would needlessly allocate extra
             // memory.
 
-            signature::detail::omp_nested nested;  // Enable nested OpenMP, so we can parallelise over both stream and batch
-
-            std::vector<std::vector<torch::Tensor>> omp_results(stream_threads);
-            // There's no guarantee that we actually get the maximum number of threads, so we have to check
-            // which ones actually get used.
-            // This also serves as a check that start < end, in the block below
-            std::vector<signature::detail::bool_wrapper> omp_used(stream_threads, {false});
-            // As for why we bother with the bool wrapper: std::vector<bool> is special-cased from other vectors and
-            // is basically broken. https://stackoverflow.com/questions/670308/alternative-to-vectorbool
-
-            #pragma omp parallel default(none) \
-                                 num_threads(stream_threads) \
-                                 shared(omp_results, omp_used, path_increments, inverse, reciprocals, \
-                                        output_stream_size, batch_size, output_channel_size, input_channel_size, \
-                                        depth, opts, batch_threads)
-            {
-                // Split up the stream dimension into chunks
-                int64_t start = 1 + ((output_stream_size - 1) * omp_get_thread_num()) / omp_get_num_threads();
-                int64_t end = 1 + ((output_stream_size - 1) * (1 + omp_get_thread_num())) / omp_get_num_threads();
-                if (start < end) {
-                    // Compute the signature of each chunk separately
-                    torch::Tensor omp_signature = torch::empty({batch_size, output_channel_size}, opts);
-                    std::vector<torch::Tensor> omp_signature_by_term_at_stream;
-                    misc::slice_by_term(omp_signature, omp_signature_by_term_at_stream, input_channel_size, depth);
-                    ta_ops::restricted_exp(path_increments[start], omp_signature_by_term_at_stream, reciprocals);
-
-
-                    signature::detail::signature_forward_inner(path_increments,
+            // Split the stream dimension up into chunks, and the batch dimension into blocks, and compute the
+            // signature of each (chunk, block) tile separately.
+            int64_t num_tiles = stream_threads * batch_threads;
+            torch::Tensor chunk_signatures = workspace::empty(workspace, "chunk_signatures",
+                                                              {stream_threads, batch_size, output_channel_size}, opts);
+            auto chunk_start = [&](int64_t chunk) {
+                return 1 + ((output_stream_size - 1) * chunk) / stream_threads;
+            };
+            misc::parallel_for(num_tiles, num_tiles, [&](int64_t begin, int64_t end) {
+                std::vector<torch::Tensor> chunk_signature_by_term_at_stream;
+                for (int64_t tile = begin; tile < end; ++tile) {
+                    int64_t chunk = tile / batch_threads;
+                    int64_t start = chunk_start(chunk);
+                    int64_t stop = chunk_start(chunk + 1);
+                    if (start >= stop) {
+                        continue;
+                    }
+                    int64_t batch_start;
+                    int64_t batch_length;
+                    std::tie(batch_start, batch_length) = signature::detail::batch_block(batch_size, batch_threads,
+                                                                                         tile % batch_threads);
+                    torch::Tensor tile_increments = path_increments.narrow(/*dim=*/batch_dim, /*start=*/batch_start,
+                                                                           /*length=*/batch_length);
+                    misc::slice_by_term(chunk_signatures[chunk].narrow(/*dim=*/batch_dim, /*start=*/batch_start,
+                                                                       /*length=*/batch_length),
+                                        chunk_signature_by_term_at_stream, input_channel_size, depth);
+                    ta_ops::restricted_exp(tile_increments[start], chunk_signature_by_term_at_stream, reciprocals);
+                    signature::detail::signature_forward_inner(tile_increments,
                                                                reciprocals,
                                                                torch::Tensor {},               // unused because stream==false
                                                                std::vector<torch::Tensor> {},  // unused because stream==false
-                                                               omp_signature_by_term_at_stream,
+                                                               chunk_signature_by_term_at_stream,
                                                                inverse,
                                                                /*stream=*/false,
                                                                /*start=*/start + 1,
-                                                               /*end=*/end,
-                                                               batch_threads);
-                    // Record results
-                    omp_results[omp_get_thread_num()] = std::move(omp_signature_by_term_at_stream);
-                    omp_used[omp_get_thread_num()] = {true};
+                                                               /*end=*/stop,
+                                                               /*batch_threads=*/1);
                 }
-            }
+            });
 
             // Combine the signatures of each chunk
-            for (int64_t thread_index = 0; thread_index < stream_threads; ++thread_index) {
-                if (omp_used[thread_index].value) {
-                    ta_ops::mult(signature_by_term_at_stream, omp_results[thread_index], inverse);
+            {
+                SIGNATORY_PROFILE_STAGE("signature_forward_combine_chunks");
+                std::vector<torch::Tensor> chunk_signature_by_term;
+                for (int64_t chunk = 0; chunk < stream_threads; ++chunk) {
+                    if (chunk_start(chunk) < chunk_start(chunk + 1)) {
+                        misc::slice_by_term(chunk_signatures[chunk], chunk_signature_by_term, input_channel_size,
+                                            depth);
+                        ta_ops::mult(signature_by_term_at_stream, chunk_signature_by_term, inverse, batch_threads);
+                    }
                 }
-                // there is no else{break;} block because it need not be true that the used threads are
-                // contiguously indexed, because of the start < end condition above.
             }
         }
 
         return std::tuple<torch::Tensor, torch::Tensor> {signature_with_scalar, path_increments};
     }
 
-    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
-    signature_backward(torch::Tensor grad_signature, torch::Tensor signature, torch::Tensor path_increments,
-                       s_size_type depth, bool stream, bool basepoint, bool inverse, bool initial, bool scalar_term) {
+    std::tuple<torch::Tensor, torch::Tensor>
+    signature_forward(torch::Tensor path, s_size_type depth, bool stream, bool basepoint, torch::Tensor basepoint_value,
+                      bool inverse, bool initial, torch::Tensor initial_value, bool scalar_term, bool time,
+                      bool lead_lag, py::object workspace_capsule) {
+        // Must do this before releasing the GIL.
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
 
         py::gil_scoped_release release;
 
-        if (scalar_term) {
-            grad_signature = grad_signature.narrow(/*dim=*/channel_dim, /*start=*/1,
-                                                   /*length=*/grad_signature.size(channel_dim) - 1);
-            signature = signature.narrow(/*dim=*/channel_dim, /*start=*/1, /*length=*/signature.size(channel_dim) - 1);
+        return signature_forward_impl(path, depth, stream, basepoint, basepoint_value, inverse, initial, initial_value,
+                                      scalar_term, time, lead_lag, workspace);
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor>
+    signature_and_inverse_forward(torch::Tensor path, s_size_type depth, bool basepoint, torch::Tensor basepoint_value,
+                                  bool initial, torch::Tensor initial_value, torch::Tensor inverse_initial_value,
+                                  bool scalar_term, py::object workspace_capsule) {
+        signature_checkargs(path, depth, basepoint, basepoint_value, initial, initial_value, scalar_term,
+                            /*time=*/false, /*lead_lag=*/false);
+        if (initial) {
+            signature_checkargs(path, depth, basepoint, basepoint_value, initial, inverse_initial_value, scalar_term,
+                                /*time=*/false, /*lead_lag=*/false);
         }
 
-        grad_signature = grad_signature.detach();
-        signature = signature.detach();
-        path_increments = path_increments.detach();
+        // Must do this before releasing the GIL.
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
 
-        torch::TensorOptions opts = signature.options();
-        torch::Tensor reciprocals = misc::make_reciprocals(depth, opts);
-        int64_t output_stream_size = path_increments.size(stream_dim);
-        int64_t input_channel_size = path_increments.size(channel_dim);
+        py::gil_scoped_release release;
 
-        std::vector<torch::Tensor> signature_by_term;
-        misc::slice_by_term(signature, signature_by_term, input_channel_size, depth);
+        path = path.detach();
+        basepoint_value = basepoint_value.detach();
+        initial_value = initial_value.detach();
+        inverse_initial_value = inverse_initial_value.detach();
 
-        // When computing the signature we essentially did a lot of computations of the form
-        // A \otimes exp(b),
+        if (scalar_term && initial) {
+            int64_t initial_channel_size = initial_value.size(channel_dim) - 1;
+            initial_value = initial_value.narrow(/*dim=*/channel_dim, /*start=*/1, /*length=*/initial_channel_size);
+            inverse_initial_value = inverse_initial_value.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                                                 /*length=*/initial_channel_size);
+        }
+
+        // Some constants to pass around
+        int64_t batch_size = path.size(batch_dim);
+        int64_t input_channel_size = path.size(channel_dim);
+        int64_t output_stream_size = path.size(stream_dim) - (basepoint ? 0 : 1);
+        int64_t output_channel_size = signature_channels(input_channel_size, depth, false);
+        torch::TensorOptions opts = path.options();
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
+
+        // Only the ordinary path increments are needed; the inverse signature is computed from their negation.
+        torch::Tensor path_increments = signature::detail::compute_path_increments(path, basepoint, basepoint_value,
+                                                                                   /*inverse=*/false);
+
+        // Allocate memory for the computation. Both are stored in a single tensor, so that they have the same strides.
+        int64_t output_channel_size_with_scalar = scalar_term ? (output_channel_size + 1) : output_channel_size;
+        torch::Tensor both_signatures = torch::empty({2, output_stream_size, batch_size,
+                                                      output_channel_size_with_scalar}, opts);
+        if (scalar_term) {
+            both_signatures.narrow(/*dim=*/channel_dim, /*start=*/0, /*length=*/1) = 1;
+        }
+        torch::Tensor signature_with_scalar = both_signatures[0];
+        torch::Tensor inverse_signature_with_scalar = both_signatures[1];
+        torch::Tensor signature = signature_with_scalar;
+        torch::Tensor inverse_signature = inverse_signature_with_scalar;
+        if (scalar_term) {
+            signature = signature.narrow(/*dim=*/channel_dim, /*start=*/1, /*length=*/output_channel_size);
+            inverse_signature = inverse_signature.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                                         /*length=*/output_channel_size);
+        }
+
+        // Starting from zero (i.e. the signature of the trivial path) means that the first term is just a
+        // mult_fused_restricted_exp as well.
+        if (initial) {
+            signature[0].copy_(initial_value);
+            inverse_signature[0].copy_(inverse_initial_value);
+        }
+        else {
+            signature[0].zero_();
+            inverse_signature[0].zero_();
+        }
+        signature::detail::signature_and_inverse_stream(path_increments, reciprocals, signature, inverse_signature,
+                                                        depth);
+
+        return std::tuple<torch::Tensor, torch::Tensor> {signature_with_scalar, inverse_signature_with_scalar};
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_backward_impl(torch::Tensor grad_signature, torch::Tensor signature, torch::Tensor path_increments,
+                            s_size_type depth, bool stream, bool basepoint, bool inverse, bool initial,
+                            bool scalar_term, bool time, bool lead_lag, workspace::Workspace* workspace) {
+        torch::ScalarType storage_dtype = signature.scalar_type();
+        if (signature::detail::is_reduced_precision(storage_dtype)) {
+            // As in signature_forward, compute in float32 and convert the results.
+            torch::Tensor grad_path;
+            torch::Tensor grad_basepoint_value;
+            torch::Tensor grad_initial_value;
+            std::tie(grad_path, grad_basepoint_value, grad_initial_value) = signature_backward_impl(
+                    grad_signature.to(torch::kFloat32), signature.to(torch::kFloat32),
+                    path_increments.to(torch::kFloat32), depth, stream, basepoint, inverse, initial, scalar_term,
+                    time, lead_lag, workspace);
+            return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> {grad_path.to(storage_dtype),
+                                                                            grad_basepoint_value.to(storage_dtype),
+                                                                            grad_initial_value.to(storage_dtype)};
+        }
+
+        SIGNATORY_PROFILE_STAGE("signature_backward");
+
+        if (scalar_term) {
+            grad_signature = grad_signature.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                                   /*length=*/grad_signature.size(channel_dim) - 1);
+            signature = signature.narrow(/*dim=*/channel_dim, /*start=*/1, /*length=*/signature.size(channel_dim) - 1);
+        }
+
+        grad_signature = grad_signature.detach();
+        signature = signature.detach();
+        path_increments = path_increments.detach();
+
+        torch::TensorOptions opts = signature.options();
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
+        int64_t batch_size = signature.size(batch_dim);
+        int64_t output_stream_size = path_increments.size(stream_dim);
+        int64_t input_stream_size = basepoint ? output_stream_size : (output_stream_size + 1);
+        int64_t input_channel_size = path_increments.size(channel_dim);
+        int64_t output_channel_size = signature.size(channel_dim);
+
+        // Decide how much parallelism to use, in the same way as signature_forward.
+        int64_t stream_threads;
+        int64_t batch_threads;
+        std::tie(stream_threads, batch_threads) = signature::detail::choose_threads(signature.is_cuda(), batch_size,
+                                                                                    input_stream_size,
+                                                                                    output_stream_size,
+                                                                                    output_channel_size, stream);
+        profiling::set("signature_backward.stream_threads", stream_threads);
+        profiling::set("signature_backward.batch_threads", batch_threads);
+
+        if (stream_threads > 1 && !initial) {
+            // Then we split the stream up into segments and handle each one independently, just like the
+            // stream_threads > 1 case of signature_forward. To do this we need the signature of the partial path up to
+            // the start of each segment, which we get by computing the signature of each segment and then combining
+            // them. (If there were an initial value then we'd need that as well, but we don't have it: in that case we
+            // fall through to the serial computation below, which recovers it at the end.)
+            SIGNATORY_PROFILE_STAGE("signature_backward_stream");
+            int64_t segment_length = (output_stream_size + stream_threads - 1) / stream_threads;
+            int64_t num_segments = (output_stream_size + segment_length - 1) / segment_length;
+
+            torch::Tensor segment_signatures = signature::detail::compute_segment_signatures(path_increments,
+                                                                                             reciprocals, inverse,
+                                                                                             depth, segment_length,
+                                                                                             num_segments,
+                                                                                             /*first_segment=*/0,
+                                                                                             stream_threads,
+                                                                                             batch_threads,
+                                                                                             workspace);
+            torch::Tensor checkpoints = workspace::empty(workspace, "backward_checkpoints",
+                                                         {num_segments, batch_size, output_channel_size}, opts);
+            checkpoints[0].zero_();
+            std::vector<torch::Tensor> checkpoint_by_term;
+            std::vector<torch::Tensor> segment_signature_by_term;
+            for (int64_t segment = 1; segment < num_segments; ++segment) {
+                if (segment == 1) {
+                    checkpoints[1].copy_(segment_signatures[0]);
+                }
+                else {
+                    checkpoints[segment].copy_(checkpoints[segment - 1]);
+                    misc::slice_by_term(checkpoints[segment], checkpoint_by_term, input_channel_size, depth);
+                    misc::slice_by_term(segment_signatures[segment - 1], segment_signature_by_term,
+                                        input_channel_size, depth);
+                    ta_ops::mult(checkpoint_by_term, segment_signature_by_term, inverse, batch_threads);
+                }
+            }
+
+            torch::Tensor grad_path_increments;
+            std::tie(grad_path_increments, std::ignore) = signature::detail::signature_segments_backward(
+                    grad_signature, checkpoints, segment_signatures, path_increments, reciprocals, inverse, initial,
+                    depth, segment_length, stream_threads, batch_threads, workspace);
+
+            torch::Tensor grad_path;
+            torch::Tensor grad_basepoint_value;
+            std::tie(grad_path, grad_basepoint_value) =
+                    signature::detail::compute_augmented_path_increments_backward(grad_path_increments, basepoint,
+                                                                                  inverse, time, lead_lag, opts);
+            // There's no initial value, so no gradient with respect to it.
+            return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+                   {grad_path, grad_basepoint_value, torch::empty({0}, opts)};
+        }
+
+        std::vector<torch::Tensor> signature_by_term;
+        misc::slice_by_term(signature, signature_by_term, input_channel_size, depth);
+
+        // When computing the signature we essentially did a lot of computations of the form
+        // A \otimes exp(b),
         // where A is a generic member of the tensor algebra, and b is a member of the lowest nonscalar part of the
         // tensor algebra.
         // Then signature_by_term_at_stream represents A.
@@ -523,31 +1687,39 @@ namespace signatory {
             // pass we do it for k going from n to 2.
             // In particular we clone the signature here as we're going to modify it in-place during these computations
             // and we don't want to leak changes to the original output.
-            misc::slice_by_term(signature.clone(), signature_by_term_at_stream, input_channel_size, depth);
+            torch::Tensor signature_copy = workspace::empty(workspace, "backward_signature", signature.sizes(), opts);
+            signature_copy.copy_(signature);
+            misc::slice_by_term(signature_copy, signature_by_term_at_stream, input_channel_size, depth);
         }
 
-        torch::Tensor grad_path_increments = torch::empty_like(path_increments);
+        torch::Tensor grad_path_increments = workspace::empty(workspace, "grad_path_increments",
+                                                              path_increments.sizes(), opts);
 
-        for (int64_t stream_index = output_stream_size - 1; stream_index >= 1; --stream_index) {
-            torch::Tensor grad_next = grad_path_increments[stream_index];
-            torch::Tensor next = path_increments[stream_index];
+        {
+            SIGNATORY_PROFILE_STAGE("signature_backward_stream");
+            for (int64_t stream_index = output_stream_size - 1; stream_index >= 1; --stream_index) {
+                torch::Tensor grad_next = grad_path_increments[stream_index];
+                torch::Tensor next = path_increments[stream_index];
 
-            if (stream) {
-                // Just look up signature_by_term_at_stream because we saved it for output
-                misc::slice_at_stream(signature_by_term, signature_by_term_at_stream, stream_index - 1);
-            }
-            else {
-                // Recompute signature_by_term_at_stream
-                ta_ops::mult_fused_restricted_exp(-next, signature_by_term_at_stream, inverse, reciprocals);
-            }
+                if (stream) {
+                    // Just look up signature_by_term_at_stream because we saved it for output
+                    misc::slice_at_stream(signature_by_term, signature_by_term_at_stream, stream_index - 1);
+                }
+                else {
+                    // Recompute signature_by_term_at_stream
+                    ta_ops::mult_fused_restricted_exp(-next, signature_by_term_at_stream, inverse, reciprocals,
+                                                      batch_threads);
+                }
 
-            ta_ops::mult_fused_restricted_exp_backward(grad_next, grad_signature_by_term_at_stream, next,
-                                                       signature_by_term_at_stream, inverse, reciprocals);
+                ta_ops::mult_fused_restricted_exp_backward(grad_next, grad_signature_by_term_at_stream, next,
+                                                           signature_by_term_at_stream, inverse, reciprocals,
+                                                           batch_threads);
 
-            if (stream) {
-                // If stream then gradients may well have accumulated on the signatures of the partial paths, so
-                // add those on here.
-                grad_signature_at_stream += grad_signature[stream_index - 1];
+                if (stream) {
+                    // If stream then gradients may well have accumulated on the signatures of the partial paths, so
+                    // add those on here.
+                    grad_signature_at_stream += grad_signature[stream_index - 1];
+                }
             }
         }
 
@@ -562,17 +1734,438 @@ namespace signatory {
                 }
             }
             // Recover initial_value in signature_by_term_at_stream
-            ta_ops::mult_fused_restricted_exp(-next, signature_by_term_at_stream, inverse, reciprocals);
+            ta_ops::mult_fused_restricted_exp(-next, signature_by_term_at_stream, inverse, reciprocals, batch_threads);
             // grad_signature_by_term_at_stream is using the same memory as grad_signature_at_stream, which uses the
             // same memory as grad_initial_value, which represents the gradient through initial_value.
             ta_ops::mult_fused_restricted_exp_backward(grad_next, grad_signature_by_term_at_stream, next,
-                                                       signature_by_term_at_stream, inverse, reciprocals);
+                                                       signature_by_term_at_stream, inverse, reciprocals,
+                                                       batch_threads);
         }
         else {
             ta_ops::restricted_exp_backward(grad_next, grad_signature_by_term_at_stream, next,
                                             signature_by_term_at_stream, reciprocals);
         }
 
+        // Find the gradient on the path from the gradient on the path increments.
+        torch::Tensor grad_path;
+        torch::Tensor grad_basepoint_value;
+        std::tie(grad_path, grad_basepoint_value) =
+                signature::detail::compute_augmented_path_increments_backward(grad_path_increments, basepoint, inverse,
+                                                                              time, lead_lag, opts);
+
+        return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+               {grad_path, grad_basepoint_value, grad_initial_value};
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_backward(torch::Tensor grad_signature, torch::Tensor signature, torch::Tensor path_increments,
+                       s_size_type depth, bool stream, bool basepoint, bool inverse, bool initial, bool scalar_term,
+                       bool time, bool lead_lag, py::object workspace_capsule) {
+        // Must do this before releasing the GIL.
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
+
+        py::gil_scoped_release release;
+
+        return signature_backward_impl(grad_signature, signature, path_increments, depth, stream, basepoint, inverse,
+                                       initial, scalar_term, time, lead_lag, workspace);
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_levels_forward(torch::Tensor path, s_size_type depth, bool basepoint, torch::Tensor basepoint_value,
+                             bool inverse, bool initial, torch::Tensor initial_value, bool scalar_term,
+                             std::vector<s_size_type> levels, torch::Tensor stream_indices,
+                             py::object workspace_capsule) {
+        signature_checkargs(path, depth, basepoint, basepoint_value, initial, initial_value, scalar_term,
+                            /*time=*/false, /*lead_lag=*/false);
+        signature_levels_checkargs(levels, depth);
+        signature_stream_indices_checkargs(stream_indices, basepoint ? path.size(stream_dim)
+                                                                     : path.size(stream_dim) - 1);
+
+        torch::ScalarType storage_dtype = path.scalar_type();
+        if (signature::detail::is_reduced_precision(storage_dtype)) {
+            // As in signature_forward, compute in float32 and convert at the end. Only the requested levels and stream
+            // indices are converted; what is saved for the backward pass stays in float32.
+            torch::Tensor levels_signature;
+            torch::Tensor signature;
+            torch::Tensor path_increments;
+            std::tie(levels_signature, signature, path_increments) = signature_levels_forward(
+                    path.to(torch::kFloat32), depth, basepoint, basepoint_value.to(torch::kFloat32), inverse, initial,
+                    initial_value.to(torch::kFloat32), scalar_term, levels, stream_indices, workspace_capsule);
+            return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> {levels_signature.to(storage_dtype),
+                                                                            signature, path_increments};
+        }
+
+        // Must do this before releasing the GIL.
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
+
+        py::gil_scoped_release release;
+
+        // No sense keeping track of gradients when we have a dedicated backwards function
+        path = path.detach();
+        basepoint_value = basepoint_value.detach();
+        initial_value = initial_value.detach();
+
+        if (scalar_term && initial) {
+            initial_value = initial_value.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                                 /*length=*/initial_value.size(channel_dim) - 1);
+        }
+
+        int64_t batch_size = path.size(batch_dim);
+        int64_t input_channel_size = path.size(channel_dim);
+        int64_t output_channel_size = signature_channels(input_channel_size, depth, false);
+        torch::TensorOptions opts = path.options();
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
+
+        torch::Tensor path_increments = signature::detail::compute_path_increments(path, basepoint, basepoint_value,
+                                                                                   inverse);
+        int64_t output_stream_size = path_increments.size(stream_dim);
+        int64_t block_size = signature::detail::stream_block_size(output_stream_size, batch_size,
+                                                                  output_channel_size);
+
+        std::vector<std::tuple<int64_t, int64_t, int64_t>> slices = signature::detail::level_slices(input_channel_size,
+                                                                                                    levels,
+                                                                                                    scalar_term);
+        int64_t levels_channel_size = std::get<1>(slices.back()) + std::get<2>(slices.back());
+        stream_indices = stream_indices.contiguous();
+        // Used to index into signature_block, so needs to be on the same device.
+        torch::Tensor stream_indices_device = stream_indices.to(path.device());
+        torch::Tensor levels_signature = torch::empty({stream_indices.size(0), batch_size, levels_channel_size}, opts);
+        if (scalar_term) {
+            levels_signature.narrow(/*dim=*/channel_dim, /*start=*/0, /*length=*/1).fill_(1);
+        }
+
+        torch::Tensor signature = signature::detail::signature_stream_blocks(
+                path_increments, reciprocals, inverse, initial, initial_value, depth, block_size, workspace,
+                [&] (int64_t block_start, torch::Tensor signature_block) {
+                    int64_t lo;
+                    int64_t hi;
+                    std::tie(lo, hi) = signature::detail::stream_indices_in_block(stream_indices, block_start,
+                                                                                  signature_block.size(0));
+                    if (lo == hi) {
+                        return;
+                    }
+                    torch::Tensor selected_signature = signature_block.index_select(
+                            /*dim=*/0, stream_indices_device.narrow(/*dim=*/0, /*start=*/lo, /*length=*/hi - lo)
+                                     - block_start);
+                    torch::Tensor levels_signature_out = levels_signature.narrow(/*dim=*/stream_dim, /*start=*/lo,
+                                                                                 /*length=*/hi - lo);
+                    for (const auto& slice : slices) {
+                        levels_signature_out.narrow(/*dim=*/channel_dim, /*start=*/std::get<1>(slice),
+                                                    /*length=*/std::get<2>(slice))
+                                            .copy_(selected_signature.narrow(/*dim=*/channel_dim,
+                                                                             /*start=*/std::get<0>(slice),
+                                                                             /*length=*/std::get<2>(slice)));
+                    }
+                });
+
+        return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> {levels_signature, signature, path_increments};
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_levels_backward(torch::Tensor grad_levels_signature, torch::Tensor signature,
+                              torch::Tensor path_increments, s_size_type depth, bool basepoint, bool inverse,
+                              bool initial, bool scalar_term, std::vector<s_size_type> levels,
+                              torch::Tensor stream_indices, py::object workspace_capsule) {
+        // The saved tensors are always float32, so the dtype of the path is that of the gradient.
+        torch::ScalarType storage_dtype = grad_levels_signature.scalar_type();
+        if (signature::detail::is_reduced_precision(storage_dtype)) {
+            // As in signature_backward, compute in float32 and convert the results.
+            torch::Tensor grad_path;
+            torch::Tensor grad_basepoint_value;
+            torch::Tensor grad_initial_value;
+            std::tie(grad_path, grad_basepoint_value, grad_initial_value) = signature_levels_backward(
+                    grad_levels_signature.to(torch::kFloat32), signature.to(torch::kFloat32),
+                    path_increments.to(torch::kFloat32), depth, basepoint, inverse, initial, scalar_term, levels,
+                    stream_indices, workspace_capsule);
+            return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> {grad_path.to(storage_dtype),
+                                                                            grad_basepoint_value.to(storage_dtype),
+                                                                            grad_initial_value.to(storage_dtype)};
+        }
+
+        // Must do this before releasing the GIL.
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
+
+        py::gil_scoped_release release;
+
+        grad_levels_signature = grad_levels_signature.detach();
+        signature = signature.detach();
+        path_increments = path_increments.detach();
+
+        torch::TensorOptions opts = signature.options();
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
+        int64_t batch_size = signature.size(batch_dim);
+        int64_t output_channel_size = signature.size(channel_dim);
+        int64_t input_channel_size = path_increments.size(channel_dim);
+        int64_t output_stream_size = path_increments.size(stream_dim);
+        int64_t block_size = signature::detail::stream_block_size(output_stream_size, batch_size,
+                                                                  output_channel_size);
+
+        std::vector<std::tuple<int64_t, int64_t, int64_t>> slices = signature::detail::level_slices(input_channel_size,
+                                                                                                    levels,
+                                                                                                    scalar_term);
+        stream_indices = stream_indices.contiguous();
+        torch::Tensor stream_indices_device = stream_indices.to(signature.device());
+
+        torch::Tensor grad_path_increments;
+        torch::Tensor grad_initial_value;
+        std::tie(grad_path_increments, grad_initial_value) = signature::detail::signature_stream_blocks_backward(
+                signature, path_increments, reciprocals, inverse, initial, depth, block_size, workspace,
+                [&] (int64_t block_start, torch::Tensor signature_block, torch::Tensor grad_signature_block) {
+                    // Only the requested levels and stream indices have any gradient on them; everything else stays
+                    // zero.
+                    int64_t lo;
+                    int64_t hi;
+                    std::tie(lo, hi) = signature::detail::stream_indices_in_block(stream_indices, block_start,
+                                                                                  signature_block.size(0));
+                    if (lo == hi) {
+                        return;
+                    }
+                    torch::Tensor block_indices = stream_indices_device.narrow(/*dim=*/0, /*start=*/lo,
+                                                                               /*length=*/hi - lo) - block_start;
+                    torch::Tensor grad_levels_signature_in = grad_levels_signature.narrow(/*dim=*/stream_dim,
+                                                                                          /*start=*/lo,
+                                                                                          /*length=*/hi - lo);
+                    for (const auto& slice : slices) {
+                        torch::Tensor grad_level = grad_levels_signature_in.narrow(/*dim=*/channel_dim,
+                                                                                   /*start=*/std::get<1>(slice),
+                                                                                   /*length=*/std::get<2>(slice));
+                        grad_signature_block.narrow(/*dim=*/channel_dim, /*start=*/std::get<0>(slice),
+                                                    /*length=*/std::get<2>(slice))
+                                            .index_copy_(/*dim=*/0, block_indices, grad_level);
+                    }
+                });
+
+        if (initial) {
+            if (scalar_term) {
+                // No gradient through the scalar term of the initial value
+                grad_initial_value = torch::cat({torch::zeros({batch_size, 1}, opts), grad_initial_value},
+                                                /*dim=*/channel_dim);
+            }
+        }
+        else {
+            grad_initial_value = torch::empty({0}, opts);
+        }
+
+        // Find the gradient on the path from the gradient on the path increments.
+        torch::Tensor grad_path;
+        torch::Tensor grad_basepoint_value;
+        std::tie(grad_path, grad_basepoint_value) = signature::detail::compute_path_increments_backward(
+                                                                                                   grad_path_increments,
+                                                                                                   basepoint,
+                                                                                                   inverse,
+                                                                                                   opts);
+
+        return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+               {grad_path, grad_basepoint_value, grad_initial_value};
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_checkpoint_forward(torch::Tensor path, s_size_type depth, bool basepoint, torch::Tensor basepoint_value,
+                                 bool inverse, bool initial, torch::Tensor initial_value, bool scalar_term,
+                                 int64_t checkpoint, py::object workspace_capsule) {
+        signature_checkargs(path, depth, basepoint, basepoint_value, initial, initial_value, scalar_term,
+                            /*time=*/false, /*lead_lag=*/false);
+        if (checkpoint < 1) {
+            throw std::invalid_argument("Argument 'checkpoint' must be at least 1.");
+        }
+
+        torch::ScalarType storage_dtype = path.scalar_type();
+        if (signature::detail::is_reduced_precision(storage_dtype)) {
+            // As in signature_forward, compute in float32 and convert at the end. The checkpoints stay in float32, as
+            // the backward pass recomputes everything else from them.
+            torch::Tensor signature_with_scalar;
+            torch::Tensor path_increments;
+            torch::Tensor checkpoints;
+            std::tie(signature_with_scalar, path_increments, checkpoints) = signature_checkpoint_forward(
+                    path.to(torch::kFloat32), depth, basepoint, basepoint_value.to(torch::kFloat32), inverse, initial,
+                    initial_value.to(torch::kFloat32), scalar_term, checkpoint, workspace_capsule);
+            return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> {signature_with_scalar.to(storage_dtype),
+                                                                            path_increments, checkpoints};
+        }
+
+        // Must do this before releasing the GIL.
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
+
+        py::gil_scoped_release release;
+
+        // No sense keeping track of gradients when we have a dedicated backwards function
+        path = path.detach();
+        basepoint_value = basepoint_value.detach();
+        initial_value = initial_value.detach();
+
+        if (scalar_term && initial) {
+            initial_value = initial_value.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                                 /*length=*/initial_value.size(channel_dim) - 1);
+        }
+
+        int64_t batch_size = path.size(batch_dim);
+        int64_t input_channel_size = path.size(channel_dim);
+        int64_t output_channel_size = signature_channels(input_channel_size, depth, false);
+        torch::TensorOptions opts = path.options();
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
+
+        torch::Tensor path_increments = signature::detail::compute_path_increments(path, basepoint, basepoint_value,
+                                                                                   inverse);
+        int64_t output_stream_size = path_increments.size(stream_dim);
+        int64_t num_segments = (output_stream_size + checkpoint - 1) / checkpoint;
+
+        int64_t output_channel_size_with_scalar = scalar_term ? (output_channel_size + 1) : output_channel_size;
+        torch::Tensor signature_with_scalar = torch::empty({batch_size, output_channel_size_with_scalar}, opts);
+        torch::Tensor signature = signature_with_scalar;
+        if (scalar_term) {
+            signature_with_scalar.narrow(/*dim=*/channel_dim, /*start=*/0, /*length=*/1).fill_(1);
+            signature = signature_with_scalar.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                                     /*length=*/output_channel_size);
+        }
+        std::vector<torch::Tensor> signature_by_term;
+        misc::slice_by_term(signature, signature_by_term, input_channel_size, depth);
+
+        // checkpoints[segment] is the signature of the partial path before that segment. (So the first one is the
+        // initial value, and is only meaningful if there is one.)
+        torch::Tensor checkpoints = torch::empty({num_segments, batch_size, output_channel_size}, opts);
+        if (initial) {
+            checkpoints[0].copy_(initial_value);
+        }
+        else {
+            checkpoints[0].zero_();
+        }
+
+        #ifdef SIGNATORY_CUDA
+        if (path.is_cuda() &&
+            ta_ops::detail::mult_fused_restricted_exp_stream_cuda_kernel_supported(path_increments, signature, depth)) {
+            // As in signature_forward, starting from zero means that the first term is just a
+            // mult_fused_restricted_exp as well.
+            signature.copy_(checkpoints[0]);
+            for (int64_t segment = 0; segment < num_segments; ++segment) {
+                int64_t start = segment * checkpoint;
+                int64_t end = std::min(start + checkpoint, output_stream_size);
+                if (segment > 0) {
+                    checkpoints[segment].copy_(signature);
+                }
+                ta_ops::detail::mult_fused_restricted_exp_stream_cuda_kernel(path_increments, signature,
+                                                                             /*stream=*/false, inverse, reciprocals,
+                                                                             depth, start, end);
+            }
+            return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> {signature_with_scalar, path_increments,
+                                                                            checkpoints};
+        }
+        #endif
+
+        if (initial) {
+            signature.copy_(initial_value);
+            ta_ops::mult_fused_restricted_exp(path_increments[0], signature_by_term, inverse, reciprocals);
+        }
+        else {
+            ta_ops::restricted_exp(path_increments[0], signature_by_term, reciprocals);
+        }
+
+        // The segments have to be computed one after the other, so we only parallelise along the batch dimension.
+        int64_t batch_threads;
+        std::tie(std::ignore, batch_threads) = signature::detail::choose_threads(path.is_cuda(), batch_size,
+                                                                                 path.size(stream_dim),
+                                                                                 output_stream_size,
+                                                                                 output_channel_size,
+                                                                                 /*stream=*/true);
+
+        for (int64_t segment = 0; segment < num_segments; ++segment) {
+            int64_t start = segment * checkpoint;
+            int64_t end = std::min(start + checkpoint, output_stream_size);
+            if (segment > 0) {
+                checkpoints[segment].copy_(signature);
+            }
+            signature::detail::signature_forward_inner(path_increments,
+                                                       reciprocals,
+                                                       torch::Tensor {},               // unused because stream==false
+                                                       std::vector<torch::Tensor> {},  // unused because stream==false
+                                                       signature_by_term,
+                                                       inverse,
+                                                       /*stream=*/false,
+                                                       /*start=*/std::max(start, static_cast<int64_t>(1)),
+                                                       /*end=*/end,
+                                                       batch_threads);
+        }
+
+        return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> {signature_with_scalar, path_increments,
+                                                                        checkpoints};
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_checkpoint_backward(torch::Tensor grad_signature, torch::Tensor checkpoints,
+                                  torch::Tensor path_increments, s_size_type depth, bool basepoint, bool inverse,
+                                  bool initial, bool scalar_term, int64_t checkpoint, py::object workspace_capsule) {
+        // The saved tensors are always float32, so the dtype of the path is that of the gradient.
+        torch::ScalarType storage_dtype = grad_signature.scalar_type();
+        if (signature::detail::is_reduced_precision(storage_dtype)) {
+            // As in signature_backward, compute in float32 and convert the results.
+            torch::Tensor grad_path;
+            torch::Tensor grad_basepoint_value;
+            torch::Tensor grad_initial_value;
+            std::tie(grad_path, grad_basepoint_value, grad_initial_value) = signature_checkpoint_backward(
+                    grad_signature.to(torch::kFloat32), checkpoints.to(torch::kFloat32),
+                    path_increments.to(torch::kFloat32), depth, basepoint, inverse, initial, scalar_term, checkpoint,
+                    workspace_capsule);
+            return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> {grad_path.to(storage_dtype),
+                                                                            grad_basepoint_value.to(storage_dtype),
+                                                                            grad_initial_value.to(storage_dtype)};
+        }
+
+        // Must do this before releasing the GIL.
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
+
+        py::gil_scoped_release release;
+
+        if (scalar_term) {
+            grad_signature = grad_signature.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                                   /*length=*/grad_signature.size(channel_dim) - 1);
+        }
+
+        grad_signature = grad_signature.detach();
+        checkpoints = checkpoints.detach();
+        path_increments = path_increments.detach();
+
+        torch::TensorOptions opts = checkpoints.options();
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
+        int64_t num_segments = checkpoints.size(0);
+        int64_t batch_size = checkpoints.size(batch_dim);
+
+        // There's no sense parallelising over the segments on the GPU, where each operation is already parallelised.
+        // On the CPU we parallelise over the segments first, and then use any threads left over on the batch
+        // dimension.
+        int64_t segment_threads = 1;
+        int64_t batch_threads = 1;
+        if (!checkpoints.is_cuda()) {
+            segment_threads = std::min(num_segments, misc::max_threads());
+            batch_threads = std::min(batch_size, (misc::max_threads() + segment_threads - 1) / segment_threads);
+        }
+
+        // The first segment doesn't need its signature, see signature_segments_backward.
+        torch::Tensor segment_signatures = signature::detail::compute_segment_signatures(path_increments, reciprocals,
+                                                                                         inverse, depth, checkpoint,
+                                                                                         num_segments,
+                                                                                         /*first_segment=*/1,
+                                                                                         segment_threads,
+                                                                                         batch_threads,
+                                                                                         workspace);
+        torch::Tensor grad_path_increments;
+        torch::Tensor grad_initial_value;
+        std::tie(grad_path_increments, grad_initial_value) = signature::detail::signature_segments_backward(
+                grad_signature, checkpoints, segment_signatures, path_increments, reciprocals, inverse, initial, depth,
+                checkpoint, segment_threads, batch_threads, workspace);
+
+        if (initial) {
+            if (scalar_term) {
+                grad_initial_value = torch::cat({torch::zeros({batch_size, 1}, opts), grad_initial_value},
+                                                /*dim=*/channel_dim);
+            }
+            else {
+                // Clone because grad_initial_value may be memory belonging to a workspace
+                grad_initial_value = grad_initial_value.clone();
+            }
+        }
+        else {
+            grad_initial_value = torch::empty({0}, opts);
+        }
+
         // Find the gradient on the path from the gradient on the path increments.
         torch::Tensor grad_path;
         torch::Tensor grad_basepoint_value;
@@ -585,4 +2178,574 @@ namespace signatory {
         return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
                {grad_path, grad_basepoint_value, grad_initial_value};
     }
+
+    void signature_windows_checkargs(torch::Tensor path, s_size_type depth, torch::Tensor starts, torch::Tensor ends,
+                                     bool scalar_term) {
+        signature_checkargs(path, depth, /*basepoint=*/false, torch::Tensor(), /*initial=*/false, torch::Tensor(),
+                            scalar_term, /*time=*/false, /*lead_lag=*/false);
+        if (starts.ndimension() != 1 || ends.ndimension() != 1) {
+            throw std::invalid_argument("Arguments 'starts' and 'ends' must be one-dimensional.");
+        }
+        if (starts.scalar_type() != torch::kInt64 || starts.is_cuda() ||
+            ends.scalar_type() != torch::kInt64 || ends.is_cuda()) {
+            throw std::invalid_argument("Arguments 'starts' and 'ends' must be CPU tensors of dtype int64.");
+        }
+        if (starts.size(0) != ends.size(0)) {
+            throw std::invalid_argument("Arguments 'starts' and 'ends' must have the same length.");
+        }
+        if (starts.size(0) == 0) {
+            throw std::invalid_argument("Arguments 'starts' and 'ends' must describe at least one window.");
+        }
+        int64_t input_stream_size = path.size(stream_dim);
+        auto starts_a = starts.accessor<int64_t, 1>();
+        auto ends_a = ends.accessor<int64_t, 1>();
+        for (int64_t index = 0; index < starts.size(0); ++index) {
+            if (starts_a[index] < 0 || ends_a[index] > input_stream_size) {
+                throw std::invalid_argument("Window " + std::to_string(index) + " with start=" +
+                                            std::to_string(starts_a[index]) + ", end=" +
+                                            std::to_string(ends_a[index]) + " is out of range for a path of length " +
+                                            std::to_string(input_stream_size) + ".");
+            }
+            if (ends_a[index] - starts_a[index] < 2) {
+                throw std::invalid_argument("Window " + std::to_string(index) + " with start=" +
+                                            std::to_string(starts_a[index]) + ", end=" +
+                                            std::to_string(ends_a[index]) + " does not contain at least two points.");
+            }
+        }
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_windows_forward(torch::Tensor path, s_size_type depth, torch::Tensor starts, torch::Tensor ends,
+                              bool scalar_term, py::object workspace_capsule) {
+        signature_windows_checkargs(path, depth, starts, ends, scalar_term);
+
+        torch::ScalarType storage_dtype = path.scalar_type();
+        if (signature::detail::is_reduced_precision(storage_dtype)) {
+            // As in signature_forward, compute in float32 and convert at the end. The prefixes stay in float32, as
+            // the backward pass needs them at full precision.
+            torch::Tensor windows_with_scalar;
+            torch::Tensor prefixes;
+            torch::Tensor path_increments;
+            std::tie(windows_with_scalar, prefixes, path_increments) = signature_windows_forward(
+                    path.to(torch::kFloat32), depth, starts, ends, scalar_term, workspace_capsule);
+            return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> {windows_with_scalar.to(storage_dtype),
+                                                                            prefixes, path_increments};
+        }
+
+        // Must do this before releasing the GIL.
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
+
+        py::gil_scoped_release release;
+
+        path = path.detach();
+
+        // Some constants to pass around
+        int64_t batch_size = path.size(batch_dim);
+        int64_t input_stream_size = path.size(stream_dim);
+        int64_t input_channel_size = path.size(channel_dim);
+        int64_t output_channel_size = signature_channels(input_channel_size, depth, false);
+        int64_t num_windows = starts.size(0);
+        torch::TensorOptions opts = path.options();
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
+
+        torch::Tensor path_increments = signature::detail::compute_path_increments(path, /*basepoint=*/false,
+                                                                                   torch::Tensor(),
+                                                                                   /*inverse=*/false);
+
+        // prefixes[0][index] is the signature of path[0:index + 1], and prefixes[1][index] is its inverse. In
+        // particular index == 0 corresponds to a path of a single point, whose signature is just the scalar 1. This
+        // means that the signature of path[start:end] is always given by prefixes[1][start] \otimes
+        // prefixes[0][end - 1], without having to special case start == 0.
+        torch::Tensor prefixes = torch::empty({2, input_stream_size, batch_size, output_channel_size}, opts);
+        prefixes.select(/*dim=*/1, /*index=*/0).zero_();
+        prefixes.select(/*dim=*/1, /*index=*/1).zero_();
+        signature::detail::signature_and_inverse_stream(path_increments, reciprocals,
+                                                        prefixes[0].narrow(/*dim=*/stream_dim, /*start=*/1,
+                                                                           /*length=*/input_stream_size - 1),
+                                                        prefixes[1].narrow(/*dim=*/stream_dim, /*start=*/1,
+                                                                           /*length=*/input_stream_size - 1),
+                                                        depth);
+
+        // Now evaluate every window at once, by treating the windows as extra batch elements.
+        torch::Tensor start_indices = starts.to(path.device());
+        torch::Tensor end_indices = (ends - 1).to(path.device());
+        torch::Tensor window_inverse_prefixes = prefixes[1].index_select(stream_dim, start_indices)
+                                                           .view({num_windows * batch_size, output_channel_size});
+        torch::Tensor window_prefixes = prefixes[0].index_select(stream_dim, end_indices)
+                                                   .view({num_windows * batch_size, output_channel_size});
+
+        int64_t output_channel_size_with_scalar = scalar_term ? (output_channel_size + 1) : output_channel_size;
+        torch::Tensor windows_with_scalar = torch::empty({num_windows, batch_size, output_channel_size_with_scalar},
+                                                         opts);
+        torch::Tensor windows = windows_with_scalar;
+        if (scalar_term) {
+            windows_with_scalar.narrow(/*dim=*/channel_dim, /*start=*/0, /*length=*/1) = 1;
+            windows = windows.narrow(/*dim=*/channel_dim, /*start=*/1, /*length=*/output_channel_size);
+        }
+        windows = windows.view({num_windows * batch_size, output_channel_size});
+
+        std::vector<torch::Tensor> windows_by_term;
+        std::vector<torch::Tensor> window_inverse_prefixes_by_term;
+        std::vector<torch::Tensor> window_prefixes_by_term;
+        misc::slice_by_term(windows, windows_by_term, input_channel_size, depth);
+        misc::slice_by_term(window_inverse_prefixes, window_inverse_prefixes_by_term, input_channel_size, depth);
+        misc::slice_by_term(window_prefixes, window_prefixes_by_term, input_channel_size, depth);
+        int64_t batch_threads = path.is_cuda() ? 1 : std::min(num_windows * batch_size, misc::max_threads());
+        ta_ops::mult_into</*add_not_copy=*/false>(windows_by_term, window_inverse_prefixes_by_term,
+                                                  window_prefixes_by_term, /*inverse=*/false, batch_threads);
+
+        return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> {windows_with_scalar, prefixes,
+                                                                        path_increments};
+    }
+
+    torch::Tensor signature_windows_backward(torch::Tensor grad_windows, torch::Tensor prefixes,
+                                             torch::Tensor path_increments, s_size_type depth, torch::Tensor starts,
+                                             torch::Tensor ends, bool scalar_term, py::object workspace_capsule) {
+        // The saved tensors are always float32, so the dtype of the path is that of the gradient.
+        torch::ScalarType storage_dtype = grad_windows.scalar_type();
+        if (signature::detail::is_reduced_precision(storage_dtype)) {
+            // As in signature_backward, compute in float32 and convert the result.
+            return signature_windows_backward(grad_windows.to(torch::kFloat32), prefixes.to(torch::kFloat32),
+                                              path_increments.to(torch::kFloat32), depth, starts, ends, scalar_term,
+                                              workspace_capsule).to(storage_dtype);
+        }
+
+        // Must do this before releasing the GIL.
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
+
+        py::gil_scoped_release release;
+
+        if (scalar_term) {
+            grad_windows = grad_windows.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                               /*length=*/grad_windows.size(channel_dim) - 1);
+        }
+
+        grad_windows = grad_windows.detach();
+        prefixes = prefixes.detach();
+        path_increments = path_increments.detach();
+
+        int64_t batch_size = prefixes.size(batch_dim);
+        int64_t input_stream_size = prefixes.size(stream_dim);
+        int64_t input_channel_size = path_increments.size(channel_dim);
+        int64_t output_channel_size = prefixes.size(channel_dim);
+        int64_t num_windows = starts.size(0);
+        torch::TensorOptions opts = prefixes.options();
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
+
+        // First of all, backward through the multiplication that evaluated every window.
+        torch::Tensor start_indices = starts.to(prefixes.device());
+        torch::Tensor end_indices = (ends - 1).to(prefixes.device());
+        torch::Tensor window_inverse_prefixes = prefixes[1].index_select(stream_dim, start_indices)
+                                                           .view({num_windows * batch_size, output_channel_size});
+        torch::Tensor window_prefixes = prefixes[0].index_select(stream_dim, end_indices)
+                                                   .view({num_windows * batch_size, output_channel_size});
+        // Copy to avoid leaking changes, as mult_backward modifies its first argument in-place.
+        torch::Tensor grad_window_inverse_prefixes = workspace::empty(workspace, "grad_window_inverse_prefixes",
+                                                                      {num_windows * batch_size, output_channel_size},
+                                                                      opts);
+        grad_window_inverse_prefixes.view({num_windows, batch_size, output_channel_size}).copy_(grad_windows);
+        torch::Tensor grad_window_prefixes = workspace::empty(workspace, "grad_window_prefixes",
+                                                              {num_windows * batch_size, output_channel_size}, opts);
+
+        std::vector<torch::Tensor> grad_window_inverse_prefixes_by_term;
+        std::vector<torch::Tensor> grad_window_prefixes_by_term;
+        std::vector<torch::Tensor> window_inverse_prefixes_by_term;
+        std::vector<torch::Tensor> window_prefixes_by_term;
+        misc::slice_by_term(grad_window_inverse_prefixes, grad_window_inverse_prefixes_by_term, input_channel_size,
+                            depth);
+        misc::slice_by_term(grad_window_prefixes, grad_window_prefixes_by_term, input_channel_size, depth);
+        misc::slice_by_term(window_inverse_prefixes, window_inverse_prefixes_by_term, input_channel_size, depth);
+        misc::slice_by_term(window_prefixes, window_prefixes_by_term, input_channel_size, depth);
+        int64_t window_threads = prefixes.is_cuda() ? 1 : std::min(num_windows * batch_size, misc::max_threads());
+        ta_ops::mult_backward</*add_not_copy=*/false>(grad_window_inverse_prefixes_by_term,
+                                                      grad_window_prefixes_by_term,
+                                                      window_inverse_prefixes_by_term,
+                                                      window_prefixes_by_term,
+                                                      window_threads);
+
+        // Then accumulate those gradients on to the prefixes they came from. (Overlapping windows will often share
+        // the same prefixes.)
+        torch::Tensor grad_prefixes = torch::zeros(prefixes.sizes(), opts);
+        grad_prefixes[0].index_add_(stream_dim, end_indices,
+                                    grad_window_prefixes.view({num_windows, batch_size, output_channel_size}));
+        grad_prefixes[1].index_add_(stream_dim, start_indices,
+                                    grad_window_inverse_prefixes.view({num_windows, batch_size,
+                                                                       output_channel_size}));
+
+        // Finally, backward through the computation of the prefixes. Both the signatures and the inverse signatures
+        // are handled in the same sweep backwards along the stream, using the values saved from the forward pass
+        // rather than recomputing anything.
+        int64_t batch_threads;
+        std::tie(std::ignore, batch_threads) = signature::detail::choose_threads(prefixes.is_cuda(), batch_size,
+                                                                                 input_stream_size,
+                                                                                 input_stream_size - 1,
+                                                                                 output_channel_size,
+                                                                                 /*stream=*/true);
+
+        torch::Tensor negative_path_increments = -path_increments;
+        torch::Tensor grad_path_increments = workspace::empty(workspace, "grad_path_increments",
+                                                              path_increments.sizes(), opts);
+        torch::Tensor grad_inverse_next = workspace::empty(workspace, "grad_inverse_next",
+                                                           {batch_size, input_channel_size}, opts);
+
+        std::vector<torch::Tensor> prefix_by_term;
+        std::vector<torch::Tensor> inverse_prefix_by_term;
+        std::vector<torch::Tensor> grad_prefix_by_term;
+        std::vector<torch::Tensor> grad_inverse_prefix_by_term;
+        misc::slice_by_term(prefixes[0], prefix_by_term, input_channel_size, depth);
+        misc::slice_by_term(prefixes[1], inverse_prefix_by_term, input_channel_size, depth);
+        misc::slice_by_term(grad_prefixes[0], grad_prefix_by_term, input_channel_size, depth);
+        misc::slice_by_term(grad_prefixes[1], grad_inverse_prefix_by_term, input_channel_size, depth);
+        std::vector<torch::Tensor> prefix_by_term_at_stream;
+        std::vector<torch::Tensor> inverse_prefix_by_term_at_stream;
+        std::vector<torch::Tensor> grad_prefix_by_term_at_stream;
+        std::vector<torch::Tensor> grad_inverse_prefix_by_term_at_stream;
+
+        for (int64_t stream_index = input_stream_size - 1; stream_index >= 1; --stream_index) {
+            // The prefixes at stream_index were computed from those at stream_index - 1 and
+            // path_increments[stream_index - 1].
+            misc::slice_at_stream(prefix_by_term, prefix_by_term_at_stream, stream_index - 1);
+            misc::slice_at_stream(inverse_prefix_by_term, inverse_prefix_by_term_at_stream, stream_index - 1);
+            misc::slice_at_stream(grad_prefix_by_term, grad_prefix_by_term_at_stream, stream_index);
+            misc::slice_at_stream(grad_inverse_prefix_by_term, grad_inverse_prefix_by_term_at_stream, stream_index);
+
+            ta_ops::mult_fused_restricted_exp_backward(grad_path_increments[stream_index - 1],
+                                                       grad_prefix_by_term_at_stream,
+                                                       path_increments[stream_index - 1],
+                                                       prefix_by_term_at_stream,
+                                                       /*inverse=*/false,
+                                                       reciprocals,
+                                                       batch_threads);
+            ta_ops::mult_fused_restricted_exp_backward(grad_inverse_next,
+                                                       grad_inverse_prefix_by_term_at_stream,
+                                                       negative_path_increments[stream_index - 1],
+                                                       inverse_prefix_by_term_at_stream,
+                                                       /*inverse=*/true,
+                                                       reciprocals,
+                                                       batch_threads);
+            // The inverse signature was computed from the negated increments.
+            grad_path_increments[stream_index - 1] -= grad_inverse_next;
+
+            // grad_prefixes at stream_index now holds the gradients with respect to the prefixes at
+            // stream_index - 1, so add those on to the gradients they already had from the windows.
+            grad_prefixes.select(/*dim=*/1, /*index=*/stream_index - 1) += grad_prefixes.select(/*dim=*/1,
+                                                                                                /*index=*/stream_index);
+        }
+
+        // Find the gradient on the path from the gradient on the path increments.
+        torch::Tensor grad_path;
+        std::tie(grad_path, std::ignore) = signature::detail::compute_path_increments_backward(grad_path_increments,
+                                                                                               /*basepoint=*/false,
+                                                                                               /*inverse=*/false,
+                                                                                               opts);
+        return grad_path;
+    }
+
+    void signature_packed_checkargs(torch::Tensor data, torch::Tensor batch_sizes, s_size_type depth, bool basepoint,
+                                    torch::Tensor basepoint_value, bool initial, torch::Tensor initial_value,
+                                    bool scalar_term) {
+        if (data.ndimension() != 2) {
+            throw std::invalid_argument("Argument 'path' must be a PackedSequence whose data is a 2-dimensional "
+                                        "tensor, with dimensions corresponding to (points, channel) respectively.");
+        }
+        if (data.size(0) == 0 || data.size(channel_dim) == 0) {
+            throw std::invalid_argument("Argument 'path' cannot have dimensions of size zero.");
+        }
+        if (depth < 1) {
+            throw std::invalid_argument("Argument 'depth' must be an integer greater than or equal to one.");
+        }
+        if (!data.is_floating_point()) {
+            throw std::invalid_argument("Argument 'path' must be of floating point type.");
+        }
+        if (batch_sizes.ndimension() != 1 || batch_sizes.size(0) == 0 || batch_sizes.scalar_type() != torch::kInt64 ||
+            batch_sizes.is_cuda()) {
+            throw std::invalid_argument("Argument 'path' must have batch_sizes given as a nonempty one-dimensional "
+                                        "CPU tensor of dtype int64.");
+        }
+        auto batch_sizes_a = batch_sizes.accessor<int64_t, 1>();
+        int64_t num_points = 0;
+        for (int64_t stream_index = 0; stream_index < batch_sizes.size(0); ++stream_index) {
+            if (batch_sizes_a[stream_index] < 1 ||
+                (stream_index > 0 && batch_sizes_a[stream_index] > batch_sizes_a[stream_index - 1])) {
+                throw std::invalid_argument("Argument 'path' must have batch_sizes that are positive and "
+                                            "nonincreasing, as produced by torch.nn.utils.rnn.pack_sequence.");
+            }
+            num_points += batch_sizes_a[stream_index];
+        }
+        if (num_points != data.size(0)) {
+            throw std::invalid_argument("Argument 'path' must have batch_sizes summing to the number of points in "
+                                        "its data.");
+        }
+        int64_t batch_size = batch_sizes_a[0];
+        if (!basepoint && (batch_sizes.size(0) < 2 || batch_sizes_a[1] != batch_size)) {
+            throw std::invalid_argument("Every batch element of argument 'path' must be of length at least 2. (Need "
+                                        "at least this many points to define a path.)");
+        }
+        if (basepoint) {
+            if (basepoint_value.ndimension() != 2) {
+                throw std::invalid_argument("Argument 'basepoint' must be a 2-dimensional tensor, corresponding to "
+                                            "(batch, channel) respectively.");
+            }
+            if (basepoint_value.size(channel_dim) != data.size(channel_dim) ||
+                basepoint_value.size(batch_dim) != batch_size) {
+                throw std::invalid_argument("Arguments 'basepoint' and 'path' must have dimensions of the same "
+                                            "size.");
+            }
+            if (data.device() != basepoint_value.device()) {
+                throw std::invalid_argument("Argument 'basepoint' does not have the same device as 'path'.");
+            }
+            if (data.dtype() != basepoint_value.dtype()) {
+                throw std::invalid_argument("Argument 'basepoint' does not have the same dtype as 'path'.");
+            }
+        }
+        if (initial) {
+            if (initial_value.ndimension() != 2) {
+                throw std::invalid_argument("Argument 'initial' must be a 2-dimensional tensor, corresponding to "
+                                            "(batch, signature_channels) respectively.");
+            }
+            if (initial_value.size(channel_dim) != signature_channels(data.size(channel_dim), depth, scalar_term) ||
+                initial_value.size(batch_dim) != batch_size) {
+                throw std::invalid_argument("Argument 'initial' must have correctly sized batch and channel "
+                                            "dimensions.");
+            }
+            if (data.device() != initial_value.device()) {
+                throw std::invalid_argument("Argument 'initial' does not have the same device as 'path'.");
+            }
+            if (data.dtype() != initial_value.dtype()) {
+                throw std::invalid_argument("Argument 'initial' does not have the same dtype as 'path'.");
+            }
+        }
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor>
+    signature_packed_forward(torch::Tensor data, torch::Tensor batch_sizes, s_size_type depth, bool basepoint,
+                             torch::Tensor basepoint_value, bool inverse, bool initial, torch::Tensor initial_value,
+                             bool scalar_term, py::object workspace_capsule) {
+        signature_packed_checkargs(data, batch_sizes, depth, basepoint, basepoint_value, initial, initial_value,
+                                   scalar_term);
+
+        torch::ScalarType storage_dtype = data.scalar_type();
+        if (signature::detail::is_reduced_precision(storage_dtype)) {
+            // As in signature_forward, compute in float32 and convert at the end.
+            torch::Tensor signature_with_scalar;
+            torch::Tensor packed_increments;
+            std::tie(signature_with_scalar, packed_increments) = signature_packed_forward(
+                    data.to(torch::kFloat32), batch_sizes, depth, basepoint, basepoint_value.to(torch::kFloat32),
+                    inverse, initial, initial_value.to(torch::kFloat32), scalar_term, workspace_capsule);
+            return std::tuple<torch::Tensor, torch::Tensor> {signature_with_scalar.to(storage_dtype),
+                                                             packed_increments};
+        }
+
+        // Must do this before releasing the GIL.
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
+
+        py::gil_scoped_release release;
+
+        data = data.detach();
+        basepoint_value = basepoint_value.detach();
+        initial_value = initial_value.detach();
+
+        if (scalar_term && initial) {
+            initial_value = initial_value.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                                 /*length=*/initial_value.size(channel_dim) - 1);
+        }
+
+        // Some constants to pass around
+        auto batch_sizes_a = batch_sizes.accessor<int64_t, 1>();
+        int64_t batch_size = batch_sizes_a[0];
+        int64_t max_stream_size = batch_sizes.size(0);
+        int64_t num_points = data.size(0);
+        int64_t input_channel_size = data.size(channel_dim);
+        int64_t output_channel_size = signature_channels(input_channel_size, depth, false);
+        torch::TensorOptions opts = data.options();
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
+
+        std::vector<int64_t> offsets = signature::detail::packed_offsets(batch_sizes);
+        torch::Tensor previous_rows = signature::detail::packed_previous_rows(batch_sizes, offsets, data.device());
+        torch::Tensor packed_increments = signature::detail::compute_packed_increments(data, offsets, previous_rows,
+                                                                                       basepoint, basepoint_value,
+                                                                                       inverse);
+
+        int64_t output_channel_size_with_scalar = scalar_term ? (output_channel_size + 1) : output_channel_size;
+        torch::Tensor signature_with_scalar = torch::empty({batch_size, output_channel_size_with_scalar}, opts);
+        torch::Tensor signature = signature_with_scalar;
+        if (scalar_term) {
+            signature_with_scalar.narrow(/*dim=*/channel_dim, /*start=*/0, /*length=*/1) = 1;
+            signature = signature_with_scalar.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                                     /*length=*/output_channel_size);
+        }
+        if (initial) {
+            signature.copy_(initial_value);
+        }
+
+        // Each batch element only costs as much as its own length. On the CPU the batch is split up into blocks with
+        // the same number of points in each, and each block is handled by a single thread, all the way along the
+        // stream. (Same magic number as in choose_threads.)
+        int64_t num_blocks = 1;
+        if (!data.is_cuda() && num_points * output_channel_size >= 81899) {
+            num_blocks = std::min(batch_size, misc::max_threads());
+        }
+        std::vector<int64_t> boundaries = signature::detail::packed_batch_blocks(batch_sizes, num_blocks);
+        int64_t first_stream_index = basepoint ? 0 : 1;
+
+        misc::parallel_for(num_blocks, num_blocks, [&](int64_t begin, int64_t end) {
+            std::vector<torch::Tensor> signature_by_term;
+            for (int64_t block = begin; block < end; ++block) {
+                int64_t batch_start = boundaries[block];
+                for (int64_t stream_index = first_stream_index; stream_index < max_stream_size; ++stream_index) {
+                    int64_t length = std::min(boundaries[block + 1], batch_sizes_a[stream_index]) - batch_start;
+                    if (length <= 0) {
+                        // The batch elements are sorted by decreasing length, so we're done with this block.
+                        break;
+                    }
+                    torch::Tensor next = packed_increments.narrow(/*dim=*/0,
+                                                                  /*start=*/offsets[stream_index] + batch_start,
+                                                                  /*length=*/length);
+                    misc::slice_by_term(signature.narrow(/*dim=*/batch_dim, /*start=*/batch_start, /*length=*/length),
+                                        signature_by_term, input_channel_size, depth);
+                    if (stream_index == first_stream_index && !initial) {
+                        ta_ops::restricted_exp(next, signature_by_term, reciprocals);
+                    }
+                    else {
+                        ta_ops::mult_fused_restricted_exp(next, signature_by_term, inverse, reciprocals);
+                    }
+                }
+            }
+        });
+
+        return std::tuple<torch::Tensor, torch::Tensor> {signature_with_scalar, packed_increments};
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_packed_backward(torch::Tensor grad_signature, torch::Tensor signature, torch::Tensor packed_increments,
+                              torch::Tensor batch_sizes, s_size_type depth, bool basepoint, bool inverse, bool initial,
+                              bool scalar_term, py::object workspace_capsule) {
+        torch::ScalarType storage_dtype = signature.scalar_type();
+        if (signature::detail::is_reduced_precision(storage_dtype)) {
+            // As in signature_backward, compute in float32 and convert the results.
+            torch::Tensor grad_data;
+            torch::Tensor grad_basepoint_value;
+            torch::Tensor grad_initial_value;
+            std::tie(grad_data, grad_basepoint_value, grad_initial_value) = signature_packed_backward(
+                    grad_signature.to(torch::kFloat32), signature.to(torch::kFloat32),
+                    packed_increments.to(torch::kFloat32), batch_sizes, depth, basepoint, inverse, initial,
+                    scalar_term, workspace_capsule);
+            return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> {grad_data.to(storage_dtype),
+                                                                            grad_basepoint_value.to(storage_dtype),
+                                                                            grad_initial_value.to(storage_dtype)};
+        }
+
+        // Must do this before releasing the GIL.
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
+
+        py::gil_scoped_release release;
+
+        if (scalar_term) {
+            grad_signature = grad_signature.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                                   /*length=*/grad_signature.size(channel_dim) - 1);
+            signature = signature.narrow(/*dim=*/channel_dim, /*start=*/1, /*length=*/signature.size(channel_dim) - 1);
+        }
+
+        grad_signature = grad_signature.detach();
+        signature = signature.detach();
+        packed_increments = packed_increments.detach();
+
+        auto batch_sizes_a = batch_sizes.accessor<int64_t, 1>();
+        int64_t batch_size = batch_sizes_a[0];
+        int64_t max_stream_size = batch_sizes.size(0);
+        int64_t num_points = packed_increments.size(0);
+        int64_t input_channel_size = packed_increments.size(channel_dim);
+        int64_t output_channel_size = signature.size(channel_dim);
+        torch::TensorOptions opts = signature.options();
+        torch::Tensor reciprocals = workspace::make_reciprocals(workspace, depth, opts);
+        std::vector<int64_t> offsets = signature::detail::packed_offsets(batch_sizes);
+
+        // As in signature_backward, the gradient through the signature ends up being the gradient through the initial
+        // value, so if there's a scalar term we make room for it.
+        torch::Tensor grad_initial_value;
+        if (scalar_term && initial) {
+            grad_initial_value = torch::empty({batch_size, 1 + output_channel_size}, opts);
+            grad_initial_value.narrow(/*dim=*/channel_dim, /*start=*/0, /*length=*/1).zero_();
+            grad_signature = grad_initial_value.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                                       /*length=*/output_channel_size).copy_(grad_signature);
+        }
+        else {
+            // make sure not to leak changes
+            grad_signature = grad_signature.clone();
+            grad_initial_value = grad_signature;
+        }
+
+        // We recompute the signature backwards along the stream, as in signature_backward, so we copy it to avoid
+        // leaking changes to the original output.
+        torch::Tensor signature_copy = workspace::empty(workspace, "backward_signature", signature.sizes(), opts);
+        signature_copy.copy_(signature);
+
+        torch::Tensor grad_packed_increments = workspace::empty(workspace, "grad_packed_increments",
+                                                                packed_increments.sizes(), opts);
+        if (!basepoint) {
+            grad_packed_increments.narrow(/*dim=*/0, /*start=*/0, /*length=*/batch_size).zero_();
+        }
+
+        // Split up the batch in the same way as signature_packed_forward.
+        int64_t num_blocks = 1;
+        if (!signature.is_cuda() && num_points * output_channel_size >= 81899) {
+            num_blocks = std::min(batch_size, misc::max_threads());
+        }
+        std::vector<int64_t> boundaries = signature::detail::packed_batch_blocks(batch_sizes, num_blocks);
+        int64_t first_stream_index = basepoint ? 0 : 1;
+
+        misc::parallel_for(num_blocks, num_blocks, [&](int64_t begin, int64_t end) {
+            std::vector<torch::Tensor> signature_by_term;
+            std::vector<torch::Tensor> grad_signature_by_term;
+            for (int64_t block = begin; block < end; ++block) {
+                int64_t batch_start = boundaries[block];
+                int64_t batch_end = boundaries[block + 1];
+                if (batch_start == batch_end) {
+                    continue;
+                }
+                for (int64_t stream_index = max_stream_size - 1; stream_index >= first_stream_index; --stream_index) {
+                    int64_t length = std::min(batch_end, batch_sizes_a[stream_index]) - batch_start;
+                    if (length <= 0) {
+                        // This block's batch elements haven't started yet.
+                        continue;
+                    }
+                    torch::Tensor next = packed_increments.narrow(/*dim=*/0,
+                                                                  /*start=*/offsets[stream_index] + batch_start,
+                                                                  /*length=*/length);
+                    torch::Tensor grad_next = grad_packed_increments.narrow(/*dim=*/0,
+                                                                            /*start=*/offsets[stream_index] +
+                                                                                      batch_start,
+                                                                            /*length=*/length);
+                    misc::slice_by_term(signature_copy.narrow(/*dim=*/batch_dim, /*start=*/batch_start,
+                                                              /*length=*/length),
+                                        signature_by_term, input_channel_size, depth);
+                    misc::slice_by_term(grad_signature.narrow(/*dim=*/batch_dim, /*start=*/batch_start,
+                                                              /*length=*/length),
+                                        grad_signature_by_term, input_channel_size, depth);
+                    if (stream_index == first_stream_index && !initial) {
+                        ta_ops::restricted_exp_backward(grad_next, grad_signature_by_term, next, signature_by_term,
+                                                        reciprocals);
+                    }
+                    else {
+                        // Recompute the signature before this increment, and then go backwards through the
+                        // computation of the signature after it.
+                        ta_ops::mult_fused_restricted_exp(-next, signature_by_term, inverse, reciprocals);
+                        ta_ops::mult_fused_restricted_exp_backward(grad_next, grad_signature_by_term, next,
+                                                                   signature_by_term, inverse, reciprocals);
+                    }
+                }
+            }
+        });
+
+        // Find the gradient on the data from the gradient on the increments.
+        torch::Tensor previous_rows = signature::detail::packed_previous_rows(batch_sizes, offsets,
+                                                                              signature.device());
+        torch::Tensor grad_data;
+        torch::Tensor grad_basepoint_value;
+        std::tie(grad_data, grad_basepoint_value) = signature::detail::compute_packed_increments_backward(
+                grad_packed_increments, offsets, previous_rows, basepoint, inverse);
+
+        return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+               {grad_data, grad_basepoint_value, grad_initial_value};
+    }
 }  // namespace signatory
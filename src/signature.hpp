@@ -18,20 +18,230 @@
 #ifndef SIGNATORY_SIGNATURE_HPP
 #define SIGNATORY_SIGNATURE_HPP
 
+#include <torch/extension.h>
+#include <cstdint>     // int64_t
+#include <functional>  // std::function
+#include <tuple>       // std::tuple
+#include <vector>      // std::vector
+
+#include "misc.hpp"
+#include "workspace.hpp"
+
 namespace signatory {
+    namespace signature {
+        namespace detail {
+            // Takes the path and basepoint and returns the path increments
+            torch::Tensor compute_path_increments(torch::Tensor path, bool basepoint, torch::Tensor basepoint_value,
+                                                  bool inverse);
+
+            // Computes the backward pass through the path increments operation.
+            // Returns the gradients for the original path, and for the basepoint.
+            std::tuple<torch::Tensor, torch::Tensor>
+            compute_path_increments_backward(torch::Tensor grad_path_increments, bool basepoint, bool inverse,
+                                             torch::TensorOptions opts);
+
+            // The number of channels of a path with 'input_channel_size' channels, once it has been augmented with a
+            // time channel (if time==true) and/or been lead-lag transformed (if lead_lag==true).
+            int64_t augmented_channels(int64_t input_channel_size, bool time, bool lead_lag);
+
+            // As compute_path_increments, except that these are the increments of the path after it has been
+            // augmented. (After the basepoint, if any, has been prepended to it.) The lead-lag transform makes the
+            // lead channels and then the lag channels take each increment in turn, so there are twice as many
+            // increments; the time channel comes last and moves uniformly from 0 to 1. The augmented path itself is
+            // never formed: its increments are written directly.
+            torch::Tensor compute_augmented_path_increments(torch::Tensor path, bool basepoint,
+                                                            torch::Tensor basepoint_value, bool inverse, bool time,
+                                                            bool lead_lag);
+
+            // Computes the backward pass through compute_augmented_path_increments.
+            // Returns the gradients for the original path, and for the basepoint.
+            std::tuple<torch::Tensor, torch::Tensor>
+            compute_augmented_path_increments_backward(torch::Tensor grad_path_increments, bool basepoint,
+                                                       bool inverse, bool time, bool lead_lag,
+                                                       torch::TensorOptions opts);
+
+            // Whether tensors of this dtype are stored at reduced precision (float16 or bfloat16). Computations on
+            // such tensors are performed in float32 instead.
+            bool is_reduced_precision(torch::ScalarType dtype);
+
+            // How many stream indices' worth of signatures signature_stream_blocks and
+            // signature_stream_blocks_backward should hold at once. Larger blocks mean fewer (but larger) operations
+            // in whatever is done with each block; smaller blocks mean less memory.
+            int64_t stream_block_size(int64_t output_stream_size, int64_t batch_size, int64_t output_channel_size);
+
+            // Computes the signature of every partial path, as signature_forward does with stream==true, except that
+            // only 'block_size' of them are held in memory at any one time. As each block is computed it is passed to
+            // 'block_fn', along with the stream index it starts at. The block is a tensor of shape
+            // (block_length, batch, channel), not including the scalar term, and is only valid for the duration of
+            // that call.
+            // 'initial_value' should not include the scalar term, and is only used if initial==true.
+            // Returns the signature of the whole path.
+            torch::Tensor signature_stream_blocks(torch::Tensor path_increments, torch::Tensor reciprocals,
+                                                  bool inverse, bool initial, torch::Tensor initial_value,
+                                                  s_size_type depth, int64_t block_size,
+                                                  workspace::Workspace* workspace,
+                                                  const std::function<void(int64_t, torch::Tensor)>& block_fn);
+
+            // The backward pass corresponding to signature_stream_blocks. The signatures of the partial paths are
+            // recomputed, backwards from 'signature' (the signature of the whole path), in the same way as
+            // signature_backward does when stream==false.
+            // As each block is recomputed, 'block_fn' is called with the stream index it starts at, the block of
+            // signatures, and a zero tensor of the same shape, on to which should be added the gradients with respect
+            // to those signatures.
+            // Returns the gradients with respect to the path increments, and with respect to the initial value, if
+            // initial==true. (Neither including the scalar term.) The former may be workspace memory, as is fine for
+            // passing to compute_path_increments_backward.
+            std::tuple<torch::Tensor, torch::Tensor>
+            signature_stream_blocks_backward(torch::Tensor signature, torch::Tensor path_increments,
+                                             torch::Tensor reciprocals, bool inverse, bool initial, s_size_type depth,
+                                             int64_t block_size, workspace::Workspace* workspace,
+                                             const std::function<void(int64_t, torch::Tensor, torch::Tensor)>&
+                                             block_fn);
+        }  // namespace signatory::signature::detail
+    }  // namespace signatory::signature
+
     // Checks the arguments for the signature_forward function.
+    // 'time' and 'lead_lag' are as for signature_forward, in which case 'initial_value' should have as many channels as
+    // a signature of the augmented path.
     void signature_checkargs(torch::Tensor path, s_size_type depth, bool basepoint, torch::Tensor basepoint_value,
-                             bool initial, torch::Tensor initial_value, bool scalar_term);
+                             bool initial, torch::Tensor initial_value, bool scalar_term, bool time, bool lead_lag);
 
     // See signatory.signature for documentation
+    // If time==true and/or lead_lag==true then the signature is of the augmented path, as described in
+    // signature::detail::compute_augmented_path_increments. Only the augmented path increments are ever formed, and
+    // these are what is returned alongside the signature.
     std::tuple<torch::Tensor, torch::Tensor>
     signature_forward(torch::Tensor path, s_size_type depth, bool stream, bool basepoint, torch::Tensor basepoint_value,
-                      bool inverse, bool initial, torch::Tensor initial_value, bool scalar_term);
+                      bool inverse, bool initial, torch::Tensor initial_value, bool scalar_term, bool time,
+                      bool lead_lag, py::object workspace_capsule);
+
+    // As signature_forward, except that it doesn't touch Python at all: the workspace is passed directly (nullptr for
+    // none), and it must be called without holding the GIL. This is what the TorchScript operators are built on; see
+    // library.cpp.
+    std::tuple<torch::Tensor, torch::Tensor>
+    signature_forward_impl(torch::Tensor path, s_size_type depth, bool stream, bool basepoint,
+                           torch::Tensor basepoint_value, bool inverse, bool initial, torch::Tensor initial_value,
+                           bool scalar_term, bool time, bool lead_lag, workspace::Workspace* workspace);
+
+    // Computes both the signature and the inverse signature of 'path', as signature_forward does with stream==true
+    // and inverse==false and inverse==true respectively. Rather than doing so with two separate calls, this is done in
+    // a single pass over the path increments. (On the GPU, in a single kernel launch.) This is a forward-only
+    // operation: no backward pass is provided. 'inverse_initial_value' is only used if initial==true, in which case
+    // it should be the inverse of 'initial_value'.
+    // Returns the signature and the inverse signature.
+    std::tuple<torch::Tensor, torch::Tensor>
+    signature_and_inverse_forward(torch::Tensor path, s_size_type depth, bool basepoint, torch::Tensor basepoint_value,
+                                  bool initial, torch::Tensor initial_value, torch::Tensor inverse_initial_value,
+                                  bool scalar_term, py::object workspace_capsule);
 
     // See signatory.signature for documentation
     std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
     signature_backward(torch::Tensor grad_signature, torch::Tensor signature, torch::Tensor path_increments,
-                       s_size_type depth, bool stream, bool basepoint, bool inverse, bool initial, bool scalar_term);
+                       s_size_type depth, bool stream, bool basepoint, bool inverse, bool initial, bool scalar_term,
+                       bool time, bool lead_lag, py::object workspace_capsule);
+
+    // As signature_backward, without touching Python; c.f. signature_forward_impl.
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_backward_impl(torch::Tensor grad_signature, torch::Tensor signature, torch::Tensor path_increments,
+                            s_size_type depth, bool stream, bool basepoint, bool inverse, bool initial,
+                            bool scalar_term, bool time, bool lead_lag, workspace::Workspace* workspace);
+
+    // Checks the 'levels' argument for the signature_levels_forward function.
+    void signature_levels_checkargs(const std::vector<s_size_type>& levels, s_size_type depth);
+
+    // Checks that 'stream_indices' is a one-dimensional CPU int64 tensor of strictly increasing indices into a stream
+    // of length output_stream_size.
+    void signature_stream_indices_checkargs(torch::Tensor stream_indices, int64_t output_stream_size);
+
+    // As signature_forward with stream==true, except that only the specified levels of the signature are returned
+    // (concatenated along the channel dimension, after the scalar term if scalar_term==true), and only at the
+    // specified stream indices. In particular the unwanted levels and stream indices are never stored; see
+    // signature::detail::signature_stream_blocks.
+    // Returns the result, the signature of the whole path, and the path increments. The latter two are what's needed
+    // for the backward pass.
+    // See signatory.signature for documentation
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_levels_forward(torch::Tensor path, s_size_type depth, bool basepoint, torch::Tensor basepoint_value,
+                             bool inverse, bool initial, torch::Tensor initial_value, bool scalar_term,
+                             std::vector<s_size_type> levels, torch::Tensor stream_indices,
+                             py::object workspace_capsule);
+
+    // The backward pass corresponding to signature_levels_forward.
+    // Returns the gradients with respect to the path, the basepoint, and the initial value.
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_levels_backward(torch::Tensor grad_levels_signature, torch::Tensor signature,
+                              torch::Tensor path_increments, s_size_type depth, bool basepoint, bool inverse,
+                              bool initial, bool scalar_term, std::vector<s_size_type> levels,
+                              torch::Tensor stream_indices, py::object workspace_capsule);
+
+    // As signature_forward with stream==false, except that the signature of the partial path is additionally saved
+    // at the start of every segment of 'checkpoint' path increments, so that signature_checkpoint_backward can handle
+    // each segment independently of the others.
+    // Returns the signature, the path increments, and these checkpoints. The latter two are what's needed for the
+    // backward pass.
+    // See signatory.signature for documentation
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_checkpoint_forward(torch::Tensor path, s_size_type depth, bool basepoint, torch::Tensor basepoint_value,
+                                 bool inverse, bool initial, torch::Tensor initial_value, bool scalar_term,
+                                 int64_t checkpoint, py::object workspace_capsule);
+
+    // The backward pass corresponding to signature_checkpoint_forward.
+    // Rather than recovering the signatures of the partial paths by running backwards through the whole stream (as
+    // signature_backward does), each segment is recomputed forwards from its checkpoint. The segments are then
+    // independent of each other, and are processed in parallel on the CPU.
+    // Returns the gradients with respect to the path, the basepoint, and the initial value.
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_checkpoint_backward(torch::Tensor grad_signature, torch::Tensor checkpoints,
+                                  torch::Tensor path_increments, s_size_type depth, bool basepoint, bool inverse,
+                                  bool initial, bool scalar_term, int64_t checkpoint, py::object workspace_capsule);
+
+    // Checks the arguments for the signature_windows_forward function.
+    void signature_windows_checkargs(torch::Tensor path, s_size_type depth, torch::Tensor starts, torch::Tensor ends,
+                                     bool scalar_term);
+
+    // Computes the signature of path[starts[i]:ends[i]] for every i. The signatures and inverse signatures of every
+    // prefix of the path are computed once (see signature_and_inverse_forward), and then every window is evaluated
+    // with a single batched multiplication, of the inverse signature of the prefix up to its start with the signature
+    // of the prefix up to its end.
+    // Returns the windows' signatures, of shape (window, batch, channel), along with the prefix signatures and the path
+    // increments, which are what's needed for the backward pass.
+    // See signatory.signature_windows for documentation
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_windows_forward(torch::Tensor path, s_size_type depth, torch::Tensor starts, torch::Tensor ends,
+                              bool scalar_term, py::object workspace_capsule);
+
+    // The backward pass corresponding to signature_windows_forward. Both the prefix signatures and the inverse prefix
+    // signatures are handled in a single sweep backwards along the stream.
+    // Returns the gradient with respect to the path.
+    torch::Tensor signature_windows_backward(torch::Tensor grad_windows, torch::Tensor prefixes,
+                                             torch::Tensor path_increments, s_size_type depth, torch::Tensor starts,
+                                             torch::Tensor ends, bool scalar_term, py::object workspace_capsule);
+
+    // Checks the arguments for the signature_packed_forward function. 'data' and 'batch_sizes' are the corresponding
+    // attributes of a torch.nn.utils.rnn.PackedSequence.
+    void signature_packed_checkargs(torch::Tensor data, torch::Tensor batch_sizes, s_size_type depth, bool basepoint,
+                                    torch::Tensor basepoint_value, bool initial, torch::Tensor initial_value,
+                                    bool scalar_term);
+
+    // Computes the signature of every path in a batch of paths of different lengths, given in the packed format of
+    // torch.nn.utils.rnn.PackedSequence. The batch elements are assumed to be sorted by decreasing length, as a
+    // PackedSequence stores them; each step along the stream only updates those batch elements which are still
+    // running, so the cost is proportional to the total number of points rather than to the longest path.
+    // Returns the signatures, of shape (batch, channel), along with the increments of the path (in the same packed
+    // format as 'data'), which are what's needed for the backward pass.
+    // See signatory.signature_packed for documentation
+    std::tuple<torch::Tensor, torch::Tensor>
+    signature_packed_forward(torch::Tensor data, torch::Tensor batch_sizes, s_size_type depth, bool basepoint,
+                             torch::Tensor basepoint_value, bool inverse, bool initial, torch::Tensor initial_value,
+                             bool scalar_term, py::object workspace_capsule);
+
+    // The backward pass corresponding to signature_packed_forward. As with signature_backward, the signature is
+    // recomputed backwards along the stream.
+    // Returns the gradients with respect to the data, the basepoint and the initial value, respectively.
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_packed_backward(torch::Tensor grad_signature, torch::Tensor signature, torch::Tensor packed_increments,
+                              torch::Tensor batch_sizes, s_size_type depth, bool basepoint, bool inverse, bool initial,
+                              bool scalar_term, py::object workspace_capsule);
 }  // namespace signatory
 
 #endif //SIGNATORY_SIGNATURE_HPP
@@ -0,0 +1,611 @@
+/* Copyright 2019 Patrick Kidger. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ========================================================================= */
+ // The signature kernel k(x, y) = <S(x), S(y)> between two paths x and y (with S denoting the untruncated signature)
+ // is the solution K(s, t) at the final times of the Goursat PDE
+ //
+ //     d^2 K / ds dt = <dx/ds, dy/dt> K,    K(0, .) = K(., 0) = 1.
+ //
+ // For piecewise linear x and y, <dx/ds, dy/dt> is constant on each cell of the grid formed by the pairs of
+ // increments, and on each such cell we use the explicit second order scheme
+ //
+ //     K[p, q] = (K[p, q - 1] + K[p - 1, q]) (1 + g / 2 + g^2 / 12) - K[p - 1, q - 1] (1 - g^2 / 12),
+ //
+ // where g is the inner product of the corresponding increments. The accuracy of this may be improved by refining
+ // the grid: each increment is split into 2^dyadic_order equal pieces, so that each cell becomes 4^dyadic_order cells,
+ // each with g reduced by a factor of 4^dyadic_order.
+ //
+ // The grid of one pair of paths never needs to be held in memory in the forward pass. The backward pass is the exact
+ // (discrete) adjoint of the scheme above, for which the grid is recomputed.
+
+
+#include <torch/extension.h>
+#include <algorithm>  // std::fill, std::max, std::min
+#include <cmath>      // std::sqrt
+#include <cstdint>    // int64_t
+#include <stdexcept>  // std::invalid_argument
+#include <tuple>      // std::ignore, std::tie, std::tuple
+#include <utility>    // std::swap
+#include <vector>     // std::vector
+
+#include "misc.hpp"
+#include "profiling.hpp"
+#include "signature.hpp"  // signatory::signature::detail::compute_path_increments,
+                          // signatory::signature::detail::compute_path_increments_backward,
+                          // signatory::signature::detail::is_reduced_precision
+#include "signature_kernel.hpp"
+#ifdef SIGNATORY_CUDA
+#include "signature_kernel_cuda.hpp"
+#endif
+
+
+namespace signatory {
+    namespace signature_kernel {
+        namespace detail {
+            // Roughly how many elements of (refined) grid to handle in one go. Pairs of paths are handled in tiles of
+            // about this size, which bounds the amount of memory used by the backward pass and by the solve on the
+            // GPU, and keeps the inner products being worked on in cache. (Not constant, so that the tests can make it
+            // small enough to exercise the tiling; see set_tile_elements.)
+            int64_t tile_elements = 1 << 24;
+
+            // Computes the inner products between the increments of the paths, i.e. <dx/ds, dy/dt> on each cell of
+            // the (unrefined) grid. 'x' and 'y' should be of shape (batch1, stream1, channel) and
+            // (batch2, stream2, channel) respectively. The result is of shape (pairs, stream1, stream2), where if
+            // gram==true then the pairs are every path of 'x' with every path of 'y' (with the index into 'y' varying
+            // fastest), and otherwise they are corresponding paths of each.
+            torch::Tensor compute_inner_products(torch::Tensor x, torch::Tensor y, bool gram) {
+                if (gram) {
+                    return torch::matmul(x.unsqueeze(/*dim=*/1), y.transpose(1, 2).unsqueeze(/*dim=*/0)).reshape(
+                            {x.size(0) * y.size(0), x.size(1), y.size(1)});
+                }
+                else {
+                    return torch::bmm(x, y.transpose(1, 2));
+                }
+            }
+
+            // The backward pass through compute_inner_products. The gradients are added on to 'grad_x' and 'grad_y'.
+            void compute_inner_products_backward(torch::Tensor grad_inner_products, torch::Tensor x, torch::Tensor y,
+                                                 bool gram, torch::Tensor grad_x, torch::Tensor grad_y) {
+                int64_t batch1 = x.size(0);
+                int64_t batch2 = y.size(0);
+                int64_t stream1 = x.size(1);
+                int64_t stream2 = y.size(1);
+                int64_t channels = x.size(2);
+                if (gram) {
+                    torch::Tensor grad = grad_inner_products.view({batch1, batch2, stream1, stream2});
+                    grad_x += torch::matmul(grad.permute({0, 2, 1, 3}).reshape({batch1, stream1, batch2 * stream2}),
+                                            y.reshape({batch2 * stream2, channels}));
+                    grad_y += torch::matmul(grad.permute({1, 3, 0, 2}).reshape({batch2, stream2, batch1 * stream1}),
+                                            x.reshape({batch1 * stream1, channels}));
+                }
+                else {
+                    grad_x += torch::bmm(grad_inner_products, y);
+                    grad_y += torch::bmm(grad_inner_products.transpose(1, 2), x);
+                }
+            }
+
+            // The inner products scaled down as appropriate for the refined grid.
+            template <typename scalar_t>
+            scalar_t refinement_scale(int64_t dyadic_order) {
+                return scalar_t(1) / static_cast<scalar_t>(int64_t(1) << (2 * dyadic_order));
+            }
+
+            // How many threads to use for solving the PDE for this many pairs on the CPU. (Same magic number as in
+            // signature_forward.)
+            int64_t cpu_threads(int64_t num_pairs, int64_t rows, int64_t columns) {
+                if (num_pairs * rows * columns < 81899) {
+                    return 1;
+                }
+                return std::min(num_pairs, misc::max_threads());
+            }
+
+            // Solves the PDE for each pair on the CPU. Each pair is handled by a single thread, which sweeps along the
+            // rows of the grid, holding only the current and previous rows in memory.
+            // 'inner_products' should be as returned by compute_inner_products; the results are written into 'out',
+            // of shape (pairs,).
+            template <typename scalar_t>
+            void solve_cpu(torch::Tensor inner_products, torch::Tensor out, int64_t dyadic_order) {
+                int64_t num_pairs = inner_products.size(0);
+                int64_t coarse_rows = inner_products.size(1);
+                int64_t coarse_columns = inner_products.size(2);
+                int64_t rows = coarse_rows << dyadic_order;
+                int64_t columns = coarse_columns << dyadic_order;
+                scalar_t scale = refinement_scale<scalar_t>(dyadic_order);
+
+                torch::Tensor inner_products_contiguous = inner_products.contiguous();
+                const scalar_t* inner_products_ptr = inner_products_contiguous.data_ptr<scalar_t>();
+                auto out_a = out.accessor<scalar_t, 1>();
+
+                misc::parallel_for(num_pairs, cpu_threads(num_pairs, rows, columns), [&](int64_t begin, int64_t end) {
+                    std::vector<scalar_t> before(columns + 1);
+                    std::vector<scalar_t> current(columns + 1);
+                    for (int64_t pair = begin; pair < end; ++pair) {
+                        const scalar_t* pair_inner_products = inner_products_ptr + pair * coarse_rows * coarse_columns;
+                        std::fill(before.begin(), before.end(), scalar_t(1));
+                        current[0] = 1;
+                        for (int64_t row = 1; row <= rows; ++row) {
+                            const scalar_t* row_inner_products = pair_inner_products +
+                                                                 ((row - 1) >> dyadic_order) * coarse_columns;
+                            for (int64_t column = 1; column <= columns; ++column) {
+                                scalar_t g = row_inner_products[(column - 1) >> dyadic_order] * scale;
+                                scalar_t g2 = g * g / 12;
+                                current[column] = (current[column - 1] + before[column]) * (1 + g / 2 + g2) -
+                                                  before[column - 1] * (1 - g2);
+                            }
+                            std::swap(before, current);
+                        }
+                        out_a[pair] = before[columns];
+                    }
+                });
+            }
+
+            // The backward pass through solve_cpu. 'grad_out' should be of shape (pairs,). The gradients with respect
+            // to the inner products are written into 'grad_inner_products'.
+            // Each pair is handled by a single thread, which first recomputes its whole grid, and then sweeps backwards
+            // through it computing the gradients with respect to each element of the grid, a row at a time.
+            template <typename scalar_t>
+            void solve_backward_cpu(torch::Tensor inner_products, torch::Tensor grad_out,
+                                    torch::Tensor grad_inner_products, int64_t dyadic_order) {
+                int64_t num_pairs = inner_products.size(0);
+                int64_t coarse_rows = inner_products.size(1);
+                int64_t coarse_columns = inner_products.size(2);
+                int64_t rows = coarse_rows << dyadic_order;
+                int64_t columns = coarse_columns << dyadic_order;
+                scalar_t scale = refinement_scale<scalar_t>(dyadic_order);
+
+                torch::Tensor inner_products_contiguous = inner_products.contiguous();
+                const scalar_t* inner_products_ptr = inner_products_contiguous.data_ptr<scalar_t>();
+                torch::Tensor grad_out_contiguous = grad_out.contiguous();
+                const scalar_t* grad_out_ptr = grad_out_contiguous.data_ptr<scalar_t>();
+                scalar_t* grad_inner_products_ptr = grad_inner_products.data_ptr<scalar_t>();
+
+                misc::parallel_for(num_pairs, cpu_threads(num_pairs, rows, columns), [&](int64_t begin, int64_t end) {
+                    std::vector<scalar_t> grid((rows + 1) * (columns + 1));
+                    std::vector<scalar_t> grad_after(columns + 1);
+                    std::vector<scalar_t> grad_current(columns + 1);
+                    for (int64_t pair = begin; pair < end; ++pair) {
+                        const scalar_t* pair_inner_products = inner_products_ptr + pair * coarse_rows * coarse_columns;
+                        scalar_t* pair_grad_inner_products = grad_inner_products_ptr +
+                                                             pair * coarse_rows * coarse_columns;
+                        auto inner_product = [&](int64_t row, int64_t column) {
+                            return pair_inner_products[(row >> dyadic_order) * coarse_columns +
+                                                       (column >> dyadic_order)] * scale;
+                        };
+
+                        // Recompute the grid, as in solve_cpu.
+                        std::fill(grid.begin(), grid.begin() + columns + 1, scalar_t(1));
+                        for (int64_t row = 1; row <= rows; ++row) {
+                            scalar_t* current = grid.data() + row * (columns + 1);
+                            scalar_t* before = current - (columns + 1);
+                            current[0] = 1;
+                            for (int64_t column = 1; column <= columns; ++column) {
+                                scalar_t g = inner_product(row - 1, column - 1);
+                                scalar_t g2 = g * g / 12;
+                                current[column] = (current[column - 1] + before[column]) * (1 + g / 2 + g2) -
+                                                  before[column - 1] * (1 - g2);
+                            }
+                        }
+
+                        // Now go backwards. grad_current[column] is the gradient with respect to grid[row, column],
+                        // and grad_after the same for the row after.
+                        for (int64_t row = rows; row >= 1; --row) {
+                            const scalar_t* current = grid.data() + row * (columns + 1);
+                            const scalar_t* before = current - (columns + 1);
+                            for (int64_t column = columns; column >= 1; --column) {
+                                scalar_t grad = (row == rows && column == columns) ? grad_out_ptr[pair] : scalar_t(0);
+                                if (column < columns) {
+                                    scalar_t g = inner_product(row - 1, column);
+                                    grad += grad_current[column + 1] * (1 + g / 2 + g * g / 12);
+                                }
+                                if (row < rows) {
+                                    scalar_t g = inner_product(row, column - 1);
+                                    grad += grad_after[column] * (1 + g / 2 + g * g / 12);
+                                    if (column < columns) {
+                                        scalar_t g_diag = inner_product(row, column);
+                                        grad -= grad_after[column + 1] * (1 - g_diag * g_diag / 12);
+                                    }
+                                }
+                                grad_current[column] = grad;
+
+                                scalar_t g = inner_product(row - 1, column - 1);
+                                scalar_t grad_g = grad * ((current[column - 1] + before[column]) *
+                                                          (scalar_t(0.5) + g / 6) + before[column - 1] * g / 6);
+                                pair_grad_inner_products[((row - 1) >> dyadic_order) * coarse_columns +
+                                                         ((column - 1) >> dyadic_order)] += grad_g * scale;
+                            }
+                            std::swap(grad_after, grad_current);
+                        }
+                    }
+                });
+            }
+
+            // Returns the inner products on the refined grid, of shape (pairs, rows, columns).
+            torch::Tensor refine(torch::Tensor inner_products, int64_t dyadic_order) {
+                if (dyadic_order == 0) {
+                    return inner_products;
+                }
+                int64_t repeats = int64_t(1) << dyadic_order;
+                double scale = 1.0 / static_cast<double>(repeats * repeats);
+                return inner_products.repeat_interleave(repeats, /*dim=*/1).repeat_interleave(repeats, /*dim=*/2) *
+                       scale;
+            }
+
+            // The elements on the anti-diagonal p + q == diagonal of a tensor of shape (pairs, rows, row_stride),
+            // with p ranging over [row_start, row_start + length), and q == diagonal - p - column_offset.
+            torch::Tensor anti_diagonal(torch::Tensor tensor, int64_t row_start, int64_t length, int64_t diagonal,
+                                        int64_t column_offset) {
+                int64_t row_stride = tensor.size(2);
+                return tensor.as_strided({tensor.size(0), length}, {tensor.size(1) * row_stride, row_stride - 1},
+                                         tensor.storage_offset() + row_start * (row_stride - 1) + diagonal -
+                                         column_offset);
+            }
+
+            // Sums up the gradients with respect to the inner products on the refined grid, to get the gradients with
+            // respect to the original inner products; i.e. the backward pass through refine.
+            torch::Tensor coarsen(torch::Tensor grad_refined, int64_t coarse_rows, int64_t coarse_columns,
+                                  int64_t dyadic_order) {
+                if (dyadic_order == 0) {
+                    return grad_refined;
+                }
+                int64_t repeats = int64_t(1) << dyadic_order;
+                double scale = 1.0 / static_cast<double>(repeats * repeats);
+                return grad_refined.reshape({grad_refined.size(0), coarse_rows, repeats, coarse_columns,
+                                             repeats}).sum({2, 4}) * scale;
+            }
+
+            // Solves the PDE for each pair, in terms of high-level PyTorch operations. This is what is used on the
+            // GPU if the hand-written CUDA kernels aren't available. Each operation handles an entire anti-diagonal
+            // of the grid, of every pair at once; the elements of each anti-diagonal depend only on the previous two.
+            // Returns the whole grid, of shape (pairs, rows + 1, columns + 1).
+            torch::Tensor solve_grid_high_level(torch::Tensor inner_products, int64_t dyadic_order) {
+                torch::Tensor refined = refine(inner_products, dyadic_order);
+                int64_t num_pairs = refined.size(0);
+                int64_t rows = refined.size(1);
+                int64_t columns = refined.size(2);
+                torch::Tensor refined_squared = refined * refined / 12;
+                torch::Tensor coefficient = (1 + refined / 2 + refined_squared).contiguous();
+                torch::Tensor diagonal_coefficient = (1 - refined_squared).contiguous();
+
+                torch::Tensor grid = torch::ones({num_pairs, rows + 1, columns + 1}, refined.options());
+                for (int64_t diagonal = 2; diagonal <= rows + columns; ++diagonal) {
+                    int64_t row_start = std::max<int64_t>(1, diagonal - columns);
+                    int64_t length = std::min(rows, diagonal - 1) - row_start + 1;
+                    // grid[p, q], grid[p, q - 1], grid[p - 1, q] and grid[p - 1, q - 1] for q == diagonal - p.
+                    // The coefficients for grid[p, q] are at [p - 1, q - 1] of their tensors.
+                    torch::Tensor current = anti_diagonal(grid, row_start, length, diagonal, 0);
+                    torch::Tensor left = anti_diagonal(grid, row_start, length, diagonal, 1);
+                    torch::Tensor up = anti_diagonal(grid, row_start - 1, length, diagonal - 1, 0);
+                    torch::Tensor diag = anti_diagonal(grid, row_start - 1, length, diagonal - 1, 1);
+                    torch::Tensor coeff = anti_diagonal(coefficient, row_start - 1, length, diagonal - 1, 1);
+                    torch::Tensor diag_coeff = anti_diagonal(diagonal_coefficient, row_start - 1, length,
+                                                             diagonal - 1, 1);
+                    current.copy_((left + up) * coeff - diag * diag_coeff);
+                }
+                return grid;
+            }
+
+            // The backward pass through solve_grid_high_level, returning the gradients with respect to the inner
+            // products. Goes backwards along the anti-diagonals in the same way.
+            torch::Tensor solve_backward_high_level(torch::Tensor inner_products, torch::Tensor grad_out,
+                                                    int64_t dyadic_order) {
+                torch::Tensor grid = solve_grid_high_level(inner_products, dyadic_order);
+                torch::Tensor refined = refine(inner_products, dyadic_order);
+                int64_t num_pairs = refined.size(0);
+                int64_t rows = refined.size(1);
+                int64_t columns = refined.size(2);
+                torch::Tensor refined_squared = refined * refined / 12;
+
+                // The coefficients are padded with zeros, so that the gradients flowing back from outside the grid are
+                // zero without needing special cases.
+                torch::Tensor coefficient = torch::zeros({num_pairs, rows + 1, columns + 1}, refined.options());
+                torch::Tensor diagonal_coefficient = torch::zeros({num_pairs, rows + 1, columns + 1},
+                                                                  refined.options());
+                coefficient.narrow(/*dim=*/1, 0, rows).narrow(/*dim=*/2, 0, columns).copy_(1 + refined / 2 +
+                                                                                           refined_squared);
+                diagonal_coefficient.narrow(/*dim=*/1, 0, rows).narrow(/*dim=*/2, 0, columns).copy_(1 -
+                                                                                                    refined_squared);
+
+                // grad_grid[p, q] is the gradient with respect to grid[p, q]; padded in the same way.
+                torch::Tensor grad_grid = torch::zeros({num_pairs, rows + 2, columns + 2}, refined.options());
+                grad_grid.select(/*dim=*/1, rows).select(/*dim=*/1, columns).copy_(grad_out);
+                for (int64_t diagonal = rows + columns - 1; diagonal >= 2; --diagonal) {
+                    int64_t row_start = std::max<int64_t>(1, diagonal - columns);
+                    int64_t length = std::min(rows, diagonal - 1) - row_start + 1;
+                    // The gradients with respect to grid[p, q] for q == diagonal - p, from grid[p, q + 1],
+                    // grid[p + 1, q] and grid[p + 1, q + 1].
+                    torch::Tensor current = anti_diagonal(grad_grid, row_start, length, diagonal, 0);
+                    torch::Tensor right = anti_diagonal(grad_grid, row_start, length, diagonal, -1);
+                    torch::Tensor down = anti_diagonal(grad_grid, row_start + 1, length, diagonal + 1, 0);
+                    torch::Tensor down_right = anti_diagonal(grad_grid, row_start + 1, length, diagonal + 1, -1);
+                    torch::Tensor right_coeff = anti_diagonal(coefficient, row_start - 1, length, diagonal - 1, 0);
+                    torch::Tensor down_coeff = anti_diagonal(coefficient, row_start, length, diagonal, 1);
+                    torch::Tensor down_right_coeff = anti_diagonal(diagonal_coefficient, row_start, length, diagonal,
+                                                                   0);
+                    current.copy_(right * right_coeff + down * down_coeff - down_right * down_right_coeff);
+                }
+
+                torch::Tensor grad_cells = grad_grid.narrow(/*dim=*/1, 1, rows).narrow(/*dim=*/2, 1, columns);
+                torch::Tensor left = grid.narrow(/*dim=*/1, 1, rows).narrow(/*dim=*/2, 0, columns);
+                torch::Tensor up = grid.narrow(/*dim=*/1, 0, rows).narrow(/*dim=*/2, 1, columns);
+                torch::Tensor diag = grid.narrow(/*dim=*/1, 0, rows).narrow(/*dim=*/2, 0, columns);
+                torch::Tensor grad_refined = grad_cells * ((left + up) * (0.5 + refined / 6) + diag * refined / 6);
+                return coarsen(grad_refined, inner_products.size(1), inner_products.size(2), dyadic_order);
+            }
+
+            // Solves the PDE for each pair, returning a tensor of shape (pairs,). 'inner_products' should be as
+            // returned by compute_inner_products.
+            torch::Tensor solve(torch::Tensor inner_products, int64_t dyadic_order) {
+                int64_t num_pairs = inner_products.size(0);
+                if (inner_products.is_cuda()) {
+                    #ifdef SIGNATORY_CUDA
+                    if (solve_cuda_kernel_supported(inner_products.size(1) << dyadic_order,
+                                                    inner_products.scalar_type())) {
+                        torch::Tensor out = torch::empty({num_pairs}, inner_products.options());
+                        solve_cuda_kernel(inner_products, out, /*grid=*/torch::Tensor(), dyadic_order);
+                        return out;
+                    }
+                    #endif
+                    torch::Tensor grid = solve_grid_high_level(inner_products, dyadic_order);
+                    return grid.select(/*dim=*/1, /*index=*/-1).select(/*dim=*/1, /*index=*/-1).clone();
+                }
+
+                torch::Tensor out = torch::empty({num_pairs}, inner_products.options());
+                AT_DISPATCH_FLOATING_TYPES(inner_products.scalar_type(), "solve_cpu", ([&] {
+                    solve_cpu<scalar_t>(inner_products, out, dyadic_order);
+                }));
+                return out;
+            }
+
+            // The backward pass through solve. Returns the gradients with respect to the inner products.
+            torch::Tensor solve_backward(torch::Tensor inner_products, torch::Tensor grad_out, int64_t dyadic_order) {
+                if (inner_products.is_cuda()) {
+                    #ifdef SIGNATORY_CUDA
+                    int64_t rows = inner_products.size(1) << dyadic_order;
+                    int64_t columns = inner_products.size(2) << dyadic_order;
+                    if (solve_cuda_kernel_supported(rows, inner_products.scalar_type())) {
+                        int64_t num_pairs = inner_products.size(0);
+                        torch::Tensor grid = torch::empty({num_pairs, rows + 1, columns + 1},
+                                                          inner_products.options());
+                        torch::Tensor out = torch::empty({num_pairs}, inner_products.options());
+                        solve_cuda_kernel(inner_products, out, grid, dyadic_order);
+                        torch::Tensor grad_refined = torch::empty({num_pairs, rows, columns}, inner_products.options());
+                        solve_backward_cuda_kernel(inner_products, grid, grad_out, grad_refined, dyadic_order);
+                        return coarsen(grad_refined, inner_products.size(1), inner_products.size(2), dyadic_order);
+                    }
+                    #endif
+                    return solve_backward_high_level(inner_products, grad_out, dyadic_order);
+                }
+
+                torch::Tensor grad_inner_products = torch::zeros(inner_products.sizes(), inner_products.options());
+                AT_DISPATCH_FLOATING_TYPES(inner_products.scalar_type(), "solve_backward_cpu", ([&] {
+                    solve_backward_cpu<scalar_t>(inner_products, grad_out, grad_inner_products, dyadic_order);
+                }));
+                return grad_inner_products;
+            }
+
+            int64_t set_tile_elements(int64_t elements) {
+                if (elements < 1) {
+                    throw std::invalid_argument("The number of elements in a tile must be at least 1.");
+                }
+                int64_t previous = tile_elements;
+                tile_elements = elements;
+                return previous;
+            }
+
+            // How many pairs to handle in each tile.
+            int64_t pairs_per_tile(int64_t rows, int64_t columns) {
+                return std::max<int64_t>(1, tile_elements / ((rows + 1) * (columns + 1)));
+            }
+
+            // When computing a Gram matrix, each tile is a block of paths from each batch; this returns the number of
+            // paths from each. These are chosen to be as close to equal as possible, as then each path is reused as
+            // many times as possible whilst it is in cache.
+            std::tuple<int64_t, int64_t> gram_tile(int64_t batch_size1, int64_t batch_size2, int64_t tile_pairs) {
+                auto side = static_cast<int64_t>(std::sqrt(static_cast<double>(tile_pairs)));
+                int64_t block_size1 = std::min(batch_size1, std::max<int64_t>(1, side));
+                int64_t block_size2 = std::min(batch_size2, std::max<int64_t>(1, tile_pairs / block_size1));
+                block_size1 = std::min(batch_size1, std::max<int64_t>(1, tile_pairs / block_size2));
+                return std::tuple<int64_t, int64_t> {block_size1, block_size2};
+            }
+        }  // namespace signatory::signature_kernel::detail
+    }  // namespace signatory::signature_kernel
+
+    void signature_kernel_checkargs(torch::Tensor path1, torch::Tensor path2, bool basepoint, int64_t dyadic_order,
+                                    bool gram) {
+        if (path1.ndimension() != 3) {
+            throw std::invalid_argument("Argument 'path1' must be a 3-dimensional tensor, with dimensions "
+                                        "corresponding to (batch, stream, channel) respectively.");
+        }
+        if (path2.ndimension() != 3) {
+            throw std::invalid_argument("Argument 'path2' must be a 3-dimensional tensor, with dimensions "
+                                        "corresponding to (batch, stream, channel) respectively.");
+        }
+        if (path1.size(batch_dim) == 0 || path1.size(stream_dim) == 0 || path1.size(channel_dim) == 0) {
+            throw std::invalid_argument("Argument 'path1' cannot have dimensions of size zero.");
+        }
+        if (path2.size(batch_dim) == 0 || path2.size(stream_dim) == 0 || path2.size(channel_dim) == 0) {
+            throw std::invalid_argument("Argument 'path2' cannot have dimensions of size zero.");
+        }
+        if (!basepoint && (path1.size(stream_dim) == 1 || path2.size(stream_dim) == 1)) {
+            throw std::invalid_argument("Arguments 'path1' and 'path2' must have stream dimension of size at least 2. "
+                                        "(Need at least this many points to define a path.)");
+        }
+        if (path1.size(channel_dim) != path2.size(channel_dim)) {
+            throw std::invalid_argument("Arguments 'path1' and 'path2' must have the same number of channels.");
+        }
+        if (!gram && path1.size(batch_dim) != path2.size(batch_dim)) {
+            throw std::invalid_argument("Arguments 'path1' and 'path2' must have the same batch size, unless "
+                                        "gram=True.");
+        }
+        if (!path1.is_floating_point()) {
+            throw std::invalid_argument("Argument 'path1' must be of floating point type.");
+        }
+        if (path1.device() != path2.device()) {
+            throw std::invalid_argument("Argument 'path2' does not have the same device as 'path1'.");
+        }
+        if (path1.dtype() != path2.dtype()) {
+            throw std::invalid_argument("Argument 'path2' does not have the same dtype as 'path1'.");
+        }
+        if (dyadic_order < 0) {
+            throw std::invalid_argument("Argument 'dyadic_order' must be an integer greater than or equal to zero.");
+        }
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_kernel_forward(torch::Tensor path1, torch::Tensor path2, bool basepoint, int64_t dyadic_order,
+                             bool gram) {
+        py::gil_scoped_release release;
+        signature_kernel_checkargs(path1, path2, basepoint, dyadic_order, gram);
+
+        // No sense keeping track of gradients when we have a dedicated backwards function
+        path1 = path1.detach();
+        path2 = path2.detach();
+
+        // As with signatures, the solution is a product of many terms close to one, so reduced precision dtypes are
+        // computed in float32.
+        torch::ScalarType storage_dtype = path1.scalar_type();
+        if (signature::detail::is_reduced_precision(storage_dtype)) {
+            path1 = path1.to(torch::kFloat32);
+            path2 = path2.to(torch::kFloat32);
+        }
+
+        torch::Tensor path_increments1 = signature::detail::compute_path_increments(
+                path1, basepoint, torch::zeros({path1.size(batch_dim), path1.size(channel_dim)}, path1.options()),
+                /*inverse=*/false);
+        torch::Tensor path_increments2 = signature::detail::compute_path_increments(
+                path2, basepoint, torch::zeros({path2.size(batch_dim), path2.size(channel_dim)}, path2.options()),
+                /*inverse=*/false);
+        // (stream, batch, channel) to (batch, stream, channel)
+        torch::Tensor x = path_increments1.transpose(0, 1);
+        torch::Tensor y = path_increments2.transpose(0, 1);
+
+        int64_t batch_size1 = x.size(0);
+        int64_t batch_size2 = y.size(0);
+        int64_t tile_pairs = signature_kernel::detail::pairs_per_tile(x.size(1) << dyadic_order,
+                                                                      y.size(1) << dyadic_order);
+
+        torch::Tensor kernel;
+        if (gram) {
+            kernel = torch::empty({batch_size1, batch_size2}, x.options());
+            int64_t block_size1;
+            int64_t block_size2;
+            std::tie(block_size1, block_size2) = signature_kernel::detail::gram_tile(batch_size1, batch_size2,
+                                                                                     tile_pairs);
+            for (int64_t start1 = 0; start1 < batch_size1; start1 += block_size1) {
+                int64_t length1 = std::min(block_size1, batch_size1 - start1);
+                torch::Tensor x_block = x.narrow(/*dim=*/0, start1, length1);
+                for (int64_t start2 = 0; start2 < batch_size2; start2 += block_size2) {
+                    int64_t length2 = std::min(block_size2, batch_size2 - start2);
+                    SIGNATORY_PROFILE_STAGE("signature_kernel_tile");
+                    torch::Tensor y_block = y.narrow(/*dim=*/0, start2, length2);
+                    torch::Tensor inner_products = signature_kernel::detail::compute_inner_products(x_block, y_block,
+                                                                                                    /*gram=*/true);
+                    torch::Tensor kernel_block = signature_kernel::detail::solve(inner_products, dyadic_order);
+                    kernel.narrow(/*dim=*/0, start1, length1).narrow(/*dim=*/1, start2, length2).copy_(
+                            kernel_block.view({length1, length2}));
+                }
+            }
+        }
+        else {
+            kernel = torch::empty({batch_size1}, x.options());
+            for (int64_t start = 0; start < batch_size1; start += tile_pairs) {
+                SIGNATORY_PROFILE_STAGE("signature_kernel_tile");
+                int64_t length = std::min(tile_pairs, batch_size1 - start);
+                torch::Tensor inner_products = signature_kernel::detail::compute_inner_products(
+                        x.narrow(/*dim=*/0, start, length), y.narrow(/*dim=*/0, start, length), /*gram=*/false);
+                kernel.narrow(/*dim=*/0, start, length).copy_(signature_kernel::detail::solve(inner_products,
+                                                                                              dyadic_order));
+            }
+        }
+
+        return std::tuple<torch::Tensor, torch::Tensor, torch::Tensor> {kernel.to(storage_dtype), path_increments1,
+                                                                        path_increments2};
+    }
+
+    std::tuple<torch::Tensor, torch::Tensor>
+    signature_kernel_backward(torch::Tensor grad_kernel, torch::Tensor path_increments1,
+                              torch::Tensor path_increments2, bool basepoint, int64_t dyadic_order, bool gram) {
+        py::gil_scoped_release release;
+
+        // The increments are already in float32 if the paths were at reduced precision.
+        torch::ScalarType storage_dtype = grad_kernel.scalar_type();
+        grad_kernel = grad_kernel.to(path_increments1.scalar_type());
+
+        // (stream, batch, channel) to (batch, stream, channel)
+        torch::Tensor x = path_increments1.transpose(0, 1);
+        torch::Tensor y = path_increments2.transpose(0, 1);
+        torch::Tensor grad_x = torch::zeros(x.sizes(), x.options());
+        torch::Tensor grad_y = torch::zeros(y.sizes(), y.options());
+
+        int64_t batch_size1 = x.size(0);
+        int64_t batch_size2 = y.size(0);
+        int64_t tile_pairs = signature_kernel::detail::pairs_per_tile(x.size(1) << dyadic_order,
+                                                                      y.size(1) << dyadic_order);
+
+        // The tiles are the same as in signature_kernel_forward. The inner products are cheap enough that they are
+        // just recomputed, rather than saved from the forward pass.
+        if (gram) {
+            int64_t block_size1;
+            int64_t block_size2;
+            std::tie(block_size1, block_size2) = signature_kernel::detail::gram_tile(batch_size1, batch_size2,
+                                                                                     tile_pairs);
+            for (int64_t start1 = 0; start1 < batch_size1; start1 += block_size1) {
+                int64_t length1 = std::min(block_size1, batch_size1 - start1);
+                torch::Tensor x_block = x.narrow(/*dim=*/0, start1, length1);
+                torch::Tensor grad_x_block = grad_x.narrow(/*dim=*/0, start1, length1);
+                for (int64_t start2 = 0; start2 < batch_size2; start2 += block_size2) {
+                    int64_t length2 = std::min(block_size2, batch_size2 - start2);
+                    SIGNATORY_PROFILE_STAGE("signature_kernel_tile_backward");
+                    torch::Tensor y_block = y.narrow(/*dim=*/0, start2, length2);
+                    torch::Tensor inner_products = signature_kernel::detail::compute_inner_products(x_block, y_block,
+                                                                                                    /*gram=*/true);
+                    torch::Tensor grad_kernel_block = grad_kernel.narrow(/*dim=*/0, start1, length1).narrow(
+                            /*dim=*/1, start2, length2).reshape({length1 * length2});
+                    torch::Tensor grad_inner_products = signature_kernel::detail::solve_backward(inner_products,
+                                                                                                 grad_kernel_block,
+                                                                                                 dyadic_order);
+                    signature_kernel::detail::compute_inner_products_backward(grad_inner_products, x_block, y_block,
+                                                                              /*gram=*/true, grad_x_block,
+                                                                              grad_y.narrow(/*dim=*/0, start2,
+                                                                                            length2));
+                }
+            }
+        }
+        else {
+            for (int64_t start = 0; start < batch_size1; start += tile_pairs) {
+                SIGNATORY_PROFILE_STAGE("signature_kernel_tile_backward");
+                int64_t length = std::min(tile_pairs, batch_size1 - start);
+                torch::Tensor x_block = x.narrow(/*dim=*/0, start, length);
+                torch::Tensor y_block = y.narrow(/*dim=*/0, start, length);
+                torch::Tensor inner_products = signature_kernel::detail::compute_inner_products(x_block, y_block,
+                                                                                                /*gram=*/false);
+                torch::Tensor grad_inner_products = signature_kernel::detail::solve_backward(
+                        inner_products, grad_kernel.narrow(/*dim=*/0, start, length), dyadic_order);
+                signature_kernel::detail::compute_inner_products_backward(grad_inner_products, x_block, y_block,
+                                                                          /*gram=*/false,
+                                                                          grad_x.narrow(/*dim=*/0, start, length),
+                                                                          grad_y.narrow(/*dim=*/0, start, length));
+            }
+        }
+
+        torch::Tensor grad_path1;
+        torch::Tensor grad_path2;
+        // (batch, stream, channel) to (stream, batch, channel)
+        std::tie(grad_path1, std::ignore) = signature::detail::compute_path_increments_backward(
+                grad_x.transpose(0, 1), basepoint, /*inverse=*/false, x.options());
+        std::tie(grad_path2, std::ignore) = signature::detail::compute_path_increments_backward(
+                grad_y.transpose(0, 1), basepoint, /*inverse=*/false, y.options());
+        return std::tuple<torch::Tensor, torch::Tensor> {grad_path1.to(storage_dtype), grad_path2.to(storage_dtype)};
+    }
+}  // namespace signatory
@@ -0,0 +1,58 @@
+/* Copyright 2019 Patrick Kidger. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ========================================================================= */
+ // Provides the computation of (untruncated) signature kernels, by solving the Goursat PDE that they satisfy.
+
+
+#ifndef SIGNATORY_SIGNATURE_KERNEL_HPP
+#define SIGNATORY_SIGNATURE_KERNEL_HPP
+
+#include <torch/extension.h>
+#include <cstdint>  // int64_t
+#include <tuple>    // std::tuple
+
+
+namespace signatory {
+    namespace signature_kernel {
+        namespace detail {
+            // Sets roughly how many elements of grid are handled in one go, and returns the previous value. Only
+            // intended for use by the tests, so that small inputs are still split into several tiles.
+            int64_t set_tile_elements(int64_t elements);
+        }  // namespace signatory::signature_kernel::detail
+    }  // namespace signatory::signature_kernel
+
+    // Checks the arguments for the signature_kernel_forward function.
+    void signature_kernel_checkargs(torch::Tensor path1, torch::Tensor path2, bool basepoint, int64_t dyadic_order,
+                                    bool gram);
+
+    // Computes the signature kernel between the paths 'path1' and 'path2', which should be of shape
+    // (stream, batch, channel).
+    // If gram==true then the kernel is computed between every path in 'path1' and every path in 'path2', and the result
+    // is of shape (batch1, batch2). Else the batch sizes must be equal, the kernel is computed between corresponding
+    // pairs of paths, and the result is of shape (batch,).
+    // Each increment of each path is split into 2^dyadic_order pieces when solving the PDE, which improves the
+    // accuracy of the solution.
+    // Returns the kernel and the increments of the two paths; the latter are needed for the backward pass.
+    std::tuple<torch::Tensor, torch::Tensor, torch::Tensor>
+    signature_kernel_forward(torch::Tensor path1, torch::Tensor path2, bool basepoint, int64_t dyadic_order,
+                             bool gram);
+
+    // Computes the backward pass of signature_kernel_forward. Returns the gradients with respect to 'path1' and
+    // 'path2'.
+    std::tuple<torch::Tensor, torch::Tensor>
+    signature_kernel_backward(torch::Tensor grad_kernel, torch::Tensor path_increments1,
+                              torch::Tensor path_increments2, bool basepoint, int64_t dyadic_order, bool gram);
+}  // namespace signatory
+
+#endif //SIGNATORY_SIGNATURE_KERNEL_HPP
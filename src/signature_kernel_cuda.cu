@@ -0,0 +1,226 @@
+/* Copyright 2019 Patrick Kidger. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ========================================================================= */
+
+
+#include <torch/extension.h>
+#include <ATen/cuda/CUDAContext.h>
+#include <cstdint>    // int64_t
+
+#include "signature_kernel_cuda.hpp"
+
+
+namespace signatory {
+    namespace signature_kernel {
+        namespace detail {
+            // Upper limit on the number of threads to use in a block. Each block handles a single pair, and the
+            // amount of parallelisable work is the length of an anti-diagonal of the grid.
+            constexpr int64_t max_cuda_threads = 256;
+
+            // The amount of shared memory that may be used by a block without opting in to more.
+            constexpr int64_t max_shared_memory = 48 * 1024;
+
+            int64_t num_cuda_threads(int64_t work) {
+                int64_t num_threads = 32;
+                while (num_threads < work && num_threads < max_cuda_threads) {
+                    num_threads *= 2;
+                }
+                return num_threads;
+            }
+
+            // The inner product of a pair of increments of the refined grid, for the cell whose solution is at
+            // (row + 1, column + 1).
+            template <typename scalar_t>
+            __device__ __forceinline__ scalar_t refined_inner_product(const scalar_t* inner_products, int64_t row,
+                                                                      int64_t column, int64_t coarse_columns,
+                                                                      int64_t dyadic_order, scalar_t scale) {
+                return inner_products[(row >> dyadic_order) * coarse_columns + (column >> dyadic_order)] * scale;
+            }
+
+            // Every block handles a single pair. The grid is swept along its anti-diagonals, which are indexed by
+            // row; the current anti-diagonal and the two before it are held in shared memory.
+            // The scheme is the same as in solve_cpu; see there.
+            template <typename scalar_t>
+            __global__ void solve_kernel(const scalar_t* __restrict__ inner_products,
+                                         scalar_t* __restrict__ out,
+                                         scalar_t* __restrict__ grid,
+                                         int64_t coarse_rows,
+                                         int64_t coarse_columns,
+                                         int64_t dyadic_order) {
+                extern __shared__ unsigned char shared_memory[];
+                int64_t rows = coarse_rows << dyadic_order;
+                int64_t columns = coarse_columns << dyadic_order;
+                scalar_t scale = scalar_t(1) / static_cast<scalar_t>(int64_t(1) << (2 * dyadic_order));
+
+                const scalar_t* pair_inner_products = inner_products + blockIdx.x * coarse_rows * coarse_columns;
+                scalar_t* pair_grid = grid == nullptr ? nullptr : grid + blockIdx.x * (rows + 1) * (columns + 1);
+
+                scalar_t* two_before = reinterpret_cast<scalar_t*>(shared_memory);
+                scalar_t* before = two_before + (rows + 1);
+                scalar_t* current = before + (rows + 1);
+
+                for (int64_t diagonal = 0; diagonal <= rows + columns; ++diagonal) {
+                    int64_t row_start = diagonal > columns ? diagonal - columns : 0;
+                    int64_t row_end = diagonal < rows ? diagonal : rows;
+                    for (int64_t row = row_start + threadIdx.x; row <= row_end; row += blockDim.x) {
+                        int64_t column = diagonal - row;
+                        scalar_t value;
+                        if (row == 0 || column == 0) {
+                            value = 1;
+                        }
+                        else {
+                            scalar_t g = refined_inner_product(pair_inner_products, row - 1, column - 1,
+                                                               coarse_columns, dyadic_order, scale);
+                            scalar_t g2 = g * g / 12;
+                            value = (before[row] + before[row - 1]) * (1 + g / 2 + g2) - two_before[row - 1] * (1 - g2);
+                        }
+                        current[row] = value;
+                        if (pair_grid != nullptr) {
+                            pair_grid[row * (columns + 1) + column] = value;
+                        }
+                    }
+                    __syncthreads();
+                    scalar_t* tmp = two_before;
+                    two_before = before;
+                    before = current;
+                    current = tmp;
+                }
+                if (threadIdx.x == 0) {
+                    out[blockIdx.x] = before[rows];
+                }
+            }
+
+            // As solve_kernel, going backwards along the anti-diagonals; the scheme is the same as in
+            // solve_backward_cpu. The gradients with respect to the solution are held in shared memory, and the
+            // solution itself is read from 'grid'.
+            template <typename scalar_t>
+            __global__ void solve_backward_kernel(const scalar_t* __restrict__ inner_products,
+                                                  const scalar_t* __restrict__ grid,
+                                                  const scalar_t* __restrict__ grad_out,
+                                                  scalar_t* __restrict__ grad_refined,
+                                                  int64_t coarse_rows,
+                                                  int64_t coarse_columns,
+                                                  int64_t dyadic_order) {
+                extern __shared__ unsigned char shared_memory[];
+                int64_t rows = coarse_rows << dyadic_order;
+                int64_t columns = coarse_columns << dyadic_order;
+                scalar_t scale = scalar_t(1) / static_cast<scalar_t>(int64_t(1) << (2 * dyadic_order));
+
+                const scalar_t* pair_inner_products = inner_products + blockIdx.x * coarse_rows * coarse_columns;
+                const scalar_t* pair_grid = grid + blockIdx.x * (rows + 1) * (columns + 1);
+                scalar_t* pair_grad_refined = grad_refined + blockIdx.x * rows * columns;
+
+                scalar_t* two_after = reinterpret_cast<scalar_t*>(shared_memory);
+                scalar_t* after = two_after + (rows + 2);
+                scalar_t* current = after + (rows + 2);
+
+                for (int64_t diagonal = rows + columns; diagonal >= 2; --diagonal) {
+                    int64_t row_start = diagonal - 1 > columns ? diagonal - columns : 1;
+                    int64_t row_end = diagonal - 1 < rows ? diagonal - 1 : rows;
+                    for (int64_t row = row_start + threadIdx.x; row <= row_end; row += blockDim.x) {
+                        int64_t column = diagonal - row;
+                        scalar_t grad = (row == rows && column == columns) ? grad_out[blockIdx.x] : scalar_t(0);
+                        if (column < columns) {
+                            scalar_t g = refined_inner_product(pair_inner_products, row - 1, column, coarse_columns,
+                                                               dyadic_order, scale);
+                            grad += after[row] * (1 + g / 2 + g * g / 12);
+                        }
+                        if (row < rows) {
+                            scalar_t g = refined_inner_product(pair_inner_products, row, column - 1, coarse_columns,
+                                                               dyadic_order, scale);
+                            grad += after[row + 1] * (1 + g / 2 + g * g / 12);
+                        }
+                        if (row < rows && column < columns) {
+                            scalar_t g = refined_inner_product(pair_inner_products, row, column, coarse_columns,
+                                                               dyadic_order, scale);
+                            grad -= two_after[row + 1] * (1 - g * g / 12);
+                        }
+                        current[row] = grad;
+
+                        scalar_t g = refined_inner_product(pair_inner_products, row - 1, column - 1, coarse_columns,
+                                                           dyadic_order, scale);
+                        scalar_t left = pair_grid[row * (columns + 1) + column - 1];
+                        scalar_t up = pair_grid[(row - 1) * (columns + 1) + column];
+                        scalar_t diag = pair_grid[(row - 1) * (columns + 1) + column - 1];
+                        scalar_t grad_g = grad * ((left + up) * (scalar_t(0.5) + g / 6) + diag * g / 6);
+                        pair_grad_refined[(row - 1) * columns + column - 1] = grad_g;
+                    }
+                    __syncthreads();
+                    scalar_t* tmp = two_after;
+                    two_after = after;
+                    after = current;
+                    current = tmp;
+                }
+            }
+
+            bool solve_cuda_kernel_supported(int64_t rows, torch::ScalarType dtype) {
+                return 3 * (rows + 2) * static_cast<int64_t>(c10::elementSize(dtype)) <= max_shared_memory;
+            }
+
+            void solve_cuda_kernel(torch::Tensor inner_products, torch::Tensor out, torch::Tensor grid,
+                                   int64_t dyadic_order) {
+                int64_t num_pairs = inner_products.size(0);
+                int64_t coarse_rows = inner_products.size(1);
+                int64_t coarse_columns = inner_products.size(2);
+                int64_t rows = coarse_rows << dyadic_order;
+                int64_t columns = coarse_columns << dyadic_order;
+                torch::Tensor inner_products_contiguous = inner_products.contiguous();
+
+                int64_t num_threads = num_cuda_threads(std::min(rows, columns) + 1);
+                auto stream = at::cuda::getCurrentCUDAStream();
+
+                AT_DISPATCH_FLOATING_TYPES(inner_products.scalar_type(), "solve_cuda_kernel", ([&] {
+                    size_t shared_memory_size = 3 * (rows + 1) * sizeof(scalar_t);
+                    solve_kernel<scalar_t>
+                    <<<num_pairs, num_threads, shared_memory_size, stream>>>(
+                            inner_products_contiguous.data_ptr<scalar_t>(),
+                            out.data_ptr<scalar_t>(),
+                            grid.defined() ? grid.data_ptr<scalar_t>() : nullptr,
+                            coarse_rows,
+                            coarse_columns,
+                            dyadic_order);
+                }));
+                AT_CUDA_CHECK(cudaGetLastError());
+            }
+
+            void solve_backward_cuda_kernel(torch::Tensor inner_products, torch::Tensor grid, torch::Tensor grad_out,
+                                            torch::Tensor grad_refined, int64_t dyadic_order) {
+                int64_t num_pairs = inner_products.size(0);
+                int64_t coarse_rows = inner_products.size(1);
+                int64_t coarse_columns = inner_products.size(2);
+                int64_t rows = coarse_rows << dyadic_order;
+                int64_t columns = coarse_columns << dyadic_order;
+                torch::Tensor inner_products_contiguous = inner_products.contiguous();
+                torch::Tensor grad_out_contiguous = grad_out.contiguous();
+
+                int64_t num_threads = num_cuda_threads(std::min(rows, columns));
+                auto stream = at::cuda::getCurrentCUDAStream();
+
+                AT_DISPATCH_FLOATING_TYPES(inner_products.scalar_type(), "solve_backward_cuda_kernel", ([&] {
+                    size_t shared_memory_size = 3 * (rows + 2) * sizeof(scalar_t);
+                    solve_backward_kernel<scalar_t>
+                    <<<num_pairs, num_threads, shared_memory_size, stream>>>(
+                            inner_products_contiguous.data_ptr<scalar_t>(),
+                            grid.data_ptr<scalar_t>(),
+                            grad_out_contiguous.data_ptr<scalar_t>(),
+                            grad_refined.data_ptr<scalar_t>(),
+                            coarse_rows,
+                            coarse_columns,
+                            dyadic_order);
+                }));
+                AT_CUDA_CHECK(cudaGetLastError());
+            }
+        }  // namespace signatory::signature_kernel::detail
+    }  // namespace signatory::signature_kernel
+}  // namespace signatory
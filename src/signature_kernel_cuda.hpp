@@ -0,0 +1,50 @@
+/* Copyright 2019 Patrick Kidger. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ========================================================================= */
+ // Hand-written CUDA kernels for solving the Goursat PDE of the signature kernel.
+ // As with tensor_algebra_ops_cuda.hpp, these are only compiled if SIGNATORY_CUDA is defined. Otherwise the solve on
+ // the GPU is expressed in terms of high-level PyTorch operations instead; see signature_kernel.cpp.
+
+
+#ifndef SIGNATORY_SIGNATURE_KERNEL_CUDA_HPP
+#define SIGNATORY_SIGNATURE_KERNEL_CUDA_HPP
+
+#include <torch/extension.h>
+#include <cstdint>  // int64_t
+
+
+namespace signatory {
+    namespace signature_kernel {
+        namespace detail {
+            // Whether the kernels below can handle a grid with this many rows. Each block holds three anti-diagonals
+            // of the grid in shared memory, so the number of rows is limited by the amount of shared memory.
+            bool solve_cuda_kernel_supported(int64_t rows, torch::ScalarType dtype);
+
+            // As solve_cpu in signature_kernel.cpp, for CUDA tensors. Each pair is handled by a single block, which
+            // sweeps along the anti-diagonals of the grid. If 'grid' is defined then the whole solution is written
+            // into it, as is needed for the backward pass.
+            void solve_cuda_kernel(torch::Tensor inner_products, torch::Tensor out, torch::Tensor grid,
+                                   int64_t dyadic_order);
+
+            // As solve_backward_cpu in signature_kernel.cpp, for CUDA tensors. 'grid' should be as computed by
+            // solve_cuda_kernel. The gradients with respect to the inner products of the increments on the refined
+            // grid are written into 'grad_refined', of shape (pairs, rows, columns); summing these up to the gradients
+            // with respect to the original inner products is left to the caller.
+            void solve_backward_cuda_kernel(torch::Tensor inner_products, torch::Tensor grid, torch::Tensor grad_out,
+                                            torch::Tensor grad_refined, int64_t dyadic_order);
+        }  // namespace signatory::signature_kernel::detail
+    }  // namespace signatory::signature_kernel
+}  // namespace signatory
+
+#endif //SIGNATORY_SIGNATURE_KERNEL_CUDA_HPP
@@ -15,14 +15,21 @@
 
 
 #include <torch/extension.h>
+#include <algorithm>  // std::copy, std::min
+#include <atomic>     // std::atomic, std::memory_order_relaxed
 #include <cstdint>    // int64_t
 #include <stdexcept>  // std::invalid_argument
+#include <tuple>      // std::tie, std::tuple
 #include <type_traits>  // std::is_same
-#include <utility>    // std::pair
+#include <utility>    // std::pair, std::swap
 #include <vector>     // std::vector
 
 #include "misc.hpp"
+#include "profiling.hpp"
 #include "tensor_algebra_ops.hpp"
+#ifdef SIGNATORY_CUDA
+#include "tensor_algebra_ops_cuda.hpp"
+#endif
 
 
 namespace signatory {
@@ -65,12 +72,229 @@ namespace signatory {
                     grad_arg2[k].unsqueeze(channel_dim - 1).baddbmm_(arg1[j].unsqueeze(channel_dim - 1), out_view);
                 }
             }
+
+            // See set_cpu_kernels_enabled.
+            std::atomic<bool> cpu_kernels_enabled {true};
+
+            bool set_cpu_kernels_enabled(bool enabled) {
+                return cpu_kernels_enabled.exchange(enabled);
+            }
+
+            // Whether the hand-written CPU implementations below (of mult, mult_into, mult_backward, log and
+            // log_backward) may be used. They assume that the channel dimension of every tensor is contiguous.
+            bool cpu_kernel_applicable(const std::vector<torch::Tensor>& tensors) {
+                if (!cpu_kernels_enabled.load(std::memory_order_relaxed)) {
+                    return false;
+                }
+                for (const auto& elem : tensors) {
+                    if (elem.is_cuda() || elem.stride(channel_dim) != 1 ||
+                        (elem.scalar_type() != torch::kFloat32 && elem.scalar_type() != torch::kFloat64)) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // The size of each term of a member of the tensor algebra.
+            std::vector<int64_t> term_sizes(const std::vector<torch::Tensor>& terms) {
+                std::vector<int64_t> sizes;
+                sizes.reserve(terms.size());
+                for (const auto& elem : terms) {
+                    sizes.push_back(elem.size(channel_dim));
+                }
+                return sizes;
+            }
+
+            // Pointers to the start of each term of a member of the tensor algebra, along with their batch strides, as
+            // used by the hand-written CPU implementations.
+            template <typename scalar_t>
+            struct CpuTermPointers {
+                std::vector<scalar_t*> data;
+                std::vector<int64_t> batch_stride;
+
+                explicit CpuTermPointers(const std::vector<torch::Tensor>& terms) {
+                    data.reserve(terms.size());
+                    batch_stride.reserve(terms.size());
+                    for (const auto& elem : terms) {
+                        data.push_back(elem.data_ptr<scalar_t>());
+                        batch_stride.push_back(elem.stride(batch_dim));
+                    }
+                }
+
+                // Sets 'out' to point at each term at the given batch element.
+                void at_batch(int64_t batch_index, std::vector<scalar_t*>& out) const {
+                    for (s_size_type depth_index = 0; depth_index < static_cast<s_size_type>(data.size());
+                         ++depth_index) {
+                        out[depth_index] = data[depth_index] + batch_index * batch_stride[depth_index];
+                    }
+                }
+            };
+
+            // Computes out = arg_a + arg_b + arg_a \otimes arg_b for a single batch element, where 'arg_a' and 'arg_b'
+            // are members of the tensor algebra with assumed scalar values 1. (So that this is every nonscalar term of
+            // their product.) If add_not_copy==true then the result is added on to 'out' instead.
+            // Each term is computed using only the terms of 'arg_a' and 'arg_b' of equal or lower depth, and the terms
+            // are computed from the highest downwards. So if add_not_copy==false then 'out' may be the same as 'arg_a'
+            // or 'arg_b', to perform the multiplication in-place.
+            template <typename scalar_t, bool add_not_copy>
+            void mult_cpu_inner(scalar_t* const* out, const scalar_t* const* arg_a, const scalar_t* const* arg_b,
+                                const int64_t* sizes, s_size_type depth) {
+                for (s_size_type depth_index = depth - 1; depth_index >= 0; --depth_index) {
+                    scalar_t* out_at_depth = out[depth_index];
+                    const scalar_t* arg_a_at_depth = arg_a[depth_index];
+                    const scalar_t* arg_b_at_depth = arg_b[depth_index];
+                    #pragma omp simd
+                    for (int64_t index = 0; index < sizes[depth_index]; ++index) {
+                        if (add_not_copy) {
+                            out_at_depth[index] += arg_a_at_depth[index] + arg_b_at_depth[index];
+                        }
+                        else {
+                            out_at_depth[index] = arg_a_at_depth[index] + arg_b_at_depth[index];
+                        }
+                    }
+                    for (s_size_type j = 0, k = depth_index - 1; j < depth_index; ++j, --k) {
+                        /* loop invariant: j + k = depth_index - 1 */
+                        const scalar_t* arg_a_j = arg_a[j];
+                        const scalar_t* arg_b_k = arg_b[k];
+                        for (int64_t a_index = 0; a_index < sizes[j]; ++a_index) {
+                            scalar_t a_val = arg_a_j[a_index];
+                            scalar_t* out_row = out_at_depth + a_index * sizes[k];
+                            #pragma omp simd
+                            for (int64_t b_index = 0; b_index < sizes[k]; ++b_index) {
+                                out_row[b_index] += a_val * arg_b_k[b_index];
+                            }
+                        }
+                    }
+                }
+            }
+
+            // Backwards through mult_cpu_inner<scalar_t, /*add_not_copy=*/false> for a single batch element, with
+            // the same conventions as ta_ops::mult_backward.
+            template <typename scalar_t, bool add_not_copy>
+            void mult_backward_cpu_inner(scalar_t* const* grad_arg1, scalar_t* const* grad_arg2,
+                                         const scalar_t* const* arg1, const scalar_t* const* arg2,
+                                         const int64_t* sizes, s_size_type depth) {
+                for (s_size_type depth_index = 0; depth_index < depth; ++depth_index) {
+                    const scalar_t* grad_at_depth = grad_arg1[depth_index];
+                    scalar_t* grad_arg2_at_depth = grad_arg2[depth_index];
+                    #pragma omp simd
+                    for (int64_t index = 0; index < sizes[depth_index]; ++index) {
+                        if (add_not_copy) {
+                            grad_arg2_at_depth[index] += grad_at_depth[index];
+                        }
+                        else {
+                            grad_arg2_at_depth[index] = grad_at_depth[index];
+                        }
+                    }
+                    for (s_size_type j = depth_index - 1, k = 0; j >= 0; --j, ++k) {
+                        /* loop invariant: j + k = depth_index - 1 */
+                        const scalar_t* arg1_j = arg1[j];
+                        const scalar_t* arg2_k = arg2[k];
+                        scalar_t* grad_arg1_j = grad_arg1[j];
+                        scalar_t* grad_arg2_k = grad_arg2[k];
+                        for (int64_t a_index = 0; a_index < sizes[j]; ++a_index) {
+                            scalar_t a_val = arg1_j[a_index];
+                            const scalar_t* grad_row = grad_at_depth + a_index * sizes[k];
+                            scalar_t grad_a_val = 0;
+                            #pragma omp simd reduction(+:grad_a_val)
+                            for (int64_t b_index = 0; b_index < sizes[k]; ++b_index) {
+                                grad_a_val += grad_row[b_index] * arg2_k[b_index];
+                                grad_arg2_k[b_index] += a_val * grad_row[b_index];
+                            }
+                            grad_arg1_j[a_index] += grad_a_val;
+                        }
+                    }
+                }
+            }
+
+            // Applies mult_cpu_inner to every batch element, parallelising over the batch dimension.
+            template <typename scalar_t, bool add_not_copy>
+            void mult_cpu(std::vector<torch::Tensor>& out, const std::vector<torch::Tensor>& arg_a,
+                          const std::vector<torch::Tensor>& arg_b, int64_t batch_threads) {
+                s_size_type depth = out.size();
+                int64_t batch_size = out[0].size(batch_dim);
+                std::vector<int64_t> sizes = term_sizes(out);
+                CpuTermPointers<scalar_t> out_pointers(out);
+                CpuTermPointers<scalar_t> arg_a_pointers(arg_a);
+                CpuTermPointers<scalar_t> arg_b_pointers(arg_b);
+
+                misc::parallel_for(batch_size, batch_threads, [&](int64_t begin, int64_t end) {
+                    std::vector<scalar_t*> out_at_batch(depth);
+                    std::vector<scalar_t*> arg_a_at_batch(depth);
+                    std::vector<scalar_t*> arg_b_at_batch(depth);
+
+                    for (int64_t batch_index = begin; batch_index < end; ++batch_index) {
+                        out_pointers.at_batch(batch_index, out_at_batch);
+                        arg_a_pointers.at_batch(batch_index, arg_a_at_batch);
+                        arg_b_pointers.at_batch(batch_index, arg_b_at_batch);
+                        mult_cpu_inner<scalar_t, add_not_copy>(out_at_batch.data(), arg_a_at_batch.data(),
+                                                               arg_b_at_batch.data(), sizes.data(), depth);
+                    }
+                });
+            }
+
+            // Applies mult_backward_cpu_inner to every batch element, parallelising over the batch dimension.
+            template <typename scalar_t, bool add_not_copy>
+            void mult_backward_cpu(std::vector<torch::Tensor>& grad_arg1, std::vector<torch::Tensor>& grad_arg2,
+                                   const std::vector<torch::Tensor>& arg1, const std::vector<torch::Tensor>& arg2,
+                                   int64_t batch_threads) {
+                s_size_type depth = arg1.size();
+                int64_t batch_size = arg1[0].size(batch_dim);
+                std::vector<int64_t> sizes = term_sizes(arg1);
+                CpuTermPointers<scalar_t> grad_arg1_pointers(grad_arg1);
+                CpuTermPointers<scalar_t> grad_arg2_pointers(grad_arg2);
+                CpuTermPointers<scalar_t> arg1_pointers(arg1);
+                CpuTermPointers<scalar_t> arg2_pointers(arg2);
+
+                misc::parallel_for(batch_size, batch_threads, [&](int64_t begin, int64_t end) {
+                    std::vector<scalar_t*> grad_arg1_at_batch(depth);
+                    std::vector<scalar_t*> grad_arg2_at_batch(depth);
+                    std::vector<scalar_t*> arg1_at_batch(depth);
+                    std::vector<scalar_t*> arg2_at_batch(depth);
+
+                    for (int64_t batch_index = begin; batch_index < end; ++batch_index) {
+                        grad_arg1_pointers.at_batch(batch_index, grad_arg1_at_batch);
+                        grad_arg2_pointers.at_batch(batch_index, grad_arg2_at_batch);
+                        arg1_pointers.at_batch(batch_index, arg1_at_batch);
+                        arg2_pointers.at_batch(batch_index, arg2_at_batch);
+                        mult_backward_cpu_inner<scalar_t, add_not_copy>(grad_arg1_at_batch.data(),
+                                                                        grad_arg2_at_batch.data(),
+                                                                        arg1_at_batch.data(), arg2_at_batch.data(),
+                                                                        sizes.data(), depth);
+                    }
+                });
+            }
+
+            // Whether the hand-written implementations of mult, mult_into and mult_backward can handle the given
+            // argument. If not then the high-level implementation should be used instead.
+            bool mult_kernel_applicable(const std::vector<torch::Tensor>& arg) {
+                #ifdef SIGNATORY_CUDA
+                if (arg[0].is_cuda()) {
+                    return mult_cuda_kernel_supported(arg);
+                }
+                #endif
+                return cpu_kernel_applicable(arg);
+            }
         }  // namespace signatory::ta_ops::detail
 
-        void mult(std::vector<torch::Tensor>& arg1, const std::vector<torch::Tensor>& arg2, bool inverse) {
+        void mult(std::vector<torch::Tensor>& arg1, const std::vector<torch::Tensor>& arg2, bool inverse,
+                  int64_t batch_threads) {
             auto& arg_a = inverse ? arg2 : arg1;
             auto& arg_b = inverse ? arg1 : arg2;
 
+            if (detail::mult_kernel_applicable(arg1) && detail::mult_kernel_applicable(arg2)) {
+                #ifdef SIGNATORY_CUDA
+                if (arg1[0].is_cuda()) {
+                    detail::mult_cuda_kernel(arg1, arg_a, arg_b, /*add_not_copy=*/false);
+                    return;
+                }
+                #endif
+                AT_DISPATCH_FLOATING_TYPES(arg1[0].scalar_type(), "mult_cpu", ([&] {
+                    detail::mult_cpu<scalar_t, /*add_not_copy=*/false>(arg1, arg_a, arg_b, batch_threads);
+                }));
+                return;
+            }
+
             auto depth = arg_a.size();
             for (s_size_type depth_index = depth - 1; depth_index >= 0; --depth_index) {
                 torch::Tensor tensor_at_depth = arg1[depth_index];  // not arg_a or arg_b
@@ -79,11 +303,71 @@ namespace signatory {
             }
         }
 
+        template<bool add_not_copy>
+        void mult_into(std::vector<torch::Tensor>& out, const std::vector<torch::Tensor>& arg1,
+                       const std::vector<torch::Tensor>& arg2, bool inverse, int64_t batch_threads) {
+            auto& arg_a = inverse ? arg2 : arg1;
+            auto& arg_b = inverse ? arg1 : arg2;
+
+            if (detail::mult_kernel_applicable(out) && detail::mult_kernel_applicable(arg1) &&
+                detail::mult_kernel_applicable(arg2)) {
+                #ifdef SIGNATORY_CUDA
+                if (out[0].is_cuda()) {
+                    detail::mult_cuda_kernel(out, arg_a, arg_b, add_not_copy);
+                    return;
+                }
+                #endif
+                AT_DISPATCH_FLOATING_TYPES(out[0].scalar_type(), "mult_into_cpu", ([&] {
+                    detail::mult_cpu<scalar_t, add_not_copy>(out, arg_a, arg_b, batch_threads);
+                }));
+                return;
+            }
+
+            s_size_type depth = out.size();
+            for (s_size_type depth_index = 0; depth_index < depth; ++depth_index) {
+                torch::Tensor tensor_at_depth = out[depth_index];
+                if (add_not_copy) {
+                    tensor_at_depth += arg1[depth_index];
+                }
+                else {
+                    tensor_at_depth.copy_(arg1[depth_index]);
+                }
+                tensor_at_depth += arg2[depth_index];
+                detail::mult_inner(tensor_at_depth, arg_a, arg_b, depth_index);
+            }
+        }
+        template void mult_into</*add_not_copy=*/false>(std::vector<torch::Tensor>& out,
+                                                        const std::vector<torch::Tensor>& arg1,
+                                                        const std::vector<torch::Tensor>& arg2,
+                                                        bool inverse,
+                                                        int64_t batch_threads);
+        template void mult_into</*add_not_copy=*/true>(std::vector<torch::Tensor>& out,
+                                                       const std::vector<torch::Tensor>& arg1,
+                                                       const std::vector<torch::Tensor>& arg2,
+                                                       bool inverse,
+                                                       int64_t batch_threads);
+
         template<bool add_not_copy>
         void mult_backward(std::vector<torch::Tensor>& grad_arg1,
                            std::vector<torch::Tensor>& grad_arg2,
                            const std::vector<torch::Tensor>& arg1,
-                           const std::vector<torch::Tensor>& arg2) {
+                           const std::vector<torch::Tensor>& arg2,
+                           int64_t batch_threads) {
+            if (detail::mult_kernel_applicable(grad_arg1) && detail::mult_kernel_applicable(grad_arg2) &&
+                detail::mult_kernel_applicable(arg1) && detail::mult_kernel_applicable(arg2)) {
+                #ifdef SIGNATORY_CUDA
+                if (arg1[0].is_cuda()) {
+                    detail::mult_backward_cuda_kernel(grad_arg1, grad_arg2, arg1, arg2, add_not_copy);
+                    return;
+                }
+                #endif
+                AT_DISPATCH_FLOATING_TYPES(arg1[0].scalar_type(), "mult_backward_cpu", ([&] {
+                    detail::mult_backward_cpu<scalar_t, add_not_copy>(grad_arg1, grad_arg2, arg1, arg2,
+                                                                      batch_threads);
+                }));
+                return;
+            }
+
             s_size_type depth = arg1.size();
             for (s_size_type depth_index = 0; depth_index < depth; ++depth_index) {
                 torch::Tensor grad_tensor_at_depth = grad_arg1[depth_index];
@@ -99,11 +383,13 @@ namespace signatory {
         template void mult_backward</*add_not_copy=*/false>(std::vector<torch::Tensor>& grad_arg1,
                                                             std::vector<torch::Tensor>& grad_arg2,
                                                             const std::vector<torch::Tensor>& arg1,
-                                                            const std::vector<torch::Tensor>& arg2);
+                                                            const std::vector<torch::Tensor>& arg2,
+                                                            int64_t batch_threads);
         template void mult_backward</*add_not_copy=*/true>(std::vector<torch::Tensor>& grad_arg1,
                                                            std::vector<torch::Tensor>& grad_arg2,
                                                            const std::vector<torch::Tensor>& arg1,
-                                                           const std::vector<torch::Tensor>& arg2);
+                                                           const std::vector<torch::Tensor>& arg2,
+                                                           int64_t batch_threads);
 
         /**********************************************************
          * Forward and backward computations for 'restricted_exp' *
@@ -203,8 +489,9 @@ namespace signatory {
 
             void mult_fused_restricted_exp_cuda(torch::Tensor next, std::vector<torch::Tensor>& prev, bool inverse,
                                                 torch::Tensor reciprocals) {
-                // We haven't tried writing custom GPU code. But if we did it would go here. Instead this is
-                // specified in terms of the higher-level PyTorch Tensors.
+                // If we've been compiled with CUDA support then the hand-written kernels in
+                // tensor_algebra_ops_cuda.cu are used instead, where possible. Otherwise (or for e.g. half precision)
+                // this is specified in terms of the higher-level PyTorch Tensors.
 
                 int64_t batch_size = next.size(batch_dim);
                 int64_t input_channel_size = next.size(channel_dim);
@@ -346,11 +633,274 @@ namespace signatory {
                 }
             }
 
+            // The generic implementation above has to work for any number of channels and any depth. However in
+            // practice most paths have only a handful of channels, and are used with only a moderate depth. In this case
+            // the innermost loops are only a few iterations long, and the compiler can't do much with them when their
+            // length isn't known until runtime.
+            // So for these common cases we instead use the following implementation, which is templated on the number of
+            // channels and the depth, so that the compiler can fully unroll and vectorise the inner loops. It also works
+            // with raw pointers rather than TensorAccessors, and arranges its loops so that the innermost loop is always
+            // contiguous in memory, whatever the value of inverse.
+            constexpr int64_t min_fixed_channels = 2;
+            constexpr int64_t max_fixed_channels = 8;
+            constexpr s_size_type min_fixed_depth = 3;
+            constexpr s_size_type max_fixed_depth = 6;
+
+            // Whether the fixed-size implementation may be used. (Besides its size restrictions, it assumes that the
+            // channel dimension of every tensor is contiguous.)
+            bool fixed_kernel_applicable(torch::Tensor next, const std::vector<torch::Tensor>& prev) {
+                int64_t input_channel_size = next.size(channel_dim);
+                s_size_type depth = prev.size();
+                if (input_channel_size < min_fixed_channels || input_channel_size > max_fixed_channels ||
+                    depth < min_fixed_depth || depth > max_fixed_depth) {
+                    return false;
+                }
+                if (next.stride(channel_dim) != 1) {
+                    return false;
+                }
+                for (const auto& elem : prev) {
+                    if (elem.stride(channel_dim) != 1) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            // Computes out = base + left \otimes right, where 'left' is of size left_size and 'right' is of size
+            // input_channel_size. (Or rather, the appropriate transpose of the outer product if inverse==true.)
+            // If accumulate==true then 'base' is ignored and instead out += left \otimes right.
+            template <typename scalar_t, bool inverse, bool accumulate, int64_t input_channel_size>
+            inline void outer_fixed(scalar_t* __restrict out, const scalar_t* __restrict base,
+                                    const scalar_t* __restrict left, int64_t left_size,
+                                    const scalar_t* __restrict right) {
+                if (inverse) {
+                    for (int64_t right_index = 0; right_index < input_channel_size; ++right_index) {
+                        scalar_t right_value = right[right_index];
+                        int64_t row = right_index * left_size;
+                        #pragma omp simd
+                        for (int64_t left_index = 0; left_index < left_size; ++left_index) {
+                            if (accumulate) {
+                                out[row + left_index] += left[left_index] * right_value;
+                            }
+                            else {
+                                out[row + left_index] = base[row + left_index] + left[left_index] * right_value;
+                            }
+                        }
+                    }
+                }
+                else {
+                    for (int64_t left_index = 0; left_index < left_size; ++left_index) {
+                        scalar_t left_value = left[left_index];
+                        int64_t row = left_index * input_channel_size;
+                        #pragma omp simd
+                        for (int64_t right_index = 0; right_index < input_channel_size; ++right_index) {
+                            if (accumulate) {
+                                out[row + right_index] += left_value * right[right_index];
+                            }
+                            else {
+                                out[row + right_index] = base[row + right_index] + left_value * right[right_index];
+                            }
+                        }
+                    }
+                }
+            }
+
+            // The part of mult_fused_restricted_exp_cpu_inner_fixed that comes after computing next_divided (which is
+            // 'next' multiplied by each of the reciprocals, stored as a (depth - 1, input_channel_size) array), so that
+            // it may be shared with mult_fused_restricted_exp_and_inverse_cpu_inner_fixed.
+            template <typename scalar_t, bool inverse, int64_t input_channel_size, s_size_type depth>
+            void mult_fused_restricted_exp_cpu_apply_fixed(const scalar_t* __restrict next,
+                                                           const scalar_t* __restrict next_divided,
+                                                           scalar_t* const* prev,
+                                                           scalar_t* new_scratch,
+                                                           scalar_t* old_scratch) {
+                for (s_size_type depth_index = depth - 1; depth_index >= 1; --depth_index) {
+                    int64_t scratch_size = input_channel_size;
+
+                    #pragma omp simd
+                    for (int64_t scratch_index = 0; scratch_index < input_channel_size; ++scratch_index) {
+                        new_scratch[scratch_index] = prev[0][scratch_index] +
+                                                     next_divided[(depth_index - 1) * input_channel_size +
+                                                                  scratch_index];
+                    }
+
+                    for (s_size_type j = 1, k = depth_index - 2; j < depth_index; ++j, --k) {
+                        std::swap(old_scratch, new_scratch);
+                        outer_fixed<scalar_t, inverse, /*accumulate=*/false,
+                                    input_channel_size>(new_scratch,
+                                                        prev[j],
+                                                        old_scratch,
+                                                        scratch_size,
+                                                        next_divided + k * input_channel_size);
+                        scratch_size *= input_channel_size;
+                    }
+
+                    outer_fixed<scalar_t, inverse, /*accumulate=*/true, input_channel_size>(prev[depth_index],
+                                                                                            prev[depth_index],
+                                                                                            new_scratch,
+                                                                                            scratch_size,
+                                                                                            next);
+                }
+
+                #pragma omp simd
+                for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                    prev[0][channel_index] += next[channel_index];
+                }
+            }
+
+            // As mult_fused_restricted_exp_cpu_inner, for a single batch element.
+            // 'prev' should be an array of 'depth' pointers, one to each term for this batch element.
+            // 'new_scratch' and 'old_scratch' should each have space for input_channel_size^(depth - 1) elements.
+            template <typename scalar_t, bool inverse, int64_t input_channel_size, s_size_type depth>
+            void mult_fused_restricted_exp_cpu_inner_fixed(const scalar_t* __restrict next,
+                                                           scalar_t* const* prev,
+                                                           const scalar_t* __restrict reciprocals,
+                                                           scalar_t* new_scratch,
+                                                           scalar_t* old_scratch) {
+                scalar_t next_divided[depth - 1][input_channel_size];
+                for (s_size_type reciprocal_index = 0; reciprocal_index < depth - 1; ++reciprocal_index) {
+                    #pragma omp simd
+                    for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                        next_divided[reciprocal_index][channel_index] = reciprocals[reciprocal_index] *
+                                                                        next[channel_index];
+                    }
+                }
+                mult_fused_restricted_exp_cpu_apply_fixed<scalar_t, inverse,
+                                                          input_channel_size, depth>(next,
+                                                                                     &next_divided[0][0],
+                                                                                     prev,
+                                                                                     new_scratch,
+                                                                                     old_scratch);
+            }
+
+            template <typename scalar_t, bool inverse, int64_t input_channel_size, s_size_type depth>
+            void mult_fused_restricted_exp_cpu_fixed(torch::Tensor next, std::vector<torch::Tensor>& prev,
+                                                     torch::Tensor reciprocals, int64_t batch_threads) {
+                int64_t batch_size = next.size(batch_dim);
+
+                const scalar_t* next_data = next.data_ptr<scalar_t>();
+                int64_t next_batch_stride = next.stride(batch_dim);
+                scalar_t* prev_data[depth];
+                int64_t prev_batch_stride[depth];
+                for (s_size_type depth_index = 0; depth_index < depth; ++depth_index) {
+                    prev_data[depth_index] = prev[depth_index].data_ptr<scalar_t>();
+                    prev_batch_stride[depth_index] = prev[depth_index].stride(batch_dim);
+                }
+                torch::Tensor reciprocals_contiguous = reciprocals.contiguous();
+                const scalar_t* reciprocals_data = reciprocals_contiguous.data_ptr<scalar_t>();
+
+                int64_t scratch_size = 1;
+                for (s_size_type depth_index = 0; depth_index < depth - 1; ++depth_index) {
+                    scratch_size *= input_channel_size;
+                }
+
+                misc::parallel_for(batch_size, batch_threads, [&](int64_t begin, int64_t end) {
+                    std::vector<scalar_t, default_init_allocator<scalar_t>> new_scratch (scratch_size);
+                    std::vector<scalar_t, default_init_allocator<scalar_t>> old_scratch (scratch_size);
+                    scalar_t* prev_at_batch[depth];
+
+                    for (int64_t batch_index = begin; batch_index < end; ++batch_index) {
+                        for (s_size_type depth_index = 0; depth_index < depth; ++depth_index) {
+                            prev_at_batch[depth_index] = prev_data[depth_index] +
+                                                         batch_index * prev_batch_stride[depth_index];
+                        }
+                        mult_fused_restricted_exp_cpu_inner_fixed<scalar_t,
+                                                                  inverse,
+                                                                  input_channel_size,
+                                                                  depth>(next_data + batch_index * next_batch_stride,
+                                                                         prev_at_batch,
+                                                                         reciprocals_data,
+                                                                         new_scratch.data(),
+                                                                         old_scratch.data());
+                    }
+                });
+            }
+
+            // Dispatches from runtime sizes to the appropriate instantiation of mult_fused_restricted_exp_cpu_fixed.
+            // Returns false if there isn't one.
+            template <typename scalar_t, bool inverse, int64_t input_channel_size>
+            bool mult_fused_restricted_exp_cpu_fixed_depth(torch::Tensor next, std::vector<torch::Tensor>& prev,
+                                                           torch::Tensor reciprocals, int64_t batch_threads) {
+                switch (prev.size()) {
+                    case 3:
+                        mult_fused_restricted_exp_cpu_fixed<scalar_t, inverse, input_channel_size, 3>(next, prev,
+                                                                                                      reciprocals,
+                                                                                                      batch_threads);
+                        return true;
+                    case 4:
+                        mult_fused_restricted_exp_cpu_fixed<scalar_t, inverse, input_channel_size, 4>(next, prev,
+                                                                                                      reciprocals,
+                                                                                                      batch_threads);
+                        return true;
+                    case 5:
+                        mult_fused_restricted_exp_cpu_fixed<scalar_t, inverse, input_channel_size, 5>(next, prev,
+                                                                                                      reciprocals,
+                                                                                                      batch_threads);
+                        return true;
+                    case 6:
+                        mult_fused_restricted_exp_cpu_fixed<scalar_t, inverse, input_channel_size, 6>(next, prev,
+                                                                                                      reciprocals,
+                                                                                                      batch_threads);
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+
+            template <typename scalar_t, bool inverse>
+            bool mult_fused_restricted_exp_cpu_fixed_channels(torch::Tensor next, std::vector<torch::Tensor>& prev,
+                                                              torch::Tensor reciprocals, int64_t batch_threads) {
+                if (!fixed_kernel_applicable(next, prev)) {
+                    return false;
+                }
+                switch (next.size(channel_dim)) {
+                    case 2:
+                        return mult_fused_restricted_exp_cpu_fixed_depth<scalar_t, inverse, 2>(next, prev, reciprocals,
+                                                                                              batch_threads);
+                    case 3:
+                        return mult_fused_restricted_exp_cpu_fixed_depth<scalar_t, inverse, 3>(next, prev, reciprocals,
+                                                                                              batch_threads);
+                    case 4:
+                        return mult_fused_restricted_exp_cpu_fixed_depth<scalar_t, inverse, 4>(next, prev, reciprocals,
+                                                                                              batch_threads);
+                    case 5:
+                        return mult_fused_restricted_exp_cpu_fixed_depth<scalar_t, inverse, 5>(next, prev, reciprocals,
+                                                                                              batch_threads);
+                    case 6:
+                        return mult_fused_restricted_exp_cpu_fixed_depth<scalar_t, inverse, 6>(next, prev, reciprocals,
+                                                                                              batch_threads);
+                    case 7:
+                        return mult_fused_restricted_exp_cpu_fixed_depth<scalar_t, inverse, 7>(next, prev, reciprocals,
+                                                                                              batch_threads);
+                    case 8:
+                        return mult_fused_restricted_exp_cpu_fixed_depth<scalar_t, inverse, 8>(next, prev, reciprocals,
+                                                                                              batch_threads);
+                    default:
+                        return false;
+                }
+            }
+
             // This basically just parallelises over the batch elements, calling mult_fused_restricted_exp_cpu_inner on
             // each one.
             template <typename scalar_t>
             void mult_fused_restricted_exp_cpu(torch::Tensor next, std::vector<torch::Tensor>& prev, bool inverse,
                                                torch::Tensor reciprocals, int64_t batch_threads) {
+                // Use the fixed-size implementation if we can
+                if (inverse) {
+                    if (mult_fused_restricted_exp_cpu_fixed_channels<scalar_t, /*inverse=*/true>(next, prev,
+                                                                                                 reciprocals,
+                                                                                                 batch_threads)) {
+                        return;
+                    }
+                }
+                else {
+                    if (mult_fused_restricted_exp_cpu_fixed_channels<scalar_t, /*inverse=*/false>(next, prev,
+                                                                                                  reciprocals,
+                                                                                                  batch_threads)) {
+                        return;
+                    }
+                }
+
                 // Convert from Tensors to TensorAccessors
                 auto next_a = next.accessor<scalar_t, 2>();
                 std::vector<torch::TensorAccessor<scalar_t, 2>> prev_a;
@@ -364,13 +914,7 @@ namespace signatory {
                 int64_t input_channel_size = next.size(channel_dim);
                 s_size_type depth = prev.size();
 
-                // commented out because of what I think is an MSVC bug?
-                #pragma omp parallel /*default(none)*/ \
-                                     if(batch_threads > 1) \
-                                     num_threads(batch_threads) \
-                                     shared(batch_size, next_a, prev_a, inverse, reciprocals_a, input_channel_size, \
-                                            depth)
-                {
+                misc::parallel_for(batch_size, batch_threads, [&](int64_t begin, int64_t end) {
                     // Allocate scratch space outside of the hot loop
                     std::vector<scalar_t, default_init_allocator<scalar_t>> next_divided (reciprocals_a.size(0) * input_channel_size);
                     std::vector<scalar_t, default_init_allocator<scalar_t>> old_scratch;
@@ -387,8 +931,7 @@ namespace signatory {
                         }
                     }
 
-                    #pragma omp for schedule(static)
-                    for (int64_t batch_index = 0; batch_index < batch_size; ++batch_index) {
+                    for (int64_t batch_index = begin; batch_index < end; ++batch_index) {
                         // Actually do the computation.
                         // Note that we pass in the 2-dimensional TensorAccessors and batch_index and let
                         // mult_fused_restricted_exp_cpu_inner reduce them to 1-dimensional TensorAccessors. This gives
@@ -413,8 +956,316 @@ namespace signatory {
                                                                                              old_scratch);
                         }
                     }
+                });
+
+            }
+
+            // As outer_fixed, except that input_channel_size is only known at runtime.
+            template <typename scalar_t, bool inverse, bool accumulate>
+            inline void outer_generic(scalar_t* __restrict out, const scalar_t* __restrict base,
+                                      const scalar_t* __restrict left, int64_t left_size,
+                                      const scalar_t* __restrict right, int64_t input_channel_size) {
+                if (inverse) {
+                    for (int64_t right_index = 0; right_index < input_channel_size; ++right_index) {
+                        scalar_t right_value = right[right_index];
+                        int64_t row = right_index * left_size;
+                        for (int64_t left_index = 0; left_index < left_size; ++left_index) {
+                            if (accumulate) {
+                                out[row + left_index] += left[left_index] * right_value;
+                            }
+                            else {
+                                out[row + left_index] = base[row + left_index] + left[left_index] * right_value;
+                            }
+                        }
+                    }
+                }
+                else {
+                    for (int64_t left_index = 0; left_index < left_size; ++left_index) {
+                        scalar_t left_value = left[left_index];
+                        int64_t row = left_index * input_channel_size;
+                        for (int64_t right_index = 0; right_index < input_channel_size; ++right_index) {
+                            if (accumulate) {
+                                out[row + right_index] += left_value * right[right_index];
+                            }
+                            else {
+                                out[row + right_index] = base[row + right_index] + left_value * right[right_index];
+                            }
+                        }
+                    }
                 }
+            }
+
+            // As mult_fused_restricted_exp_cpu_apply_fixed, except that the number of channels and the depth are only
+            // known at runtime.
+            template <typename scalar_t, bool inverse>
+            void mult_fused_restricted_exp_cpu_apply(const scalar_t* __restrict next,
+                                                     const scalar_t* __restrict next_divided,
+                                                     scalar_t* const* prev,
+                                                     int64_t input_channel_size,
+                                                     s_size_type depth,
+                                                     scalar_t* new_scratch,
+                                                     scalar_t* old_scratch) {
+                for (s_size_type depth_index = depth - 1; depth_index >= 1; --depth_index) {
+                    int64_t scratch_size = input_channel_size;
 
+                    const scalar_t* next_divided_part = next_divided + (depth_index - 1) * input_channel_size;
+                    for (int64_t scratch_index = 0; scratch_index < input_channel_size; ++scratch_index) {
+                        new_scratch[scratch_index] = prev[0][scratch_index] + next_divided_part[scratch_index];
+                    }
+
+                    for (s_size_type j = 1, k = depth_index - 2; j < depth_index; ++j, --k) {
+                        std::swap(old_scratch, new_scratch);
+                        outer_generic<scalar_t, inverse, /*accumulate=*/false>(new_scratch,
+                                                                               prev[j],
+                                                                               old_scratch,
+                                                                               scratch_size,
+                                                                               next_divided + k * input_channel_size,
+                                                                               input_channel_size);
+                        scratch_size *= input_channel_size;
+                    }
+
+                    outer_generic<scalar_t, inverse, /*accumulate=*/true>(prev[depth_index],
+                                                                          prev[depth_index],
+                                                                          new_scratch,
+                                                                          scratch_size,
+                                                                          next,
+                                                                          input_channel_size);
+                }
+
+                for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                    prev[0][channel_index] += next[channel_index];
+                }
+            }
+
+            // Computes both prev \otimes \exp(next) and \exp(-next) \otimes inverse_prev, for a single batch element.
+            // That is, it's equivalent to calling mult_fused_restricted_exp_cpu_inner_fixed twice, once with
+            // inverse==false, and once with inverse==true and a negated 'next'. The point is that 'next' only has to be
+            // loaded and divided by the reciprocals once; the values needed for the inverse are then just negations of
+            // the same thing.
+            // 'prev' and 'inverse_prev' should each be an array of 'depth' pointers, and 'new_scratch' and
+            // 'old_scratch' are as for mult_fused_restricted_exp_cpu_inner_fixed.
+            template <typename scalar_t, int64_t input_channel_size, s_size_type depth>
+            void mult_fused_restricted_exp_and_inverse_cpu_inner_fixed(const scalar_t* __restrict next,
+                                                                       scalar_t* const* prev,
+                                                                       scalar_t* const* inverse_prev,
+                                                                       const scalar_t* __restrict reciprocals,
+                                                                       scalar_t* new_scratch,
+                                                                       scalar_t* old_scratch) {
+                scalar_t next_values[input_channel_size];
+                scalar_t negative_next[input_channel_size];
+                #pragma omp simd
+                for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                    next_values[channel_index] = next[channel_index];
+                    negative_next[channel_index] = -next[channel_index];
+                }
+
+                scalar_t next_divided[depth - 1][input_channel_size];
+                scalar_t negative_next_divided[depth - 1][input_channel_size];
+                for (s_size_type reciprocal_index = 0; reciprocal_index < depth - 1; ++reciprocal_index) {
+                    #pragma omp simd
+                    for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                        scalar_t divided = reciprocals[reciprocal_index] * next_values[channel_index];
+                        next_divided[reciprocal_index][channel_index] = divided;
+                        negative_next_divided[reciprocal_index][channel_index] = -divided;
+                    }
+                }
+
+                mult_fused_restricted_exp_cpu_apply_fixed<scalar_t, /*inverse=*/false,
+                                                          input_channel_size, depth>(next_values,
+                                                                                     &next_divided[0][0],
+                                                                                     prev,
+                                                                                     new_scratch,
+                                                                                     old_scratch);
+                mult_fused_restricted_exp_cpu_apply_fixed<scalar_t, /*inverse=*/true,
+                                                          input_channel_size, depth>(negative_next,
+                                                                                     &negative_next_divided[0][0],
+                                                                                     inverse_prev,
+                                                                                     new_scratch,
+                                                                                     old_scratch);
+            }
+
+            template <typename scalar_t, int64_t input_channel_size, s_size_type depth>
+            void mult_fused_restricted_exp_and_inverse_cpu_fixed(torch::Tensor next, std::vector<torch::Tensor>& prev,
+                                                                 std::vector<torch::Tensor>& inverse_prev,
+                                                                 torch::Tensor reciprocals, int64_t batch_threads) {
+                int64_t batch_size = next.size(batch_dim);
+
+                const scalar_t* next_data = next.data_ptr<scalar_t>();
+                int64_t next_batch_stride = next.stride(batch_dim);
+                CpuTermPointers<scalar_t> prev_pointers (prev);
+                CpuTermPointers<scalar_t> inverse_prev_pointers (inverse_prev);
+                torch::Tensor reciprocals_contiguous = reciprocals.contiguous();
+                const scalar_t* reciprocals_data = reciprocals_contiguous.data_ptr<scalar_t>();
+
+                int64_t scratch_size = 1;
+                for (s_size_type depth_index = 0; depth_index < depth - 1; ++depth_index) {
+                    scratch_size *= input_channel_size;
+                }
+
+                misc::parallel_for(batch_size, batch_threads, [&](int64_t begin, int64_t end) {
+                    std::vector<scalar_t, default_init_allocator<scalar_t>> new_scratch (scratch_size);
+                    std::vector<scalar_t, default_init_allocator<scalar_t>> old_scratch (scratch_size);
+                    std::vector<scalar_t*> prev_at_batch (depth);
+                    std::vector<scalar_t*> inverse_prev_at_batch (depth);
+
+                    for (int64_t batch_index = begin; batch_index < end; ++batch_index) {
+                        prev_pointers.at_batch(batch_index, prev_at_batch);
+                        inverse_prev_pointers.at_batch(batch_index, inverse_prev_at_batch);
+                        mult_fused_restricted_exp_and_inverse_cpu_inner_fixed<scalar_t,
+                                                                              input_channel_size,
+                                                                              depth>(next_data +
+                                                                                     batch_index * next_batch_stride,
+                                                                                     prev_at_batch.data(),
+                                                                                     inverse_prev_at_batch.data(),
+                                                                                     reciprocals_data,
+                                                                                     new_scratch.data(),
+                                                                                     old_scratch.data());
+                    }
+                });
+            }
+
+            // As mult_fused_restricted_exp_cpu_fixed_depth.
+            template <typename scalar_t, int64_t input_channel_size>
+            bool mult_fused_restricted_exp_and_inverse_cpu_fixed_depth(torch::Tensor next,
+                                                                       std::vector<torch::Tensor>& prev,
+                                                                       std::vector<torch::Tensor>& inverse_prev,
+                                                                       torch::Tensor reciprocals,
+                                                                       int64_t batch_threads) {
+                switch (prev.size()) {
+                    case 3:
+                        mult_fused_restricted_exp_and_inverse_cpu_fixed<scalar_t, input_channel_size, 3>(
+                                next, prev, inverse_prev, reciprocals, batch_threads);
+                        return true;
+                    case 4:
+                        mult_fused_restricted_exp_and_inverse_cpu_fixed<scalar_t, input_channel_size, 4>(
+                                next, prev, inverse_prev, reciprocals, batch_threads);
+                        return true;
+                    case 5:
+                        mult_fused_restricted_exp_and_inverse_cpu_fixed<scalar_t, input_channel_size, 5>(
+                                next, prev, inverse_prev, reciprocals, batch_threads);
+                        return true;
+                    case 6:
+                        mult_fused_restricted_exp_and_inverse_cpu_fixed<scalar_t, input_channel_size, 6>(
+                                next, prev, inverse_prev, reciprocals, batch_threads);
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+
+            // As mult_fused_restricted_exp_cpu_fixed_channels.
+            template <typename scalar_t>
+            bool mult_fused_restricted_exp_and_inverse_cpu_fixed_channels(torch::Tensor next,
+                                                                          std::vector<torch::Tensor>& prev,
+                                                                          std::vector<torch::Tensor>& inverse_prev,
+                                                                          torch::Tensor reciprocals,
+                                                                          int64_t batch_threads) {
+                if (!fixed_kernel_applicable(next, prev) || !fixed_kernel_applicable(next, inverse_prev)) {
+                    return false;
+                }
+                switch (next.size(channel_dim)) {
+                    case 2:
+                        return mult_fused_restricted_exp_and_inverse_cpu_fixed_depth<scalar_t, 2>(
+                                next, prev, inverse_prev, reciprocals, batch_threads);
+                    case 3:
+                        return mult_fused_restricted_exp_and_inverse_cpu_fixed_depth<scalar_t, 3>(
+                                next, prev, inverse_prev, reciprocals, batch_threads);
+                    case 4:
+                        return mult_fused_restricted_exp_and_inverse_cpu_fixed_depth<scalar_t, 4>(
+                                next, prev, inverse_prev, reciprocals, batch_threads);
+                    case 5:
+                        return mult_fused_restricted_exp_and_inverse_cpu_fixed_depth<scalar_t, 5>(
+                                next, prev, inverse_prev, reciprocals, batch_threads);
+                    case 6:
+                        return mult_fused_restricted_exp_and_inverse_cpu_fixed_depth<scalar_t, 6>(
+                                next, prev, inverse_prev, reciprocals, batch_threads);
+                    case 7:
+                        return mult_fused_restricted_exp_and_inverse_cpu_fixed_depth<scalar_t, 7>(
+                                next, prev, inverse_prev, reciprocals, batch_threads);
+                    case 8:
+                        return mult_fused_restricted_exp_and_inverse_cpu_fixed_depth<scalar_t, 8>(
+                                next, prev, inverse_prev, reciprocals, batch_threads);
+                    default:
+                        return false;
+                }
+            }
+
+            // Parallelises over the batch elements, computing both prev \otimes \exp(next) and
+            // \exp(-next) \otimes inverse_prev for each one. 'prev' and 'inverse_prev' should satisfy
+            // cpu_kernel_applicable. 'next' may have any strides.
+            template <typename scalar_t>
+            void mult_fused_restricted_exp_and_inverse_cpu(torch::Tensor next, std::vector<torch::Tensor>& prev,
+                                                           std::vector<torch::Tensor>& inverse_prev,
+                                                           torch::Tensor reciprocals, int64_t batch_threads) {
+                // Use the fixed-size implementation if we can
+                if (mult_fused_restricted_exp_and_inverse_cpu_fixed_channels<scalar_t>(next, prev, inverse_prev,
+                                                                                       reciprocals, batch_threads)) {
+                    return;
+                }
+
+                int64_t batch_size = next.size(batch_dim);
+                int64_t input_channel_size = next.size(channel_dim);
+                s_size_type depth = prev.size();
+
+                const scalar_t* next_data = next.data_ptr<scalar_t>();
+                int64_t next_batch_stride = next.stride(batch_dim);
+                int64_t next_channel_stride = next.stride(channel_dim);
+                CpuTermPointers<scalar_t> prev_pointers (prev);
+                CpuTermPointers<scalar_t> inverse_prev_pointers (inverse_prev);
+                torch::Tensor reciprocals_contiguous = reciprocals.contiguous();
+                const scalar_t* reciprocals_data = reciprocals_contiguous.data_ptr<scalar_t>();
+
+                int64_t scratch_size = 1;
+                for (s_size_type depth_index = 0; depth_index < depth - 1; ++depth_index) {
+                    scratch_size *= input_channel_size;
+                }
+                int64_t next_divided_size = (depth - 1) * input_channel_size;
+
+                misc::parallel_for(batch_size, batch_threads, [&](int64_t begin, int64_t end) {
+                    // Allocate scratch space outside of the hot loop
+                    std::vector<scalar_t, default_init_allocator<scalar_t>> next_values (input_channel_size);
+                    std::vector<scalar_t, default_init_allocator<scalar_t>> negative_next (input_channel_size);
+                    std::vector<scalar_t, default_init_allocator<scalar_t>> next_divided (next_divided_size);
+                    std::vector<scalar_t, default_init_allocator<scalar_t>> negative_next_divided (next_divided_size);
+                    std::vector<scalar_t, default_init_allocator<scalar_t>> new_scratch (scratch_size);
+                    std::vector<scalar_t, default_init_allocator<scalar_t>> old_scratch (scratch_size);
+                    std::vector<scalar_t*> prev_at_batch (depth);
+                    std::vector<scalar_t*> inverse_prev_at_batch (depth);
+
+                    for (int64_t batch_index = begin; batch_index < end; ++batch_index) {
+                        const scalar_t* next_at_batch = next_data + batch_index * next_batch_stride;
+                        for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                            next_values[channel_index] = next_at_batch[channel_index * next_channel_stride];
+                            negative_next[channel_index] = -next_values[channel_index];
+                        }
+                        int64_t next_divided_index = 0;
+                        for (s_size_type reciprocal_index = 0; reciprocal_index < depth - 1; ++reciprocal_index) {
+                            for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                                scalar_t divided = reciprocals_data[reciprocal_index] * next_values[channel_index];
+                                next_divided[next_divided_index] = divided;
+                                negative_next_divided[next_divided_index] = -divided;
+                                ++next_divided_index;
+                            }
+                        }
+
+                        prev_pointers.at_batch(batch_index, prev_at_batch);
+                        inverse_prev_pointers.at_batch(batch_index, inverse_prev_at_batch);
+                        mult_fused_restricted_exp_cpu_apply<scalar_t, /*inverse=*/false>(next_values.data(),
+                                                                                         next_divided.data(),
+                                                                                         prev_at_batch.data(),
+                                                                                         input_channel_size,
+                                                                                         depth,
+                                                                                         new_scratch.data(),
+                                                                                         old_scratch.data());
+                        mult_fused_restricted_exp_cpu_apply<scalar_t, /*inverse=*/true>(negative_next.data(),
+                                                                                        negative_next_divided.data(),
+                                                                                        inverse_prev_at_batch.data(),
+                                                                                        input_channel_size,
+                                                                                        depth,
+                                                                                        new_scratch.data(),
+                                                                                        old_scratch.data());
+                    }
+                });
             }
 
             // If you're reading this function and trying to understand it...
@@ -830,13 +1681,343 @@ namespace signatory {
                 }
             }
 
+            // The backward of outer_fixed: given grad_out, computes grad_left, and adds on to grad_right.
+            template <typename scalar_t, bool inverse, int64_t input_channel_size>
+            inline void outer_fixed_backward(scalar_t* __restrict grad_left, scalar_t* __restrict grad_right,
+                                             const scalar_t* __restrict grad_out, const scalar_t* __restrict left,
+                                             int64_t left_size, const scalar_t* __restrict right) {
+                if (inverse) {
+                    for (int64_t left_index = 0; left_index < left_size; ++left_index) {
+                        grad_left[left_index] = 0;
+                    }
+                    for (int64_t right_index = 0; right_index < input_channel_size; ++right_index) {
+                        scalar_t right_value = right[right_index];
+                        int64_t row = right_index * left_size;
+                        scalar_t grad_right_value = 0;
+                        #pragma omp simd reduction(+:grad_right_value)
+                        for (int64_t left_index = 0; left_index < left_size; ++left_index) {
+                            grad_left[left_index] += grad_out[row + left_index] * right_value;
+                            grad_right_value += grad_out[row + left_index] * left[left_index];
+                        }
+                        grad_right[right_index] += grad_right_value;
+                    }
+                }
+                else {
+                    for (int64_t left_index = 0; left_index < left_size; ++left_index) {
+                        scalar_t left_value = left[left_index];
+                        int64_t row = left_index * input_channel_size;
+                        scalar_t grad_left_value = 0;
+                        #pragma omp simd reduction(+:grad_left_value)
+                        for (int64_t right_index = 0; right_index < input_channel_size; ++right_index) {
+                            grad_left_value += grad_out[row + right_index] * right[right_index];
+                            grad_right[right_index] += grad_out[row + right_index] * left_value;
+                        }
+                        grad_left[left_index] = grad_left_value;
+                    }
+                }
+            }
+
+            // The total amount of space needed to record the scratches in mult_fused_restricted_exp_backward_cpu_fixed.
+            inline int64_t fixed_scratches_size(int64_t input_channel_size, s_size_type depth) {
+                int64_t total = 0;
+                for (s_size_type depth_index = 1; depth_index < depth; ++depth_index) {
+                    int64_t scratch_size = 1;
+                    for (s_size_type j = 0; j < depth_index; ++j) {
+                        scratch_size *= input_channel_size;
+                        total += scratch_size;
+                    }
+                }
+                return total;
+            }
+
+            // As mult_fused_restricted_exp_backward_cpu_inner, for a single batch element.
+            // 'grad_prev' and 'prev' should be arrays of 'depth' pointers, one to each term for this batch element.
+            // 'scratches' and 'grad_scratches' should each have space for fixed_scratches_size(...) elements.
+            template <typename scalar_t, bool inverse, int64_t input_channel_size, s_size_type depth>
+            void mult_fused_restricted_exp_backward_cpu_inner_fixed(scalar_t* __restrict grad_next,
+                                                                    scalar_t* const* grad_prev,
+                                                                    const scalar_t* __restrict next,
+                                                                    const scalar_t* const* prev,
+                                                                    const scalar_t* __restrict reciprocals,
+                                                                    scalar_t* scratches,
+                                                                    scalar_t* grad_scratches) {
+                // term_sizes[j] is the size of the (j + 1)-th term of the tensor algebra
+                int64_t term_sizes[depth];
+                term_sizes[0] = input_channel_size;
+                for (s_size_type j = 1; j < depth; ++j) {
+                    term_sizes[j] = term_sizes[j - 1] * input_channel_size;
+                }
+                // scratch_offsets[depth_index - 1][j] is where the j-th scratch used in computing the depth_index-th
+                // term is recorded, in 'scratches' and 'grad_scratches'. This scratch is of size term_sizes[j].
+                int64_t scratch_offsets[depth - 1][depth - 1];
+                int64_t offset = 0;
+                for (s_size_type depth_index = 1; depth_index < depth; ++depth_index) {
+                    for (s_size_type j = 0; j < depth_index; ++j) {
+                        scratch_offsets[depth_index - 1][j] = offset;
+                        offset += term_sizes[j];
+                    }
+                }
+
+                scalar_t next_divided[depth - 1][input_channel_size];
+                for (s_size_type reciprocal_index = 0; reciprocal_index < depth - 1; ++reciprocal_index) {
+                    #pragma omp simd
+                    for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                        next_divided[reciprocal_index][channel_index] = reciprocals[reciprocal_index] *
+                                                                        next[channel_index];
+                    }
+                }
+
+                // Recompute the forward pass, recording the scratches
+
+                for (s_size_type depth_index = depth - 1; depth_index >= 1; --depth_index) {
+                    scalar_t* scratch = scratches + scratch_offsets[depth_index - 1][0];
+                    #pragma omp simd
+                    for (int64_t scratch_index = 0; scratch_index < input_channel_size; ++scratch_index) {
+                        scratch[scratch_index] = prev[0][scratch_index] + next_divided[depth_index - 1][scratch_index];
+                    }
+                    for (s_size_type j = 1, k = depth_index - 2; j < depth_index; ++j, --k) {
+                        scalar_t* new_scratch = scratches + scratch_offsets[depth_index - 1][j];
+                        outer_fixed<scalar_t, inverse, /*accumulate=*/false, input_channel_size>(new_scratch,
+                                                                                                 prev[j],
+                                                                                                 scratch,
+                                                                                                 term_sizes[j - 1],
+                                                                                                 next_divided[k]);
+                        scratch = new_scratch;
+                    }
+                }
+
+                // Do the backward computation
+
+                scalar_t grad_next_divided[depth - 1][input_channel_size];
+                for (s_size_type reciprocal_index = 0; reciprocal_index < depth - 1; ++reciprocal_index) {
+                    for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                        grad_next_divided[reciprocal_index][channel_index] = 0;
+                    }
+                }
+
+                for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                    grad_next[channel_index] = grad_prev[0][channel_index];
+                }
+                for (s_size_type depth_index = 1; depth_index < depth; ++depth_index) {
+                    const int64_t* offsets = scratch_offsets[depth_index - 1];
+
+                    outer_fixed_backward<scalar_t, inverse, input_channel_size>(grad_scratches +
+                                                                                offsets[depth_index - 1],
+                                                                                grad_next,
+                                                                                grad_prev[depth_index],
+                                                                                scratches + offsets[depth_index - 1],
+                                                                                term_sizes[depth_index - 1],
+                                                                                next);
+
+                    for (s_size_type j = depth_index - 1, k = 0; j >= 1; --j, ++k) {
+                        const scalar_t* grad_scratch = grad_scratches + offsets[j];
+                        #pragma omp simd
+                        for (int64_t index = 0; index < term_sizes[j]; ++index) {
+                            grad_prev[j][index] += grad_scratch[index];
+                        }
+                        outer_fixed_backward<scalar_t, inverse, input_channel_size>(grad_scratches + offsets[j - 1],
+                                                                                    grad_next_divided[k],
+                                                                                    grad_scratch,
+                                                                                    scratches + offsets[j - 1],
+                                                                                    term_sizes[j - 1],
+                                                                                    next_divided[k]);
+                    }
+
+                    const scalar_t* grad_first_scratch = grad_scratches + offsets[0];
+                    #pragma omp simd
+                    for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                        grad_next_divided[depth_index - 1][channel_index] += grad_first_scratch[channel_index];
+                        grad_prev[0][channel_index] += grad_first_scratch[channel_index];
+                    }
+                }
+
+                for (s_size_type reciprocal_index = 0; reciprocal_index < depth - 1; ++reciprocal_index) {
+                    #pragma omp simd
+                    for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                        grad_next[channel_index] += reciprocals[reciprocal_index] *
+                                                    grad_next_divided[reciprocal_index][channel_index];
+                    }
+                }
+            }
+
+            template <typename scalar_t, bool inverse, int64_t input_channel_size, s_size_type depth>
+            void mult_fused_restricted_exp_backward_cpu_fixed(torch::Tensor grad_next,
+                                                              std::vector<torch::Tensor>& grad_prev,
+                                                              torch::Tensor next,
+                                                              const std::vector<torch::Tensor>& prev,
+                                                              torch::Tensor reciprocals,
+                                                              int64_t batch_threads) {
+                int64_t batch_size = next.size(batch_dim);
+
+                scalar_t* grad_next_data = grad_next.data_ptr<scalar_t>();
+                int64_t grad_next_batch_stride = grad_next.stride(batch_dim);
+                const scalar_t* next_data = next.data_ptr<scalar_t>();
+                int64_t next_batch_stride = next.stride(batch_dim);
+                scalar_t* grad_prev_data[depth];
+                int64_t grad_prev_batch_stride[depth];
+                const scalar_t* prev_data[depth];
+                int64_t prev_batch_stride[depth];
+                for (s_size_type depth_index = 0; depth_index < depth; ++depth_index) {
+                    grad_prev_data[depth_index] = grad_prev[depth_index].data_ptr<scalar_t>();
+                    grad_prev_batch_stride[depth_index] = grad_prev[depth_index].stride(batch_dim);
+                    prev_data[depth_index] = prev[depth_index].data_ptr<scalar_t>();
+                    prev_batch_stride[depth_index] = prev[depth_index].stride(batch_dim);
+                }
+                torch::Tensor reciprocals_contiguous = reciprocals.contiguous();
+                const scalar_t* reciprocals_data = reciprocals_contiguous.data_ptr<scalar_t>();
+
+                int64_t scratches_size = fixed_scratches_size(input_channel_size, depth);
+
+                misc::parallel_for(batch_size, batch_threads, [&](int64_t begin, int64_t end) {
+                    std::vector<scalar_t, default_init_allocator<scalar_t>> scratches (scratches_size);
+                    std::vector<scalar_t, default_init_allocator<scalar_t>> grad_scratches (scratches_size);
+                    scalar_t* grad_prev_at_batch[depth];
+                    const scalar_t* prev_at_batch[depth];
+
+                    for (int64_t batch_index = begin; batch_index < end; ++batch_index) {
+                        for (s_size_type depth_index = 0; depth_index < depth; ++depth_index) {
+                            grad_prev_at_batch[depth_index] = grad_prev_data[depth_index] +
+                                                              batch_index * grad_prev_batch_stride[depth_index];
+                            prev_at_batch[depth_index] = prev_data[depth_index] +
+                                                         batch_index * prev_batch_stride[depth_index];
+                        }
+                        mult_fused_restricted_exp_backward_cpu_inner_fixed<scalar_t,
+                                                                           inverse,
+                                                                           input_channel_size,
+                                                                           depth>(grad_next_data +
+                                                                                  batch_index * grad_next_batch_stride,
+                                                                                  grad_prev_at_batch,
+                                                                                  next_data +
+                                                                                  batch_index * next_batch_stride,
+                                                                                  prev_at_batch,
+                                                                                  reciprocals_data,
+                                                                                  scratches.data(),
+                                                                                  grad_scratches.data());
+                    }
+                });
+            }
+
+            // Dispatches from runtime sizes to the appropriate instantiation of
+            // mult_fused_restricted_exp_backward_cpu_fixed. Returns false if there isn't one.
+            template <typename scalar_t, bool inverse, int64_t input_channel_size>
+            bool mult_fused_restricted_exp_backward_cpu_fixed_depth(torch::Tensor grad_next,
+                                                                    std::vector<torch::Tensor>& grad_prev,
+                                                                    torch::Tensor next,
+                                                                    const std::vector<torch::Tensor>& prev,
+                                                                    torch::Tensor reciprocals,
+                                                                    int64_t batch_threads) {
+                switch (prev.size()) {
+                    case 3:
+                        mult_fused_restricted_exp_backward_cpu_fixed<scalar_t, inverse, input_channel_size,
+                                                                     3>(grad_next, grad_prev, next, prev, reciprocals,
+                                                                        batch_threads);
+                        return true;
+                    case 4:
+                        mult_fused_restricted_exp_backward_cpu_fixed<scalar_t, inverse, input_channel_size,
+                                                                     4>(grad_next, grad_prev, next, prev, reciprocals,
+                                                                        batch_threads);
+                        return true;
+                    case 5:
+                        mult_fused_restricted_exp_backward_cpu_fixed<scalar_t, inverse, input_channel_size,
+                                                                     5>(grad_next, grad_prev, next, prev, reciprocals,
+                                                                        batch_threads);
+                        return true;
+                    case 6:
+                        mult_fused_restricted_exp_backward_cpu_fixed<scalar_t, inverse, input_channel_size,
+                                                                     6>(grad_next, grad_prev, next, prev, reciprocals,
+                                                                        batch_threads);
+                        return true;
+                    default:
+                        return false;
+                }
+            }
+
+            template <typename scalar_t, bool inverse>
+            bool mult_fused_restricted_exp_backward_cpu_fixed_channels(torch::Tensor grad_next,
+                                                                       std::vector<torch::Tensor>& grad_prev,
+                                                                       torch::Tensor next,
+                                                                       const std::vector<torch::Tensor>& prev,
+                                                                       torch::Tensor reciprocals,
+                                                                       int64_t batch_threads) {
+                if (!fixed_kernel_applicable(next, prev) || !fixed_kernel_applicable(grad_next, grad_prev)) {
+                    return false;
+                }
+                switch (next.size(channel_dim)) {
+                    case 2:
+                        return mult_fused_restricted_exp_backward_cpu_fixed_depth<scalar_t, inverse, 2>(grad_next,
+                                                                                                       grad_prev,
+                                                                                                       next, prev,
+                                                                                                       reciprocals,
+                                                                                                       batch_threads);
+                    case 3:
+                        return mult_fused_restricted_exp_backward_cpu_fixed_depth<scalar_t, inverse, 3>(grad_next,
+                                                                                                       grad_prev,
+                                                                                                       next, prev,
+                                                                                                       reciprocals,
+                                                                                                       batch_threads);
+                    case 4:
+                        return mult_fused_restricted_exp_backward_cpu_fixed_depth<scalar_t, inverse, 4>(grad_next,
+                                                                                                       grad_prev,
+                                                                                                       next, prev,
+                                                                                                       reciprocals,
+                                                                                                       batch_threads);
+                    case 5:
+                        return mult_fused_restricted_exp_backward_cpu_fixed_depth<scalar_t, inverse, 5>(grad_next,
+                                                                                                       grad_prev,
+                                                                                                       next, prev,
+                                                                                                       reciprocals,
+                                                                                                       batch_threads);
+                    case 6:
+                        return mult_fused_restricted_exp_backward_cpu_fixed_depth<scalar_t, inverse, 6>(grad_next,
+                                                                                                       grad_prev,
+                                                                                                       next, prev,
+                                                                                                       reciprocals,
+                                                                                                       batch_threads);
+                    case 7:
+                        return mult_fused_restricted_exp_backward_cpu_fixed_depth<scalar_t, inverse, 7>(grad_next,
+                                                                                                       grad_prev,
+                                                                                                       next, prev,
+                                                                                                       reciprocals,
+                                                                                                       batch_threads);
+                    case 8:
+                        return mult_fused_restricted_exp_backward_cpu_fixed_depth<scalar_t, inverse, 8>(grad_next,
+                                                                                                       grad_prev,
+                                                                                                       next, prev,
+                                                                                                       reciprocals,
+                                                                                                       batch_threads);
+                    default:
+                        return false;
+                }
+            }
+
             template <typename scalar_t>
             void mult_fused_restricted_exp_backward_cpu(torch::Tensor grad_next,
                                                         std::vector<torch::Tensor>& grad_prev,
                                                         torch::Tensor next,
                                                         const std::vector<torch::Tensor>& prev,
                                                         bool inverse,
-                                                        torch::Tensor reciprocals) {
+                                                        torch::Tensor reciprocals,
+                                                        int64_t batch_threads) {
+                // Use the fixed-size implementation if we can
+                if (inverse) {
+                    if (mult_fused_restricted_exp_backward_cpu_fixed_channels<scalar_t,
+                                                                              /*inverse=*/true>(grad_next, grad_prev,
+                                                                                                next, prev,
+                                                                                                reciprocals,
+                                                                                                batch_threads)) {
+                        return;
+                    }
+                }
+                else {
+                    if (mult_fused_restricted_exp_backward_cpu_fixed_channels<scalar_t,
+                                                                              /*inverse=*/false>(grad_next, grad_prev,
+                                                                                                 next, prev,
+                                                                                                 reciprocals,
+                                                                                                 batch_threads)) {
+                        return;
+                    }
+                }
+
                 auto grad_next_a = grad_next.accessor<scalar_t, 2>();
 
                 std::vector<torch::TensorAccessor<scalar_t, 2>> grad_prev_a;
@@ -856,35 +2037,40 @@ namespace signatory {
                 auto reciprocals_a = reciprocals.accessor<scalar_t, 1>();
 
                 int64_t batch_size = next.size(batch_dim);
-                #pragma omp parallel for default(none) \
-                                         shared(batch_size, grad_next_a, grad_prev_a, next_a, prev_a, inverse, \
-                                                reciprocals_a)
-                for (int64_t batch_index = 0; batch_index < batch_size; ++batch_index) {
-                    if (inverse) {
-                        mult_fused_restricted_exp_backward_cpu_inner<scalar_t,
-                                                                     /*inverse=*/true>(grad_next_a,
-                                                                                       grad_prev_a,
-                                                                                       next_a,
-                                                                                       prev_a,
-                                                                                       reciprocals_a,
-                                                                                       batch_index);
-                    }
-                    else {
-                        mult_fused_restricted_exp_backward_cpu_inner<scalar_t,
-                                                                     /*inverse=*/false>(grad_next_a,
-                                                                                        grad_prev_a,
-                                                                                        next_a,
-                                                                                        prev_a,
-                                                                                        reciprocals_a,
-                                                                                        batch_index);
+                misc::parallel_for(batch_size, batch_threads, [&](int64_t begin, int64_t end) {
+                    for (int64_t batch_index = begin; batch_index < end; ++batch_index) {
+                        if (inverse) {
+                            mult_fused_restricted_exp_backward_cpu_inner<scalar_t,
+                                                                         /*inverse=*/true>(grad_next_a,
+                                                                                           grad_prev_a,
+                                                                                           next_a,
+                                                                                           prev_a,
+                                                                                           reciprocals_a,
+                                                                                           batch_index);
+                        }
+                        else {
+                            mult_fused_restricted_exp_backward_cpu_inner<scalar_t,
+                                                                         /*inverse=*/false>(grad_next_a,
+                                                                                            grad_prev_a,
+                                                                                            next_a,
+                                                                                            prev_a,
+                                                                                            reciprocals_a,
+                                                                                            batch_index);
+                        }
                     }
-                }
+                });
             }
         }  // namespace signatory::ta_ops::detail
 
         void mult_fused_restricted_exp(torch::Tensor next, std::vector<torch::Tensor>& prev, bool inverse,
                                        torch::Tensor reciprocals, int64_t batch_threads) {
             if (next.is_cuda()) {
+                #ifdef SIGNATORY_CUDA
+                if (detail::mult_fused_restricted_exp_cuda_kernel_supported(next, prev)) {
+                    detail::mult_fused_restricted_exp_cuda_kernel(next, prev, inverse, reciprocals);
+                    return;
+                }
+                #endif
                 detail::mult_fused_restricted_exp_cuda(next, prev, inverse, reciprocals);
             }
             else{
@@ -894,19 +2080,44 @@ namespace signatory {
             }
         }
 
+        void mult_fused_restricted_exp_and_inverse(torch::Tensor next, std::vector<torch::Tensor>& prev,
+                                                   std::vector<torch::Tensor>& inverse_prev, torch::Tensor reciprocals,
+                                                   int64_t batch_threads) {
+            if (!next.is_cuda() && (next.scalar_type() == torch::kFloat32 || next.scalar_type() == torch::kFloat64) &&
+                detail::cpu_kernel_applicable(prev) && detail::cpu_kernel_applicable(inverse_prev)) {
+                AT_DISPATCH_FLOATING_TYPES(next.scalar_type(), "mult_fused_restricted_exp_and_inverse_cpu", ([&] {
+                    detail::mult_fused_restricted_exp_and_inverse_cpu<scalar_t>(next, prev, inverse_prev, reciprocals,
+                                                                                batch_threads);
+                }));
+            }
+            else {
+                mult_fused_restricted_exp(next, prev, /*inverse=*/false, reciprocals, batch_threads);
+                mult_fused_restricted_exp(-next, inverse_prev, /*inverse=*/true, reciprocals, batch_threads);
+            }
+        }
+
         void mult_fused_restricted_exp_backward(torch::Tensor grad_next,
                                                 std::vector<torch::Tensor>& grad_prev,
                                                 torch::Tensor next,
                                                 const std::vector<torch::Tensor>& prev,
                                                 bool inverse,
-                                                torch::Tensor reciprocals) {
+                                                torch::Tensor reciprocals,
+                                                int64_t batch_threads) {
             if (grad_next.is_cuda()) {
+                #ifdef SIGNATORY_CUDA
+                if (detail::mult_fused_restricted_exp_cuda_kernel_supported(next, prev) &&
+                    detail::mult_fused_restricted_exp_cuda_kernel_supported(grad_next, grad_prev)) {
+                    detail::mult_fused_restricted_exp_backward_cuda_kernel(grad_next, grad_prev, next, prev, inverse,
+                                                                           reciprocals);
+                    return;
+                }
+                #endif
                 detail::mult_fused_restricted_exp_backward_cuda(grad_next, grad_prev, next, prev, inverse, reciprocals);
             }
             else{
                 AT_DISPATCH_FLOATING_TYPES(grad_next.scalar_type(), "mult_fused_restricted_exp_backward_cpu", ([&] {
                     detail::mult_fused_restricted_exp_backward_cpu<scalar_t>(grad_next, grad_prev, next, prev, inverse,
-                                                                             reciprocals);
+                                                                             reciprocals, batch_threads);
                 }));
             }
         }
@@ -964,15 +2175,212 @@ namespace signatory {
                     grad_tensor_at_depth.zero_();
                 }
             }
+
+            // The coefficients of the power series of the logarithm, as log_coefficient_at_depth.
+            template <typename scalar_t>
+            std::vector<scalar_t> log_coefficients(s_size_type depth, torch::Tensor reciprocals) {
+                torch::Tensor reciprocals_contiguous = reciprocals.contiguous();
+                const scalar_t* reciprocals_data = reciprocals_contiguous.data_ptr<scalar_t>();
+                std::vector<scalar_t> coefficients(depth - 1);
+                for (s_size_type depth_index = 0; depth_index < depth - 1; ++depth_index) {
+                    coefficients[depth_index] = (((depth_index % 2) == 0) ? -1 : 1) * reciprocals_data[depth_index];
+                }
+                return coefficients;
+            }
+
+            // Performs a single step of the Horner scheme used to compute the logarithm, for a single batch element.
+            // This is precisely what mult_partial does: each of the terms of 'out' up to and including 'top_term' is
+            // replaced with scalar_term_value * in + out \otimes in. (Going from the top term downwards, so that the
+            // lower terms of 'out' are still their previous values when they're used.)
+            template <typename scalar_t>
+            inline void log_cpu_step(scalar_t* const* out, const scalar_t* const* in, const int64_t* sizes,
+                                     scalar_t scalar_term_value, s_size_type top_term) {
+                for (s_size_type depth_index = top_term; depth_index >= 0; --depth_index) {
+                    scalar_t* out_at_depth = out[depth_index];
+                    const scalar_t* in_at_depth = in[depth_index];
+                    #pragma omp simd
+                    for (int64_t index = 0; index < sizes[depth_index]; ++index) {
+                        out_at_depth[index] = scalar_term_value * in_at_depth[index];
+                    }
+                    for (s_size_type j = 0, k = depth_index - 1; j < depth_index; ++j, --k) {
+                        for (int64_t out_index = 0; out_index < sizes[j]; ++out_index) {
+                            scalar_t out_val = out[j][out_index];
+                            scalar_t* out_row = out_at_depth + out_index * sizes[k];
+                            const scalar_t* in_k = in[k];
+                            #pragma omp simd
+                            for (int64_t in_index = 0; in_index < sizes[k]; ++in_index) {
+                                out_row[in_index] += out_val * in_k[in_index];
+                            }
+                        }
+                    }
+                }
+            }
+
+            // Backwards through log_cpu_step.
+            // 'out' should be as passed to log_cpu_step. (Not as it returns.)
+            // 'grad_out' is the input gradient, and will be modified in-place.
+            // 'grad_in' will have the result of this operation added on to it.
+            template <typename scalar_t>
+            inline void log_cpu_step_backward(scalar_t* const* grad_out, scalar_t* const* grad_in,
+                                              const scalar_t* const* out, const scalar_t* const* in,
+                                              const int64_t* sizes, scalar_t scalar_term_value,
+                                              s_size_type top_term) {
+                for (s_size_type depth_index = 0; depth_index <= top_term; ++depth_index) {
+                    scalar_t* grad_out_at_depth = grad_out[depth_index];
+                    scalar_t* grad_in_at_depth = grad_in[depth_index];
+                    #pragma omp simd
+                    for (int64_t index = 0; index < sizes[depth_index]; ++index) {
+                        grad_in_at_depth[index] += scalar_term_value * grad_out_at_depth[index];
+                    }
+                    for (s_size_type j = depth_index - 1, k = 0; j >= 0; --j, ++k) {
+                        for (int64_t out_index = 0; out_index < sizes[j]; ++out_index) {
+                            scalar_t out_val = out[j][out_index];
+                            const scalar_t* grad_out_row = grad_out_at_depth + out_index * sizes[k];
+                            const scalar_t* in_k = in[k];
+                            scalar_t* grad_in_k = grad_in[k];
+                            scalar_t grad_out_val = 0;
+                            #pragma omp simd reduction(+:grad_out_val)
+                            for (int64_t in_index = 0; in_index < sizes[k]; ++in_index) {
+                                grad_out_val += grad_out_row[in_index] * in_k[in_index];
+                                grad_in_k[in_index] += out_val * grad_out_row[in_index];
+                            }
+                            grad_out[j][out_index] += grad_out_val;
+                        }
+                    }
+                    #pragma omp simd
+                    for (int64_t index = 0; index < sizes[depth_index]; ++index) {
+                        grad_out_at_depth[index] = 0;
+                    }
+                }
+            }
+
+            // The scalar value and top term of each step of the Horner scheme. Step 'step' corresponds to the call to
+            // mult_partial in log with depth_index == depth - 3 - step. (With the final call being step == depth - 2.)
+            template <typename scalar_t>
+            inline scalar_t log_step_scalar(s_size_type step, s_size_type depth, const scalar_t* coefficients) {
+                return (step < depth - 2) ? coefficients[depth - 3 - step] : 1;
+            }
+
+            // As ta_ops::log, for CPU tensors whose channel dimension is contiguous. Rather than making lots of calls
+            // to ATen for every little piece of the computation, this handles each batch element in one go, and
+            // parallelises over the batch dimension.
+            template <typename scalar_t>
+            void log_cpu(std::vector<torch::Tensor>& output_vector, const std::vector<torch::Tensor>& input_vector,
+                         torch::Tensor reciprocals, int64_t batch_threads) {
+                s_size_type depth = input_vector.size();
+                int64_t batch_size = input_vector[0].size(batch_dim);
+                std::vector<scalar_t> coefficients = log_coefficients<scalar_t>(depth, reciprocals);
+
+                std::vector<int64_t> sizes = term_sizes(input_vector);
+                CpuTermPointers<scalar_t> out_pointers(output_vector);
+                CpuTermPointers<scalar_t> in_pointers(input_vector);
+
+                misc::parallel_for(batch_size, batch_threads, [&](int64_t begin, int64_t end) {
+                    std::vector<scalar_t*> out(depth);
+                    std::vector<scalar_t*> in(depth);
+
+                    for (int64_t batch_index = begin; batch_index < end; ++batch_index) {
+                        out_pointers.at_batch(batch_index, out);
+                        in_pointers.at_batch(batch_index, in);
+                        for (int64_t index = 0; index < sizes[0]; ++index) {
+                            out[0][index] = coefficients[depth - 2] * in[0][index];
+                        }
+                        for (s_size_type step = 0; step < depth - 1; ++step) {
+                            log_cpu_step<scalar_t>(out.data(), in.data(), sizes.data(),
+                                                   log_step_scalar(step, depth, coefficients.data()),
+                                                   /*top_term=*/step + 1);
+                        }
+                    }
+                });
+            }
+
+            // As ta_ops::log_backward, for CPU tensors whose channel dimension is contiguous.
+            // The partially-computed logarithms are recorded for each batch element separately, in a scratch space
+            // belonging to each thread. So unlike the generic implementation, the extra memory used doesn't scale with
+            // the batch size.
+            template <typename scalar_t>
+            void log_backward_cpu(std::vector<torch::Tensor>& grad_output_vector,
+                                  std::vector<torch::Tensor>& grad_input_vector,
+                                  const std::vector<torch::Tensor>& input_vector,
+                                  torch::Tensor reciprocals,
+                                  int64_t batch_threads) {
+                s_size_type depth = input_vector.size();
+                int64_t batch_size = input_vector[0].size(batch_dim);
+                std::vector<scalar_t> coefficients = log_coefficients<scalar_t>(depth, reciprocals);
+
+                std::vector<int64_t> sizes = term_sizes(input_vector);
+                std::vector<int64_t> offsets(depth);
+                int64_t total_size = 0;
+                for (s_size_type depth_index = 0; depth_index < depth; ++depth_index) {
+                    offsets[depth_index] = total_size;
+                    total_size += sizes[depth_index];
+                }
+                CpuTermPointers<scalar_t> grad_out_pointers(grad_output_vector);
+                CpuTermPointers<scalar_t> grad_in_pointers(grad_input_vector);
+                CpuTermPointers<scalar_t> in_pointers(input_vector);
+
+                misc::parallel_for(batch_size, batch_threads, [&](int64_t begin, int64_t end) {
+                    // records[step] is the partially-computed logarithm before that step. (Of which only the terms up
+                    // to and including 'step' are actually used.)
+                    std::vector<scalar_t, default_init_allocator<scalar_t>> records ((depth - 1) * total_size);
+                    std::vector<std::vector<scalar_t*>> record_pointers(depth - 1, std::vector<scalar_t*>(depth));
+                    for (s_size_type step = 0; step < depth - 1; ++step) {
+                        for (s_size_type depth_index = 0; depth_index < depth; ++depth_index) {
+                            record_pointers[step][depth_index] = records.data() + step * total_size +
+                                                                 offsets[depth_index];
+                        }
+                    }
+                    std::vector<scalar_t*> grad_out(depth);
+                    std::vector<scalar_t*> grad_in(depth);
+                    std::vector<scalar_t*> in(depth);
+
+                    for (int64_t batch_index = begin; batch_index < end; ++batch_index) {
+                        grad_out_pointers.at_batch(batch_index, grad_out);
+                        grad_in_pointers.at_batch(batch_index, grad_in);
+                        in_pointers.at_batch(batch_index, in);
+
+                        // Compute the logarithm forwards and remember every intermediate value...
+                        for (int64_t index = 0; index < sizes[0]; ++index) {
+                            record_pointers[0][0][index] = coefficients[depth - 2] * in[0][index];
+                        }
+                        for (s_size_type step = 1; step < depth - 1; ++step) {
+                            // Only the terms up to and including 'step' are needed, and those are contiguous.
+                            std::copy(records.data() + (step - 1) * total_size,
+                                      records.data() + (step - 1) * total_size + offsets[step],
+                                      records.data() + step * total_size);
+                            log_cpu_step<scalar_t>(record_pointers[step].data(), in.data(), sizes.data(),
+                                                   log_step_scalar(step - 1, depth, coefficients.data()),
+                                                   /*top_term=*/step);
+                        }
+
+                        // ...and then go backwards through it.
+                        for (s_size_type step = depth - 2; step >= 0; --step) {
+                            log_cpu_step_backward<scalar_t>(grad_out.data(), grad_in.data(),
+                                                            record_pointers[step].data(), in.data(), sizes.data(),
+                                                            log_step_scalar(step, depth, coefficients.data()),
+                                                            /*top_term=*/step + 1);
+                        }
+                        for (int64_t index = 0; index < sizes[0]; ++index) {
+                            grad_in[0][index] += coefficients[depth - 2] * grad_out[0][index];
+                        }
+                    }
+                });
+            }
         }  // namespace signatory::ta_ops::detail
 
         void log(std::vector<torch::Tensor>& output_vector, const std::vector<torch::Tensor>& input_vector,
-                 torch::Tensor reciprocals) {
+                 torch::Tensor reciprocals, int64_t batch_threads) {
             s_size_type depth = input_vector.size();
             if (depth == 1) {
                 output_vector[0].copy_(input_vector[0]);
                 return;
             }
+            if (detail::cpu_kernel_applicable(output_vector) && detail::cpu_kernel_applicable(input_vector)) {
+                AT_DISPATCH_FLOATING_TYPES(input_vector[0].scalar_type(), "log_cpu", ([&] {
+                    detail::log_cpu<scalar_t>(output_vector, input_vector, reciprocals, batch_threads);
+                }));
+                return;
+            }
             output_vector[0].copy_(input_vector[0] * detail::log_coefficient_at_depth(depth - 2, reciprocals));
             for (s_size_type depth_index = depth - 3; depth_index >= 0; --depth_index) {
                 detail::mult_partial(output_vector,
@@ -987,12 +2395,21 @@ namespace signatory {
         void log_backward(std::vector<torch::Tensor>& grad_output_vector,
                           std::vector<torch::Tensor>& grad_input_vector,
                           const std::vector<torch::Tensor>& input_vector,
-                          torch::Tensor reciprocals) {
+                          torch::Tensor reciprocals,
+                          int64_t batch_threads) {
             s_size_type depth = input_vector.size();
             if (depth == 1) {
                 grad_input_vector[0].copy_(grad_output_vector[0]);
                 return;
             }
+            if (detail::cpu_kernel_applicable(grad_output_vector) && detail::cpu_kernel_applicable(grad_input_vector) &&
+                detail::cpu_kernel_applicable(input_vector)) {
+                AT_DISPATCH_FLOATING_TYPES(input_vector[0].scalar_type(), "log_backward_cpu", ([&] {
+                    detail::log_backward_cpu<scalar_t>(grad_output_vector, grad_input_vector, input_vector,
+                                                       reciprocals, batch_threads);
+                }));
+                return;
+            }
 
             // Will have the logarithm progressively computed in it
             std::vector<torch::Tensor> scratch_vector;
@@ -1053,10 +2470,153 @@ namespace signatory {
      * Forward and backward computations for 'signature_combine' *
      *************************************************************/
 
-    torch::Tensor signature_combine_forward(std::vector<torch::Tensor> sigtensors, // copy not reference as we modify it
-                                            int64_t input_channels,
-                                            s_size_type depth,
-                                            bool scalar_term) {
+    namespace detail {
+        // Multiplies together adjacent pairs of members of the tensor algebra, as one level of a balanced tree
+        // reduction.
+        // 'level' should be of shape (pieces, batch, signature_channels), not including the scalar term. The result is
+        // of shape ((pieces + 1) / 2, batch, signature_channels), and its 'i'-th piece is level[2i] \otimes
+        // level[2i + 1]. If there is an odd number of pieces then the final one is carried over unchanged.
+        // On the CPU the multiplications are parallelised over the pairs. On the GPU they are all performed at once,
+        // by putting the pairs into the batch dimension.
+        torch::Tensor combine_tree_level(torch::Tensor level, int64_t input_channels, s_size_type depth) {
+            int64_t pieces = level.size(0);
+            int64_t pairs = pieces / 2;
+            int64_t batch_size = level.size(1);
+            int64_t channels = level.size(2);
+            torch::Tensor next_level = torch::empty({(pieces + 1) / 2, batch_size, channels}, level.options());
+            torch::Tensor next_pairs = next_level.narrow(/*dim=*/0, /*start=*/0, /*length=*/pairs);
+            torch::Tensor level_pairs = level.narrow(/*dim=*/0, /*start=*/0, /*length=*/2 * pairs).view({pairs, 2,
+                                                                                                       batch_size,
+                                                                                                       channels});
+
+            if (level.is_cuda()) {
+                next_pairs.copy_(level_pairs.select(/*dim=*/1, /*index=*/0));
+                torch::Tensor right = level_pairs.select(/*dim=*/1, /*index=*/1).reshape({pairs * batch_size,
+                                                                                         channels});
+                std::vector<torch::Tensor> next_vector;
+                std::vector<torch::Tensor> right_vector;
+                misc::slice_by_term(next_pairs.view({pairs * batch_size, channels}), next_vector, input_channels,
+                                    depth);
+                misc::slice_by_term(right, right_vector, input_channels, depth);
+                ta_ops::mult(next_vector, right_vector, /*inverse=*/false);
+            }
+            else {
+                // Once there's only a single pair left we parallelise over the batch dimension instead.
+                int64_t batch_threads = (pairs > 1) ? 1 : std::min(batch_size, misc::max_threads());
+                misc::parallel_for(pairs, misc::max_threads(), [&](int64_t begin, int64_t end) {
+                    for (int64_t pair_index = begin; pair_index < end; ++pair_index) {
+                        std::vector<torch::Tensor> next_vector;
+                        std::vector<torch::Tensor> left_vector;
+                        std::vector<torch::Tensor> right_vector;
+                        misc::slice_by_term(next_pairs[pair_index], next_vector, input_channels, depth);
+                        misc::slice_by_term(level[2 * pair_index], left_vector, input_channels, depth);
+                        misc::slice_by_term(level[2 * pair_index + 1], right_vector, input_channels, depth);
+                        ta_ops::mult_into</*add_not_copy=*/false>(next_vector, left_vector, right_vector,
+                                                                  /*inverse=*/false, batch_threads);
+                    }
+                });
+            }
+
+            if (pieces % 2 == 1) {
+                next_level[pairs].copy_(level[pieces - 1]);
+            }
+            return next_level;
+        }
+
+        // Backwards through combine_tree_level.
+        // 'grad_next_level' is the gradient with respect to the result of combine_tree_level.
+        // 'grad_level' should be of the same shape as 'level', and will have the gradient with respect to 'level'
+        // copied into it.
+        // 'level' should be as passed to combine_tree_level.
+        void combine_tree_level_backward(torch::Tensor grad_next_level, torch::Tensor grad_level, torch::Tensor level,
+                                         int64_t input_channels, s_size_type depth) {
+            int64_t pieces = level.size(0);
+            int64_t pairs = pieces / 2;
+            int64_t batch_size = level.size(1);
+            int64_t channels = level.size(2);
+
+            if (level.is_cuda()) {
+                torch::Tensor level_pairs = level.narrow(/*dim=*/0, /*start=*/0, /*length=*/2 * pairs).view(
+                        {pairs, 2, batch_size, channels});
+                torch::Tensor grad_level_pairs = grad_level.narrow(/*dim=*/0, /*start=*/0, /*length=*/2 * pairs).view(
+                        {pairs, 2, batch_size, channels});
+                torch::Tensor left = level_pairs.select(/*dim=*/1, /*index=*/0).reshape({pairs * batch_size, channels});
+                torch::Tensor right = level_pairs.select(/*dim=*/1, /*index=*/1).reshape({pairs * batch_size,
+                                                                                         channels});
+                torch::Tensor grad_left = grad_next_level.narrow(/*dim=*/0, /*start=*/0, /*length=*/pairs).reshape(
+                        {pairs * batch_size, channels}).clone();
+                torch::Tensor grad_right = torch::empty({pairs * batch_size, channels}, grad_level.options());
+
+                std::vector<torch::Tensor> left_vector;
+                std::vector<torch::Tensor> right_vector;
+                std::vector<torch::Tensor> grad_left_vector;
+                std::vector<torch::Tensor> grad_right_vector;
+                misc::slice_by_term(left, left_vector, input_channels, depth);
+                misc::slice_by_term(right, right_vector, input_channels, depth);
+                misc::slice_by_term(grad_left, grad_left_vector, input_channels, depth);
+                misc::slice_by_term(grad_right, grad_right_vector, input_channels, depth);
+                ta_ops::mult_backward</*add_not_copy=*/false>(grad_left_vector, grad_right_vector, left_vector,
+                                                              right_vector);
+
+                grad_level_pairs.select(/*dim=*/1, /*index=*/0).copy_(grad_left.view({pairs, batch_size, channels}));
+                grad_level_pairs.select(/*dim=*/1, /*index=*/1).copy_(grad_right.view({pairs, batch_size, channels}));
+            }
+            else {
+                int64_t batch_threads = (pairs > 1) ? 1 : std::min(batch_size, misc::max_threads());
+                misc::parallel_for(pairs, misc::max_threads(), [&](int64_t begin, int64_t end) {
+                    for (int64_t pair_index = begin; pair_index < end; ++pair_index) {
+                        torch::Tensor grad_left = grad_level[2 * pair_index];
+                        grad_left.copy_(grad_next_level[pair_index]);
+
+                        std::vector<torch::Tensor> left_vector;
+                        std::vector<torch::Tensor> right_vector;
+                        std::vector<torch::Tensor> grad_left_vector;
+                        std::vector<torch::Tensor> grad_right_vector;
+                        misc::slice_by_term(level[2 * pair_index], left_vector, input_channels, depth);
+                        misc::slice_by_term(level[2 * pair_index + 1], right_vector, input_channels, depth);
+                        misc::slice_by_term(grad_left, grad_left_vector, input_channels, depth);
+                        misc::slice_by_term(grad_level[2 * pair_index + 1], grad_right_vector, input_channels, depth);
+                        ta_ops::mult_backward</*add_not_copy=*/false>(grad_left_vector, grad_right_vector, left_vector,
+                                                                      right_vector, batch_threads);
+                    }
+                });
+            }
+
+            if (pieces % 2 == 1) {
+                grad_level[pieces - 1].copy_(grad_next_level[pairs]);
+            }
+        }
+
+        // Stacks 'sigtensors' into a single tensor of shape (pieces, batch, signature_channels), not including the
+        // scalar term.
+        torch::Tensor stack_sigtensors(const std::vector<torch::Tensor>& sigtensors, bool scalar_term) {
+            torch::Tensor stacked = torch::stack(sigtensors);
+            if (scalar_term) {
+                stacked = stacked.narrow(/*dim=*/channel_dim, /*start=*/1, /*length=*/stacked.size(channel_dim) - 1);
+            }
+            return stacked;
+        }
+
+        // Computes every level of the tree reduction performed by combine_tree_level. The first element of the result
+        // is the stacked input; the last element is the result of the whole reduction, and has only a single piece.
+        std::vector<torch::Tensor> combine_tree(const std::vector<torch::Tensor>& sigtensors, int64_t input_channels,
+                                                s_size_type depth, bool scalar_term) {
+            torch::Tensor level = stack_sigtensors(sigtensors, scalar_term);
+            std::vector<torch::Tensor> levels;
+            levels.push_back(level);
+            while (level.size(0) > 1) {
+                level = combine_tree_level(level, input_channels, depth);
+                levels.push_back(level);
+            }
+            return levels;
+        }
+    }  // namespace signatory::detail
+
+    torch::Tensor signature_combine_forward_impl(std::vector<torch::Tensor> sigtensors,  // copy as we modify it
+                                                 int64_t input_channels,
+                                                 s_size_type depth,
+                                                 bool scalar_term) {
+        SIGNATORY_PROFILE_STAGE("signature_combine_forward");
         // Perform a bunch of argument checking
 
         misc::checkargs_channels_depth(input_channels, depth);
@@ -1070,8 +2630,6 @@ namespace signatory {
                                         "(batch, signature_channels(input_channels, depth, scalar_term))");
         }
 
-        py::gil_scoped_release release;
-
         int64_t batch_size = sigtensors[0].size(batch_dim);
         for (auto& elem : sigtensors) {
             if (elem.ndimension() != 2) {
@@ -1090,168 +2648,262 @@ namespace signatory {
         }
 
         // Actually do the computation
+        // We multiply the signatures together in a balanced tree, rather than folding them from left to right: this
+        // means that there are only logarithmically many (in the number of sigtensors) steps that have to happen one
+        // after the other, and every multiplication in each step can happen in parallel.
 
-        torch::Tensor out;
         torch::Tensor out_with_scalar = sigtensors[0].clone();
-        if (scalar_term) {
-            out = out_with_scalar.narrow(/*dim=*/channel_dim, /*start=*/1,
-                                         /*length=*/out_with_scalar.size(channel_dim) - 1);
-        }
-        else {
-            out = out_with_scalar;
-        }
-        std::vector<torch::Tensor> out_vector;
-        misc::slice_by_term(out, out_vector, input_channels, depth);
-        for (s_size_type sigtensor_index = 1;
-             sigtensor_index < static_cast<s_size_type>(sigtensors.size());
-             ++sigtensor_index) {
-            std::vector<torch::Tensor> sigtensor_vector;
-            torch::Tensor sigtensor = sigtensors[sigtensor_index];
+        if (sigtensors.size() > 1) {
+            torch::Tensor out;
             if (scalar_term) {
-                sigtensor = sigtensor.narrow(/*dim=*/channel_dim, /*start=*/1,
-                                             /*length=*/sigtensor.size(channel_dim) - 1);
+                out = out_with_scalar.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                             /*length=*/out_with_scalar.size(channel_dim) - 1);
+            }
+            else {
+                out = out_with_scalar;
+            }
+            // Only the final level is needed here, so we don't hold on to all of them, unlike combine_tree.
+            torch::Tensor level = detail::stack_sigtensors(sigtensors, scalar_term);
+            while (level.size(0) > 1) {
+                level = detail::combine_tree_level(level, input_channels, depth);
             }
-            misc::slice_by_term(sigtensor, sigtensor_vector, input_channels, depth);
-            ta_ops::mult(out_vector, sigtensor_vector, /*inverse=*/false);
+            out.copy_(level[0]);
         }
         return out_with_scalar;
     }
 
-    std::vector<torch::Tensor> signature_combine_backward(torch::Tensor grad_out,
-                                                          // copy not reference as we modify it
-                                                          std::vector<torch::Tensor> sigtensors,
-                                                          int64_t input_channels,
-                                                          s_size_type depth,
-                                                          bool scalar_term) {
-
-        py::gil_scoped_release release;
-
+    std::vector<torch::Tensor> signature_combine_backward_impl(torch::Tensor grad_out,
+                                                               // copy not reference as we modify it
+                                                               std::vector<torch::Tensor> sigtensors,
+                                                               int64_t input_channels,
+                                                               s_size_type depth,
+                                                               bool scalar_term) {
+        SIGNATORY_PROFILE_STAGE("signature_combine_backward");
         grad_out = grad_out.detach();
         for (auto& elem : sigtensors) {
             elem = elem.detach();
         }
 
-        // Allocate memory for the output gradients
-        std::vector<torch::Tensor> grad_sigtensors;
-        std::vector<torch::Tensor> grad_sigtensors_with_scalars;
-        grad_sigtensors.reserve(sigtensors.size());
-        grad_sigtensors_with_scalars.reserve(sigtensors.size());
-        grad_sigtensors.emplace_back();  // we'll fill in the first slot at the very end
-        grad_sigtensors_with_scalars.emplace_back();
-        for (s_size_type sigtensors_index = 1;
-             sigtensors_index < static_cast<s_size_type>(sigtensors.size());
-             ++sigtensors_index) {
-            torch::Tensor grad_sigtensor_with_scalar = torch::empty_like(sigtensors[sigtensors_index]);
-            torch::Tensor grad_sigtensor;
-            if (scalar_term) {
-                grad_sigtensor_with_scalar.narrow(/*dim=*/channel_dim, /*start=*/0, /*length=*/1).zero_();
-                grad_sigtensor = grad_sigtensor_with_scalar.narrow(/*dim=*/channel_dim, /*start=*/1,
-                                                                   /*length=*/grad_sigtensor_with_scalar.size(channel_dim) - 1);
-            }
-            else {
-                grad_sigtensor = grad_sigtensor_with_scalar;
-            }
-            grad_sigtensors.push_back(grad_sigtensor);
-            grad_sigtensors_with_scalars.push_back(grad_sigtensor_with_scalar);
+        // Allocate memory for the output gradients. The gradient with respect to the scalar term is always zero.
+        int64_t num_sigtensors = sigtensors.size();
+        torch::Tensor grad_sigtensors_with_scalars = torch::empty({num_sigtensors, grad_out.size(batch_dim),
+                                                                   grad_out.size(channel_dim)},
+                                                                  grad_out.options());
+        torch::Tensor grad_sigtensors;
+        torch::Tensor grad_signature;
+        if (scalar_term) {
+            grad_sigtensors_with_scalars.narrow(/*dim=*/channel_dim, /*start=*/0, /*length=*/1).zero_();
+            grad_sigtensors = grad_sigtensors_with_scalars.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                                                  /*length=*/grad_out.size(channel_dim) - 1);
+            grad_signature = grad_out.narrow(/*dim=*/channel_dim, /*start=*/1,
+                                             /*length=*/grad_out.size(channel_dim) - 1);
+        }
+        else {
+            grad_sigtensors = grad_sigtensors_with_scalars;
+            grad_signature = grad_out;
         }
 
-        // Recompute the inputs to each tensor multiplication
-        std::vector<std::vector<torch::Tensor>> scratch_vector_vector;
-        auto reserve_amount = sigtensors.size();
-        if (reserve_amount < 2) {
-            reserve_amount = 0;
+        if (num_sigtensors == 1) {
+            grad_sigtensors[0].copy_(grad_signature);
         }
         else {
-            reserve_amount -= 2;
-        }
-        scratch_vector_vector.reserve(reserve_amount);
-        torch::Tensor scratch = sigtensors[0];  // no clone necessary here, we're going to do it in the loop below
-        if (scalar_term) {
-            scratch = scratch.narrow(/*dim=*/channel_dim, /*start=*/1, /*length=*/scratch.size(channel_dim) - 1);
+            // Recompute every level of the tree...
+            std::vector<torch::Tensor> levels = detail::combine_tree(sigtensors, input_channels, depth, scalar_term);
+
+            // ...and then go backwards through it.
+            torch::Tensor grad_next_level = grad_signature.unsqueeze(0);
+            for (s_size_type level_index = levels.size() - 2; level_index >= 0; --level_index) {
+                torch::Tensor level = levels[level_index];
+                torch::Tensor grad_level;
+                if (level_index == 0) {
+                    grad_level = grad_sigtensors;
+                }
+                else {
+                    grad_level = torch::empty_like(level);
+                }
+                detail::combine_tree_level_backward(grad_next_level, grad_level, level, input_channels, depth);
+                grad_next_level = grad_level;
+            }
         }
-        // -1 to the size because we don't need to store the final output
-        for (s_size_type sigtensor_index = 1;
-             sigtensor_index < static_cast<s_size_type>(sigtensors.size()) - 1;
-             ++sigtensor_index) {
-            scratch = scratch.clone();
-            std::vector<torch::Tensor> scratch_vector;
-            misc::slice_by_term(scratch, scratch_vector, input_channels, depth);
 
-            std::vector<torch::Tensor> sigtensor_vector;
-            torch::Tensor sigtensor = sigtensors[sigtensor_index];
-            if (scalar_term) {
-                sigtensor = sigtensor.narrow(/*dim=*/channel_dim, /*start=*/1,
-                                             /*length=*/sigtensor.size(channel_dim) - 1);
+        return grad_sigtensors_with_scalars.unbind(/*dim=*/0);
+    }
+
+    torch::Tensor signature_combine_forward(std::vector<torch::Tensor> sigtensors, int64_t input_channels,
+                                            s_size_type depth, bool scalar_term) {
+        py::gil_scoped_release release;
+        return signature_combine_forward_impl(sigtensors, input_channels, depth, scalar_term);
+    }
+
+    std::vector<torch::Tensor> signature_combine_backward(torch::Tensor grad_out, std::vector<torch::Tensor> sigtensors,
+                                                          int64_t input_channels, s_size_type depth,
+                                                          bool scalar_term) {
+        py::gil_scoped_release release;
+        return signature_combine_backward_impl(grad_out, sigtensors, input_channels, depth, scalar_term);
+    }
+
+    /******************************************
+     * Forward and backward for the inversion *
+     ******************************************/
+
+    namespace detail {
+        // The insertion algorithm reconstructs a path with 'depth' pieces from its signature. The increment over the
+        // i-th piece is found by solving a least-squares problem involving the linear map which inserts a vector at
+        // the i-th position of the penultimate term of the signature. This has a closed form solution: the increment
+        // is the contraction of the top term of the signature against the penultimate term, over every index except
+        // the i-th, divided by the squared norm of the penultimate term. So we never form the insertion map itself.
+        //
+        // This returns views of the top term of shape (batch, channels^i, channels, channels^(depth - 1 - i)), and of
+        // the penultimate term of shape (batch, channels^i, channels^(depth - 1 - i)), for the i-th position.
+        std::tuple<torch::Tensor, torch::Tensor> inversion_views(torch::Tensor top_term, torch::Tensor penultimate_term,
+                                                                 int64_t channels, s_size_type position) {
+            int64_t batch_size = top_term.size(batch_dim);
+            int64_t before = 1;
+            for (s_size_type i = 0; i < position; ++i) {
+                before *= channels;
             }
-            misc::slice_by_term(sigtensor, sigtensor_vector, input_channels, depth);
-            ta_ops::mult(scratch_vector, sigtensor_vector, /*inverse=*/false);
+            int64_t after = penultimate_term.size(channel_dim) / before;
+            return std::tuple<torch::Tensor, torch::Tensor> {top_term.view({batch_size, before, channels, after}),
+                                                             penultimate_term.view({batch_size, before, after})};
+        }
 
-            scratch_vector_vector.push_back(scratch_vector);
+        // Computes the increments of the path reconstructed from 'signature', as a tensor of shape
+        // (batch, depth, channels).
+        torch::Tensor inversion_increments(torch::Tensor signature, int64_t channels, s_size_type depth) {
+            if (depth == 1) {
+                return signature.unsqueeze(/*dim=*/1);
+            }
+            int64_t batch_size = signature.size(batch_dim);
+            std::vector<torch::Tensor> signature_by_term;
+            misc::slice_by_term(signature, signature_by_term, channels, depth);
+            torch::Tensor top_term = signature_by_term[depth - 1];
+            torch::Tensor penultimate_term = signature_by_term[depth - 2];
+
+            // Every insertion position is independent of every other, so on the CPU we handle them in parallel.
+            // (Same magic number as in signature_forward.)
+            int64_t threads = 1;
+            if (!signature.is_cuda() && depth * signature.numel() >= 81899) {
+                threads = std::min<int64_t>(depth, misc::max_threads());
+            }
+            torch::Tensor increments = torch::empty({batch_size, depth, channels}, signature.options());
+            misc::parallel_for(depth, threads, [&](int64_t begin, int64_t end) {
+                for (int64_t position = begin; position < end; ++position) {
+                    torch::Tensor top_view;
+                    torch::Tensor penultimate_view;
+                    std::tie(top_view, penultimate_view) = inversion_views(top_term, penultimate_term, channels,
+                                                                           position);
+                    increments.select(/*dim=*/1, /*index=*/position).copy_(torch::einsum("bpkq,bpq->bk",
+                                                                                         {top_view,
+                                                                                          penultimate_view}));
+                }
+            });
+            torch::Tensor norm_squared = (penultimate_term * penultimate_term).sum(/*dim=*/channel_dim);
+            increments /= norm_squared.view({batch_size, 1, 1});
+            return increments;
         }
 
-        // Allocate memory for the gradient when computing backward through the tensor multiplications
-        torch::Tensor grad_scratch_with_scalar = grad_out.clone();
-        torch::Tensor grad_scratch;
-        if (scalar_term) {
-            grad_scratch_with_scalar.narrow(/*dim=*/channel_dim, /*start=*/0, /*length=*/1).zero_();
-            grad_scratch = grad_scratch_with_scalar.narrow(/*dim=*/channel_dim, /*start=*/1,
-                                                           /*length=*/grad_out.size(channel_dim) - 1);
+        void invert_signature_checkargs(torch::Tensor signature, int64_t channels, s_size_type depth, bool initial,
+                                        torch::Tensor initial_position) {
+            misc::checkargs_channels_depth(channels, depth);
+            if (signature.ndimension() != 2) {
+                throw std::invalid_argument("Argument 'signature' must be a 2-dimensional tensor, corresponding to "
+                                            "(batch, signature_channels) respectively.");
+            }
+            if (signature.size(channel_dim) != signature_channels(channels, depth, /*scalar_term=*/false)) {
+                throw std::invalid_argument("channels and depth do not correspond to signature shape.");
+            }
+            if (!signature.is_floating_point()) {
+                throw std::invalid_argument("Argument 'signature' must be of floating point type.");
+            }
+            if (initial) {
+                if (initial_position.ndimension() != 2 || initial_position.size(batch_dim) != signature.size(batch_dim)
+                    || initial_position.size(channel_dim) != channels) {
+                    throw std::invalid_argument("Argument 'initial_position' must be a 2-dimensional tensor, "
+                                                "corresponding to (batch, channels) respectively.");
+                }
+                if (initial_position.device() != signature.device()) {
+                    throw std::invalid_argument("Argument 'initial_position' does not have the same device as "
+                                                "'signature'.");
+                }
+            }
         }
-        else {
-            grad_scratch = grad_scratch_with_scalar;
+    }  // namespace signatory::detail
+
+    torch::Tensor invert_signature_forward(torch::Tensor signature, int64_t channels, s_size_type depth, bool initial,
+                                           torch::Tensor initial_position) {
+        py::gil_scoped_release release;
+        SIGNATORY_PROFILE_STAGE("invert_signature_forward");
+        detail::invert_signature_checkargs(signature, channels, depth, initial, initial_position);
+        // No sense keeping track of gradients when we have a custom backwards
+        signature = signature.detach();
+
+        int64_t batch_size = signature.size(batch_dim);
+        torch::Tensor path = torch::zeros({batch_size, depth + 1, channels}, signature.options());
+        path.narrow(/*dim=*/1, /*start=*/1, /*length=*/depth).copy_(
+                detail::inversion_increments(signature, channels, depth).cumsum(/*dim=*/1));
+        if (initial) {
+            path += initial_position.detach().to(signature.scalar_type()).unsqueeze(/*dim=*/1);
         }
-        std::vector<torch::Tensor> grad_scratch_vector;
-        misc::slice_by_term(grad_scratch, grad_scratch_vector, input_channels, depth);
+        return path;
+    }
 
-        // Actually do the computation
-        for (s_size_type sigtensors_index = sigtensors.size() - 1; sigtensors_index >= 2; --sigtensors_index) {
-            // Recompute the inputs of each multiplication
-            std::vector<torch::Tensor> sigtensor_vector;
-            torch::Tensor sigtensor = sigtensors[sigtensors_index];
-            if (scalar_term) {
-                sigtensor = sigtensor.narrow(/*dim=*/channel_dim, /*start=*/1,
-                                             /*length=*/sigtensor.size(channel_dim) - 1);
-            }
-            misc::slice_by_term(sigtensor, sigtensor_vector, input_channels, depth);
-
-            // Actually perform the backward operation
-            std::vector<torch::Tensor> grad_sigtensor_vector;
-            misc::slice_by_term(grad_sigtensors[sigtensors_index], grad_sigtensor_vector, input_channels, depth);
-            ta_ops::mult_backward</*add_not_copy=*/false>(grad_scratch_vector, grad_sigtensor_vector,
-                                                          // -1 because we're getting the input to this operation, so we
-                                                          // need to look one step into the past
-                                                          // -1 again because we don't store this input for the very
-                                                          // first operation (we don't need to for that one), and it's
-                                                          // pulled out as a special case below.
-                                                          scratch_vector_vector[sigtensors_index - 2],
-                                                          sigtensor_vector);
+    std::tuple<torch::Tensor, torch::Tensor>
+    invert_signature_backward(torch::Tensor grad_path, torch::Tensor signature, int64_t channels, s_size_type depth,
+                              bool initial) {
+        py::gil_scoped_release release;
+        SIGNATORY_PROFILE_STAGE("invert_signature_backward");
+        signature = signature.detach();
+        int64_t batch_size = signature.size(batch_dim);
+
+        torch::Tensor grad_initial_position;
+        if (initial) {
+            grad_initial_position = grad_path.sum(/*dim=*/1);
         }
-        if (sigtensors.size() > 1) {
-            // Correponds to sigtensors_index == 1
-            // This iteration pulled out because we don't need to do the final division
-            std::vector<torch::Tensor> sigtensor_vector;
-            torch::Tensor sigtensor_one = sigtensors[1];
-            if (scalar_term) {
-                sigtensor_one = sigtensor_one.narrow(/*dim=*/channel_dim, /*start=*/1,
-                                                     /*length=*/sigtensor_one.size(channel_dim) - 1);
-            }
-            misc::slice_by_term(sigtensor_one, sigtensor_vector, input_channels, depth);
-            std::vector<torch::Tensor> first_sigtensor_vector;
-            torch::Tensor sigtensor_zero = sigtensors[0];
-            if (scalar_term) {
-                sigtensor_zero = sigtensor_zero.narrow(/*dim=*/channel_dim, /*start=*/1,
-                                                       /*length=*/sigtensor_zero.size(channel_dim) - 1);
-            }
-            misc::slice_by_term(sigtensor_zero, first_sigtensor_vector, input_channels, depth);
-            std::vector<torch::Tensor> grad_sigtensor_vector;
-            misc::slice_by_term(grad_sigtensors[1], grad_sigtensor_vector, input_channels, depth);
-            ta_ops::mult_backward</*add_not_copy=*/false>(grad_scratch_vector, grad_sigtensor_vector,
-                                                          first_sigtensor_vector, sigtensor_vector);
+        else {
+            grad_initial_position = torch::empty({0}, signature.options());
+        }
+        // Each point of the path is the sum of the increments before it, so the gradient with respect to each
+        // increment is the sum of the gradients with respect to the points after it.
+        torch::Tensor grad_increments = grad_path.narrow(/*dim=*/1, /*start=*/1, /*length=*/depth).flip(
+                {1}).cumsum(/*dim=*/1).flip({1});
+        if (depth == 1) {
+            return std::tuple<torch::Tensor, torch::Tensor> {grad_increments.squeeze(/*dim=*/1),
+                                                             grad_initial_position};
         }
-        // Fill in the gradient for the very first sigtensor.
-        grad_sigtensors_with_scalars[0] = grad_scratch_with_scalar;
-        grad_sigtensors[0] = grad_scratch;  // unnecessary, I'm pretty sure. TODO: remove this + shorten grad_sigtensors by one?
 
-        return grad_sigtensors_with_scalars;
+        std::vector<torch::Tensor> signature_by_term;
+        misc::slice_by_term(signature, signature_by_term, channels, depth);
+        torch::Tensor top_term = signature_by_term[depth - 1];
+        torch::Tensor penultimate_term = signature_by_term[depth - 2];
+        torch::Tensor norm_squared = (penultimate_term * penultimate_term).sum(/*dim=*/channel_dim);
+
+        // Recompute the increments, rather than saving them, as they're cheap.
+        torch::Tensor increments = detail::inversion_increments(signature, channels, depth);
+        torch::Tensor grad_contractions = grad_increments / norm_squared.view({batch_size, 1, 1});
+        torch::Tensor grad_norm_squared = -(grad_increments * increments).sum({1, 2}) / norm_squared;
+
+        torch::Tensor grad_signature = torch::zeros({batch_size, signature.size(channel_dim)}, signature.options());
+        std::vector<torch::Tensor> grad_signature_by_term;
+        misc::slice_by_term(grad_signature, grad_signature_by_term, channels, depth);
+        torch::Tensor grad_top_term = grad_signature_by_term[depth - 1];
+        torch::Tensor grad_penultimate_term = grad_signature_by_term[depth - 2];
+        // Every insertion position contributes to the gradients with respect to the same terms, so here they are
+        // handled one after another.
+        for (s_size_type position = 0; position < depth; ++position) {
+            torch::Tensor top_view;
+            torch::Tensor penultimate_view;
+            torch::Tensor grad_top_view;
+            torch::Tensor grad_penultimate_view;
+            std::tie(top_view, penultimate_view) = detail::inversion_views(top_term, penultimate_term, channels,
+                                                                           position);
+            std::tie(grad_top_view, grad_penultimate_view) = detail::inversion_views(grad_top_term,
+                                                                                     grad_penultimate_term, channels,
+                                                                                     position);
+            torch::Tensor grad_contraction = grad_contractions.select(/*dim=*/1, /*index=*/position);
+            grad_top_view.add_(grad_contraction.view({batch_size, 1, channels, 1}) * penultimate_view.unsqueeze(2));
+            grad_penultimate_view.add_(torch::einsum("bpkq,bk->bpq", {top_view, grad_contraction}));
+        }
+        grad_penultimate_term.add_(2 * penultimate_term * grad_norm_squared.unsqueeze(/*dim=*/1));
+        return std::tuple<torch::Tensor, torch::Tensor> {grad_signature, grad_initial_position};
     }
 }  // namespace signatory
\ No newline at end of file
@@ -30,6 +30,7 @@
 #define SIGNATORY_TENSOR_ALGEBRA_OPS_HPP
 
 #include <torch/extension.h>
+#include <tuple>    // std::tuple
 #include <utility>  // std::pair
 
 #include "misc.hpp"
@@ -38,21 +39,41 @@
 namespace signatory {
     // Note that ta_ops operations do not perform any checking that the information passed is in a valid state.
     namespace ta_ops {
+        namespace detail {
+            // Sets whether the hand-written CPU implementations of mult, mult_into, mult_backward, log and
+            // log_backward may be used, and returns the previous setting. If not then the high-level implementations
+            // in terms of PyTorch operations are used instead. Only intended for use by the tests, which compare the
+            // two.
+            bool set_cpu_kernels_enabled(bool enabled);
+        }  // namespace signatory::ta_ops::detail
+
         // Computes a multiplication in the tensor algebra.
         // 'arg1' and 'arg2' are both general members of the tensor algebra.
         // If inverse==false then arg1 is modified to hold arg1 \otimes arg2.
         // If inverse==true then arg1 is modified to hold arg2 \otimes arg1.
-        void mult(std::vector<torch::Tensor>& arg1, const std::vector<torch::Tensor>& arg2, bool inverse);
+        // On the CPU, up to 'batch_threads' threads are used to parallelise over the batch dimension.
+        void mult(std::vector<torch::Tensor>& arg1, const std::vector<torch::Tensor>& arg2, bool inverse,
+                  int64_t batch_threads=1);
+
+        // As mult, except that the result is placed in 'out' rather than in 'arg1'.
+        // If add_not_copy==false then the result will be copied into 'out'.
+        // If add_not_copy==true then the result will be added onto 'out'.
+        // (In both cases, just the nonscalar terms of the result.) 'out' should not be the same as 'arg1' or 'arg2'.
+        template<bool add_not_copy>
+        void mult_into(std::vector<torch::Tensor>& out, const std::vector<torch::Tensor>& arg1,
+                       const std::vector<torch::Tensor>& arg2, bool inverse, int64_t batch_threads=1);
 
         // Backwards through mult(..., /*inverse=*/false).
         // 'arg1' and 'arg2' should be as mult was called with. (Not as it returns).
         // If add_not_copy==false then the gradient through arg2 will be copied into grad_arg2.
         // If add_not_copy==true then the gradient through arg2 will be added onto grad_arg2.
+        // 'batch_threads' is as for mult.
         template<bool add_not_copy>
         void mult_backward(std::vector<torch::Tensor>& grad_arg1,
                            std::vector<torch::Tensor>& grad_arg2,
                            const std::vector<torch::Tensor>& arg1,
-                           const std::vector<torch::Tensor>& arg2);
+                           const std::vector<torch::Tensor>& arg2,
+                           int64_t batch_threads=1);
 
         // Computes a restricted exponential in the tensor algebra.
         //
@@ -82,33 +103,49 @@ namespace signatory {
         void mult_fused_restricted_exp(torch::Tensor next, std::vector<torch::Tensor>& prev, bool inverse,
                                        torch::Tensor reciprocals, int64_t batch_threads=1);
 
+        // Equivalent to
+        // mult_fused_restricted_exp(next, prev, /*inverse=*/false, reciprocals, batch_threads);
+        // mult_fused_restricted_exp(-next, inverse_prev, /*inverse=*/true, reciprocals, batch_threads);
+        // That is, if 'prev' and 'inverse_prev' are a signature and its inverse, then they are both updated to
+        // include the increment 'next'. On the CPU this is done in a single pass, so that 'next' is only loaded and
+        // divided by the reciprocals once.
+        void mult_fused_restricted_exp_and_inverse(torch::Tensor next, std::vector<torch::Tensor>& prev,
+                                                   std::vector<torch::Tensor>& inverse_prev, torch::Tensor reciprocals,
+                                                   int64_t batch_threads=1);
+
         // Backwards through the fused multiply-exponentiate.
         // 'grad_next' will have the gradient from this operation copied in to it.
         // 'grad_prev' is the input gradient to this function, and will be modified in-place.
         // 'next' should be as passed to mult_fused_restricted_exp
         // 'prev' should as passed to mult_fused_restricted_exp
+        // On the CPU, up to 'batch_threads' threads are used to parallelise over the batch dimension, as for
+        // mult_fused_restricted_exp.
         void mult_fused_restricted_exp_backward(torch::Tensor grad_next,
                                                 std::vector<torch::Tensor>& grad_prev,
                                                 torch::Tensor next,
                                                 const std::vector<torch::Tensor>& prev,
                                                 bool inverse,
-                                                torch::Tensor reciprocals);
+                                                torch::Tensor reciprocals,
+                                                int64_t batch_threads=1);
 
         // Computes the logarithm in the tensor algebra
         // 'output_vector' and 'input_vector' are both members of the tensor algebra, with assumed scalar values 1.
         // They are assumed to have equal values to each other when passed.
         // Then 'output_vector' is modified to be log(input_vector).
+        // On the CPU, up to 'batch_threads' threads are used to parallelise over the batch dimension.
         void log(std::vector<torch::Tensor>& output_vector, const std::vector<torch::Tensor>& input_vector,
-                 torch::Tensor reciprocals);
+                 torch::Tensor reciprocals, int64_t batch_threads=1);
 
         // Computes the backwards pass through compute_log
         // 'input_vector' is as passed to log.
         // 'grad_output_vector' is the input gradient, and will be modified in-place.
         // 'grad_input_vector' is the output gradient, and will have the result of this operation added on to it.
+        // 'batch_threads' is as for log.
         void log_backward(std::vector<torch::Tensor>& grad_output_vector,
                           std::vector<torch::Tensor>& grad_input_vector,
                           const std::vector<torch::Tensor>& input_vector,
-                          torch::Tensor reciprocals);
+                          torch::Tensor reciprocals,
+                          int64_t batch_threads=1);
     }  // namespace signatory::ta_ops
 
     // See signatory.signature_combine
@@ -121,6 +158,28 @@ namespace signatory {
                                                           int64_t input_channels,
                                                           s_size_type depth,
                                                           bool scalar_term);
+
+    // As signature_combine_forward and signature_combine_backward, except that these must be called without holding
+    // the GIL. These are what the TorchScript operators are built on; see library.cpp.
+    torch::Tensor signature_combine_forward_impl(std::vector<torch::Tensor> sigtensors, int64_t input_channels,
+                                                 s_size_type depth, bool scalar_term);
+
+    std::vector<torch::Tensor> signature_combine_backward_impl(torch::Tensor grad_out,
+                                                               std::vector<torch::Tensor> sigtensors,
+                                                               int64_t input_channels,
+                                                               s_size_type depth,
+                                                               bool scalar_term);
+
+    // See signatory.invert_signature. Returns the reconstructed path, of shape (batch, depth + 1, channels).
+    // 'initial_position' is only used if initial==true.
+    torch::Tensor invert_signature_forward(torch::Tensor signature, int64_t channels, s_size_type depth, bool initial,
+                                           torch::Tensor initial_position);
+
+    // The backward pass through invert_signature_forward. Returns the gradients with respect to the signature and the
+    // initial position.
+    std::tuple<torch::Tensor, torch::Tensor>
+    invert_signature_backward(torch::Tensor grad_path, torch::Tensor signature, int64_t channels, s_size_type depth,
+                              bool initial);
 }  // namespace signatory
 
 #endif //SIGNATORY_TENSOR_ALGEBRA_OPS_HPP
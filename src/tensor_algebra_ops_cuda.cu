@@ -0,0 +1,1018 @@
+/* Copyright 2019 Patrick Kidger. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ========================================================================= */
+
+
+#include <torch/extension.h>
+#include <ATen/cuda/CUDAContext.h>
+#include <cstdint>    // int64_t
+#include <vector>     // std::vector
+
+#include "misc.hpp"
+#include "tensor_algebra_ops_cuda.hpp"
+
+
+namespace signatory {
+    namespace ta_ops {
+        namespace detail {
+            // Upper limit on the number of threads to use in a block. Each block handles a single batch element, and
+            // for the small channel sizes typical of signature computations there's simply not much work available
+            // inside a single batch element.
+            constexpr int64_t max_cuda_threads = 256;
+
+            // The kernels can't be passed a std::vector<torch::Tensor>, so instead we pass pointers to the start of
+            // each term, along with their batch strides. (Every term is required to have a channel stride of one.)
+            template <typename scalar_t>
+            struct TermPointers {
+                scalar_t* data[max_cuda_kernel_depth];
+                int64_t batch_stride[max_cuda_kernel_depth];
+            };
+
+            template <typename scalar_t>
+            TermPointers<scalar_t> make_term_pointers(const std::vector<torch::Tensor>& terms) {
+                TermPointers<scalar_t> term_pointers;
+                for (s_size_type depth_index = 0; depth_index < static_cast<s_size_type>(terms.size());
+                     ++depth_index) {
+                    term_pointers.data[depth_index] = terms[depth_index].data_ptr<scalar_t>();
+                    term_pointers.batch_stride[depth_index] = terms[depth_index].stride(batch_dim);
+                }
+                return term_pointers;
+            }
+
+            // The number of threads to use for a block, given the largest amount of parallelisable work that it will
+            // have to do. Always a power of two, as block_reduce_sum relies on this.
+            int64_t num_cuda_threads(int64_t work) {
+                int64_t num_threads = 32;
+                while (num_threads < work && num_threads < max_cuda_threads) {
+                    num_threads *= 2;
+                }
+                return num_threads;
+            }
+
+            // Sums 'value' over all the threads in the block. Every thread receives the result.
+            // 'shared' should be a piece of shared memory with space for one scalar_t per thread.
+            template <typename scalar_t>
+            __device__ scalar_t block_reduce_sum(scalar_t value, scalar_t* shared) {
+                shared[threadIdx.x] = value;
+                __syncthreads();
+                for (unsigned int offset = blockDim.x / 2; offset > 0; offset /= 2) {
+                    if (threadIdx.x < offset) {
+                        shared[threadIdx.x] += shared[threadIdx.x + offset];
+                    }
+                    __syncthreads();
+                }
+                scalar_t result = shared[0];
+                // Make sure everyone has read the result before 'shared' gets used again.
+                __syncthreads();
+                return result;
+            }
+
+            // Computes the size of each term of the tensor algebra.
+            __device__ __forceinline__ void compute_term_sizes(int64_t* term_sizes, int64_t input_channel_size,
+                                                               int64_t depth) {
+                int64_t term_size = 1;
+                for (int64_t depth_index = 0; depth_index < depth; ++depth_index) {
+                    term_size *= input_channel_size;
+                    term_sizes[depth_index] = term_size;
+                }
+            }
+
+            // Computes out = arg_a + arg_b + arg_a \otimes arg_b for a single batch element per block; this is the
+            // same computation as mult_cpu_inner. Every thread computes distinct elements of each term, from the
+            // highest term downwards, so that 'out' may be the same as 'arg_a' or 'arg_b' if add_not_copy==false.
+            template <typename scalar_t, bool add_not_copy>
+            __global__ void mult_kernel(TermPointers<scalar_t> out,
+                                        TermPointers<scalar_t> arg_a,
+                                        TermPointers<scalar_t> arg_b,
+                                        int64_t input_channel_size,
+                                        int64_t depth) {
+                int64_t batch_index = blockIdx.x;
+                int64_t term_sizes[max_cuda_kernel_depth];
+                compute_term_sizes(term_sizes, input_channel_size, depth);
+
+                const scalar_t* arg_a_at_batch[max_cuda_kernel_depth];
+                const scalar_t* arg_b_at_batch[max_cuda_kernel_depth];
+                for (int64_t depth_index = 0; depth_index < depth; ++depth_index) {
+                    arg_a_at_batch[depth_index] = arg_a.data[depth_index] +
+                                                  batch_index * arg_a.batch_stride[depth_index];
+                    arg_b_at_batch[depth_index] = arg_b.data[depth_index] +
+                                                  batch_index * arg_b.batch_stride[depth_index];
+                }
+
+                for (int64_t depth_index = depth - 1; depth_index >= 0; --depth_index) {
+                    scalar_t* out_at_depth = out.data[depth_index] + batch_index * out.batch_stride[depth_index];
+                    for (int64_t index = threadIdx.x; index < term_sizes[depth_index]; index += blockDim.x) {
+                        scalar_t total = arg_a_at_batch[depth_index][index] + arg_b_at_batch[depth_index][index];
+                        for (int64_t j = 0, k = depth_index - 1; j < depth_index; ++j, --k) {
+                            int64_t a_index = index / term_sizes[k];
+                            int64_t b_index = index - a_index * term_sizes[k];
+                            total += arg_a_at_batch[j][a_index] * arg_b_at_batch[k][b_index];
+                        }
+                        if (add_not_copy) {
+                            out_at_depth[index] += total;
+                        }
+                        else {
+                            out_at_depth[index] = total;
+                        }
+                    }
+                    // If 'out' is the same as one of the arguments, then the lower terms must not be overwritten
+                    // until every thread is done reading them.
+                    __syncthreads();
+                }
+            }
+
+            // Backwards through mult_kernel<scalar_t, /*add_not_copy=*/false>, for a single batch element per block;
+            // this is the same computation as mult_backward_cpu_inner.
+            template <typename scalar_t, bool add_not_copy>
+            __global__ void mult_backward_kernel(TermPointers<scalar_t> grad_arg1,
+                                                 TermPointers<scalar_t> grad_arg2,
+                                                 TermPointers<scalar_t> arg1,
+                                                 TermPointers<scalar_t> arg2,
+                                                 int64_t input_channel_size,
+                                                 int64_t depth) {
+                int64_t batch_index = blockIdx.x;
+                int64_t term_sizes[max_cuda_kernel_depth];
+                compute_term_sizes(term_sizes, input_channel_size, depth);
+
+                for (int64_t depth_index = 0; depth_index < depth; ++depth_index) {
+                    const scalar_t* grad_at_depth = grad_arg1.data[depth_index] +
+                                                    batch_index * grad_arg1.batch_stride[depth_index];
+                    scalar_t* grad_arg2_at_depth = grad_arg2.data[depth_index] +
+                                                   batch_index * grad_arg2.batch_stride[depth_index];
+                    for (int64_t index = threadIdx.x; index < term_sizes[depth_index]; index += blockDim.x) {
+                        if (add_not_copy) {
+                            grad_arg2_at_depth[index] += grad_at_depth[index];
+                        }
+                        else {
+                            grad_arg2_at_depth[index] = grad_at_depth[index];
+                        }
+                    }
+
+                    // Each thread always handles the same elements of each term of grad_arg1 and grad_arg2, so no
+                    // synchronisation is needed between these loops.
+                    for (int64_t j = depth_index - 1, k = 0; j >= 0; --j, ++k) {
+                        const scalar_t* arg1_j = arg1.data[j] + batch_index * arg1.batch_stride[j];
+                        const scalar_t* arg2_k = arg2.data[k] + batch_index * arg2.batch_stride[k];
+                        scalar_t* grad_arg1_j = grad_arg1.data[j] + batch_index * grad_arg1.batch_stride[j];
+                        scalar_t* grad_arg2_k = grad_arg2.data[k] + batch_index * grad_arg2.batch_stride[k];
+                        for (int64_t a_index = threadIdx.x; a_index < term_sizes[j]; a_index += blockDim.x) {
+                            scalar_t total = 0;
+                            for (int64_t b_index = 0; b_index < term_sizes[k]; ++b_index) {
+                                total += grad_at_depth[a_index * term_sizes[k] + b_index] * arg2_k[b_index];
+                            }
+                            grad_arg1_j[a_index] += total;
+                        }
+                        for (int64_t b_index = threadIdx.x; b_index < term_sizes[k]; b_index += blockDim.x) {
+                            scalar_t total = 0;
+                            for (int64_t a_index = 0; a_index < term_sizes[j]; ++a_index) {
+                                total += arg1_j[a_index] * grad_at_depth[a_index * term_sizes[k] + b_index];
+                            }
+                            grad_arg2_k[b_index] += total;
+                        }
+                    }
+                    // The next iteration modifies this term of grad_arg1, which other threads may still be reading.
+                    __syncthreads();
+                }
+            }
+
+            // Given an index into a tensor of shape (scratch_size, channel) if inverse==false, or (channel,
+            // scratch_size) if inverse==true, computes the index into each of those dimensions.
+            // This is the inverse of the computation of new_scratch_index in mult_fused_restricted_exp_cpu_inner.
+            template <bool inverse>
+            __device__ __forceinline__ void split_index(int64_t index, int64_t scratch_size,
+                                                        int64_t input_channel_size, int64_t& scratch_index,
+                                                        int64_t& channel_index) {
+                if (inverse) {
+                    channel_index = index / scratch_size;
+                    scratch_index = index - channel_index * scratch_size;
+                }
+                else {
+                    scratch_index = index / input_channel_size;
+                    channel_index = index - scratch_index * input_channel_size;
+                }
+            }
+
+            // The part of mult_fused_restricted_exp_block that comes after computing next_divided (which is 'next'
+            // multiplied by each of the reciprocals), so that it may be shared with
+            // mult_fused_restricted_exp_and_inverse_stream_kernel. 'next' and 'next_divided' must be visible to every
+            // thread of the block.
+            template <typename scalar_t, bool inverse>
+            __device__ void mult_fused_restricted_exp_block_apply(const scalar_t* __restrict__ next,
+                                                                  scalar_t* const* prev,
+                                                                  const scalar_t* __restrict__ next_divided,
+                                                                  scalar_t* new_scratch,
+                                                                  scalar_t* old_scratch,
+                                                                  int64_t input_channel_size,
+                                                                  int64_t depth) {
+                for (int64_t depth_index = depth - 1; depth_index >= 1; --depth_index) {
+                    int64_t scratch_size = input_channel_size;
+                    const scalar_t* next_divided_part = next_divided + (depth_index - 1) * input_channel_size;
+                    for (int64_t scratch_index = threadIdx.x; scratch_index < input_channel_size;
+                         scratch_index += blockDim.x) {
+                        new_scratch[scratch_index] = prev[0][scratch_index] + next_divided_part[scratch_index];
+                    }
+
+                    for (int64_t j = 1, k = depth_index - 2; j < depth_index; ++j, --k) {
+                        __syncthreads();
+                        scalar_t* swap = old_scratch;
+                        old_scratch = new_scratch;
+                        new_scratch = swap;
+
+                        const scalar_t* next_divided_part2 = next_divided + k * input_channel_size;
+                        const scalar_t* prev_j = prev[j];
+                        int64_t new_scratch_size = scratch_size * input_channel_size;
+                        for (int64_t new_scratch_index = threadIdx.x; new_scratch_index < new_scratch_size;
+                             new_scratch_index += blockDim.x) {
+                            int64_t old_scratch_index;
+                            int64_t channel_index;
+                            split_index<inverse>(new_scratch_index, scratch_size, input_channel_size,
+                                                 old_scratch_index, channel_index);
+                            new_scratch[new_scratch_index] = prev_j[new_scratch_index] +
+                                                             old_scratch[old_scratch_index] *
+                                                             next_divided_part2[channel_index];
+                        }
+                        scratch_size = new_scratch_size;
+                    }
+                    __syncthreads();
+
+                    scalar_t* prev_at_depth = prev[depth_index];
+                    int64_t prev_size = scratch_size * input_channel_size;
+                    for (int64_t prev_index = threadIdx.x; prev_index < prev_size; prev_index += blockDim.x) {
+                        int64_t new_scratch_index;
+                        int64_t next_index;
+                        split_index<inverse>(prev_index, scratch_size, input_channel_size, new_scratch_index,
+                                             next_index);
+                        prev_at_depth[prev_index] += new_scratch[new_scratch_index] * next[next_index];
+                    }
+                    // Everyone must be done with new_scratch before the next iteration overwrites it.
+                    __syncthreads();
+                }
+
+                for (int64_t channel_index = threadIdx.x; channel_index < input_channel_size;
+                     channel_index += blockDim.x) {
+                    prev[0][channel_index] += next[channel_index];
+                }
+                // So that the result may be safely read by any thread afterwards.
+                __syncthreads();
+            }
+
+            // Computes prev \otimes \exp(next) (or \exp(next) \otimes prev if inverse==true) for a single batch
+            // element, using every thread of the block. This is the same computation as
+            // mult_fused_restricted_exp_cpu_inner.
+            // 'prev' should have 'depth' many pointers, one to each term of the tensor algebra at this batch element.
+            // 'next_divided' should have space for (depth - 1) * input_channel_size elements, and 'new_scratch' and
+            // 'old_scratch' should each have space for input_channel_size^(depth - 1) elements.
+            template <typename scalar_t, bool inverse>
+            __device__ void mult_fused_restricted_exp_block(const scalar_t* __restrict__ next,
+                                                            scalar_t* const* prev,
+                                                            const scalar_t* __restrict__ reciprocals,
+                                                            scalar_t* __restrict__ next_divided,
+                                                            scalar_t* new_scratch,
+                                                            scalar_t* old_scratch,
+                                                            int64_t input_channel_size,
+                                                            int64_t depth) {
+                int64_t next_divided_size = (depth - 1) * input_channel_size;
+                for (int64_t index = threadIdx.x; index < next_divided_size; index += blockDim.x) {
+                    next_divided[index] = reciprocals[index / input_channel_size] * next[index % input_channel_size];
+                }
+                __syncthreads();
+
+                mult_fused_restricted_exp_block_apply<scalar_t, inverse>(next, prev, next_divided, new_scratch,
+                                                                         old_scratch, input_channel_size, depth);
+            }
+
+            // The pieces of the workspace used for each batch element: next_divided, followed by two scratch
+            // vectors, each of which can get as large as input_channel_size^(depth - 1).
+            template <typename scalar_t, bool inverse>
+            __global__ void mult_fused_restricted_exp_kernel(const scalar_t* __restrict__ next,
+                                                             int64_t next_batch_stride,
+                                                             TermPointers<scalar_t> prev,
+                                                             const scalar_t* __restrict__ reciprocals,
+                                                             scalar_t* __restrict__ workspace,
+                                                             int64_t scratch_capacity,
+                                                             int64_t input_channel_size,
+                                                             int64_t depth) {
+                int64_t batch_index = blockIdx.x;
+                int64_t next_divided_size = (depth - 1) * input_channel_size;
+
+                scalar_t* next_divided = workspace + batch_index * (next_divided_size + 2 * scratch_capacity);
+                scalar_t* prev_at_batch[max_cuda_kernel_depth];
+                for (int64_t depth_index = 0; depth_index < depth; ++depth_index) {
+                    prev_at_batch[depth_index] = prev.data[depth_index] + batch_index * prev.batch_stride[depth_index];
+                }
+
+                mult_fused_restricted_exp_block<scalar_t, inverse>(next + batch_index * next_batch_stride,
+                                                                   prev_at_batch,
+                                                                   reciprocals,
+                                                                   next_divided,
+                                                                   next_divided + next_divided_size,
+                                                                   next_divided + next_divided_size + scratch_capacity,
+                                                                   input_channel_size,
+                                                                   depth);
+            }
+
+            // Computes the signature over a whole stream of increments, in a single kernel launch. Each block handles
+            // a single batch element, and loops over the stream dimension on the device.
+            // 'signature' should point at the signature (without scalar term) at stream index 0 for batch element 0.
+            // If stream==true then the signature at every stream index is written out (with stride
+            // signature_stream_stride). If stream==false then the signature is accumulated in-place.
+            // The workspace is as for mult_fused_restricted_exp_kernel.
+            template <typename scalar_t, bool inverse>
+            __global__ void mult_fused_restricted_exp_stream_kernel(const scalar_t* __restrict__ path_increments,
+                                                                    int64_t increments_stream_stride,
+                                                                    int64_t increments_batch_stride,
+                                                                    scalar_t* signature,
+                                                                    int64_t signature_stream_stride,
+                                                                    int64_t signature_batch_stride,
+                                                                    const scalar_t* __restrict__ reciprocals,
+                                                                    scalar_t* __restrict__ workspace,
+                                                                    int64_t scratch_capacity,
+                                                                    int64_t input_channel_size,
+                                                                    int64_t depth,
+                                                                    int64_t start,
+                                                                    int64_t end,
+                                                                    bool stream) {
+                int64_t batch_index = blockIdx.x;
+                int64_t next_divided_size = (depth - 1) * input_channel_size;
+
+                scalar_t* next_divided = workspace + batch_index * (next_divided_size + 2 * scratch_capacity);
+                scalar_t* new_scratch = next_divided + next_divided_size;
+                scalar_t* old_scratch = new_scratch + scratch_capacity;
+
+                // The offset of each term within the signature, and the total number of signature channels.
+                int64_t term_offsets[max_cuda_kernel_depth];
+                int64_t output_channel_size = 0;
+                int64_t term_size = 1;
+                for (int64_t depth_index = 0; depth_index < depth; ++depth_index) {
+                    term_offsets[depth_index] = output_channel_size;
+                    term_size *= input_channel_size;
+                    output_channel_size += term_size;
+                }
+
+                scalar_t* signature_at_batch = signature + batch_index * signature_batch_stride;
+                const scalar_t* increments_at_batch = path_increments + batch_index * increments_batch_stride;
+                scalar_t* prev_at_stream[max_cuda_kernel_depth];
+                for (int64_t stream_index = start; stream_index < end; ++stream_index) {
+                    scalar_t* signature_at_stream = signature_at_batch;
+                    if (stream) {
+                        signature_at_stream += stream_index * signature_stream_stride;
+                        if (stream_index > 0) {
+                            const scalar_t* signature_at_prev_stream = signature_at_stream - signature_stream_stride;
+                            for (int64_t index = threadIdx.x; index < output_channel_size; index += blockDim.x) {
+                                signature_at_stream[index] = signature_at_prev_stream[index];
+                            }
+                            __syncthreads();
+                        }
+                    }
+                    for (int64_t depth_index = 0; depth_index < depth; ++depth_index) {
+                        prev_at_stream[depth_index] = signature_at_stream + term_offsets[depth_index];
+                    }
+                    mult_fused_restricted_exp_block<scalar_t, inverse>(increments_at_batch +
+                                                                       stream_index * increments_stream_stride,
+                                                                       prev_at_stream,
+                                                                       reciprocals,
+                                                                       next_divided,
+                                                                       new_scratch,
+                                                                       old_scratch,
+                                                                       input_channel_size,
+                                                                       depth);
+                }
+            }
+
+            // Computes both the signature and the inverse signature over a whole stream of increments, in a single
+            // kernel launch. This is like running mult_fused_restricted_exp_stream_kernel twice (with stream==true,
+            // once with inverse==false, and once with inverse==true and negated increments), except that each
+            // increment is only loaded and divided by the reciprocals once.
+            // 'signature' and 'inverse_signature' should point at the values at stream index 0 for batch element 0,
+            // and should have the same strides as each other.
+            // The workspace for each batch element is: the increment, its negation, next_divided, its negation, and
+            // then two scratch vectors, each of which can get as large as input_channel_size^(depth - 1).
+            template <typename scalar_t>
+            __global__ void mult_fused_restricted_exp_and_inverse_stream_kernel(
+                    const scalar_t* __restrict__ path_increments,
+                    int64_t increments_stream_stride,
+                    int64_t increments_batch_stride,
+                    scalar_t* signature,
+                    scalar_t* inverse_signature,
+                    int64_t signature_stream_stride,
+                    int64_t signature_batch_stride,
+                    const scalar_t* __restrict__ reciprocals,
+                    scalar_t* __restrict__ workspace,
+                    int64_t scratch_capacity,
+                    int64_t input_channel_size,
+                    int64_t depth,
+                    int64_t start,
+                    int64_t end) {
+                int64_t batch_index = blockIdx.x;
+                int64_t next_divided_size = (depth - 1) * input_channel_size;
+
+                scalar_t* next = workspace + batch_index * (2 * input_channel_size + 2 * next_divided_size +
+                                                            2 * scratch_capacity);
+                scalar_t* negative_next = next + input_channel_size;
+                scalar_t* next_divided = negative_next + input_channel_size;
+                scalar_t* negative_next_divided = next_divided + next_divided_size;
+                scalar_t* new_scratch = negative_next_divided + next_divided_size;
+                scalar_t* old_scratch = new_scratch + scratch_capacity;
+
+                // The offset of each term within the signature, and the total number of signature channels.
+                int64_t term_offsets[max_cuda_kernel_depth];
+                int64_t output_channel_size = 0;
+                int64_t term_size = 1;
+                for (int64_t depth_index = 0; depth_index < depth; ++depth_index) {
+                    term_offsets[depth_index] = output_channel_size;
+                    term_size *= input_channel_size;
+                    output_channel_size += term_size;
+                }
+
+                scalar_t* signature_at_batch = signature + batch_index * signature_batch_stride;
+                scalar_t* inverse_signature_at_batch = inverse_signature + batch_index * signature_batch_stride;
+                const scalar_t* increments_at_batch = path_increments + batch_index * increments_batch_stride;
+                scalar_t* prev_at_stream[max_cuda_kernel_depth];
+                scalar_t* inverse_prev_at_stream[max_cuda_kernel_depth];
+                for (int64_t stream_index = start; stream_index < end; ++stream_index) {
+                    scalar_t* signature_at_stream = signature_at_batch + stream_index * signature_stream_stride;
+                    scalar_t* inverse_signature_at_stream = inverse_signature_at_batch +
+                                                            stream_index * signature_stream_stride;
+                    if (stream_index > 0) {
+                        for (int64_t index = threadIdx.x; index < output_channel_size; index += blockDim.x) {
+                            signature_at_stream[index] = signature_at_stream[index - signature_stream_stride];
+                            inverse_signature_at_stream[index] = inverse_signature_at_stream[index -
+                                                                                             signature_stream_stride];
+                        }
+                    }
+                    const scalar_t* increment = increments_at_batch + stream_index * increments_stream_stride;
+                    for (int64_t index = threadIdx.x; index < input_channel_size; index += blockDim.x) {
+                        scalar_t value = increment[index];
+                        next[index] = value;
+                        negative_next[index] = -value;
+                    }
+                    for (int64_t index = threadIdx.x; index < next_divided_size; index += blockDim.x) {
+                        scalar_t divided = reciprocals[index / input_channel_size] *
+                                           increment[index % input_channel_size];
+                        next_divided[index] = divided;
+                        negative_next_divided[index] = -divided;
+                    }
+                    __syncthreads();
+
+                    for (int64_t depth_index = 0; depth_index < depth; ++depth_index) {
+                        prev_at_stream[depth_index] = signature_at_stream + term_offsets[depth_index];
+                        inverse_prev_at_stream[depth_index] = inverse_signature_at_stream + term_offsets[depth_index];
+                    }
+                    mult_fused_restricted_exp_block_apply<scalar_t, /*inverse=*/false>(next,
+                                                                                       prev_at_stream,
+                                                                                       next_divided,
+                                                                                       new_scratch,
+                                                                                       old_scratch,
+                                                                                       input_channel_size,
+                                                                                       depth);
+                    mult_fused_restricted_exp_block_apply<scalar_t, /*inverse=*/true>(negative_next,
+                                                                                      inverse_prev_at_stream,
+                                                                                      negative_next_divided,
+                                                                                      new_scratch,
+                                                                                      old_scratch,
+                                                                                      input_channel_size,
+                                                                                      depth);
+                }
+            }
+
+            // The offset of the start of the scratches used at depth_index, in the workspace used by
+            // mult_fused_restricted_exp_backward_kernel. The scratches for each depth_index are stored contiguously,
+            // and are of size input_channel_size, input_channel_size^2, ..., input_channel_size^depth_index.
+            __device__ __forceinline__ int64_t scratches_offset(int64_t depth_index, int64_t input_channel_size) {
+                int64_t offset = 0;
+                int64_t group_size = 0;
+                int64_t scratch_size = 1;
+                for (int64_t index = 1; index < depth_index; ++index) {
+                    scratch_size *= input_channel_size;
+                    group_size += scratch_size;
+                    offset += group_size;
+                }
+                return offset;
+            }
+
+            // The workspace for each batch element consists of next_divided, grad_next_divided, all the scratches,
+            // and the gradients through all the scratches; this is the same as in
+            // mult_fused_restricted_exp_backward_cpu_inner.
+            template <typename scalar_t, bool inverse>
+            __global__ void mult_fused_restricted_exp_backward_kernel(scalar_t* __restrict__ grad_next,
+                                                                      int64_t grad_next_batch_stride,
+                                                                      TermPointers<scalar_t> grad_prev,
+                                                                      const scalar_t* __restrict__ next,
+                                                                      int64_t next_batch_stride,
+                                                                      TermPointers<scalar_t> prev,
+                                                                      const scalar_t* __restrict__ reciprocals,
+                                                                      scalar_t* __restrict__ workspace,
+                                                                      int64_t all_scratches_size,
+                                                                      int64_t input_channel_size,
+                                                                      int64_t depth) {
+                extern __shared__ unsigned char shared_memory[];
+                scalar_t* shared = reinterpret_cast<scalar_t*>(shared_memory);
+
+                int64_t batch_index = blockIdx.x;
+                int64_t next_divided_size = (depth - 1) * input_channel_size;
+
+                scalar_t* grad_next_at_batch = grad_next + batch_index * grad_next_batch_stride;
+                const scalar_t* next_at_batch = next + batch_index * next_batch_stride;
+                scalar_t* next_divided = workspace + batch_index * 2 * (next_divided_size + all_scratches_size);
+                scalar_t* grad_next_divided = next_divided + next_divided_size;
+                scalar_t* all_scratches = grad_next_divided + next_divided_size;
+                scalar_t* all_grad_scratches = all_scratches + all_scratches_size;
+                const scalar_t* prev_zero = prev.data[0] + batch_index * prev.batch_stride[0];
+                scalar_t* grad_prev_zero = grad_prev.data[0] + batch_index * grad_prev.batch_stride[0];
+
+                for (int64_t index = threadIdx.x; index < next_divided_size; index += blockDim.x) {
+                    next_divided[index] = reciprocals[index / input_channel_size] *
+                                          next_at_batch[index % input_channel_size];
+                    grad_next_divided[index] = 0;
+                }
+                __syncthreads();
+
+                // First of all we recompute the forward pass and record all the intermediate scratches.
+
+                for (int64_t depth_index = depth - 1; depth_index >= 1; --depth_index) {
+                    scalar_t* scratch = all_scratches + scratches_offset(depth_index, input_channel_size);
+                    const scalar_t* next_divided_part = next_divided + (depth_index - 1) * input_channel_size;
+                    for (int64_t scratch_index = threadIdx.x; scratch_index < input_channel_size;
+                         scratch_index += blockDim.x) {
+                        scratch[scratch_index] = prev_zero[scratch_index] + next_divided_part[scratch_index];
+                    }
+
+                    int64_t scratch_size = input_channel_size;
+                    for (int64_t j = 1, k = depth_index - 2; j < depth_index; ++j, --k) {
+                        __syncthreads();
+                        const scalar_t* old_scratch = scratch;
+                        scratch += scratch_size;
+
+                        const scalar_t* next_divided_part2 = next_divided + k * input_channel_size;
+                        const scalar_t* prev_j = prev.data[j] + batch_index * prev.batch_stride[j];
+                        int64_t new_scratch_size = scratch_size * input_channel_size;
+                        for (int64_t new_scratch_index = threadIdx.x; new_scratch_index < new_scratch_size;
+                             new_scratch_index += blockDim.x) {
+                            int64_t old_scratch_index;
+                            int64_t channel_index;
+                            split_index<inverse>(new_scratch_index, scratch_size, input_channel_size,
+                                                 old_scratch_index, channel_index);
+                            scratch[new_scratch_index] = prev_j[new_scratch_index] +
+                                                         old_scratch[old_scratch_index] *
+                                                         next_divided_part2[channel_index];
+                        }
+                        scratch_size = new_scratch_size;
+                    }
+                }
+
+                for (int64_t index = threadIdx.x; index < input_channel_size; index += blockDim.x) {
+                    grad_next_at_batch[index] = grad_prev_zero[index];
+                }
+                __syncthreads();
+
+                // Now do the actual backward computation.
+
+                int64_t last_scratch_offset = 0;  // the offset of the final scratch, within the scratches for depth_index
+                int64_t last_scratch_size = input_channel_size;
+                for (int64_t depth_index = 1; depth_index < depth; ++depth_index) {
+                    int64_t offset = scratches_offset(depth_index, input_channel_size);
+                    const scalar_t* scratches = all_scratches + offset;
+                    scalar_t* grad_scratches = all_grad_scratches + offset;
+
+                    const scalar_t* scratch = scratches + last_scratch_offset;
+                    scalar_t* grad_scratch = grad_scratches + last_scratch_offset;
+                    const scalar_t* grad_prev_at_depth = grad_prev.data[depth_index] +
+                                                         batch_index * grad_prev.batch_stride[depth_index];
+
+                    for (int64_t scratch_index = threadIdx.x; scratch_index < last_scratch_size;
+                         scratch_index += blockDim.x) {
+                        scalar_t total = 0;
+                        for (int64_t next_index = 0; next_index < input_channel_size; ++next_index) {
+                            int64_t prev_index = inverse ? (next_index * last_scratch_size + scratch_index)
+                                                         : (scratch_index * input_channel_size + next_index);
+                            total += next_at_batch[next_index] * grad_prev_at_depth[prev_index];
+                        }
+                        grad_scratch[scratch_index] = total;
+                    }
+                    for (int64_t next_index = 0; next_index < input_channel_size; ++next_index) {
+                        scalar_t partial = 0;
+                        for (int64_t scratch_index = threadIdx.x; scratch_index < last_scratch_size;
+                             scratch_index += blockDim.x) {
+                            int64_t prev_index = inverse ? (next_index * last_scratch_size + scratch_index)
+                                                         : (scratch_index * input_channel_size + next_index);
+                            partial += scratch[scratch_index] * grad_prev_at_depth[prev_index];
+                        }
+                        scalar_t total = block_reduce_sum(partial, shared);
+                        if (threadIdx.x == 0) {
+                            grad_next_at_batch[next_index] += total;
+                        }
+                    }
+                    __syncthreads();
+
+                    int64_t grad_scratch_offset = last_scratch_offset;
+                    int64_t grad_scratch_size = last_scratch_size;
+                    for (int64_t j = depth_index - 1, k = 0; j >= 1; --j, ++k) {
+                        int64_t old_scratch_size = grad_scratch_size / input_channel_size;
+                        int64_t old_scratch_offset = grad_scratch_offset - old_scratch_size;
+                        const scalar_t* grad_scratch = grad_scratches + grad_scratch_offset;
+                        scalar_t* grad_old_scratch = grad_scratches + old_scratch_offset;
+                        const scalar_t* old_scratch = scratches + old_scratch_offset;
+                        const scalar_t* next_divided_narrow = next_divided + k * input_channel_size;
+                        scalar_t* grad_next_divided_narrow = grad_next_divided + k * input_channel_size;
+                        scalar_t* grad_prev_j = grad_prev.data[j] + batch_index * grad_prev.batch_stride[j];
+
+                        for (int64_t index = threadIdx.x; index < grad_scratch_size; index += blockDim.x) {
+                            grad_prev_j[index] += grad_scratch[index];
+                        }
+                        for (int64_t old_scratch_index = threadIdx.x; old_scratch_index < old_scratch_size;
+                             old_scratch_index += blockDim.x) {
+                            scalar_t total = 0;
+                            for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                                int64_t index = inverse ? (channel_index * old_scratch_size + old_scratch_index)
+                                                        : (old_scratch_index * input_channel_size + channel_index);
+                                total += next_divided_narrow[channel_index] * grad_scratch[index];
+                            }
+                            grad_old_scratch[old_scratch_index] = total;
+                        }
+                        for (int64_t channel_index = 0; channel_index < input_channel_size; ++channel_index) {
+                            scalar_t partial = 0;
+                            for (int64_t old_scratch_index = threadIdx.x; old_scratch_index < old_scratch_size;
+                                 old_scratch_index += blockDim.x) {
+                                int64_t index = inverse ? (channel_index * old_scratch_size + old_scratch_index)
+                                                        : (old_scratch_index * input_channel_size + channel_index);
+                                partial += old_scratch[old_scratch_index] * grad_scratch[index];
+                            }
+                            scalar_t total = block_reduce_sum(partial, shared);
+                            if (threadIdx.x == 0) {
+                                grad_next_divided_narrow[channel_index] += total;
+                            }
+                        }
+                        __syncthreads();
+
+                        grad_scratch_offset = old_scratch_offset;
+                        grad_scratch_size = old_scratch_size;
+                    }
+
+                    scalar_t* grad_next_divided_part = grad_next_divided + (depth_index - 1) * input_channel_size;
+                    for (int64_t index = threadIdx.x; index < input_channel_size; index += blockDim.x) {
+                        grad_next_divided_part[index] += grad_scratches[index];
+                        grad_prev_zero[index] += grad_scratches[index];
+                    }
+                    __syncthreads();
+
+                    last_scratch_offset += last_scratch_size;
+                    last_scratch_size *= input_channel_size;
+                }
+
+                // Finally do the backward from next_divided into next
+                for (int64_t channel_index = threadIdx.x; channel_index < input_channel_size;
+                     channel_index += blockDim.x) {
+                    scalar_t total = 0;
+                    for (int64_t reciprocal_index = 0; reciprocal_index < depth - 1; ++reciprocal_index) {
+                        total += reciprocals[reciprocal_index] *
+                                 grad_next_divided[reciprocal_index * input_channel_size + channel_index];
+                    }
+                    grad_next_at_batch[channel_index] += total;
+                }
+            }
+
+            bool mult_cuda_kernel_supported(const std::vector<torch::Tensor>& arg) {
+                if (arg[0].scalar_type() != torch::kFloat32 && arg[0].scalar_type() != torch::kFloat64) {
+                    return false;
+                }
+                if (static_cast<s_size_type>(arg.size()) > max_cuda_kernel_depth) {
+                    return false;
+                }
+                for (const auto& elem : arg) {
+                    if (elem.stride(channel_dim) != 1) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            void mult_cuda_kernel(std::vector<torch::Tensor>& out, const std::vector<torch::Tensor>& arg_a,
+                                  const std::vector<torch::Tensor>& arg_b, bool add_not_copy) {
+                int64_t batch_size = out[0].size(batch_dim);
+                int64_t input_channel_size = out[0].size(channel_dim);
+                s_size_type depth = out.size();
+
+                int64_t num_threads = num_cuda_threads(out.back().size(channel_dim));
+                auto stream = at::cuda::getCurrentCUDAStream();
+
+                AT_DISPATCH_FLOATING_TYPES(out[0].scalar_type(), "mult_cuda_kernel", ([&] {
+                    TermPointers<scalar_t> out_pointers = make_term_pointers<scalar_t>(out);
+                    TermPointers<scalar_t> arg_a_pointers = make_term_pointers<scalar_t>(arg_a);
+                    TermPointers<scalar_t> arg_b_pointers = make_term_pointers<scalar_t>(arg_b);
+                    if (add_not_copy) {
+                        mult_kernel<scalar_t, /*add_not_copy=*/true>
+                        <<<batch_size, num_threads, 0, stream>>>(out_pointers, arg_a_pointers, arg_b_pointers,
+                                                                 input_channel_size, depth);
+                    }
+                    else {
+                        mult_kernel<scalar_t, /*add_not_copy=*/false>
+                        <<<batch_size, num_threads, 0, stream>>>(out_pointers, arg_a_pointers, arg_b_pointers,
+                                                                 input_channel_size, depth);
+                    }
+                }));
+                AT_CUDA_CHECK(cudaGetLastError());
+            }
+
+            void mult_backward_cuda_kernel(std::vector<torch::Tensor>& grad_arg1,
+                                           std::vector<torch::Tensor>& grad_arg2,
+                                           const std::vector<torch::Tensor>& arg1,
+                                           const std::vector<torch::Tensor>& arg2,
+                                           bool add_not_copy) {
+                int64_t batch_size = arg1[0].size(batch_dim);
+                int64_t input_channel_size = arg1[0].size(channel_dim);
+                s_size_type depth = arg1.size();
+
+                int64_t num_threads = num_cuda_threads(arg1.back().size(channel_dim));
+                auto stream = at::cuda::getCurrentCUDAStream();
+
+                AT_DISPATCH_FLOATING_TYPES(arg1[0].scalar_type(), "mult_backward_cuda_kernel", ([&] {
+                    TermPointers<scalar_t> grad_arg1_pointers = make_term_pointers<scalar_t>(grad_arg1);
+                    TermPointers<scalar_t> grad_arg2_pointers = make_term_pointers<scalar_t>(grad_arg2);
+                    TermPointers<scalar_t> arg1_pointers = make_term_pointers<scalar_t>(arg1);
+                    TermPointers<scalar_t> arg2_pointers = make_term_pointers<scalar_t>(arg2);
+                    if (add_not_copy) {
+                        mult_backward_kernel<scalar_t, /*add_not_copy=*/true>
+                        <<<batch_size, num_threads, 0, stream>>>(grad_arg1_pointers, grad_arg2_pointers,
+                                                                 arg1_pointers, arg2_pointers, input_channel_size,
+                                                                 depth);
+                    }
+                    else {
+                        mult_backward_kernel<scalar_t, /*add_not_copy=*/false>
+                        <<<batch_size, num_threads, 0, stream>>>(grad_arg1_pointers, grad_arg2_pointers,
+                                                                 arg1_pointers, arg2_pointers, input_channel_size,
+                                                                 depth);
+                    }
+                }));
+                AT_CUDA_CHECK(cudaGetLastError());
+            }
+
+            bool mult_fused_restricted_exp_cuda_kernel_supported(torch::Tensor next,
+                                                                 const std::vector<torch::Tensor>& prev) {
+                if (next.scalar_type() != torch::kFloat32 && next.scalar_type() != torch::kFloat64) {
+                    return false;
+                }
+                if (static_cast<s_size_type>(prev.size()) > max_cuda_kernel_depth) {
+                    return false;
+                }
+                if (next.stride(channel_dim) != 1) {
+                    return false;
+                }
+                for (const auto& elem : prev) {
+                    if (elem.stride(channel_dim) != 1) {
+                        return false;
+                    }
+                }
+                return true;
+            }
+
+            void mult_fused_restricted_exp_cuda_kernel(torch::Tensor next, std::vector<torch::Tensor>& prev,
+                                                       bool inverse, torch::Tensor reciprocals) {
+                int64_t batch_size = next.size(batch_dim);
+                int64_t input_channel_size = next.size(channel_dim);
+                s_size_type depth = prev.size();
+
+                // The largest either scratch vector gets is input_channel_size^(depth - 1).
+                int64_t scratch_capacity = (depth > 1) ? prev[depth - 2].size(channel_dim) : 0;
+                // A single allocation for every batch element, rather than one per depth as in the high-level
+                // implementation.
+                torch::Tensor workspace = torch::empty({batch_size,
+                                                        (depth - 1) * input_channel_size + 2 * scratch_capacity},
+                                                       next.options());
+                torch::Tensor reciprocals_contiguous = reciprocals.contiguous();
+
+                int64_t num_threads = num_cuda_threads(prev.back().size(channel_dim));
+                auto stream = at::cuda::getCurrentCUDAStream();
+
+                AT_DISPATCH_FLOATING_TYPES(next.scalar_type(), "mult_fused_restricted_exp_cuda_kernel", ([&] {
+                    TermPointers<scalar_t> prev_pointers = make_term_pointers<scalar_t>(prev);
+                    if (inverse) {
+                        mult_fused_restricted_exp_kernel<scalar_t, /*inverse=*/true>
+                        <<<batch_size, num_threads, 0, stream>>>(next.data_ptr<scalar_t>(),
+                                                                 next.stride(batch_dim),
+                                                                 prev_pointers,
+                                                                 reciprocals_contiguous.data_ptr<scalar_t>(),
+                                                                 workspace.data_ptr<scalar_t>(),
+                                                                 scratch_capacity,
+                                                                 input_channel_size,
+                                                                 depth);
+                    }
+                    else {
+                        mult_fused_restricted_exp_kernel<scalar_t, /*inverse=*/false>
+                        <<<batch_size, num_threads, 0, stream>>>(next.data_ptr<scalar_t>(),
+                                                                 next.stride(batch_dim),
+                                                                 prev_pointers,
+                                                                 reciprocals_contiguous.data_ptr<scalar_t>(),
+                                                                 workspace.data_ptr<scalar_t>(),
+                                                                 scratch_capacity,
+                                                                 input_channel_size,
+                                                                 depth);
+                    }
+                }));
+                AT_CUDA_CHECK(cudaGetLastError());
+            }
+
+            bool mult_fused_restricted_exp_stream_cuda_kernel_supported(torch::Tensor path_increments,
+                                                                        torch::Tensor signature,
+                                                                        s_size_type depth) {
+                if (path_increments.scalar_type() != torch::kFloat32 &&
+                    path_increments.scalar_type() != torch::kFloat64) {
+                    return false;
+                }
+                if (depth > max_cuda_kernel_depth) {
+                    return false;
+                }
+                return path_increments.stride(channel_dim) == 1 && signature.stride(channel_dim) == 1;
+            }
+
+            void mult_fused_restricted_exp_stream_cuda_kernel(torch::Tensor path_increments, torch::Tensor signature,
+                                                              bool stream, bool inverse, torch::Tensor reciprocals,
+                                                              s_size_type depth, int64_t start, int64_t end) {
+                if (start >= end) {
+                    return;
+                }
+
+                int64_t batch_size = path_increments.size(batch_dim);
+                int64_t input_channel_size = path_increments.size(channel_dim);
+
+                int64_t scratch_capacity = 1;
+                for (s_size_type depth_index = 0; depth_index < depth - 1; ++depth_index) {
+                    scratch_capacity *= input_channel_size;
+                }
+                if (depth == 1) {
+                    scratch_capacity = 0;
+                }
+                torch::Tensor workspace = torch::empty({batch_size,
+                                                        (depth - 1) * input_channel_size + 2 * scratch_capacity},
+                                                       path_increments.options());
+                torch::Tensor reciprocals_contiguous = reciprocals.contiguous();
+
+                int64_t num_threads = num_cuda_threads(scratch_capacity * input_channel_size);
+                auto cuda_stream = at::cuda::getCurrentCUDAStream();
+                int64_t signature_stream_stride = stream ? signature.stride(stream_dim) : 0;
+
+                AT_DISPATCH_FLOATING_TYPES(path_increments.scalar_type(), "mult_fused_restricted_exp_stream_cuda_kernel",
+                                           ([&] {
+                    if (inverse) {
+                        mult_fused_restricted_exp_stream_kernel<scalar_t, /*inverse=*/true>
+                        <<<batch_size, num_threads, 0, cuda_stream>>>(path_increments.data_ptr<scalar_t>(),
+                                                                      path_increments.stride(stream_dim),
+                                                                      path_increments.stride(batch_dim),
+                                                                      signature.data_ptr<scalar_t>(),
+                                                                      signature_stream_stride,
+                                                                      signature.stride(batch_dim),
+                                                                      reciprocals_contiguous.data_ptr<scalar_t>(),
+                                                                      workspace.data_ptr<scalar_t>(),
+                                                                      scratch_capacity,
+                                                                      input_channel_size,
+                                                                      depth,
+                                                                      start,
+                                                                      end,
+                                                                      stream);
+                    }
+                    else {
+                        mult_fused_restricted_exp_stream_kernel<scalar_t, /*inverse=*/false>
+                        <<<batch_size, num_threads, 0, cuda_stream>>>(path_increments.data_ptr<scalar_t>(),
+                                                                      path_increments.stride(stream_dim),
+                                                                      path_increments.stride(batch_dim),
+                                                                      signature.data_ptr<scalar_t>(),
+                                                                      signature_stream_stride,
+                                                                      signature.stride(batch_dim),
+                                                                      reciprocals_contiguous.data_ptr<scalar_t>(),
+                                                                      workspace.data_ptr<scalar_t>(),
+                                                                      scratch_capacity,
+                                                                      input_channel_size,
+                                                                      depth,
+                                                                      start,
+                                                                      end,
+                                                                      stream);
+                    }
+                }));
+                AT_CUDA_CHECK(cudaGetLastError());
+            }
+
+            void mult_fused_restricted_exp_and_inverse_stream_cuda_kernel(torch::Tensor path_increments,
+                                                                          torch::Tensor signature,
+                                                                          torch::Tensor inverse_signature,
+                                                                          torch::Tensor reciprocals,
+                                                                          s_size_type depth, int64_t start,
+                                                                          int64_t end) {
+                if (start >= end) {
+                    return;
+                }
+
+                int64_t batch_size = path_increments.size(batch_dim);
+                int64_t input_channel_size = path_increments.size(channel_dim);
+
+                int64_t scratch_capacity = 1;
+                for (s_size_type depth_index = 0; depth_index < depth - 1; ++depth_index) {
+                    scratch_capacity *= input_channel_size;
+                }
+                if (depth == 1) {
+                    scratch_capacity = 0;
+                }
+                torch::Tensor workspace = torch::empty({batch_size,
+                                                        2 * input_channel_size + 2 * (depth - 1) * input_channel_size +
+                                                        2 * scratch_capacity},
+                                                       path_increments.options());
+                torch::Tensor reciprocals_contiguous = reciprocals.contiguous();
+
+                int64_t num_threads = num_cuda_threads(scratch_capacity * input_channel_size);
+                auto cuda_stream = at::cuda::getCurrentCUDAStream();
+
+                AT_DISPATCH_FLOATING_TYPES(path_increments.scalar_type(),
+                                           "mult_fused_restricted_exp_and_inverse_stream_cuda_kernel", ([&] {
+                    mult_fused_restricted_exp_and_inverse_stream_kernel<scalar_t>
+                    <<<batch_size, num_threads, 0, cuda_stream>>>(path_increments.data_ptr<scalar_t>(),
+                                                                  path_increments.stride(stream_dim),
+                                                                  path_increments.stride(batch_dim),
+                                                                  signature.data_ptr<scalar_t>(),
+                                                                  inverse_signature.data_ptr<scalar_t>(),
+                                                                  signature.stride(stream_dim),
+                                                                  signature.stride(batch_dim),
+                                                                  reciprocals_contiguous.data_ptr<scalar_t>(),
+                                                                  workspace.data_ptr<scalar_t>(),
+                                                                  scratch_capacity,
+                                                                  input_channel_size,
+                                                                  depth,
+                                                                  start,
+                                                                  end);
+                }));
+                AT_CUDA_CHECK(cudaGetLastError());
+            }
+
+            void mult_fused_restricted_exp_backward_cuda_kernel(torch::Tensor grad_next,
+                                                                std::vector<torch::Tensor>& grad_prev,
+                                                                torch::Tensor next,
+                                                                const std::vector<torch::Tensor>& prev,
+                                                                bool inverse,
+                                                                torch::Tensor reciprocals) {
+                int64_t batch_size = next.size(batch_dim);
+                int64_t input_channel_size = next.size(channel_dim);
+                s_size_type depth = prev.size();
+
+                // The total size of all the scratches, over every depth_index; see scratches_offset.
+                int64_t all_scratches_size = 0;
+                int64_t group_size = 0;
+                for (s_size_type depth_index = 0; depth_index < depth - 1; ++depth_index) {
+                    group_size += prev[depth_index].size(channel_dim);
+                    all_scratches_size += group_size;
+                }
+                torch::Tensor workspace = torch::empty({batch_size,
+                                                        2 * ((depth - 1) * input_channel_size + all_scratches_size)},
+                                                       next.options());
+                torch::Tensor reciprocals_contiguous = reciprocals.contiguous();
+
+                int64_t num_threads = num_cuda_threads(prev.back().size(channel_dim));
+                auto stream = at::cuda::getCurrentCUDAStream();
+
+                AT_DISPATCH_FLOATING_TYPES(next.scalar_type(), "mult_fused_restricted_exp_backward_cuda_kernel", ([&] {
+                    TermPointers<scalar_t> grad_prev_pointers = make_term_pointers<scalar_t>(grad_prev);
+                    TermPointers<scalar_t> prev_pointers = make_term_pointers<scalar_t>(prev);
+                    size_t shared_memory_size = num_threads * sizeof(scalar_t);
+                    if (inverse) {
+                        mult_fused_restricted_exp_backward_kernel<scalar_t, /*inverse=*/true>
+                        <<<batch_size, num_threads, shared_memory_size, stream>>>(
+                                grad_next.data_ptr<scalar_t>(),
+                                grad_next.stride(batch_dim),
+                                grad_prev_pointers,
+                                next.data_ptr<scalar_t>(),
+                                next.stride(batch_dim),
+                                prev_pointers,
+                                reciprocals_contiguous.data_ptr<scalar_t>(),
+                                workspace.data_ptr<scalar_t>(),
+                                all_scratches_size,
+                                input_channel_size,
+                                depth);
+                    }
+                    else {
+                        mult_fused_restricted_exp_backward_kernel<scalar_t, /*inverse=*/false>
+                        <<<batch_size, num_threads, shared_memory_size, stream>>>(
+                                grad_next.data_ptr<scalar_t>(),
+                                grad_next.stride(batch_dim),
+                                grad_prev_pointers,
+                                next.data_ptr<scalar_t>(),
+                                next.stride(batch_dim),
+                                prev_pointers,
+                                reciprocals_contiguous.data_ptr<scalar_t>(),
+                                workspace.data_ptr<scalar_t>(),
+                                all_scratches_size,
+                                input_channel_size,
+                                depth);
+                    }
+                }));
+                AT_CUDA_CHECK(cudaGetLastError());
+            }
+        }  // namespace signatory::ta_ops::detail
+    }  // namespace signatory::ta_ops
+}  // namespace signatory
@@ -0,0 +1,108 @@
+/* Copyright 2019 Patrick Kidger. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ========================================================================= */
+ // Hand-written CUDA kernels for the hot loops of the tensor algebra operations.
+ // These are only compiled if SIGNATORY_CUDA is defined, which setup.py does if it finds a CUDA toolkit. Otherwise
+ // computations on the GPU are expressed in terms of high-level PyTorch operations instead; see
+ // tensor_algebra_ops.cpp.
+
+
+#ifndef SIGNATORY_TENSOR_ALGEBRA_OPS_CUDA_HPP
+#define SIGNATORY_TENSOR_ALGEBRA_OPS_CUDA_HPP
+
+#include <torch/extension.h>
+#include <vector>  // std::vector
+
+#include "misc.hpp"
+
+
+namespace signatory {
+    namespace ta_ops {
+        namespace detail {
+            // The kernels are passed pointers to each term of the tensor algebra as kernel arguments, so there is a
+            // (generous) upper limit on the depth that they may be used with.
+            constexpr s_size_type max_cuda_kernel_depth = 32;
+
+            // Whether mult_cuda_kernel and mult_backward_cuda_kernel can handle the given member of the tensor
+            // algebra.
+            bool mult_cuda_kernel_supported(const std::vector<torch::Tensor>& arg);
+
+            // Computes out = arg_a + arg_b + arg_a \otimes arg_b, or adds that on to 'out' if add_not_copy==true; see
+            // mult_cpu_inner. Each batch element is handled by a single block.
+            void mult_cuda_kernel(std::vector<torch::Tensor>& out, const std::vector<torch::Tensor>& arg_a,
+                                  const std::vector<torch::Tensor>& arg_b, bool add_not_copy);
+
+            // As ta_ops::mult_backward, for CUDA tensors. Each batch element is handled by a single block, mirroring
+            // mult_backward_cpu_inner.
+            void mult_backward_cuda_kernel(std::vector<torch::Tensor>& grad_arg1,
+                                           std::vector<torch::Tensor>& grad_arg2,
+                                           const std::vector<torch::Tensor>& arg1,
+                                           const std::vector<torch::Tensor>& arg2,
+                                           bool add_not_copy);
+
+            // Whether the hand-written kernels below can handle the given arguments. If not then the high-level
+            // implementation should be used instead.
+            bool mult_fused_restricted_exp_cuda_kernel_supported(torch::Tensor next,
+                                                                 const std::vector<torch::Tensor>& prev);
+
+            // As ta_ops::mult_fused_restricted_exp, for CUDA tensors.
+            // Each batch element is handled by a single block, mirroring mult_fused_restricted_exp_cpu_inner.
+            void mult_fused_restricted_exp_cuda_kernel(torch::Tensor next, std::vector<torch::Tensor>& prev,
+                                                       bool inverse, torch::Tensor reciprocals);
+
+            // As ta_ops::mult_fused_restricted_exp_backward, for CUDA tensors.
+            // Each batch element is handled by a single block, mirroring
+            // mult_fused_restricted_exp_backward_cpu_inner.
+            void mult_fused_restricted_exp_backward_cuda_kernel(torch::Tensor grad_next,
+                                                                std::vector<torch::Tensor>& grad_prev,
+                                                                torch::Tensor next,
+                                                                const std::vector<torch::Tensor>& prev,
+                                                                bool inverse,
+                                                                torch::Tensor reciprocals);
+
+            // Whether mult_fused_restricted_exp_stream_cuda_kernel can handle the given arguments.
+            bool mult_fused_restricted_exp_stream_cuda_kernel_supported(torch::Tensor path_increments,
+                                                                        torch::Tensor signature,
+                                                                        s_size_type depth);
+
+            // Repeatedly applies mult_fused_restricted_exp to 'signature', for every increment in
+            // path_increments[start:end], all in a single kernel launch. The loop over the stream dimension happens on
+            // the device, so the cost of this doesn't scale with the number of kernel launches.
+            // 'path_increments' should be of shape (stream, batch, channel).
+            // 'signature' should not include the scalar term. If stream==true then it should be of shape
+            // (stream, batch, signature_channel), and the signature at each stream index is computed from the one at
+            // the previous stream index. If stream==false it should be of shape (batch, signature_channel) and is
+            // modified in-place.
+            void mult_fused_restricted_exp_stream_cuda_kernel(torch::Tensor path_increments, torch::Tensor signature,
+                                                              bool stream, bool inverse, torch::Tensor reciprocals,
+                                                              s_size_type depth, int64_t start, int64_t end);
+
+            // As mult_fused_restricted_exp_stream_cuda_kernel with stream==true, except that both the signature and
+            // the inverse signature are computed, from the same (non-inverted) path increments. That is, it's
+            // equivalent to calling mult_fused_restricted_exp_stream_cuda_kernel twice, once on 'signature' with
+            // inverse==false, and once on 'inverse_signature' with inverse==true and negated path increments. However
+            // this is all done in a single kernel launch, with each increment only loaded and divided by the
+            // reciprocals once. 'signature' and 'inverse_signature' should have the same strides as each other, and
+            // each should satisfy mult_fused_restricted_exp_stream_cuda_kernel_supported.
+            void mult_fused_restricted_exp_and_inverse_stream_cuda_kernel(torch::Tensor path_increments,
+                                                                          torch::Tensor signature,
+                                                                          torch::Tensor inverse_signature,
+                                                                          torch::Tensor reciprocals,
+                                                                          s_size_type depth, int64_t start,
+                                                                          int64_t end);
+        }  // namespace signatory::ta_ops::detail
+    }  // namespace signatory::ta_ops
+}  // namespace signatory
+
+#endif //SIGNATORY_TENSOR_ALGEBRA_OPS_CUDA_HPP
@@ -0,0 +1,102 @@
+/* Copyright 2019 Patrick Kidger. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ========================================================================= */
+
+
+#include <torch/extension.h>
+#include <cstdint>    // int64_t
+#include <mutex>      // std::lock_guard
+#include <string>     // std::string
+#include <tuple>      // std::make_tuple
+
+#include "misc.hpp"
+#include "profiling.hpp"
+#include "pycapsule.hpp"
+#include "workspace.hpp"
+
+
+namespace signatory {
+    namespace workspace {
+        torch::Tensor Workspace::reciprocals(s_size_type depth, torch::TensorOptions opts) {
+            std::lock_guard<std::mutex> lock {mutex};
+            auto key = std::make_tuple(depth, misc::make_options_key(opts));
+            auto found = reciprocals_cache.find(key);
+            if (found != reciprocals_cache.end()) {
+                return found->second;
+            }
+            torch::Tensor reciprocals = misc::make_reciprocals(depth, opts);
+            reciprocals_cache[key] = reciprocals;
+            return reciprocals;
+        }
+
+        torch::Tensor Workspace::buffer(const std::string& name, torch::IntArrayRef sizes,
+                                        torch::TensorOptions opts) {
+            int64_t numel = 1;
+            for (auto size : sizes) {
+                numel *= size;
+            }
+
+            std::lock_guard<std::mutex> lock {mutex};
+            torch::Tensor& storage = buffers[std::make_tuple(name, misc::make_options_key(opts))];
+            if (!storage.defined() || storage.size(0) < numel) {
+                storage = torch::empty({numel}, opts);
+                profiling::add("bytes_allocated", numel * storage.element_size());
+            }
+            return storage.narrow(/*dim=*/0, /*start=*/0, /*length=*/numel).view(sizes);
+        }
+
+        void Workspace::clear() {
+            std::lock_guard<std::mutex> lock {mutex};
+            reciprocals_cache.clear();
+            buffers.clear();
+        }
+
+        Workspace* unwrap(py::object workspace_capsule) {
+            if (workspace_capsule.is_none()) {
+                return nullptr;
+            }
+            return misc::unwrap_capsule<Workspace>(workspace_capsule);
+        }
+
+        torch::Tensor make_reciprocals(Workspace* workspace, s_size_type depth, torch::TensorOptions opts) {
+            if (workspace == nullptr) {
+                return misc::make_reciprocals(depth, opts);
+            }
+            return workspace->reciprocals(depth, opts);
+        }
+
+        torch::Tensor empty(Workspace* workspace, const std::string& name, torch::IntArrayRef sizes,
+                            torch::TensorOptions opts) {
+            if (workspace == nullptr) {
+                torch::Tensor out = torch::empty(sizes, opts);
+                profiling::add("bytes_allocated", out.numel() * out.element_size());
+                return out;
+            }
+            return workspace->buffer(name, sizes, opts);
+        }
+    }  // namespace signatory::workspace
+
+    py::object make_workspace() {
+        return misc::wrap_capsule<workspace::Workspace>();
+    }
+
+    void workspace_clear(py::object workspace_capsule) {
+        workspace::Workspace* workspace = workspace::unwrap(workspace_capsule);
+        if (workspace == nullptr) {
+            return;
+        }
+        py::gil_scoped_release release;
+        workspace->clear();
+    }
+}  // namespace signatory
@@ -0,0 +1,79 @@
+/* Copyright 2019 Patrick Kidger. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ * 
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ * 
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ * ========================================================================= */
+ // Provides for reusing memory across repeated calls to the signature and logsignature computations.
+
+
+#ifndef SIGNATORY_WORKSPACE_HPP
+#define SIGNATORY_WORKSPACE_HPP
+
+#include <torch/extension.h>
+#include <map>        // std::map
+#include <mutex>      // std::mutex
+#include <string>     // std::string
+#include <tuple>      // std::tuple
+
+#include "misc.hpp"
+
+
+namespace signatory {
+    namespace workspace {
+        // This struct will be wrapped into a PyCapsule; see signatory.Workspace.
+        // It holds on to memory between calls, so that repeatedly computing signatures of similarly-sized inputs
+        // doesn't have to keep going back to the allocator for its temporary tensors.
+        //
+        // A Workspace must not be used by two computations simultaneously: the buffers it hands out are shared
+        // between every computation using it.
+        class Workspace {
+        public:
+            // As misc::make_reciprocals, except that the result is only computed once for each depth, dtype and
+            // device.
+            torch::Tensor reciprocals(s_size_type depth, torch::TensorOptions opts);
+
+            // Returns a tensor of the given shape, with unspecified contents. The same memory is handed out (grown as
+            // necessary) for every request with the same name, dtype and device, so the result must not be used
+            // outside of the computation that asked for it.
+            torch::Tensor buffer(const std::string& name, torch::IntArrayRef sizes, torch::TensorOptions opts);
+
+            // Frees all memory held.
+            void clear();
+
+            constexpr static auto capsule_name = "signatory.WorkspaceCapsule";
+        private:
+            std::mutex mutex;
+            std::map<std::tuple<s_size_type, misc::options_key>, torch::Tensor> reciprocals_cache;
+            std::map<std::tuple<std::string, misc::options_key>, torch::Tensor> buffers;
+        };
+
+        // Gets the Workspace out of its PyCapsule. Returns nullptr if passed None.
+        Workspace* unwrap(py::object workspace_capsule);
+
+        // As misc::make_reciprocals, using the workspace if there is one.
+        torch::Tensor make_reciprocals(Workspace* workspace, s_size_type depth, torch::TensorOptions opts);
+
+        // As torch::empty, using the workspace if there is one. See Workspace::buffer for the caveats.
+        // Any memory that is freshly allocated (rather than reused) is added onto the "bytes_allocated" counter; see
+        // profiling.hpp.
+        torch::Tensor empty(Workspace* workspace, const std::string& name, torch::IntArrayRef sizes,
+                            torch::TensorOptions opts);
+    }  // namespace signatory::workspace
+
+    // Makes a Workspace PyCapsule.
+    py::object make_workspace();
+
+    // Frees all memory held by a Workspace PyCapsule.
+    void workspace_clear(py::object workspace_capsule);
+}  // namespace signatory
+
+#endif //SIGNATORY_WORKSPACE_HPP
@@ -113,7 +113,11 @@ def validate_tests(tests, depends):
         last = len(split_string) - 1
         for i, string_elem in enumerate(split_string):
             obj = getattr(obj, string_elem)
-            obj_mock_new = argparse.Namespace()
-            setattr(obj_mock, string_elem, obj if i == last else obj_mock_new)
-            obj_mock = obj_mock_new
+            if i == last:
+                setattr(obj_mock, string_elem, obj)
+            else:
+                # Reuse the namespace if an earlier string has already created it, e.g. 'impl.x' then 'impl.y'.
+                if not hasattr(obj_mock, string_elem):
+                    setattr(obj_mock, string_elem, argparse.Namespace())
+                obj_mock = getattr(obj_mock, string_elem)
     return signatory_mock
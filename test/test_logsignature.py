@@ -210,7 +210,9 @@ def _test_forward(class_, device, path_grad, batch_size, input_stream, input_cha
         ctx = logsignature.grad_fn
         if stream:
             ctx = ctx.next_functions[0][0]
-        assert type(ctx).__name__ == '_SignatureToLogsignatureFunctionBackward'
+            assert type(ctx).__name__ == '_LogSignatureStreamFunctionBackward'
+        else:
+            assert type(ctx).__name__ == '_SignatureToLogsignatureFunctionBackward'
         ref = weakref.ref(ctx)
         del ctx
         del logsignature
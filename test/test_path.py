@@ -80,6 +80,68 @@ def test_path():
                    extrarandom=False, which='none')
 
 
+def test_window():
+    """Tests that Path with a window only retains what it needs to, and still gets the right answers."""
+    for device in h.get_devices():
+        for window in (2, 3, 7):
+            for remember_path in (True, False):
+                for basepoint in (False, h.without_grad):
+                    _test_window(device, window, remember_path, basepoint)
+
+        with pytest.raises(ValueError):
+            signatory.Path(h.get_path(2, 4, 3, device, path_grad=False), 3, window=1)
+
+
+def _test_window(device, window, remember_path, basepoint):
+    path = h.get_path(2, 4, 3, device, path_grad=False)
+    basepoint = h.get_basepoint(2, 3, device, basepoint)
+    path_obj = signatory.Path(path, 3, basepoint=basepoint, remember_path=remember_path, window=window)
+    # Indices are into the path with any basepoint prepended. (Although if remember_path=False then the length of
+    # path_obj doesn't count the basepoint.)
+    full_path = path if basepoint is False else torch.cat([basepoint.unsqueeze(-2), path], dim=1)
+    length_offset = 1 if basepoint is not False and not remember_path else 0
+    for length in (1, 5, 2, 9, 3):
+        new_path = h.get_path(2, length, 3, device, path_grad=False)
+        path_obj.update(new_path)
+        full_path = torch.cat([full_path, new_path], dim=1)
+        path_length = path_obj.size(1)
+
+        assert path_length == full_path.size(1) - length_offset
+        assert path_obj._signature.size(-2) == window
+        for start in range(max(0, full_path.size(1) - window), path_length - 1):
+            for end in range(start + 2, path_length + 1):
+                true_signature = signatory.signature(full_path[:, start:end], 3)
+                h.diff(path_obj.signature(start, end), true_signature)
+        if full_path.size(1) > window:
+            with pytest.raises(ValueError):
+                path_obj.signature(full_path.size(1) - window - 1, None)
+        if remember_path:
+            retained = torch.cat(path_obj.path, dim=-2)
+            # The first retained piece should be the only one that starts before the window.
+            assert retained.size(-2) - path_obj.path[0].size(-2) < window
+            h.diff(retained, full_path[:, -retained.size(-2):])
+
+
+def test_signature_and_inverse():
+    """Tests that the signatures and inverse signatures that Path computes together are correct."""
+    for device in h.get_devices():
+        # Covers both the fixed-size and generic CPU implementations.
+        for input_channels, depth in ((1, 7), (2, 2), (3, 4), (3, 7), (9, 3)):
+            for scalar_term in (False, True):
+                path = h.get_path(2, 5, input_channels, device, path_grad=False)
+                path_obj = signatory.Path(path, depth, scalar_term=scalar_term)
+                new_path = h.get_path(2, 3, input_channels, device, path_grad=False)
+                path_obj.update(new_path)
+                full_path = torch.cat([path, new_path], dim=1)
+
+                length = path_obj._signature_length
+                true_signature = signatory.signature(full_path, depth, stream=True, scalar_term=scalar_term)
+                true_inverse_signature = signatory.signature(full_path, depth, stream=True, inverse=True,
+                                                             scalar_term=scalar_term)
+                h.diff(path_obj._signature[:, :length], true_signature)
+                h.diff(path_obj._inverse_signature[:, :length], true_inverse_signature)
+
+
 def _randint(value):
     return torch.randint(low=0, high=value, size=(1,)).item()
 
@@ -0,0 +1,79 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Tests the profiling counters."""
+
+
+import torch
+
+from helpers import helpers as h
+from helpers import validation as v
+
+
+tests = ['enable_profiling_counters', 'profiling_counters', 'reset_profiling_counters']
+depends = ['signature', 'logsignature', 'Workspace']
+signatory = v.validate_tests(tests, depends)
+
+
+def test_profiling_counters():
+    """Tests that the counters are recorded when turned on, and only when turned on."""
+    for device in h.get_devices():
+        signatory.reset_profiling_counters()
+        try:
+            path = h.get_path(2, 10, 3, device, path_grad=True)
+            signatory.signature(path, 3)
+            assert signatory.profiling_counters() == {}
+
+            signatory.enable_profiling_counters()
+            signature = signatory.signature(path, 3)
+            signature.backward(torch.rand_like(signature))
+            logsignature = signatory.logsignature(path, 3, mode=h.brackets_mode)
+            logsignature.backward(torch.rand_like(logsignature))
+            counters = signatory.profiling_counters()
+            for stage in ('signature_forward', 'signature_backward', 'signature_to_logsignature_forward',
+                          'signature_to_logsignature_backward', 'logsignature_log', 'logsignature_log_backward'):
+                assert counters[stage + '.seconds'] >= 0
+                assert counters[stage + '.calls'] >= 1
+            assert counters['signature_forward.calls'] == 2
+            assert counters['signature_forward.batch_threads'] >= 1
+            assert counters['signature_forward.stream_threads'] >= 1
+            assert counters['signature_backward.batch_threads'] >= 1
+            assert counters['bytes_allocated'] > 0
+
+            signatory.reset_profiling_counters()
+            assert signatory.profiling_counters() == {}
+            signatory.enable_profiling_counters(False)
+            signatory.signature(path, 3)
+            assert signatory.profiling_counters() == {}
+        finally:
+            signatory.enable_profiling_counters(False)
+            signatory.reset_profiling_counters()
+
+
+def test_profiling_workspace():
+    """Tests that reusing memory via a workspace shows up as no more memory being allocated."""
+    for device in h.get_devices():
+        signatory.reset_profiling_counters()
+        signatory.enable_profiling_counters()
+        try:
+            workspace = signatory.Workspace()
+            path = h.get_path(2, 10, 3, device, path_grad=False)
+            signatory.logsignature(path, 3, mode=h.brackets_mode, workspace=workspace)
+            bytes_allocated = signatory.profiling_counters()['bytes_allocated']
+            assert bytes_allocated > 0
+            signatory.logsignature(path, 3, mode=h.brackets_mode, workspace=workspace)
+            assert signatory.profiling_counters()['bytes_allocated'] == bytes_allocated
+        finally:
+            signatory.enable_profiling_counters(False)
+            signatory.reset_profiling_counters()
@@ -77,6 +77,25 @@ def signatory_signature(class_, path, depth, stream, basepoint, inverse, initial
                                        initial=initial, scalar_term=scalar_term)
 
 
+def _compare_with_reference(compute, reference, path, basepoint, initial):
+    """Checks that compute() gives the same values, and the same gradients with respect to 'path', 'basepoint' and
+    'initial', as reference(). Both should be functions of no arguments, computing something from those inputs."""
+    inputs = [path] + [tensor for tensor in (basepoint, initial)
+                       if isinstance(tensor, torch.Tensor) and tensor.requires_grad]
+    with warnings.catch_warnings():
+        warnings.filterwarnings('ignore', message="Argument 'initial' has been set but argument 'basepoint' has "
+                                                  "not.", category=UserWarning)
+        result = compute()
+        grad = torch.rand_like(result)
+        grads = autograd.grad(result, inputs, grad)
+        true_result = reference()
+        true_grads = autograd.grad(true_result, inputs, grad)
+
+    h.diff(result, true_result)
+    for input_grad, true_input_grad in zip(grads, true_grads):
+        h.diff(input_grad, true_input_grad)
+
+
 def test_forward():
     """Tests that the forward calculations of the signature behave correctly."""
     for class_ in (False, True):
@@ -176,7 +195,7 @@ def test_batch_trick():
                                                               initial, scalar_term)
 
 
-def _no_batch_trick(path, depth, stream, basepoint, inverse, initial, scalar_term):
+def _no_batch_trick(path, depth, stream, basepoint, inverse, initial, scalar_term, workspace=None):
     return
 
 
@@ -247,6 +266,21 @@ def _test_batch_trick(class_, device, path_grad, batch_size, input_stream, input
         initial.grad.zero_()
 
 
+def test_stream_scan():
+    """Tests that the parallel scan for computing signatures with stream=True, which is selected for long streams with
+    small batch sizes, does produce the correct values."""
+    # Note that whether the scan is actually used depends upon the number of threads available, so on a machine with very
+    # few cores this just tests the usual computation.
+    for device in h.get_devices():
+        for batch_size in (1, 2):
+            for basepoint in (False, h.without_grad):
+                for inverse in (False, True):
+                    for initial in (None, h.without_grad):
+                        for scalar_term in (False, True):
+                            _test_forward(False, device, False, batch_size, 3000, 4, 3, True, basepoint, inverse,
+                                          initial, scalar_term)
+
+
 def test_backward():
     """Tests that the backwards operation through the signature gives the correct values."""
     for class_ in (False, True):
@@ -261,6 +295,42 @@ def test_backward():
                                                    stream, basepoint, inverse, initial, scalar_term)
 
 
+def test_backward_parallel():
+    """Tests that the backwards operation through the signature gives the correct values for long streams, for which
+    the stream is split up into segments that are handled in parallel."""
+    # As with test_stream_scan, whether this parallelism is actually used depends upon the number of threads available.
+    for device in h.get_devices():
+        for batch_size in (1, 2):
+            for basepoint in (False, h.with_grad):
+                for inverse in (False, True):
+                    for initial in (None, h.with_grad):
+                        for scalar_term in (False, True):
+                            _test_backward(False, device, batch_size, 3000, 4, 3, False, basepoint, inverse, initial,
+                                           scalar_term)
+
+
+def test_num_threads():
+    """Tests that the results don't depend upon the number of threads set via torch.set_num_threads."""
+    num_threads = torch.get_num_threads()
+    for batch_size in (1, 3):
+        for stream in (False, True):
+            for inverse in (False, True):
+                path = h.get_path(batch_size, 3000, 4, 'cpu', path_grad=True)
+                signature = signatory.signature(path, 3, stream=stream, inverse=inverse)
+                grad = torch.rand_like(signature)
+                signature.backward(grad)
+                path_grad = path.grad.clone()
+                path.grad.zero_()
+                try:
+                    torch.set_num_threads(1)
+                    serial_signature = signatory.signature(path, 3, stream=stream, inverse=inverse)
+                    serial_signature.backward(grad)
+                finally:
+                    torch.set_num_threads(num_threads)
+                h.diff(signature, serial_signature)
+                h.diff(path_grad, path.grad)
+
+
 def _test_backward(class_, device, batch_size, input_stream, input_channels, depth, stream, basepoint, inverse,
                    initial, scalar_term):
     path = h.get_path(batch_size, input_stream, input_channels, device, path_grad=True)
@@ -307,6 +377,273 @@ def _test_backward(class_, device, batch_size, input_stream, input_channels, dep
         h.diff(initial.grad, initial_grad, atol=1e-4)
 
 
+def test_levels():
+    """Tests that computing only some levels of the signature gives the same values and gradients as computing the
+    whole signature and then extracting those levels."""
+    for class_ in (False, True):
+        for device in h.get_devices():
+            for batch_size, input_stream, input_channels, basepoint in h.random_sizes_and_basepoint():
+                for depth, levels in ((1, (1,)), (3, (3,)), (3, (1, 3)), (4, (2, 3, 4))):
+                    for stream in (False, True):
+                        for inverse in (False, True):
+                            for initial in (None, h.with_grad):
+                                for scalar_term in (False, True):
+                                    _test_levels(class_, device, batch_size, input_stream, input_channels, depth,
+                                                 levels, stream, basepoint, inverse, initial, scalar_term)
+    # Long enough that the stream is processed in several blocks
+    for device in h.get_devices():
+        for inverse in (False, True):
+            _test_levels(False, device, 2, 1000, 4, 6, (2, 6), True, False, inverse, None, False)
+
+
+def _test_levels(class_, device, batch_size, input_stream, input_channels, depth, levels, stream, basepoint, inverse,
+                 initial, scalar_term):
+    path = h.get_path(batch_size, input_stream, input_channels, device, path_grad=True)
+    basepoint = h.get_basepoint(batch_size, input_channels, device, basepoint)
+    initial = h.get_initial(batch_size, input_channels, device, depth, initial, scalar_term)
+
+    def compute():
+        if class_:
+            return signatory.Signature(depth, stream=stream, inverse=inverse, scalar_term=scalar_term,
+                                       levels=levels)(path, basepoint=basepoint, initial=initial)
+        else:
+            return signatory.signature(path, depth, stream=stream, basepoint=basepoint, inverse=inverse,
+                                       initial=initial, scalar_term=scalar_term, levels=levels)
+
+    def reference():
+        signature = signatory_signature(False, path, depth, stream, basepoint, inverse, initial, scalar_term)
+        terms = []
+        start = 0
+        if scalar_term:
+            terms.append(signature.narrow(dim=-1, start=0, length=1))
+            start = 1
+        for level in range(1, depth + 1):
+            length = input_channels ** level
+            if level in levels:
+                terms.append(signature.narrow(dim=-1, start=start, length=length))
+            start += length
+        return torch.cat(terms, dim=-1)
+
+    _compare_with_reference(compute, reference, path, basepoint, initial)
+
+
+def test_stream_indices():
+    """Tests that passing a stride or some indices as the 'stream' argument gives the same values and gradients as
+    computing the signature with stream=True and then indexing into it."""
+    for class_ in (False, True):
+        for device in h.get_devices():
+            for batch_size, input_stream, input_channels, basepoint in h.random_sizes_and_basepoint():
+                output_stream = input_stream if basepoint is not False else input_stream - 1
+                if output_stream < 1:
+                    continue
+                for stream in (1, 2, 3, [0], [-1], [0, output_stream - 1], torch.tensor([output_stream - 1])):
+                    if isinstance(stream, int) and stream > output_stream:
+                        continue
+                    if isinstance(stream, list) and len(stream) == 2 and output_stream == 1:
+                        continue
+                    for depth in (1, 3):
+                        for inverse in (False, True):
+                            for initial in (None, h.with_grad):
+                                for scalar_term in (False, True):
+                                    _test_stream_indices(class_, device, batch_size, input_stream, input_channels,
+                                                         depth, stream, basepoint, inverse, initial, scalar_term)
+    # Long enough that the stream is processed in several blocks
+    for device in h.get_devices():
+        for stream in (7, [3, 500, 998]):
+            _test_stream_indices(False, device, 2, 1000, 4, 6, stream, False, False, None, False)
+
+
+def _test_stream_indices(class_, device, batch_size, input_stream, input_channels, depth, stream, basepoint, inverse,
+                         initial, scalar_term):
+    path = h.get_path(batch_size, input_stream, input_channels, device, path_grad=True)
+    basepoint = h.get_basepoint(batch_size, input_channels, device, basepoint)
+    initial = h.get_initial(batch_size, input_channels, device, depth, initial, scalar_term)
+
+    def compute():
+        return signatory_signature(class_, path, depth, stream, basepoint, inverse, initial, scalar_term)
+
+    def reference():
+        signature = signatory_signature(False, path, depth, True, basepoint, inverse, initial, scalar_term)
+        if isinstance(stream, int):
+            return signature[:, stream - 1::stream]
+        else:
+            return signature[:, stream]
+
+    _compare_with_reference(compute, reference, path, basepoint, initial)
+
+
+def test_stream_zero_one():
+    """Tests that the ints 0 and 1 as the 'stream' argument still mean False and True, as they did before strides were
+    supported, and that smaller ints are rejected."""
+    for device in h.get_devices():
+        path = h.get_path(2, 6, 3, device, path_grad=False)
+        for int_stream, bool_stream in ((0, False), (1, True)):
+            h.diff(signatory.signature(path, 3, stream=int_stream), signatory.signature(path, 3, stream=bool_stream))
+            # Only bools are allowed with augmentation; these count as bools.
+            h.diff(signatory.signature(path, 3, stream=int_stream, include_time=True),
+                   signatory.signature(path, 3, stream=bool_stream, include_time=True))
+        # checkpoint is only allowed with stream=False
+        h.diff(signatory.signature(path, 3, stream=0, checkpoint=2), signatory.signature(path, 3))
+        with pytest.raises(ValueError):
+            signatory.signature(path, 3, stream=-1)
+
+
+def test_checkpoint():
+    """Tests that the checkpointed computation gives the same values and gradients as the usual one."""
+    for class_ in (False, True):
+        for device in h.get_devices():
+            for batch_size, input_stream, input_channels, basepoint in h.random_sizes_and_basepoint():
+                for depth in (1, 2, 4):
+                    for checkpoint in (1, 2, 3, 100):
+                        for inverse in (False, True):
+                            for initial in (None, h.with_grad):
+                                for scalar_term in (False, True):
+                                    _test_checkpoint(class_, device, batch_size, input_stream, input_channels, depth,
+                                                     checkpoint, basepoint, inverse, initial, scalar_term)
+    # Enough segments to be worth parallelising over
+    for device in h.get_devices():
+        for inverse in (False, True):
+            _test_checkpoint(False, device, 2, 1000, 4, 4, 31, False, inverse, None, False)
+
+
+def _test_checkpoint(class_, device, batch_size, input_stream, input_channels, depth, checkpoint, basepoint, inverse,
+                     initial, scalar_term):
+    path = h.get_path(batch_size, input_stream, input_channels, device, path_grad=True)
+    basepoint = h.get_basepoint(batch_size, input_channels, device, basepoint)
+    initial = h.get_initial(batch_size, input_channels, device, depth, initial, scalar_term)
+
+    def compute():
+        if class_:
+            return signatory.Signature(depth, inverse=inverse, scalar_term=scalar_term,
+                                       checkpoint=checkpoint)(path, basepoint=basepoint, initial=initial)
+        else:
+            return signatory.signature(path, depth, basepoint=basepoint, inverse=inverse, initial=initial,
+                                       scalar_term=scalar_term, checkpoint=checkpoint)
+
+    def reference():
+        return signatory_signature(False, path, depth, False, basepoint, inverse, initial, scalar_term)
+
+    _compare_with_reference(compute, reference, path, basepoint, initial)
+
+
+def test_reduced_precision():
+    """Tests that paths of dtype float16 and bfloat16 give results in that dtype, which agree with computing in float32
+    and converting afterwards."""
+    # Each of these goes through a different code path: the plain signature, selected levels, a stride or indices
+    # into the stream, and checkpointing.
+    for device in h.get_devices():
+        for dtype in (torch.float16, torch.bfloat16):
+            for kwargs in (dict(stream=False), dict(stream=True), dict(stream=3), dict(stream=[0, 4, -1]),
+                           dict(levels=[1, 3]), dict(stream=True, levels=[2]), dict(checkpoint=4)):
+                for basepoint in (False, h.with_grad):
+                    for inverse in (False, True):
+                        for scalar_term in (False, True):
+                            _test_reduced_precision(device, dtype, kwargs, basepoint, inverse, scalar_term)
+
+
+def _test_reduced_precision(device, dtype, kwargs, basepoint, inverse, scalar_term):
+    path = h.get_path(2, 10, 3, device, path_grad=False).to(dtype).requires_grad_()
+    basepoint = h.get_basepoint(2, 3, device, basepoint)
+    if isinstance(basepoint, torch.Tensor):
+        basepoint = basepoint.detach().to(dtype).requires_grad_()
+    signature = signatory.signature(path, 3, basepoint=basepoint, inverse=inverse, scalar_term=scalar_term,
+                                    **kwargs)
+    assert signature.dtype == dtype
+
+    grad = torch.rand_like(signature)
+    signature.backward(grad)
+    assert path.grad.dtype == dtype
+
+    float_path = path.detach().float().requires_grad_()
+    float_basepoint = basepoint
+    if isinstance(basepoint, torch.Tensor):
+        float_basepoint = basepoint.detach().float().requires_grad_()
+    float_signature = signatory.signature(float_path, 3, basepoint=float_basepoint, inverse=inverse,
+                                          scalar_term=scalar_term, **kwargs)
+    float_signature.backward(grad.float())
+
+    # Allow for a couple of rounding errors at the reduced precision.
+    eps = torch.finfo(dtype).eps
+    h.diff(signature.float(), float_signature, atol=4 * eps * max(1, float_signature.abs().max().item()))
+    # The backward pass additionally starts from the signature as stored at reduced precision.
+    h.diff(path.grad.float(), float_path.grad, atol=16 * eps * max(1, float_path.grad.abs().max().item()))
+    if isinstance(basepoint, torch.Tensor):
+        h.diff(basepoint.grad.float(), float_basepoint.grad,
+               atol=16 * eps * max(1, float_basepoint.grad.abs().max().item()))
+
+
+def test_augmentation():
+    """Tests that augmenting with time and lead-lag on the fly agrees with explicitly augmenting the path first."""
+    for class_ in (False, True):
+        for device in h.get_devices():
+            for batch_size, input_stream, input_channels, basepoint in h.random_sizes_and_basepoint():
+                for include_time, lead_lag in ((True, False), (False, True), (True, True)):
+                    for stream in (False, True):
+                        for inverse in (False, True):
+                            for initial in (None, h.with_grad):
+                                _test_augmentation(class_, device, batch_size, input_stream, input_channels, 3,
+                                                   stream, basepoint, inverse, initial, False, include_time, lead_lag)
+        # Larger, to be split up between threads
+        for device in h.get_devices():
+            for stream in (False, True):
+                _test_augmentation(class_, device, 4, 1000, 2, 3, stream, False, False, None, True, True, True)
+
+
+def _augment(path, basepoint, include_time, lead_lag):
+    if basepoint is True:
+        path = torch.cat([torch.zeros_like(path[:, :1]), path], dim=1)
+    elif isinstance(basepoint, torch.Tensor):
+        path = torch.cat([basepoint.unsqueeze(1), path], dim=1)
+    if lead_lag:
+        repeated = path.repeat_interleave(2, dim=1)
+        path = torch.cat([repeated[:, 1:], repeated[:, :-1]], dim=2)
+    if include_time:
+        time = torch.linspace(0, 1, path.size(1), dtype=path.dtype, device=path.device)
+        path = torch.cat([path, time.unsqueeze(1).expand(path.size(0), path.size(1), 1)], dim=2)
+    return path
+
+
+def _test_augmentation(class_, device, batch_size, input_stream, input_channels, depth, stream, basepoint, inverse,
+                       initial, scalar_term, include_time, lead_lag):
+    augmented_channels = (2 * input_channels if lead_lag else input_channels) + (1 if include_time else 0)
+    path = h.get_path(batch_size, input_stream, input_channels, device, path_grad=True)
+    basepoint = h.get_basepoint(batch_size, input_channels, device, basepoint)
+    initial = h.get_initial(batch_size, augmented_channels, device, depth, initial, scalar_term)
+
+    def compute():
+        if class_:
+            return signatory.Signature(depth, stream=stream, inverse=inverse, scalar_term=scalar_term,
+                                       include_time=include_time, lead_lag=lead_lag)(path, basepoint=basepoint,
+                                                                                     initial=initial)
+        else:
+            return signatory.signature(path, depth, stream=stream, basepoint=basepoint, inverse=inverse,
+                                       initial=initial, scalar_term=scalar_term, include_time=include_time,
+                                       lead_lag=lead_lag)
+
+    def reference():
+        augmented_path = _augment(path, basepoint, include_time, lead_lag)
+        return signatory.signature(augmented_path, depth, stream=stream, inverse=inverse, initial=initial,
+                                   scalar_term=scalar_term)
+
+    _compare_with_reference(compute, reference, path, basepoint, initial)
+
+
+def test_augmentation_errors():
+    """Tests that the unsupported combinations of augmentation with other arguments raise errors."""
+    for device in h.get_devices():
+        path = h.get_path(2, 4, 3, device, path_grad=False)
+        with pytest.raises(ValueError):
+            signatory.signature(path, 2, stream=2, include_time=True)
+        with pytest.raises(ValueError):
+            signatory.signature(path, 2, levels=[2], lead_lag=True)
+        with pytest.raises(ValueError):
+            signatory.signature(path, 2, checkpoint=2, include_time=True)
+        # The initial value must be a signature of the augmented path.
+        initial = signatory.signature(path, 2)
+        with pytest.raises(ValueError):
+            signatory.signature(path, 2, initial=initial, basepoint=True, lead_lag=True)
+
+
 def test_no_adjustments():
     """Tests that the signature computations don't modify any memory that they're not supposed to."""
 
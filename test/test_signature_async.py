@@ -0,0 +1,74 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Tests scheduling signature computations asynchronously."""
+
+
+import pytest
+import torch
+
+from helpers import helpers as h
+from helpers import validation as v
+
+
+tests = ['signature_async']
+depends = ['signature']
+signatory = v.validate_tests(tests, depends)
+
+
+def test_forward_backward():
+    """Tests that several asynchronous computations give the same values and gradients as the usual ones."""
+    for device in h.get_devices():
+        for stream in (False, True):
+            for basepoint in (False, h.with_grad):
+                paths = [h.get_path(2, 10, 3, device, path_grad=True) for _ in range(4)]
+                basepoints = [h.get_basepoint(2, 3, device, basepoint) for _ in range(4)]
+                futures = [signatory.signature_async(path, 3, stream=stream, basepoint=basepoint_)
+                           for path, basepoint_ in zip(paths, basepoints)]
+                results = [future.value() for future in torch.futures.wait_all(futures)]
+                for path, basepoint_, result in zip(paths, basepoints, results):
+                    grad = torch.rand_like(result)
+                    result.backward(grad)
+                    path_grad = path.grad.clone()
+                    path.grad.zero_()
+                    if isinstance(basepoint_, torch.Tensor):
+                        basepoint_grad = basepoint_.grad.clone()
+                        basepoint_.grad.zero_()
+
+                    signature = signatory.signature(path, 3, stream=stream, basepoint=basepoint_)
+                    signature.backward(grad)
+                    h.diff(result, signature)
+                    h.diff(path.grad, path_grad)
+                    if isinstance(basepoint_, torch.Tensor):
+                        h.diff(basepoint_.grad, basepoint_grad)
+
+
+def test_no_grad():
+    """Tests that the caller's grad mode is respected."""
+    path = h.get_path(2, 10, 3, 'cpu', path_grad=True)
+    with torch.no_grad():
+        future = signatory.signature_async(path, 3)
+    assert future.wait().grad_fn is None
+    assert signatory.signature_async(path, 3).wait().grad_fn is not None
+
+
+def test_errors():
+    """Tests that invalid arguments raise errors."""
+    # Caught immediately
+    with pytest.raises(ValueError):
+        signatory.signature_async(h.get_path(2, 10, 3, 'cpu', path_grad=False), 0)
+    # Only caught by the computation itself
+    future = signatory.signature_async(h.get_path(2, 10, 3, 'cpu', path_grad=False), 3, stream=[20])
+    with pytest.raises(Exception):
+        future.wait()
@@ -67,7 +67,7 @@ def iisignature_signature(path, depth, stream=False, basepoint=False, inverse=Fa
 
 def test_forward():
     """Tests that the forward calculation for combing signatures produces the correct values."""
-    for signature_combine, amount in ((True, 2), (False, 1), (False, 2), (False, 3), (False, 10)):
+    for signature_combine, amount in ((True, 2), (False, 1), (False, 2), (False, 3), (False, 7), (False, 10)):
         for signature_grad in (False, True):
             for device in h.get_devices():
                 for batch_size in (1, 2, 5):
@@ -117,7 +117,7 @@ def _test_forward(signature_combine, signature_grad, amount, device, batch_size,
 
 def test_backward():
     """Tests that the backwards calculation for combining signatures produces the correct values."""
-    for signature_combine, amount in ((True, 2), (False, 1), (False, 2), (False, 3), (False, 10)):
+    for signature_combine, amount in ((True, 2), (False, 1), (False, 2), (False, 3), (False, 7), (False, 10)):
         for device in h.get_devices():
             for batch_size, input_stream, input_channels in h.random_sizes():
                 for depth in (1, 2, 4, 6):
@@ -175,7 +175,7 @@ def _test_backward(signature_combine, amount, device, batch_size, input_stream,
 
 def test_no_adjustments():
     """Tests that the calculations for combining signatures don't modify memory they're not supposed to."""
-    for signature_combine, amount in ((True, 2), (False, 1), (False, 2), (False, 3), (False, 10)):
+    for signature_combine, amount in ((True, 2), (False, 1), (False, 2), (False, 3), (False, 7), (False, 10)):
         for signature_grad in (False, True):
             for device in h.get_devices():
                 for batch_size, input_stream, input_channels in h.random_sizes():
@@ -225,7 +225,7 @@ def _test_no_adjustments(signature_combine, amount, device, batch_size, input_st
 @pytest.mark.skipif(not torch.cuda.is_available(), reason='CUDA not available')
 def test_memory_leaks():
     """Checks that there are no memory leaks."""
-    for signature_combine, amount in ((True, 2), (False, 1), (False, 2), (False, 3), (False, 10)):
+    for signature_combine, amount in ((True, 2), (False, 1), (False, 2), (False, 3), (False, 7), (False, 10)):
         for signature_grad in (False, True):
             for batch_size, input_stream, input_channels in h.random_sizes():
                 for depth in (1, 2, 5):
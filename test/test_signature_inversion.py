@@ -49,3 +49,78 @@ def test_inversion_close_original_path():
 
     assert torch.allclose(path[:, :, :], inverted_path[:, :, :], atol=1e-01)
 
+
+def _signature_term(signature, channels, depth):
+    start = sum(channels ** i for i in range(1, depth))
+    return signature[:, start:start + channels ** depth]
+
+
+def _get_insertion_matrix(signature, insertion_position, depth, channels):
+    """The linear insertion map, exactly as the original pure Python implementation of invert_signature formed it."""
+    batch = signature.shape[0]
+    B = torch.cat(batch * [torch.eye(channels, dtype=signature.dtype)])
+    new_shape = [batch] + [channels] + [1] * (insertion_position - 1) + [channels] + [1] * (depth + 1 -
+                                                                                            insertion_position)
+    repeat_points = [1, 1] + [channels] * (insertion_position - 1) + [1] + [channels] * (depth + 1 - insertion_position)
+    new_B = B.view(new_shape)
+    new_B = new_B.repeat(repeat_points)
+
+    last_signature_term = _signature_term(signature, channels, depth)
+    last_signature_term = last_signature_term.reshape([batch] + [channels] * int(depth)).unsqueeze(insertion_position)
+    repeat_points_sig = [1, channels] + [1] * (insertion_position - 1) + [channels] + [1] * (
+                depth + 1 - insertion_position)
+    sig_new_tensor = last_signature_term.unsqueeze(1).repeat(repeat_points_sig)
+
+    A = (new_B * sig_new_tensor).flatten(start_dim=2)
+    return A
+
+
+def _original_invert_signature(signature, depth, channels):
+    """The insertion algorithm, exactly as the original pure Python implementation of invert_signature performed it,
+    for comparison."""
+    batch = signature.shape[0]
+    path = torch.zeros((batch, depth + 1, channels), dtype=signature.dtype)
+    if depth == 1:
+        path[:, 1, :] = path[:, 0, :] + signature
+        return path
+    for insertion_position in range(1, depth + 1):
+        A_matrix = _get_insertion_matrix(signature[:, :-channels ** depth], insertion_position, depth - 1, channels)
+        b_vector = depth * _signature_term(signature, channels, depth)
+        x_optimal = torch.matmul(A_matrix, b_vector.unsqueeze(-1)).squeeze(-1)
+        sign_1 = _signature_term(signature, channels, depth - 1)
+        x_optimal = x_optimal / (torch.norm(sign_1, dim=1).unsqueeze(-1) ** 2)
+        path[:, insertion_position, :] = path[:, insertion_position - 1, :] + x_optimal * (1 / depth)
+    return path
+
+
+def test_original_implementation():
+    """Tests that the inversion agrees with the original implementation, which explicitly formed the insertion map."""
+    for input_channels in (1, 2, 3):
+        for depth in (1, 2, 3, 5):
+            path = torch.rand((4, 6, input_channels), dtype=torch.double)
+            signature = signatory.signature(path, depth)
+            inverted_path = signatory.invert_signature(signature, depth, input_channels)
+            assert torch.allclose(inverted_path, _original_invert_signature(signature, depth, input_channels))
+
+
+def test_device_dtype():
+    """Tests that the inverted path is on the same device, and of the same dtype, as the signature."""
+    devices = ['cpu'] + (['cuda'] if torch.cuda.is_available() else [])
+    for device in devices:
+        for dtype in (torch.float, torch.double):
+            path = torch.rand((3, 5, 2), dtype=dtype, device=device)
+            for depth in (1, 3):
+                signature = signatory.signature(path, depth)
+                inverted_path = signatory.invert_signature(signature, depth, 2, initial_position=path[:, 0, :])
+                assert inverted_path.device == signature.device
+                assert inverted_path.dtype == signature.dtype
+
+
+def test_backward():
+    """Tests the backward pass with gradcheck."""
+    for depth in (1, 2, 4):
+        signature = signatory.signature(torch.rand((2, 5, 2), dtype=torch.double), depth).requires_grad_()
+        initial_position = torch.rand((2, 2), dtype=torch.double, requires_grad=True)
+        torch.autograd.gradcheck(lambda x, y: signatory.invert_signature(x, depth, 2, initial_position=y),
+                                 (signature, initial_position))
+        torch.autograd.gradcheck(lambda x: signatory.invert_signature(x, depth, 2), (signature,))
@@ -0,0 +1,169 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Tests computing signature kernels by solving the Goursat PDE."""
+
+
+import pytest
+import torch
+
+from helpers import helpers as h
+from helpers import validation as v
+
+
+tests = ['signature_kernel']
+depends = ['signature', 'enable_profiling_counters', 'profiling_counters', 'reset_profiling_counters',
+           'impl.signature_kernel_set_tile_elements']
+signatory = v.validate_tests(tests, depends)
+
+
+# The depth to which the signatures are computed when checking against them. The paths are kept small enough that the
+# terms of the kernel beyond this are negligible.
+_truncation_depth = 10
+
+
+def _truncated_kernel(path1, path2, basepoint, gram):
+    signature1 = signatory.signature(path1, _truncation_depth, basepoint=basepoint, scalar_term=True)
+    signature2 = signatory.signature(path2, _truncation_depth, basepoint=basepoint, scalar_term=True)
+    if gram:
+        return signature1 @ signature2.t()
+    else:
+        return (signature1 * signature2).sum(dim=-1)
+
+
+def test_forward():
+    """Tests that the signature kernel agrees with the inner product of (highly truncated) signatures."""
+    for device in h.get_devices():
+        for batch_size1, batch_size2 in ((1, 1), (3, 3), (2, 4)):
+            for input_stream1, input_stream2 in ((2, 2), (4, 3), (6, 5)):
+                for input_channels in (1, 2):
+                    for basepoint in (False, True):
+                        for gram in (False, True):
+                            if not gram and batch_size1 != batch_size2:
+                                continue
+                            path1 = 0.5 * h.get_path(batch_size1, input_stream1, input_channels, device,
+                                                     path_grad=False)
+                            path2 = 0.5 * h.get_path(batch_size2, input_stream2, input_channels, device,
+                                                     path_grad=False)
+                            true_kernel = _truncated_kernel(path1, path2, basepoint, gram)
+                            kernel = signatory.signature_kernel(path1, path2, dyadic_order=4, basepoint=basepoint,
+                                                                gram=gram)
+                            h.diff(kernel, true_kernel, atol=1e-4)
+
+
+def test_dyadic_order():
+    """Tests that refining the grid makes the kernel more accurate."""
+    for device in h.get_devices():
+        path1 = 0.5 * h.get_path(2, 5, 3, device, path_grad=False)
+        path2 = 0.5 * h.get_path(2, 4, 3, device, path_grad=False)
+        true_kernel = _truncated_kernel(path1, path2, basepoint=False, gram=False)
+        errors = []
+        for dyadic_order in (0, 1, 2, 3):
+            kernel = signatory.signature_kernel(path1, path2, dyadic_order=dyadic_order)
+            errors.append((kernel - true_kernel).abs().max().item())
+        assert errors == sorted(errors, reverse=True)
+
+
+def test_gram_pairwise():
+    """Tests that the Gram matrix agrees with computing each pair separately. Large enough to be split up between
+    threads on the CPU."""
+    for device in h.get_devices():
+        _test_gram_pairwise(device, expect_tiles=False)
+
+
+def test_tiling():
+    """As test_gram_pairwise, with the tiles made small enough that everything is split into several of them, some of
+    which are only partially filled."""
+    # Each pair of paths in _test_gram_pairwise is on a grid of 79 x 59 elements, so this is 20 pairs per tile. For the
+    # Gram matrix that means blocks of 4 x 5 paths, except for the last blocks along the second batch dimension, which
+    # are 4 x 4.
+    previous = signatory.impl.signature_kernel_set_tile_elements(20 * 79 * 59)
+    signatory.reset_profiling_counters()
+    signatory.enable_profiling_counters()
+    try:
+        for device in h.get_devices():
+            _test_gram_pairwise(device, expect_tiles=True)
+    finally:
+        signatory.enable_profiling_counters(False)
+        signatory.reset_profiling_counters()
+        signatory.impl.signature_kernel_set_tile_elements(previous)
+
+
+def _test_gram_pairwise(device, expect_tiles):
+    path1 = (0.1 * h.get_path(12, 40, 3, device, path_grad=False)).requires_grad_()
+    path2 = (0.1 * h.get_path(9, 30, 3, device, path_grad=False)).requires_grad_()
+    signatory.reset_profiling_counters()
+    gram = signatory.signature_kernel(path1, path2, dyadic_order=1, gram=True)
+    grad = torch.rand_like(gram)
+    gram.backward(grad)
+    path1_grad = path1.grad.clone()
+    path2_grad = path2.grad.clone()
+    path1.grad.zero_()
+    path2.grad.zero_()
+    if expect_tiles:
+        # 3 x 2 blocks of paths
+        assert signatory.profiling_counters()['signature_kernel_tile.calls'] == 6
+        assert signatory.profiling_counters()['signature_kernel_tile_backward.calls'] == 6
+
+    signatory.reset_profiling_counters()
+    repeated1 = path1.repeat_interleave(path2.size(0), dim=0)
+    repeated2 = path2.repeat(path1.size(0), 1, 1)
+    pairwise = signatory.signature_kernel(repeated1, repeated2, dyadic_order=1).view(path1.size(0), path2.size(0))
+    pairwise.backward(grad)
+    if expect_tiles:
+        # 108 pairs, 20 at a time
+        assert signatory.profiling_counters()['signature_kernel_tile.calls'] == 6
+        assert signatory.profiling_counters()['signature_kernel_tile_backward.calls'] == 6
+
+    h.diff(gram, pairwise)
+    h.diff(path1_grad, path1.grad)
+    h.diff(path2_grad, path2.grad)
+
+
+def test_backward():
+    """Tests the backward pass with gradcheck."""
+    for device in h.get_devices():
+        for batch_size1, batch_size2 in ((1, 1), (2, 3)):
+            for input_stream1, input_stream2 in ((2, 3), (4, 4)):
+                for dyadic_order in (0, 1):
+                    for basepoint in (False, True):
+                        for gram in (False, True):
+                            if not gram and batch_size1 != batch_size2:
+                                continue
+                            path1 = h.get_path(batch_size1, input_stream1, 2, device, path_grad=True)
+                            path2 = h.get_path(batch_size2, input_stream2, 2, device, path_grad=True)
+                            torch.autograd.gradcheck(lambda x, y: signatory.signature_kernel(x, y, dyadic_order,
+                                                                                             basepoint, gram),
+                                                     (path1, path2), atol=2e-05, rtol=0.002)
+
+
+def test_errors():
+    """Tests that errors are raised for invalid arguments."""
+    for device in h.get_devices():
+        path = h.get_path(2, 4, 3, device, path_grad=False)
+        with pytest.raises(ValueError):
+            signatory.signature_kernel(path, path[..., :2])
+        with pytest.raises(ValueError):
+            signatory.signature_kernel(path, path[:1])
+        with pytest.raises(ValueError):
+            signatory.signature_kernel(path, path.float())
+        with pytest.raises(ValueError):
+            signatory.signature_kernel(path, path, dyadic_order=-1)
+        with pytest.raises(ValueError):
+            signatory.signature_kernel(path[:, :1], path[:, :1])
+        with pytest.raises(ValueError):
+            signatory.signature_kernel(path[0], path[0])
+        # These are fine
+        signatory.signature_kernel(path, path[:1], gram=True)
+        signatory.signature_kernel(path[:, :1], path[:, :1], basepoint=True)
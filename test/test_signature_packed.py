@@ -0,0 +1,103 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Tests computing the signatures of paths of different lengths, packed into a PackedSequence."""
+
+
+import pytest
+import random
+import torch
+
+from helpers import helpers as h
+from helpers import validation as v
+
+
+tests = ['signature_packed']
+depends = ['signature']
+signatory = v.validate_tests(tests, depends)
+
+
+def test_forward_backward():
+    """Tests that signature_packed gives the same values and gradients as computing each signature separately."""
+    for device in h.get_devices():
+        for lengths in ((2,), (5, 2, 7), (3, 3, 3), (10, 4, 2, 9, 6)):
+            for input_channels in (1, 3):
+                for depth in (1, 2, 4):
+                    for basepoint in (False, True, h.with_grad):
+                        for inverse in (False, True):
+                            for initial in (None, h.with_grad):
+                                for scalar_term in (False, True):
+                                    _test_forward_backward(device, lengths, input_channels, depth, basepoint, inverse,
+                                                           initial, scalar_term)
+    # Long enough to be split up between threads on the CPU
+    lengths = [random.randint(500, 3000) for _ in range(8)]
+    _test_forward_backward('cpu', lengths, 4, 3, h.with_grad, False, None, False)
+
+
+def _test_forward_backward(device, lengths, input_channels, depth, basepoint, inverse, initial, scalar_term):
+    paths = [h.get_path(1, length, input_channels, device, path_grad=True) for length in lengths]
+    basepoint = h.get_basepoint(len(lengths), input_channels, device, basepoint)
+    initial = h.get_initial(len(lengths), input_channels, device, depth, initial, scalar_term)
+
+    packed = torch.nn.utils.rnn.pack_sequence([path[0] for path in paths], enforce_sorted=False)
+    signature = signatory.signature_packed(packed, depth, basepoint=basepoint, inverse=inverse, initial=initial,
+                                           scalar_term=scalar_term)
+    grad = torch.rand_like(signature)
+    signature.backward(grad)
+    path_grads = [path.grad.clone() for path in paths]
+    for path in paths:
+        path.grad.zero_()
+    if isinstance(basepoint, torch.Tensor):
+        basepoint_grad = basepoint.grad.clone()
+        basepoint.grad.zero_()
+    if isinstance(initial, torch.Tensor):
+        initial_grad = initial.grad.clone()
+        initial.grad.zero_()
+
+    true_signature = []
+    for index, path in enumerate(paths):
+        basepoint_ = basepoint[index:index + 1] if isinstance(basepoint, torch.Tensor) else basepoint
+        initial_ = initial[index:index + 1] if isinstance(initial, torch.Tensor) else initial
+        true_signature.append(signatory.signature(path, depth, basepoint=basepoint_, inverse=inverse, initial=initial_,
+                                                  scalar_term=scalar_term))
+    true_signature = torch.cat(true_signature)
+    true_signature.backward(grad)
+
+    h.diff(signature, true_signature)
+    for path, path_grad in zip(paths, path_grads):
+        h.diff(path_grad, path.grad)
+    if isinstance(basepoint, torch.Tensor):
+        h.diff(basepoint_grad, basepoint.grad)
+    if isinstance(initial, torch.Tensor):
+        h.diff(initial_grad, initial.grad)
+
+
+def test_errors():
+    """Tests that invalid arguments are rejected."""
+    for device in h.get_devices():
+        packed = torch.nn.utils.rnn.pack_sequence([torch.rand(4, 3, device=device), torch.rand(1, 3, device=device)],
+                                                  enforce_sorted=False)
+        # A path of only one point
+        with pytest.raises(ValueError):
+            signatory.signature_packed(packed, 2)
+        # ... is fine with a basepoint
+        signatory.signature_packed(packed, 2, basepoint=True)
+        packed = torch.nn.utils.rnn.pack_sequence([torch.rand(4, 3, device=device), torch.rand(2, 3, device=device)],
+                                                  enforce_sorted=False)
+        with pytest.raises(ValueError):
+            signatory.signature_packed(packed, 0)
+        with pytest.raises(ValueError):
+            signatory.signature_packed(packed, 2, basepoint=torch.rand(3, 3, device=device))
+        with pytest.raises(ValueError):
+            signatory.signature_packed(packed, 2, initial=torch.rand(2, 5, device=device))
@@ -0,0 +1,164 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Tests computing signatures by splitting the stream up between devices and processes."""
+
+
+import pytest
+import torch
+from torch import distributed as dist
+from torch import multiprocessing as mp
+import warnings
+
+from helpers import helpers as h
+from helpers import validation as v
+
+
+tests = ['signature_sharded', 'signature_distributed']
+depends = ['signature']
+signatory = v.validate_tests(tests, depends)
+
+
+def _signature_and_grads(fn, path, basepoint, initial, grad):
+    with warnings.catch_warnings():
+        warnings.filterwarnings('ignore', message="Argument 'initial' has been set but argument 'basepoint' has "
+                                                  "not.", category=UserWarning)
+        result = fn(path, basepoint, initial)
+    if isinstance(result, list):
+        result = torch.cat([elem.to(path.device) for elem in result], dim=1)
+    if grad is None:
+        grad = torch.rand_like(result)
+    result.backward(grad)
+    grads = {}
+    for name, tensor in (('path', path), ('basepoint', basepoint), ('initial', initial)):
+        if isinstance(tensor, torch.Tensor) and tensor.requires_grad:
+            grads[name] = tensor.grad.clone()
+            tensor.grad.zero_()
+    return result, grad, grads
+
+
+def test_sharded():
+    """Tests that splitting the stream up between devices gives the same values and gradients as the usual
+    computation."""
+    available_devices = h.get_devices()
+    for num_devices in (1, 2, 3):
+        devices = [available_devices[i % len(available_devices)] for i in range(num_devices)]
+        for input_stream in (2, 3, 10):
+            for stream in (False, True):
+                for basepoint in (False, True, h.with_grad):
+                    for inverse in (False, True):
+                        for initial in (None, h.with_grad):
+                            for scalar_term in (False, True):
+                                _test_sharded(devices, input_stream, stream, basepoint, inverse, initial,
+                                              scalar_term)
+
+
+def _test_sharded(devices, input_stream, stream, basepoint, inverse, initial, scalar_term):
+    path = h.get_path(2, input_stream, 3, devices[0], path_grad=True)
+    basepoint = h.get_basepoint(2, 3, devices[0], basepoint)
+    initial = h.get_initial(2, 3, devices[0], 3, initial, scalar_term)
+
+    def sharded(path_, basepoint_, initial_):
+        return signatory.signature_sharded(path_, 3, devices, stream=stream, basepoint=basepoint_, inverse=inverse,
+                                           initial=initial_, scalar_term=scalar_term)
+
+    def unsharded(path_, basepoint_, initial_):
+        return signatory.signature(path_, 3, stream=stream, basepoint=basepoint_, inverse=inverse, initial=initial_,
+                                   scalar_term=scalar_term)
+
+    sharded_signature, grad, sharded_grads = _signature_and_grads(sharded, path, basepoint, initial, None)
+    signature, _, grads = _signature_and_grads(unsharded, path, basepoint, initial, grad)
+    h.diff(sharded_signature, signature)
+    for name, grad_ in grads.items():
+        h.diff(sharded_grads[name], grad_)
+
+
+def test_sharded_errors():
+    """Tests that errors are raised for invalid arguments."""
+    path = h.get_path(2, 4, 3, 'cpu', path_grad=False)
+    with pytest.raises(ValueError):
+        signatory.signature_sharded(path, 3, [])
+    with pytest.raises(ValueError):
+        signatory.signature_sharded(path[:, :1], 3, ['cpu'])
+
+
+_world_size = 3
+
+
+def _distributed_worker(rank, init_file, stream, basepoint, inverse, initial, scalar_term):
+    dist.init_process_group('gloo', init_method='file://' + init_file, rank=rank, world_size=_world_size)
+    try:
+        # The same on every process.
+        torch.manual_seed(0)
+        path = h.get_path(2, 3 * _world_size + 1, 3, 'cpu', path_grad=True)
+        basepoint = h.get_basepoint(2, 3, 'cpu', basepoint)
+        initial = h.get_initial(2, 3, 'cpu', 3, initial, scalar_term)
+
+        def unsharded(path_, basepoint_, initial_):
+            return signatory.signature(path_, 3, stream=stream, basepoint=basepoint_, inverse=inverse,
+                                       initial=initial_, scalar_term=scalar_term)
+
+        signature, grad, grads = _signature_and_grads(unsharded, path, basepoint, initial, None)
+
+        # Rank 0 gets one more point, so that every process has the same number of increments.
+        start = 0 if rank == 0 else 3 * rank + 1
+        end = 3 * (rank + 1) + 1
+        shard = path[:, start:end].detach().requires_grad_()
+
+        def distributed(shard_, basepoint_, initial_):
+            return signatory.signature_distributed(shard_, 3, stream=stream, basepoint=basepoint_, inverse=inverse,
+                                                   initial=initial_, scalar_term=scalar_term)
+
+        if stream:
+            stream_start = 0 if rank == 0 else start - (0 if basepoint is not False else 1)
+            stream_end = end - (0 if basepoint is not False else 1)
+            signature = signature[:, stream_start:stream_end]
+            grad = grad[:, stream_start:stream_end]
+        # The basepoint is only used on rank 0.
+        shard_basepoint = basepoint if rank == 0 else False
+        distributed_signature, _, distributed_grads = _signature_and_grads(distributed, shard, shard_basepoint,
+                                                                           initial, grad)
+        h.diff(distributed_signature, signature)
+
+        # With stream=False every process used the signature of the whole path, so the gradients with respect to the
+        # path are summed over every process.
+        scale = 1 if stream else _world_size
+        h.diff(distributed_grads['path'], scale * grads['path'][:, start:end])
+        if 'basepoint' in grads and rank == 0:
+            h.diff(distributed_grads['basepoint'], scale * grads['basepoint'])
+        if 'initial' in grads:
+            # The initial value isn't communicated: each process has its own copy of it.
+            if stream:
+                dist.all_reduce(distributed_grads['initial'])
+            h.diff(distributed_grads['initial'], grads['initial'])
+    finally:
+        dist.destroy_process_group()
+
+
+@pytest.mark.skipif(not dist.is_available(), reason="torch.distributed is not available")
+def test_distributed(tmp_path):
+    """Tests that splitting the stream up between processes gives the same values and gradients as the usual
+    computation. (Up to the gradients being summed over every process.)"""
+    run = 0
+    for stream in (False, True):
+        for basepoint in (False, h.with_grad):
+            for inverse in (False, True):
+                for initial in (None, h.with_grad):
+                    for scalar_term in (False, True):
+                        # A fresh file for every process group.
+                        init_file = str(tmp_path / 'init_{}'.format(run))
+                        run += 1
+                        mp.start_processes(_distributed_worker, args=(init_file, stream, basepoint, inverse, initial,
+                                                                      scalar_term),
+                                           nprocs=_world_size, start_method='fork')
@@ -251,3 +251,51 @@ def _test_repeat_and_memory_leaks(class_, batch_size, input_stream, input_channe
         # This one seems to be a bit inconsistent with how much memory is used on each run, so we give some
         # leeway by doubling
         assert one_iteration() <= 2 * memory_used
+
+
+def test_lyndon_cache(tmp_path, monkeypatch):
+    """Tests that the precomputed Lyndon information may be saved to and loaded from a cache directory."""
+    monkeypatch.setenv('SIGNATORY_LYNDON_CACHE', str(tmp_path))
+    for device in h.get_devices():
+        for mode in h.all_modes:
+            path = h.get_path(2, 10, 3, device, path_grad=False)
+            signature = signatory.signature(path, 4)
+            expected = signatory.signature_to_logsignature(signature, 3, 4, mode=mode)
+            filename = tmp_path / 'lyndon_info_3_4_{}.bin'.format(mode)
+            assert filename.exists()  # Saved by the line above
+            # Loaded from the cache
+            h.diff(signatory.signature_to_logsignature(signature, 3, 4, mode=mode), expected)
+            # Recomputed if the cache is invalid
+            filename.write_bytes(b'not a cache file')
+            h.diff(signatory.signature_to_logsignature(signature, 3, 4, mode=mode), expected)
+
+
+def test_stream_blocks():
+    """Tests that computing the logsignature with stream=True gives the same result as going via the signature, when
+    the stream is long enough that it is broken up into several blocks."""
+    for device in h.get_devices():
+        for basepoint in (False, h.with_grad):
+            for inverse in (False, True):
+                for mode in h.all_modes:
+                    path = h.get_path(2, 1000, 4, device, path_grad=True)
+                    basepoint_ = h.get_basepoint(2, 4, device, basepoint)
+                    with warnings.catch_warnings():
+                        warnings.filterwarnings('ignore', message="The logsignature with mode='brackets' has been "
+                                                                  "requested on the GPU.", category=UserWarning)
+                        logsignature = signatory.logsignature(path, 6, stream=True, basepoint=basepoint_,
+                                                              inverse=inverse, mode=mode)
+                        signature = signatory.signature(path, 6, stream=True, basepoint=basepoint_, inverse=inverse)
+                        expected = signatory.signature_to_logsignature(signature, 4, 6, stream=True, mode=mode)
+                    h.diff(logsignature, expected)
+
+                    grad = torch.rand_like(logsignature)
+                    logsignature.backward(grad)
+                    path_grad = path.grad.clone()
+                    path.grad.zero_()
+                    if isinstance(basepoint_, torch.Tensor):
+                        basepoint_grad = basepoint_.grad.clone()
+                        basepoint_.grad.zero_()
+                    expected.backward(grad)
+                    h.diff(path.grad, path_grad)
+                    if isinstance(basepoint_, torch.Tensor):
+                        h.diff(basepoint_.grad, basepoint_grad)
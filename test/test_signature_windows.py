@@ -0,0 +1,108 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Tests computing the signatures of many windows at once."""
+
+
+import pytest
+import random
+import torch
+
+from helpers import helpers as h
+from helpers import validation as v
+
+
+tests = ['signature_windows']
+depends = ['signature']
+signatory = v.validate_tests(tests, depends)
+
+
+def _random_windows(input_stream):
+    starts = []
+    ends = []
+    for _ in range(random.randint(1, 6)):
+        start = random.randint(0, input_stream - 2)
+        end = random.randint(start + 2, input_stream)
+        starts.append(start)
+        ends.append(end)
+    return starts, ends
+
+
+def test_forward_backward():
+    """Tests that signature_windows gives the same values and gradients as computing each window separately."""
+    for device in h.get_devices():
+        for batch_size in (1, 3):
+            for input_stream in (2, 3, 10):
+                for input_channels in (1, 2, 4):
+                    for depth in (1, 2, 3, 5):
+                        for scalar_term in (False, True):
+                            starts, ends = _random_windows(input_stream)
+                            _test_forward_backward(device, batch_size, input_stream, input_channels, depth, starts,
+                                                   ends, scalar_term)
+    # Includes repeated windows, windows starting at zero, and negative indices
+    for device in h.get_devices():
+        _test_forward_backward(device, 2, 8, 3, 4, [0, 0, 2, -4, 5], [8, 8, -1, 8, 7], False)
+
+
+def _test_forward_backward(device, batch_size, input_stream, input_channels, depth, starts, ends, scalar_term):
+    path = h.get_path(batch_size, input_stream, input_channels, device, path_grad=True)
+    windows = signatory.signature_windows(path, depth, starts, ends, scalar_term=scalar_term)
+    grad = torch.rand_like(windows)
+    windows.backward(grad)
+    path_grad = path.grad.clone()
+    path.grad.zero_()
+
+    true_windows = torch.stack([signatory.signature(path[:, start:end], depth, scalar_term=scalar_term)
+                                for start, end in zip(starts, ends)], dim=1)
+    true_windows.backward(grad)
+
+    h.diff(windows, true_windows)
+    h.diff(path_grad, path.grad)
+
+
+def test_reduced_precision():
+    """Tests that paths of dtype float16 and bfloat16 give windows in that dtype, which agree with computing in float32
+    and converting afterwards."""
+    for device in h.get_devices():
+        for dtype in (torch.float16, torch.bfloat16):
+            for scalar_term in (False, True):
+                path = h.get_path(2, 10, 3, device, path_grad=False).to(dtype).requires_grad_()
+                starts, ends = [0, 2, -4], [10, 6, 10]
+                windows = signatory.signature_windows(path, 3, starts, ends, scalar_term=scalar_term)
+                assert windows.dtype == dtype
+                grad = torch.rand_like(windows)
+                windows.backward(grad)
+                assert path.grad.dtype == dtype
+
+                float_path = path.detach().float().requires_grad_()
+                float_windows = signatory.signature_windows(float_path, 3, starts, ends, scalar_term=scalar_term)
+                float_windows.backward(grad.float())
+
+                # As in test_signature.test_reduced_precision
+                eps = torch.finfo(dtype).eps
+                h.diff(windows.float(), float_windows, atol=4 * eps * max(1, float_windows.abs().max().item()))
+                h.diff(path.grad.float(), float_path.grad, atol=16 * eps * max(1, float_path.grad.abs().max().item()))
+
+
+def test_errors():
+    """Tests that invalid windows are rejected."""
+    for device in h.get_devices():
+        path = h.get_path(2, 5, 3, device, path_grad=False)
+        for starts, ends in (([0], [1]),       # fewer than two points
+                             ([3], [2]),       # end before start
+                             ([0], [6]),       # out of range
+                             ([0, 1], [3]),    # mismatched lengths
+                             ([], [])):        # no windows
+            with pytest.raises(ValueError):
+                signatory.signature_windows(path, 2, starts, ends)
@@ -0,0 +1,186 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Tests the hand-written CPU implementations of the tensor algebra operations directly, by comparing them against the
+high-level implementations in terms of PyTorch operations."""
+
+
+import torch
+
+from helpers import helpers as h
+from helpers import validation as v
+
+
+tests = ['impl.tensor_algebra_mult', 'impl.tensor_algebra_mult_into', 'impl.tensor_algebra_mult_into_add',
+         'impl.tensor_algebra_mult_backward', 'impl.tensor_algebra_mult_backward_add', 'impl.tensor_algebra_log',
+         'impl.tensor_algebra_log_backward']
+depends = ['impl.tensor_algebra_set_cpu_kernels_enabled']
+signatory = v.validate_tests(tests, depends)
+
+
+# How the terms of a member of the tensor algebra are laid out in memory. The hand-written implementations handle
+# anything with a contiguous channel dimension; 'channel_strided' checks that anything else falls back correctly.
+_layouts = ('contiguous', 'sliced', 'batch_strided', 'channel_strided')
+
+
+def _random_terms(batch_size, channels, depth, dtype):
+    # Scaled down so that the higher terms don't dominate.
+    return [0.5 * torch.rand(batch_size, channels ** level, dtype=dtype) for level in range(1, depth + 1)]
+
+
+def _with_layout(terms, layout):
+    """Returns a copy of 'terms' laid out in memory as described by 'layout'."""
+    if layout == 'contiguous':
+        return [term.clone() for term in terms]
+    if layout == 'sliced':
+        # As signatures are actually stored: every term is a slice of a single tensor.
+        whole = torch.cat(terms, dim=-1)
+        out = []
+        start = 0
+        for term in terms:
+            out.append(whole.narrow(dim=-1, start=start, length=term.size(-1)))
+            start += term.size(-1)
+        return out
+    if layout == 'batch_strided':
+        out = []
+        for term in terms:
+            big = torch.zeros(2 * term.size(0), term.size(-1), dtype=term.dtype)
+            big[::2] = term
+            out.append(big[::2])
+        return out
+    if layout == 'channel_strided':
+        out = []
+        for term in terms:
+            big = torch.zeros(term.size(0), term.size(-1), 2, dtype=term.dtype)
+            big[..., 0] = term
+            out.append(big[..., 0])
+        return out
+    raise ValueError(layout)
+
+
+def _reciprocals(depth, dtype):
+    return torch.linspace(2, depth, depth - 1, dtype=dtype).reciprocal()
+
+
+def _compare_kernels(fn):
+    """Calls fn() once with the hand-written implementations enabled and once with them disabled, and checks that the
+    results agree."""
+    previous = signatory.impl.tensor_algebra_set_cpu_kernels_enabled(True)
+    try:
+        kernel_results = fn()
+        signatory.impl.tensor_algebra_set_cpu_kernels_enabled(False)
+        generic_results = fn()
+    finally:
+        signatory.impl.tensor_algebra_set_cpu_kernels_enabled(previous)
+    for kernel_result, generic_result in zip(kernel_results, generic_results):
+        atol = 1e-5 if kernel_result.dtype == torch.float32 else 1e-10
+        h.diff(kernel_result, generic_result, atol=atol)
+
+
+def _sizes():
+    for dtype in (torch.float32, torch.float64):
+        for batch_size in (1, 5):
+            for channels in (1, 2, 3):
+                for depth in range(1, 7):
+                    for layout in _layouts:
+                        for batch_threads in (1, 2):
+                            yield dtype, batch_size, channels, depth, layout, batch_threads
+
+
+def test_mult():
+    """Tests multiplication, in place."""
+    for dtype, batch_size, channels, depth, layout, batch_threads in _sizes():
+        terms1 = _random_terms(batch_size, channels, depth, dtype)
+        terms2 = _random_terms(batch_size, channels, depth, dtype)
+        for inverse in (False, True):
+            def fn():
+                arg1 = _with_layout(terms1, layout)
+                arg2 = _with_layout(terms2, layout)
+                signatory.impl.tensor_algebra_mult(arg1, arg2, inverse, batch_threads)
+                return arg1
+
+            _compare_kernels(fn)
+
+
+def test_mult_into():
+    """Tests multiplication, into a separate output."""
+    for dtype, batch_size, channels, depth, layout, batch_threads in _sizes():
+        terms1 = _random_terms(batch_size, channels, depth, dtype)
+        terms2 = _random_terms(batch_size, channels, depth, dtype)
+        out_terms = _random_terms(batch_size, channels, depth, dtype)
+        for inverse in (False, True):
+            for mult_into in (signatory.impl.tensor_algebra_mult_into, signatory.impl.tensor_algebra_mult_into_add):
+                def fn():
+                    # Starts off nonzero, to check that the result is copied or added on as appropriate.
+                    out = _with_layout(out_terms, layout)
+                    mult_into(out, _with_layout(terms1, layout), _with_layout(terms2, layout), inverse,
+                              batch_threads)
+                    return out
+
+                _compare_kernels(fn)
+
+
+def test_mult_backward():
+    """Tests the backward pass through multiplication."""
+    for dtype, batch_size, channels, depth, layout, batch_threads in _sizes():
+        terms1 = _random_terms(batch_size, channels, depth, dtype)
+        terms2 = _random_terms(batch_size, channels, depth, dtype)
+        grad_terms1 = _random_terms(batch_size, channels, depth, dtype)
+        grad_terms2 = _random_terms(batch_size, channels, depth, dtype)
+        for mult_backward in (signatory.impl.tensor_algebra_mult_backward,
+                              signatory.impl.tensor_algebra_mult_backward_add):
+            def fn():
+                grad_arg1 = _with_layout(grad_terms1, layout)
+                # Starts off nonzero, to check that the result is copied or added on as appropriate.
+                grad_arg2 = _with_layout(grad_terms2, layout)
+                mult_backward(grad_arg1, grad_arg2, _with_layout(terms1, layout), _with_layout(terms2, layout),
+                              batch_threads)
+                return grad_arg1 + grad_arg2
+
+            _compare_kernels(fn)
+
+
+def test_log():
+    """Tests the logarithm."""
+    for dtype, batch_size, channels, depth, layout, batch_threads in _sizes():
+        input_terms = _random_terms(batch_size, channels, depth, dtype)
+        reciprocals = _reciprocals(depth, dtype)
+
+        def fn():
+            input_vector = _with_layout(input_terms, layout)
+            output_vector = _with_layout(input_terms, layout)
+            signatory.impl.tensor_algebra_log(output_vector, input_vector, reciprocals, batch_threads)
+            return output_vector
+
+        _compare_kernels(fn)
+
+
+def test_log_backward():
+    """Tests the backward pass through the logarithm."""
+    for dtype, batch_size, channels, depth, layout, batch_threads in _sizes():
+        input_terms = _random_terms(batch_size, channels, depth, dtype)
+        grad_output_terms = _random_terms(batch_size, channels, depth, dtype)
+        grad_input_terms = _random_terms(batch_size, channels, depth, dtype)
+        reciprocals = _reciprocals(depth, dtype)
+
+        def fn():
+            input_vector = _with_layout(input_terms, layout)
+            grad_output_vector = _with_layout(grad_output_terms, layout)
+            # Starts off nonzero, to check that the result is added on to it.
+            grad_input_vector = _with_layout(grad_input_terms, layout)
+            signatory.impl.tensor_algebra_log_backward(grad_output_vector, grad_input_vector, input_vector,
+                                                       reciprocals, batch_threads)
+            return grad_input_vector
+
+        _compare_kernels(fn)
@@ -0,0 +1,152 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Tests the operators registered for use with TorchScript: torch.ops.signatory.*."""
+
+
+import io
+import pytest
+import torch
+
+from helpers import helpers as h
+from helpers import validation as v
+
+
+# The operators being tested aren't part of the signatory namespace; they are registered when it is imported.
+tests = []
+depends = ['signature', 'signature_to_logsignature', 'multi_signature_combine']
+signatory = v.validate_tests(tests, depends)
+
+
+@torch.jit.script
+def _scripted_signature(path, depth: int, stream: bool, basepoint: torch.Tensor, inverse: bool,
+                        initial: torch.Tensor, scalar_term: bool):
+    return torch.ops.signatory.signature(path, depth, stream, basepoint, inverse, initial, scalar_term)
+
+
+def test_signature():
+    """Tests that torch.ops.signatory.signature gives the same values and gradients as signatory.signature."""
+    for device in h.get_devices():
+        for stream in (False, True):
+            for inverse in (False, True):
+                for scalar_term in (False, True):
+                    path = h.get_path(2, 6, 3, device, path_grad=True)
+                    basepoint = h.get_basepoint(2, 3, device, h.with_grad)
+                    initial = h.get_initial(2, 3, device, 3, h.with_grad, scalar_term)
+                    signature = _scripted_signature(path, 3, stream, basepoint, inverse, initial, scalar_term)
+                    grad = torch.rand_like(signature)
+                    signature.backward(grad)
+                    grads = [tensor.grad.clone() for tensor in (path, basepoint, initial)]
+                    for tensor in (path, basepoint, initial):
+                        tensor.grad.zero_()
+
+                    true_signature = signatory.signature(path, 3, stream=stream, basepoint=basepoint, inverse=inverse,
+                                                         initial=initial, scalar_term=scalar_term)
+                    true_signature.backward(grad)
+                    h.diff(signature, true_signature)
+                    for grad_, tensor in zip(grads, (path, basepoint, initial)):
+                        h.diff(grad_, tensor.grad)
+
+        # Without a basepoint or initial value
+        path = h.get_path(2, 6, 3, device, path_grad=False)
+        h.diff(torch.ops.signatory.signature(path, 3), signatory.signature(path, 3))
+
+
+def test_signature_to_logsignature():
+    """Tests that torch.ops.signatory.signature_to_logsignature gives the same values and gradients as
+    signatory.signature_to_logsignature."""
+    for device in h.get_devices():
+        for mode in ('expand', 'brackets', 'words'):
+            for stream in (False, True):
+                lyndon_info = torch.classes.signatory.LyndonInfo(3, 4, mode)
+                path = h.get_path(2, 6, 3, device, path_grad=False)
+                signature = signatory.signature(path, 4, stream=stream).requires_grad_()
+                logsignature = torch.ops.signatory.signature_to_logsignature(signature, lyndon_info, stream)
+                grad = torch.rand_like(logsignature)
+                logsignature.backward(grad)
+                signature_grad = signature.grad.clone()
+                signature.grad.zero_()
+
+                true_logsignature = signatory.signature_to_logsignature(signature, 3, 4, stream=stream, mode=mode)
+                true_logsignature.backward(grad)
+                h.diff(logsignature, true_logsignature)
+                h.diff(signature_grad, signature.grad)
+
+
+def test_signature_combine():
+    """Tests that torch.ops.signatory.signature_combine gives the same values and gradients as
+    signatory.multi_signature_combine."""
+    for device in h.get_devices():
+        for scalar_term in (False, True):
+            sigtensors = [signatory.signature(h.get_path(2, 4, 3, device, path_grad=False), 3,
+                                              scalar_term=scalar_term).requires_grad_() for _ in range(3)]
+            combined = torch.ops.signatory.signature_combine(sigtensors, 3, 3, scalar_term)
+            grad = torch.rand_like(combined)
+            combined.backward(grad)
+            sigtensor_grads = [sigtensor.grad.clone() for sigtensor in sigtensors]
+            for sigtensor in sigtensors:
+                sigtensor.grad.zero_()
+
+            true_combined = signatory.multi_signature_combine(sigtensors, 3, 3, scalar_term=scalar_term)
+            true_combined.backward(grad)
+            h.diff(combined, true_combined)
+            for sigtensor_grad, sigtensor in zip(sigtensor_grads, sigtensors):
+                h.diff(sigtensor_grad, sigtensor.grad)
+
+
+def test_once_differentiable():
+    """Tests that the operators refuse to be differentiated twice, rather than silently giving wrong gradients."""
+    for device in h.get_devices():
+        path = h.get_path(2, 6, 3, device, path_grad=True)
+        signature = torch.ops.signatory.signature(path, 3)
+        with pytest.raises(RuntimeError):
+            torch.autograd.grad(signature, path, torch.rand_like(signature, requires_grad=True), create_graph=True)
+
+        lyndon_info = torch.classes.signatory.LyndonInfo(3, 3, 'words')
+        signature = signatory.signature(path, 3).detach().requires_grad_()
+        logsignature = torch.ops.signatory.signature_to_logsignature(signature, lyndon_info)
+        with pytest.raises(RuntimeError):
+            torch.autograd.grad(logsignature, signature, torch.rand_like(logsignature, requires_grad=True),
+                                create_graph=True)
+
+        combined = torch.ops.signatory.signature_combine([signature, signature], 3, 3)
+        with pytest.raises(RuntimeError):
+            torch.autograd.grad(combined, signature, torch.rand_like(combined, requires_grad=True), create_graph=True)
+
+        # Still fine if the backward pass doesn't need to be differentiable.
+        grad, = torch.autograd.grad(combined, signature, torch.rand_like(combined), create_graph=True)
+        assert not grad.requires_grad
+
+
+class _LogSignatureModule(torch.nn.Module):
+    def __init__(self):
+        super(_LogSignatureModule, self).__init__()
+        self.lyndon_info = torch.classes.signatory.LyndonInfo(3, 3, 'brackets')
+
+    def forward(self, path):
+        signature = torch.ops.signatory.signature(path, 3)
+        return torch.ops.signatory.signature_to_logsignature(signature, self.lyndon_info)
+
+
+def test_save_load():
+    """Tests that a scripted module using the operators, and holding a LyndonInfo, may be saved and loaded."""
+    module = torch.jit.script(_LogSignatureModule())
+    buffer = io.BytesIO()
+    torch.jit.save(module, buffer)
+    buffer.seek(0)
+    loaded = torch.jit.load(buffer)
+
+    path = h.get_path(2, 6, 3, 'cpu', path_grad=False)
+    h.diff(loaded(path), module(path))
+    h.diff(loaded(path), signatory.signature_to_logsignature(signatory.signature(path, 3), 3, 3, mode='brackets'))
@@ -0,0 +1,72 @@
+# Copyright 2019 Patrick Kidger. All Rights Reserved.
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+#    http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+# =========================================================================
+"""Tests using a Workspace with the signature and logsignature functions."""
+
+
+import torch
+
+from helpers import helpers as h
+from helpers import validation as v
+
+
+tests = ['Workspace']
+depends = ['signature', 'logsignature']
+signatory = v.validate_tests(tests, depends)
+
+
+def test_workspace():
+    """Tests that using a workspace doesn't change the results, even when it's reused across calls of different
+    sizes."""
+    for device in h.get_devices():
+        workspace = signatory.Workspace()
+        for batch_size, input_stream, input_channels, depth in ((1, 4, 2, 3), (5, 10, 3, 4), (2, 3, 2, 2),
+                                                                (5, 10, 3, 4)):
+            for stream in (False, True):
+                for inverse in (False, True):
+                    for mode in h.all_modes:
+                        _test_workspace(workspace, device, batch_size, input_stream, input_channels, depth, stream,
+                                        inverse, mode)
+        workspace.clear()
+        _test_workspace(workspace, device, 2, 5, 3, 3, False, False, h.words_mode)
+
+
+def _test_workspace(workspace, device, batch_size, input_stream, input_channels, depth, stream, inverse, mode):
+    path = h.get_path(batch_size, input_stream, input_channels, device, path_grad=True)
+    basepoint = h.get_basepoint(batch_size, input_channels, device, h.without_grad)
+
+    signature = signatory.signature(path, depth, stream=stream, basepoint=basepoint, inverse=inverse)
+    workspace_signature = signatory.signature(path, depth, stream=stream, basepoint=basepoint, inverse=inverse,
+                                              workspace=workspace)
+    h.diff(signature, workspace_signature)
+
+    grad = torch.rand_like(signature)
+    signature.backward(grad)
+    path_grad = path.grad.clone()
+    path.grad.zero_()
+    workspace_signature.backward(grad)
+    h.diff(path_grad, path.grad)
+    path.grad.zero_()
+
+    logsignature = signatory.logsignature(path, depth, stream=stream, basepoint=basepoint, inverse=inverse, mode=mode)
+    workspace_logsignature = signatory.logsignature(path, depth, stream=stream, basepoint=basepoint, inverse=inverse,
+                                                    mode=mode, workspace=workspace)
+    h.diff(logsignature, workspace_logsignature)
+
+    grad = torch.rand_like(logsignature)
+    logsignature.backward(grad)
+    path_grad = path.grad.clone()
+    path.grad.zero_()
+    workspace_logsignature.backward(grad)
+    h.diff(path_grad, path.grad)